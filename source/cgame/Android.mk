@@ -12,6 +12,7 @@ LOCAL_SRC_FILES := \
   ../gameshared/gs_players.c \
   ../gameshared/gs_pmove.c \
   ../gameshared/gs_slidebox.c \
+  ../gameshared/gs_tracecache.c \
   ../gameshared/gs_weapondefs.c \
   ../gameshared/gs_weapons.c \
   ../gameshared/q_math.c \
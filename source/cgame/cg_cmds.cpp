@@ -1286,6 +1286,7 @@ static const cgcmd_t cgcmds[] =
 	{ "weaplast", CG_Cmd_LastWeapon_f, true },
 	{ "weapcross", CG_Cmd_WeaponCross_f, true },
 	{ "viewpos", CG_Viewpos_f, true },
+	{ "cg_tracecachestats", CG_TraceCacheStats_f, true },
 	{ "players", NULL, false },
 	{ "spectators", NULL, false },
 
@@ -714,6 +714,7 @@ struct sfx_s *CG_RegisterSexedSound( int entnum, const char *name );
 extern cvar_t *cg_predict;
 extern cvar_t *cg_predict_optimize;
 extern cvar_t *cg_showMiss;
+extern cvar_t *cg_tracecache;
 
 void CG_PredictedEvent( int entNum, int ev, int parm );
 void CG_Predict_ChangeWeapon( int new_weapon );
@@ -722,6 +723,7 @@ void CG_CheckPredictionError( void );
 void CG_BuildSolidList( void );
 void CG_Trace( trace_t *t, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int ignore, int contentmask );
 int CG_PointContents( const vec3_t point );
+void CG_TraceCacheStats_f( void );
 void CG_Predict_TouchTriggers( pmove_t *pm, vec3_t previous_origin );
 
 //
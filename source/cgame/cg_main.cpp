@@ -27,6 +27,7 @@ centity_t cg_entities[MAX_EDICTS];
 cvar_t *cg_predict;
 cvar_t *cg_predict_optimize;
 cvar_t *cg_showMiss;
+cvar_t *cg_tracecache;
 
 cvar_t *cg_model;
 cvar_t *cg_skin;
@@ -731,6 +732,7 @@ static void CG_RegisterVariables( void )
 	cg_predict =	    trap_Cvar_Get( "cg_predict", "1", 0 );
 	cg_predict_optimize = trap_Cvar_Get( "cg_predict_optimize", "1", 0 );
 	cg_showMiss =	    trap_Cvar_Get( "cg_showMiss", "0", 0 );
+	cg_tracecache =	    trap_Cvar_Get( "cg_tracecache", "1", CVAR_ARCHIVE );
 
 	cg_debugPlayerModels =	trap_Cvar_Get( "cg_debugPlayerModels", "0", CVAR_CHEAT|CVAR_ARCHIVE );
 	cg_debugWeaponModels =	trap_Cvar_Get( "cg_debugWeaponModels", "0", CVAR_CHEAT|CVAR_ARCHIVE );
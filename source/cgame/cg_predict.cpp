@@ -110,6 +110,34 @@ void CG_CheckPredictionError( void )
 	}
 }
 
+/*
+* Trace cache
+*
+* Prediction replays the same moves against the same snapshot every frame,
+* so identical traces are remembered until the solid list is rebuilt.
+*/
+
+static gs_tracecache_t cg_tracecache_frame;
+
+/*
+* CG_TraceCacheStats_f
+*/
+void CG_TraceCacheStats_f( void )
+{
+	const gs_tracecache_t *cache = &cg_tracecache_frame;
+	unsigned int traces = cache->traceHits + cache->traceMisses;
+	unsigned int contents = cache->contentsHits + cache->contentsMisses;
+
+	CG_Printf( "trace cache: %s, %i entries\n", cg_tracecache->integer ? "enabled" : "disabled", GS_TRACECACHE_SIZE );
+	CG_Printf( "  CG_Trace: %u hits, %u misses (%.1f%%)\n", cache->traceHits, 
+		cache->traceMisses, traces ? 100.0f * cache->traceHits / traces : 0.0f );
+	CG_Printf( "  CG_PointContents: %u hits, %u misses (%.1f%%)\n", cache->contentsHits, 
+		cache->contentsMisses, contents ? 100.0f * cache->contentsHits / contents : 0.0f );
+
+	if( trap_Cmd_Argc() > 1 && !Q_stricmp( trap_Cmd_Argv( 1 ), "reset" ) )
+		GS_TraceCache_ResetStats( &cg_tracecache_frame );
+}
+
 /*
 * CG_BuildSolidList
 */
@@ -118,6 +146,9 @@ void CG_BuildSolidList( void )
 	int i;
 	entity_state_t *ent;
 
+	// a new snapshot, the entities are about to move
+	GS_TraceCache_Invalidate( &cg_tracecache_frame );
+
 	cg_numSolids = 0;
 	cg_numTriggers = 0;
 	for( i = 0; i < cg.frame.numEntities; i++ )
@@ -308,9 +339,9 @@ static void CG_ClipMoveToEntities( const vec3_t start, const vec3_t mins, const
 }
 
 /*
-* CG_Trace
+* CG_TraceUncached
 */
-void CG_Trace( trace_t *t, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int ignore, int contentmask )
+static void CG_TraceUncached( trace_t *t, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int ignore, int contentmask )
 {
 	// check against world
 	trap_CM_TransformedBoxTrace( t, start, end, mins, maxs, NULL, contentmask, NULL, NULL );
@@ -323,9 +354,9 @@ void CG_Trace( trace_t *t, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, i
 }
 
 /*
-* CG_PointContents
+* CG_PointContentsUncached
 */
-int CG_PointContents( const vec3_t point )
+static int CG_PointContentsUncached( const vec3_t point )
 {
 	int i;
 	entity_state_t *ent;
@@ -348,6 +379,42 @@ int CG_PointContents( const vec3_t point )
 	return contents;
 }
 
+/*
+* CG_Trace
+*/
+void CG_Trace( trace_t *t, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int ignore, int contentmask )
+{
+	if( !cg_tracecache->integer )
+	{
+		CG_TraceUncached( t, start, mins, maxs, end, ignore, contentmask );
+		return;
+	}
+
+	if( GS_TraceCache_FindTrace( &cg_tracecache_frame, t, start, mins, maxs, end, ignore, contentmask ) )
+		return;
+
+	CG_TraceUncached( t, start, mins, maxs, end, ignore, contentmask );
+	GS_TraceCache_StoreTrace( &cg_tracecache_frame, t, start, mins, maxs, end, ignore, contentmask );
+}
+
+/*
+* CG_PointContents
+*/
+int CG_PointContents( const vec3_t point )
+{
+	int contents;
+
+	if( !cg_tracecache->integer )
+		return CG_PointContentsUncached( point );
+
+	if( GS_TraceCache_FindContents( &cg_tracecache_frame, point, &contents ) )
+		return contents;
+
+	contents = CG_PointContentsUncached( point );
+	GS_TraceCache_StoreContents( &cg_tracecache_frame, point, contents );
+	return contents;
+}
+
 
 static float predictedSteps[CMD_BACKUP]; // for step smoothing
 /*
@@ -82,6 +82,8 @@ void CL_Stop_f( void )
 	CL_SetDemoMetaKeyValue( "matchname", cl.configstrings[CS_MATCHNAME] );
 	CL_SetDemoMetaKeyValue( "matchscore", cl.configstrings[CS_MATCHSCORE] );
 	CL_SetDemoMetaKeyValue( "matchuuid", cl.configstrings[CS_MATCHUUID] );
+	cls.demo.meta_data_realsize = SNAP_SetDemoMetaSeekIndex( cls.demo.meta_data, sizeof( cls.demo.meta_data ), 
+		cls.demo.meta_data_realsize, &cls.demo.seekindex );
 
 	FS_FCloseFile( cls.demo.file );
 
@@ -350,6 +352,8 @@ void CL_ReadDemoPackets( void )
 */
 void CL_LatchedDemoJump( void )
 {
+	const snap_demokeyframe_t *keyframe;
+
 	if( cls.demo.paused || ! cls.demo.play_jump_latched ) {
 		return;
 	}
@@ -361,10 +365,29 @@ void CL_LatchedDemoJump( void )
 
 	CL_AdjustServerTime( 1 );
 
+	// restart from the last keyframe before the target time instead of parsing
+	// every message in between, when the demo has a seek index
+	keyframe = SNAP_FindDemoKeyframe( &cls.demo.seekindex, cls.demo.play_jump_time );
+
 	if( cl.serverTime < cl.snapShots[cl.receivedSnapNum&UPDATE_MASK].serverTime )
 	{
-		demofilelen = demofilelentotal;
-		FS_Seek( demofilehandle, 0, FS_SEEK_SET );
+		if( keyframe )
+		{
+			demofilelen = demofilelentotal - keyframe->offset;
+			FS_Seek( demofilehandle, keyframe->offset, FS_SEEK_SET );
+		}
+		else
+		{
+			demofilelen = demofilelentotal;
+			FS_Seek( demofilehandle, 0, FS_SEEK_SET );
+		}
+		cl.currentSnapNum = cl.receivedSnapNum = 0;
+		cls.lastExecutedServerCommand = 0;
+	}
+	else if( keyframe && keyframe->offset > FS_Tell( demofilehandle ) )
+	{
+		demofilelen = demofilelentotal - keyframe->offset;
+		FS_Seek( demofilehandle, keyframe->offset, FS_SEEK_SET );
 		cl.currentSnapNum = cl.receivedSnapNum = 0;
 	}
 
@@ -22,6 +22,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "client.h"
 #include "ftlib.h"
 #include "../qcommon/asyncstream.h"
+#include "../qcommon/compression.h"
 #include "../qalgo/hash.h"
 
 cvar_t *cl_stereo_separation;
@@ -35,6 +36,7 @@ cvar_t *cl_maxfps;
 cvar_t *cl_sleep;
 cvar_t *cl_pps;
 cvar_t *cl_compresspackets;
+cvar_t *cl_bitpackedsnaps;
 cvar_t *cl_shownet;
 
 cvar_t *cl_extrapolationTime;
@@ -225,15 +227,20 @@ static void CL_Quit_f( void )
 */
 static void CL_SendConnectPacket( void )
 {
+	int protocol;
+
 	userinfo_modified = false;
 
+	// the older protocol gets byte-aligned snapshots from the server
+	protocol = cl_bitpackedsnaps->integer ? APP_PROTOCOL_VERSION : APP_LEGACY_PROTOCOL_VERSION;
+
 	Com_DPrintf("CL_MM_Initialized: %d, cls.mm_ticket: %u\n", CL_MM_Initialized(), cls.mm_ticket );
 	if( CL_MM_Initialized() && cls.mm_ticket != 0 )
 		Netchan_OutOfBandPrint( cls.socket, &cls.serveraddress, "connect %i %i %i \"%s\" %i %u\n",
-				APP_PROTOCOL_VERSION, Netchan_GamePort(), cls.challenge, Cvar_Userinfo(), 0, cls.mm_ticket );
+				protocol, Netchan_GamePort(), cls.challenge, Cvar_Userinfo(), 0, cls.mm_ticket );
 	else
 		Netchan_OutOfBandPrint( cls.socket, &cls.serveraddress, "connect %i %i %i \"%s\" %i\n",
-				APP_PROTOCOL_VERSION, Netchan_GamePort(), cls.challenge, Cvar_Userinfo(), 0 );
+				protocol, Netchan_GamePort(), cls.challenge, Cvar_Userinfo(), 0 );
 }
 
 /*
@@ -1091,6 +1098,33 @@ void CL_Reconnect_f( void )
 	Mem_TempFree( servername );
 }
 
+/*
+* CL_SetNetchanCompression
+*/
+static void CL_SetNetchanCompression( const char *line )
+{
+	const char *s = line, *token;
+	int compressor;
+
+	cls.netchan.compressor = COMPRESSOR_ZLIB;
+	cls.netchan.compressdict = false;
+
+	token = COM_Parse( &s );
+	if( !token[0] )
+		return;
+
+	compressor = Com_FindCompressor( token );
+	if( !Com_CompressorAvailable( compressor ) )
+	{
+		Com_Printf( "Server picked unavailable compressor %s\n", token );
+		return;
+	}
+
+	cls.netchan.compressor = compressor;
+	token = COM_Parse( &s );
+	cls.netchan.compressdict = atoi( token ) != 0 && Com_CompressionDictionaryChecksum() != 0;
+}
+
 /*
 * CL_ConnectionlessPacket
 * 
@@ -1178,6 +1212,9 @@ static void CL_ConnectionlessPacket( const socket_t *socket, const netadr_t *add
 		Q_strncpyz( cls.session, MSG_ReadStringLine( msg ), sizeof( cls.session ) );
 
 		Netchan_Setup( &cls.netchan, socket, address, Netchan_GamePort() );
+
+		// the compressor picked by the server, zlib if there's none
+		CL_SetNetchanCompression( MSG_ReadStringLine( msg ) );
 		memset( cl.configstrings, 0, sizeof( cl.configstrings ) );
 		CL_SetClientState( CA_HANDSHAKE );
 		CL_AddReliableCommand( "new" );
@@ -1337,7 +1374,7 @@ static bool CL_ProcessPacket( netchan_t *netchan, msg_t *msg )
 	MSG_ReadLong( msg ); // sequence_ack
 	if( msg->compressed )
 	{
-		zerror = Netchan_DecompressMessage( msg );
+		zerror = Netchan_DecompressMessage( netchan, msg );
 		if( zerror < 0 )
 		{
 			// compression error. Drop the packet
@@ -2078,6 +2115,7 @@ static void CL_InitLocal( void )
 	cl_sleep =		Cvar_Get( "cl_sleep", "0", CVAR_ARCHIVE );
 	cl_pps =		Cvar_Get( "cl_pps", "40", CVAR_ARCHIVE );
 	cl_compresspackets =	Cvar_Get( "cl_compresspackets", "1", CVAR_ARCHIVE );
+	cl_bitpackedsnaps =	Cvar_Get( "cl_bitpackedsnaps", "1", CVAR_ARCHIVE );
 
 	cl_extrapolationTime =	Cvar_Get( "cl_extrapolationTime", "0", CVAR_DEVELOPER );
 	cl_extrapolate = Cvar_Get( "cl_extrapolate", "1", CVAR_ARCHIVE );
@@ -2159,6 +2197,12 @@ static void CL_InitLocal( void )
 	Cvar_Get( "hand", "0", CVAR_USERINFO | CVAR_ARCHIVE );
 	Cvar_Get( "handicap", "0", CVAR_USERINFO | CVAR_ARCHIVE );
 
+	// advertise the netchan compressors and dictionary we can use to the server
+	Cvar_Get( "cl_compression", "", CVAR_USERINFO | CVAR_READONLY );
+	Cvar_ForceSet( "cl_compression", Com_AvailableCompressors() );
+	Cvar_Get( "cl_compressdict", "", CVAR_USERINFO | CVAR_READONLY );
+	Cvar_ForceSet( "cl_compressdict", Com_CompressionDictionaryChecksum() ? va( "%08x", Com_CompressionDictionaryChecksum() ) : "" );
+
 	Cvar_Get( "cl_download_name", "", CVAR_READONLY );
 	Cvar_Get( "cl_download_percent", "0", CVAR_READONLY );
 
@@ -2421,7 +2465,7 @@ void CL_Netchan_Transmit( msg_t *msg )
 	// do not enable client compression until I fix the compression+fragmentation rare case bug
 	if( ( cl_compresspackets->integer && msg->cursize > 60 ) || cl_compresspackets->integer > 1 )
 	{
-		zerror = Netchan_CompressMessage( msg );
+		zerror = Netchan_CompressMessage( &cls.netchan, msg );
 		if( zerror < 0 ) // it's compression error, just send uncompressed
 		{
 			Com_DPrintf( "CL_Netchan_Transmit (ignoring compression): Compression error %i\n", zerror );
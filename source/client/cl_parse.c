@@ -897,7 +897,7 @@ static void CL_ParseServerData( msg_t *msg )
 	// parse protocol version number
 	i = MSG_ReadLong( msg );
 
-	if( i != APP_PROTOCOL_VERSION && !(cls.demo.playing && i == APP_DEMO_PROTOCOL_VERSION) )
+	if( i != APP_PROTOCOL_VERSION && i != APP_LEGACY_PROTOCOL_VERSION && !(cls.demo.playing && i == APP_DEMO_PROTOCOL_VERSION) )
 		Com_Error( ERR_DROP, "Server returned version %i, not %i", i, APP_PROTOCOL_VERSION );
 
 	cl.servercount = MSG_ReadLong( msg );
@@ -1061,6 +1061,8 @@ static void CL_ParseFrame( msg_t *msg )
 
 				// clear demo meta data, we'll write some keys later
 				cls.demo.meta_data_realsize = SNAP_ClearDemoMeta( cls.demo.meta_data, sizeof( cls.demo.meta_data ) );
+				SNAP_ClearDemoSeekIndex( &cls.demo.seekindex, cl.configstrings[0] );
+				cls.demo.keyframe_requested = false;
 
 				// write out messages to hold the startup information
 				SNAP_BeginDemoRecording( cls.demo.file, 0x10000 + cl.servercount, cl.snapFrameTime, 
@@ -1071,7 +1073,25 @@ static void CL_ParseFrame( msg_t *msg )
 			}
 
 			if( !cls.demo.waiting )
+			{
 				cls.demo.duration = snap->serverTime - cls.demo.basetime;
+
+				// periodically ask for a non-delta frame, so that playback can seek to it.
+				// the keyframe goes in before the message holding the frame is recorded
+				if( SNAP_DemoKeyframeDue( &cls.demo.seekindex, cls.demo.duration ) )
+				{
+					if( !snap->delta )
+					{
+						SNAP_RecordDemoKeyframe( cls.demo.file, &cls.demo.seekindex, cls.demo.duration, cl.configstrings[0] );
+						cls.demo.keyframe_requested = false;
+					}
+					else if( !cls.demo.keyframe_requested )
+					{
+						CL_AddReliableCommand( "nodelta" );
+						cls.demo.keyframe_requested = true;
+					}
+				}
+			}
 			cls.demo.time = cls.demo.duration;
 		}
 
@@ -1419,6 +1439,8 @@ void CL_ParseServerMessage( msg_t *msg )
 
 				MSG_ReadData( msg, cls.demo.meta_data, cls.demo.meta_data_realsize );
 				MSG_SkipData( msg, meta_data_maxsize - cls.demo.meta_data_realsize );
+
+				SNAP_ReadDemoMetaSeekIndex( cls.demo.meta_data, cls.demo.meta_data_realsize, &cls.demo.seekindex );
 			}
 			break;
 
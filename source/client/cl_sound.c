@@ -255,6 +255,9 @@ void CL_SoundModule_Init( bool verbose )
 	import.FS_RemoveFile = FS_RemoveFile;
 	import.FS_GetFileList = FS_GetFileList;
 	import.FS_IsUrl = FS_IsUrl;
+	import.FS_FileMTime = FS_FileMTime;
+	import.FS_MMapBaseFileDetached = FS_MMapBaseFileDetached;
+	import.FS_UnMMapDetached = FS_UnMMapDetached;
 
 	import.Sys_Milliseconds = Sys_Milliseconds;
 	import.Sys_Sleep = Sys_Sleep;
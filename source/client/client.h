@@ -204,6 +204,9 @@ typedef struct
 
 	char meta_data[SNAP_MAX_DEMO_META_DATA_SIZE];
 	size_t meta_data_realsize;
+
+	snap_demoseekindex_t seekindex;
+	bool keyframe_requested;	// waiting for a non-delta frame to write a keyframe
 } cl_demo_t;
 
 typedef cl_demo_t demorec_t;
@@ -327,6 +330,7 @@ extern cvar_t *cl_run;
 extern cvar_t *cl_anglespeedkey;
 
 extern cvar_t *cl_compresspackets;
+extern cvar_t *cl_bitpackedsnaps;
 extern cvar_t *cl_shownet;
 
 extern cvar_t *cl_extrapolationTime;
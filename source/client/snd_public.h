@@ -20,7 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 // snd_public.h -- sound dll information visible to engine
 
-#define	SOUND_API_VERSION   39
+#define	SOUND_API_VERSION   40
 
 #define	ATTN_NONE 0
 
@@ -77,6 +77,9 @@ typedef struct
 	bool ( *FS_RemoveFile )( const char *filename );
 	int ( *FS_GetFileList )( const char *dir, const char *extension, char *buf, size_t bufsize, int start, int end );
 	bool ( *FS_IsUrl )( const char *url );
+	time_t ( *FS_FileMTime )( const char *filename );
+	void *( *FS_MMapBaseFileDetached )( int file, size_t size, size_t offset );
+	void ( *FS_UnMMapDetached )( void *data );
 
 	unsigned int ( *Sys_Milliseconds )( void );
 	void ( *Sys_Sleep )( unsigned int milliseconds );
@@ -27,9 +27,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 //
 //==========================================
 
-static short int alist[MAX_NODES];  //list contains all studied nodes, Open and Closed together
-static int alist_numNodes;
-
 enum
 {
 	NOLIST,
@@ -44,12 +41,43 @@ typedef struct
 	int H;
 
 	short int list;
+	short int heapIndex;		// position in the open list heap, -1 if not in it
+
+	unsigned int generation;	// the node state is only valid when it matches astarGeneration
 
 } astarnode_t;
 
 astarnode_t astarnodes[MAX_NODES];
+static unsigned int astarGeneration;
+
+// open list, binary heap ordered by F = G + H
+static short int astarheap[MAX_NODES];
+static int astarheap_numNodes;
 
 struct astarpath_s *Apath;
+
+//==========================================
+// path query cache
+// paths only depend on the links graph, so results are kept
+// until a link is added or removed
+//==========================================
+#define ASTAR_CACHE_SIZE	512		// must be a power of two
+
+typedef struct
+{
+	bool valid;
+	bool failed;
+	short int originNode;
+	short int goalNode;
+	int movetypes;
+	int numNodes;
+	int totalDistance;
+	short int *nodes;
+} astarcache_t;
+
+static astarcache_t astarcache[ASTAR_CACHE_SIZE];
+static bool astarcacheDirty;
+
 //==========================================
 //
 //
@@ -66,9 +94,26 @@ static int ValidLinksMask;
 //
 //==========================================
 
+static inline astarnode_t *AStar_Node( int node )
+{
+	astarnode_t *anode = &astarnodes[node];
+
+	if( anode->generation != astarGeneration )
+	{
+		anode->generation = astarGeneration;
+		anode->parent = 0;
+		anode->G = 0;
+		anode->H = 0;
+		anode->list = NOLIST;
+		anode->heapIndex = -1;
+	}
+
+	return anode;
+}
+
 int AStar_nodeIsInClosed( int node )
 {
-	if( astarnodes[node].list == CLOSEDLIST )
+	if( AStar_Node( node )->list == CLOSEDLIST )
 		return 1;
 
 	return 0;
@@ -76,7 +121,7 @@ int AStar_nodeIsInClosed( int node )
 
 int AStar_nodeIsInOpen( int node )
 {
-	if( astarnodes[node].list == OPENLIST )
+	if( AStar_Node( node )->list == OPENLIST )
 		return 1;
 
 	return 0;
@@ -84,28 +129,93 @@ int AStar_nodeIsInOpen( int node )
 
 static void AStar_InitLists( void )
 {
-	memset( astarnodes, 0, sizeof( astarnodes ) ); //jabot092
+	// bumping the generation invalidates the state of all nodes
+	astarGeneration++;
+	if( !astarGeneration )
+	{
+		memset( astarnodes, 0, sizeof( astarnodes ) );
+		astarGeneration = 1;
+	}
+
 	if( Apath ) Apath->numNodes = 0;
-	alist_numNodes = 0;
+	astarheap_numNodes = 0;
 }
 
-static int AStar_PLinkDistance( int n1, int n2 )
+static inline int AStar_NodeF( int node )
 {
-	int i;
+	return astarnodes[node].G + astarnodes[node].H;
+}
 
-	//teleporters are exceptional
-	//if( nodes[n1].flags & NODEFLAGS_TELEPORTER_IN )
-	//	n1++; //it's tele out is stored in the next node in the array
+static void AStar_HeapMoveUp( int pos )
+{
+	int node = astarheap[pos];
+	int F = AStar_NodeF( node );
 
-	for( i = 0; i < pLinks[n1].numLinks; i++ )
+	while( pos > 0 )
 	{
-		if( pLinks[n1].nodes[i] == n2 )
-		{
-			return (int)pLinks[n1].dist[i];
-		}
+		int parent = ( pos - 1 ) >> 1;
+		if( AStar_NodeF( astarheap[parent] ) <= F )
+			break;
+
+		astarheap[pos] = astarheap[parent];
+		astarnodes[astarheap[pos]].heapIndex = pos;
+		pos = parent;
 	}
 
-	return -1;
+	astarheap[pos] = node;
+	astarnodes[node].heapIndex = pos;
+}
+
+static void AStar_HeapMoveDown( int pos )
+{
+	int node = astarheap[pos];
+	int F = AStar_NodeF( node );
+
+	while( 1 )
+	{
+		int child = ( pos << 1 ) + 1;
+		if( child >= astarheap_numNodes )
+			break;
+
+		if( child + 1 < astarheap_numNodes && AStar_NodeF( astarheap[child + 1] ) < AStar_NodeF( astarheap[child] ) )
+			child++;
+		if( F <= AStar_NodeF( astarheap[child] ) )
+			break;
+
+		astarheap[pos] = astarheap[child];
+		astarnodes[astarheap[pos]].heapIndex = pos;
+		pos = child;
+	}
+
+	astarheap[pos] = node;
+	astarnodes[node].heapIndex = pos;
+}
+
+static void AStar_HeapPush( int node )
+{
+	astarheap[astarheap_numNodes] = node;
+	astarheap_numNodes++;
+	AStar_HeapMoveUp( astarheap_numNodes - 1 );
+}
+
+static int AStar_HeapPop( void )
+{
+	int best;
+
+	if( !astarheap_numNodes )
+		return -1;
+
+	best = astarheap[0];
+	astarnodes[best].heapIndex = -1;
+
+	astarheap_numNodes--;
+	if( astarheap_numNodes )
+	{
+		astarheap[0] = astarheap[astarheap_numNodes];
+		AStar_HeapMoveDown( 0 );
+	}
+
+	return best;
 }
 
 static int  Astar_HDist_ManhatanGuess( int node )
@@ -133,108 +243,63 @@ static int  Astar_HDist_ManhatanGuess( int node )
 
 static void AStar_PutInClosed( int node )
 {
-	if( !astarnodes[node].list )
-	{
-		alist[alist_numNodes] = node;
-		alist_numNodes++;
-	}
-
-	astarnodes[node].list = CLOSEDLIST;
+	AStar_Node( node )->list = CLOSEDLIST;
 }
 
 static void AStar_PutAdjacentsInOpen( int node )
 {
 	int i;
+	const nav_plink_t *plink = &pLinks[node];
 
-	for( i = 0; i < pLinks[node].numLinks; i++ )
+	for( i = 0; i < plink->numLinks; i++ )
 	{
 		int addnode;
+		int plinkDist;
+		astarnode_t *anode;
 
 		//ignore invalid links
-		if( !( ValidLinksMask & pLinks[node].moveType[i] ) )
+		if( !( ValidLinksMask & plink->moveType[i] ) )
 			continue;
 
-		addnode = pLinks[node].nodes[i];
+		addnode = plink->nodes[i];
 
 		//ignore self
 		if( addnode == node )
 			continue;
 
+		anode = AStar_Node( addnode );
+
 		//ignore if it's already in closed list
-		if( AStar_nodeIsInClosed( addnode ) )
+		if( anode->list == CLOSEDLIST )
 			continue;
 
+		// link distances are computed when the links are added
+		plinkDist = plink->dist[i];
+
 		//if it's already inside open list
-		if( AStar_nodeIsInOpen( addnode ) )
+		if( anode->list == OPENLIST )
 		{
-			int plinkDist;
-
-			plinkDist = AStar_PLinkDistance( node, addnode );
-			if( plinkDist != -1 )
+			//compare G distances and choose best parent
+			if( anode->G > ( astarnodes[node].G + plinkDist ) )
 			{
-				//compare G distances and choose best parent
-				if( astarnodes[addnode].G > ( astarnodes[node].G + plinkDist ) )
-				{
-					astarnodes[addnode].parent = node;
-					astarnodes[addnode].G = astarnodes[node].G + plinkDist;
-				}
+				anode->parent = node;
+				anode->G = astarnodes[node].G + plinkDist;
+				if( anode->heapIndex >= 0 )
+					AStar_HeapMoveUp( anode->heapIndex );
 			}
 		}
 		else
 		{
 			//just put it in
-
-			int plinkDist;
-
-			plinkDist = AStar_PLinkDistance( node, addnode );
-			if( plinkDist == -1 )
-			{
-				plinkDist = AStar_PLinkDistance( addnode, node );
-				if( plinkDist == -1 )
-					plinkDist = 999; //jalFIXME
-
-				//ERROR
-				//printf("WARNING: AStar_PutAdjacentsInOpen - Couldn't find distance between nodes\n");
-			}
-
-			//put in global list
-			if( !astarnodes[addnode].list )
-			{
-				alist[alist_numNodes] = addnode;
-				alist_numNodes++;
-			}
-
-			astarnodes[addnode].parent = node;
-			astarnodes[addnode].G = astarnodes[node].G + plinkDist;
-			astarnodes[addnode].H = Astar_HDist_ManhatanGuess( addnode );
-			astarnodes[addnode].list = OPENLIST;
+			anode->parent = node;
+			anode->G = astarnodes[node].G + plinkDist;
+			anode->H = Astar_HDist_ManhatanGuess( addnode );
+			anode->list = OPENLIST;
+			AStar_HeapPush( addnode );
 		}
 	}
 }
 
-static int AStar_FindInOpen_BestF( void )
-{
-	int i;
-	int bestF = -1;
-	int best = -1;
-
-	for( i = 0; i < alist_numNodes; i++ )
-	{
-		int node = alist[i];
-
-		if( astarnodes[node].list != OPENLIST )
-			continue;
-
-		if( bestF == -1 || bestF > ( astarnodes[node].G + astarnodes[node].H ) )
-		{
-			bestF = astarnodes[node].G + astarnodes[node].H;
-			best = node;
-		}
-	}
-	//printf("BEST:%i\n", best);
-	return best;
-}
-
 static void AStar_ListsToPath( void )
 {
 	int count = 0;
@@ -264,7 +329,7 @@ static int AStar_FillLists( void )
 	AStar_PutAdjacentsInOpen( currentNode );
 
 	//find best adjacent and make it our current
-	currentNode = AStar_FindInOpen_BestF();
+	currentNode = AStar_HeapPop();
 
 	return ( currentNode != -1 ); //if -1 path is blocked
 }
@@ -292,17 +357,130 @@ int AStar_ResolvePath( int n1, int n2, int movetypes )
 	return 1;
 }
 
+//==========================================
+// AStar_InvalidateCache
+// must be called whenever the links graph changes, the cache is
+// only flushed by the next query so adding many links stays cheap
+//==========================================
+void AStar_InvalidateCache( void )
+{
+	astarcacheDirty = true;
+}
+
+//==========================================
+// AStar_FreeCache
+// releases the cached paths and the navigation table
+//==========================================
+void AStar_FreeCache( void )
+{
+	int i;
+
+	for( i = 0; i < ASTAR_CACHE_SIZE; i++ )
+	{
+		if( astarcache[i].nodes )
+			G_Free( astarcache[i].nodes );
+	}
+	memset( astarcache, 0, sizeof( astarcache ) );
+	astarcacheDirty = false;
+
+	AI_NavTable_Free();
+}
+
+//==========================================
+// AStar_RebuildCache
+// drops everything computed from an older links graph
+// and starts over with the current one
+//==========================================
+void AStar_RebuildCache( void )
+{
+	AStar_FreeCache();
+	AI_NavTable_Init();
+}
+
+static astarcache_t *AStar_CacheEntry( int origin, int goal, int movetypes )
+{
+	unsigned int hash;
+
+	hash = (unsigned int)origin * 2654435761u;
+	hash ^= (unsigned int)goal * 2246822519u;
+	hash ^= (unsigned int)movetypes * 3266489917u;
+	hash ^= hash >> 15;
+
+	return &astarcache[hash & ( ASTAR_CACHE_SIZE - 1 )];
+}
+
+static void AStar_CacheStore( astarcache_t *entry, int origin, int goal, int movetypes, const struct astarpath_s *path )
+{
+	if( entry->nodes )
+	{
+		G_Free( entry->nodes );
+		entry->nodes = NULL;
+	}
+
+	entry->valid = true;
+	entry->failed = ( path == NULL );
+	entry->originNode = origin;
+	entry->goalNode = goal;
+	entry->movetypes = movetypes;
+	entry->numNodes = 0;
+	entry->totalDistance = 0;
+
+	if( path )
+	{
+		entry->numNodes = path->numNodes;
+		entry->totalDistance = path->totalDistance;
+		if( path->numNodes >= 0 )
+		{
+			entry->nodes = ( short int * )G_Malloc( sizeof( short int ) * ( path->numNodes + 1 ) );
+			memcpy( entry->nodes, path->nodes, sizeof( short int ) * ( path->numNodes + 1 ) );
+		}
+	}
+}
+
 int AStar_GetPath( int origin, int goal, int movetypes, struct astarpath_s *path )
 {
+	astarcache_t *entry;
+	int result;
+
 	Apath = path;
 
 	if( goal < 0 )
 		return 0;
 
+	if( !movetypes )
+		movetypes = DEFAULT_MOVETYPES_MASK;
+
+	if( astarcacheDirty )
+		AStar_RebuildCache();
+
+	// the precomputed table answers the default bot queries without a search
+	result = AI_NavTable_GetPath( origin, goal, movetypes, path );
+	if( result != -1 )
+		return result;
+
+	entry = AStar_CacheEntry( origin, goal, movetypes );
+	if( entry->valid && entry->originNode == origin && entry->goalNode == goal && entry->movetypes == movetypes )
+	{
+		if( entry->failed )
+			return 0;
+
+		path->numNodes = entry->numNodes;
+		path->totalDistance = entry->totalDistance;
+		if( entry->nodes )
+			memcpy( path->nodes, entry->nodes, sizeof( short int ) * ( entry->numNodes + 1 ) );
+		path->originNode = origin;
+		path->goalNode = goal;
+		return 1;
+	}
+
 	if( !AStar_ResolvePath( origin, goal, movetypes ) )
+	{
+		AStar_CacheStore( entry, origin, goal, movetypes, NULL );
 		return 0;
+	}
 
 	path->originNode = origin;
 	path->goalNode = goal;
+	AStar_CacheStore( entry, origin, goal, movetypes, path );
 	return 1;
 }
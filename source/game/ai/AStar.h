@@ -37,3 +37,6 @@ int AStar_nodeIsInPath( int node );
 int AStar_ResolvePath( int origin, int goal, int movetypes );
 //===========================================
 int AStar_GetPath( int origin, int goal, int movetypes, struct astarpath_s *path );
+void AStar_InvalidateCache( void );
+void AStar_FreeCache( void );
+void AStar_RebuildCache( void );
@@ -43,6 +43,7 @@ bool    BOT_ServerCommand( void );
 
 // ai_main.c
 void        AI_InitLevel( void );
+void        AI_Shutdown( void );
 void		AI_AddGoalEntity( edict_t *ent );
 void		AI_AddGoalEntityCustom( edict_t *ent );
 void		AI_AddNavigatableEntity( edict_t *ent, int node );
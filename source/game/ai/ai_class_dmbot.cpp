@@ -1731,7 +1731,7 @@ void BOT_DMclass_InitPersistant( edict_t *self )
 	gsitem_t *item;
 	int i, w;
 
-	self->classname = "dmbot";
+	G_SetClassname( self, "dmbot" );
 
 	if( self->r.client->netname )
 		self->ai->pers.netname = self->r.client->netname;
@@ -1744,7 +1744,7 @@ void BOT_DMclass_InitPersistant( edict_t *self )
 	self->ai->pers.blockedTimeout = BOT_DMClass_BlockedTimeout;
 
 	//available moveTypes for this class
-	self->ai->pers.moveTypesMask = ( LINK_MOVE|LINK_STAIRS|LINK_FALL|LINK_WATER|LINK_WATERJUMP|LINK_JUMPPAD|LINK_PLATFORM|LINK_TELEPORT|LINK_LADDER|LINK_JUMP|LINK_CROUCH );
+	self->ai->pers.moveTypesMask = NAV_TABLE_MOVETYPES;
 
 	//Persistant Inventory Weights (0 = can not pick)
 	memset( self->ai->pers.inventoryWeights, 0, sizeof( self->ai->pers.inventoryWeights ) );
@@ -107,6 +107,8 @@ void AI_DeleteNode( int node )
 		nav.num_nodes--;
 		memset( &nodes[nav.num_nodes], 0, sizeof( nav_node_t ) );
 		memset( &pLinks[nav.num_nodes], 0, sizeof( nav_plink_t ) );
+
+		AStar_InvalidateCache();
 	}
 }
 
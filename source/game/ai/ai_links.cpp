@@ -197,6 +197,8 @@ bool AI_AddLink( int n1, int n2, int linkType )
 	
 	pLinks[n1].numLinks++;
 
+	AStar_InvalidateCache();
+
 	return true;
 }
 
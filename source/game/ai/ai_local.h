@@ -75,6 +75,7 @@ extern cvar_t *sv_botpersonality;
 #define	NAV_FILE_VERSION 10
 #define NAV_FILE_EXTENSION "nav"
 #define NAV_FILE_FOLDER "navigation"
+#define NAV_TABLE_MOVETYPES ( LINK_MOVE|LINK_STAIRS|LINK_FALL|LINK_WATER|LINK_WATERJUMP|LINK_JUMPPAD|LINK_PLATFORM|LINK_TELEPORT|LINK_LADDER|LINK_JUMP|LINK_CROUCH )
 
 #define	AI_STEPSIZE	STEPSIZE    // 18
 #define AI_JUMPABLE_HEIGHT		50
@@ -361,6 +362,12 @@ int	    AI_FlagsForNode( vec3_t origin, edict_t *passent );
 bool    AI_LoadPLKFile( char *mapname );
 void AI_DeleteNode( int node );
 
+// ai_navtable.c
+//----------------------------------------------------------
+void AI_NavTable_Init( void );
+void AI_NavTable_Free( void );
+int AI_NavTable_GetPath( int origin, int goal, int movetypes, struct astarpath_s *path );
+
 
 // ai_tools.c
 //----------------------------------------------------------
@@ -123,6 +123,15 @@ void AI_InitLevel( void )
 	AIWeapons[WEAP_INSTAGUN].RangeWeight[AIWEAP_MELEE_RANGE] = 0.9f;
 }
 
+//==========================================
+// AI_Shutdown
+// Releases map local navigation data
+//==========================================
+void AI_Shutdown( void )
+{
+	AStar_FreeCache();
+}
+
 //==========================================
 // G_FreeAI
 // removes the AI handle from memory
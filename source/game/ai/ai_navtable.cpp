@@ -0,0 +1,429 @@
+/*
+Copyright (C) 2006 Pekka Lampila ("Medar"), Damien Deville ("Pb")
+and German Garcia Fernandez ("Jal") for Chasseur de bots association.
+
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#include "../g_local.h"
+#include "ai_local.h"
+
+//==========================================
+// Precomputed navigation table
+// For the default bot movetypes, the next node and the total cost from every
+// node to every other node are computed on a worker thread once the links of
+// the map are final, and cached to disk next to the .nav file. Path queries
+// then become a walk along the next nodes instead of an A* search.
+// The worker only fills buffers allocated for it up front, memory and files
+// are handled on the main thread.
+//==========================================
+
+#define NAV_TABLE_VERSION 1
+#define NAV_TABLE_EXTENSION "navtable"
+
+// the table takes 6 bytes per pair of nodes, bigger maps keep using A*
+#define NAV_TABLE_MAX_NODES 1024
+
+typedef struct
+{
+	int numNodes;
+	int movetypes;
+	unsigned int checksum;
+	char filename[MAX_QPATH];
+
+	short int *next;			// numNodes * numNodes, -1 when unreachable
+	int *cost;
+
+	nav_plink_t *links;			// copy of the links graph for the worker thread
+	int *heap;					// numNodes * 2, scratch space for the worker thread
+
+	struct qthread_s *thread;
+	struct qmutex_s *lock;		// guards done and abort
+	bool done;
+	bool abort;
+	bool ready;
+} ai_navtable_t;
+
+static ai_navtable_t navtable;
+
+static cvar_t *ai_navtable;
+
+//==========================================
+// AI_NavTable_Checksum
+// identifies the links graph the table was built from
+//==========================================
+static unsigned int AI_NavTable_Checksum( int numNodes, int movetypes )
+{
+	unsigned int hash = 2166136261u;
+	const uint8_t *data;
+	size_t i, size;
+	int n;
+
+	hash = ( hash ^ (unsigned int)numNodes ) * 16777619u;
+	hash = ( hash ^ (unsigned int)movetypes ) * 16777619u;
+
+	for( n = 0; n < numNodes; n++ )
+	{
+		data = ( const uint8_t * )&pLinks[n];
+		size = sizeof( nav_plink_t );
+		for( i = 0; i < size; i++ )
+			hash = ( hash ^ data[i] ) * 16777619u;
+	}
+
+	return hash;
+}
+
+//==========================================
+// AI_NavTable_BuildRow
+// Dijkstra from one node, remembering the first step taken towards every other node
+//==========================================
+static void AI_NavTable_BuildRow( int origin, int *heap, int *heapIndex )
+{
+	int numNodes = navtable.numNodes;
+	short int *next = navtable.next + origin * numNodes;
+	int *cost = navtable.cost + origin * numNodes;
+	int heapSize = 0;
+	int i, node, pos, child, parent;
+
+	for( i = 0; i < numNodes; i++ )
+	{
+		next[i] = -1;
+		cost[i] = -1;
+		heapIndex[i] = -1;
+	}
+
+	cost[origin] = 0;
+	next[origin] = origin;
+	heap[heapSize] = origin;
+	heapIndex[origin] = heapSize++;
+
+	while( heapSize )
+	{
+		const nav_plink_t *plink;
+
+		// pop the closest node
+		node = heap[0];
+		heapIndex[node] = -2;	// settled
+		heapSize--;
+		if( heapSize )
+		{
+			int last = heap[heapSize];
+
+			pos = 0;
+			while( ( child = ( pos << 1 ) + 1 ) < heapSize )
+			{
+				if( child + 1 < heapSize && cost[heap[child + 1]] < cost[heap[child]] )
+					child++;
+				if( cost[last] <= cost[heap[child]] )
+					break;
+				heap[pos] = heap[child];
+				heapIndex[heap[pos]] = pos;
+				pos = child;
+			}
+			heap[pos] = last;
+			heapIndex[last] = pos;
+		}
+
+		plink = &navtable.links[node];
+		for( i = 0; i < plink->numLinks; i++ )
+		{
+			int addnode = plink->nodes[i];
+			int newCost;
+
+			if( !( navtable.movetypes & plink->moveType[i] ) )
+				continue;
+			if( addnode == node || addnode < 0 || addnode >= numNodes )
+				continue;
+			if( heapIndex[addnode] == -2 )
+				continue;
+
+			newCost = cost[node] + plink->dist[i];
+			if( cost[addnode] != -1 && cost[addnode] <= newCost )
+				continue;
+
+			cost[addnode] = newCost;
+			next[addnode] = ( node == origin ) ? addnode : next[node];
+
+			pos = heapIndex[addnode];
+			if( pos < 0 )
+			{
+				pos = heapSize++;
+			}
+
+			// move up
+			while( pos > 0 )
+			{
+				parent = ( pos - 1 ) >> 1;
+				if( cost[heap[parent]] <= newCost )
+					break;
+				heap[pos] = heap[parent];
+				heapIndex[heap[pos]] = pos;
+				pos = parent;
+			}
+			heap[pos] = addnode;
+			heapIndex[addnode] = pos;
+		}
+	}
+
+	next[origin] = -1;
+}
+
+//==========================================
+// AI_NavTable_Save
+//==========================================
+static void AI_NavTable_Save( void )
+{
+	int version = NAV_TABLE_VERSION;
+	int filenum;
+	size_t size = (size_t)navtable.numNodes * navtable.numNodes;
+
+	if( trap_FS_FOpenFile( navtable.filename, &filenum, FS_WRITE ) == -1 )
+		return;
+
+	trap_FS_Write( &version, sizeof( int ), filenum );
+	trap_FS_Write( &navtable.numNodes, sizeof( int ), filenum );
+	trap_FS_Write( &navtable.movetypes, sizeof( int ), filenum );
+	trap_FS_Write( &navtable.checksum, sizeof( unsigned int ), filenum );
+	trap_FS_Write( navtable.next, sizeof( short int ) * size, filenum );
+	trap_FS_Write( navtable.cost, sizeof( int ) * size, filenum );
+
+	trap_FS_FCloseFile( filenum );
+}
+
+//==========================================
+// AI_NavTable_Load
+//==========================================
+static bool AI_NavTable_Load( void )
+{
+	int version, numNodes, movetypes;
+	unsigned int checksum;
+	int filenum;
+	int length;
+	size_t size = (size_t)navtable.numNodes * navtable.numNodes;
+
+	length = trap_FS_FOpenFile( navtable.filename, &filenum, FS_READ );
+	if( length == -1 )
+		return false;
+
+	if( (size_t)length != sizeof( int ) * 3 + sizeof( unsigned int ) + ( sizeof( short int ) + sizeof( int ) ) * size )
+	{
+		trap_FS_FCloseFile( filenum );
+		return false;
+	}
+
+	trap_FS_Read( &version, sizeof( int ), filenum );
+	trap_FS_Read( &numNodes, sizeof( int ), filenum );
+	trap_FS_Read( &movetypes, sizeof( int ), filenum );
+	trap_FS_Read( &checksum, sizeof( unsigned int ), filenum );
+	if( version != NAV_TABLE_VERSION || numNodes != navtable.numNodes
+		|| movetypes != navtable.movetypes || checksum != navtable.checksum )
+	{
+		trap_FS_FCloseFile( filenum );
+		return false;
+	}
+
+	trap_FS_Read( navtable.next, sizeof( short int ) * size, filenum );
+	trap_FS_Read( navtable.cost, sizeof( int ) * size, filenum );
+
+	trap_FS_FCloseFile( filenum );
+
+	return true;
+}
+
+//==========================================
+// AI_NavTable_Aborted
+//==========================================
+static bool AI_NavTable_Aborted( void )
+{
+	bool abort;
+
+	trap_Mutex_Lock( navtable.lock );
+	abort = navtable.abort;
+	trap_Mutex_Unlock( navtable.lock );
+
+	return abort;
+}
+
+//==========================================
+// AI_NavTable_ThreadProc
+//==========================================
+static void *AI_NavTable_ThreadProc( void *param )
+{
+	int origin;
+	int *heap = navtable.heap;
+	int *heapIndex = navtable.heap + navtable.numNodes;
+
+	for( origin = 0; origin < navtable.numNodes; origin++ )
+	{
+		if( AI_NavTable_Aborted() )
+			break;
+		AI_NavTable_BuildRow( origin, heap, heapIndex );
+	}
+
+	// the mutex also publishes the rows written above to the main thread
+	trap_Mutex_Lock( navtable.lock );
+	navtable.done = true;
+	trap_Mutex_Unlock( navtable.lock );
+	return NULL;
+}
+
+//==========================================
+// AI_NavTable_Free
+// stops the worker thread and releases the table
+//==========================================
+void AI_NavTable_Free( void )
+{
+	if( navtable.thread )
+	{
+		trap_Mutex_Lock( navtable.lock );
+		navtable.abort = true;
+		trap_Mutex_Unlock( navtable.lock );
+
+		trap_Thread_Join( navtable.thread );
+		navtable.thread = NULL;
+	}
+
+	if( navtable.lock )
+		trap_Mutex_Destroy( &navtable.lock );
+
+	if( navtable.next )
+		G_Free( navtable.next );
+	if( navtable.cost )
+		G_Free( navtable.cost );
+	if( navtable.links )
+		G_Free( navtable.links );
+	if( navtable.heap )
+		G_Free( navtable.heap );
+
+	memset( &navtable, 0, sizeof( navtable ) );
+}
+
+//==========================================
+// AI_NavTable_Init
+// loads the table from disk or starts building it,
+// once all nodes and links of the map have been added
+//==========================================
+void AI_NavTable_Init( void )
+{
+	size_t size;
+
+	AI_NavTable_Free();
+
+	ai_navtable = trap_Cvar_Get( "ai_navtable", "1", CVAR_ARCHIVE );
+	if( !ai_navtable->integer || nav.editmode || nav.num_nodes < 2 || nav.num_nodes > NAV_TABLE_MAX_NODES )
+		return;
+
+	navtable.numNodes = nav.num_nodes;
+	navtable.movetypes = NAV_TABLE_MOVETYPES;
+	navtable.checksum = AI_NavTable_Checksum( navtable.numNodes, navtable.movetypes );
+	Q_snprintfz( navtable.filename, sizeof( navtable.filename ), "%s/%s.%s", NAV_FILE_FOLDER, level.mapname, NAV_TABLE_EXTENSION );
+
+	size = (size_t)navtable.numNodes * navtable.numNodes;
+	navtable.next = ( short int * )G_Malloc( sizeof( short int ) * size );
+	navtable.cost = ( int * )G_Malloc( sizeof( int ) * size );
+
+	if( AI_NavTable_Load() )
+	{
+		navtable.ready = true;
+		if( developer->integer )
+			G_Printf( "       : loaded navigation table for %i nodes\n", navtable.numNodes );
+		return;
+	}
+
+	// the worker thread uses its own copy of the graph
+	navtable.links = ( nav_plink_t * )G_Malloc( sizeof( nav_plink_t ) * navtable.numNodes );
+	memcpy( navtable.links, pLinks, sizeof( nav_plink_t ) * navtable.numNodes );
+	navtable.heap = ( int * )G_Malloc( sizeof( int ) * navtable.numNodes * 2 );
+
+	navtable.lock = trap_Mutex_Create();
+	navtable.thread = trap_Thread_Create( AI_NavTable_ThreadProc, NULL );
+}
+
+//==========================================
+// AI_NavTable_Ready
+//==========================================
+static bool AI_NavTable_Ready( void )
+{
+	bool done;
+
+	if( navtable.ready )
+		return true;
+	if( !navtable.thread )
+		return false;
+
+	trap_Mutex_Lock( navtable.lock );
+	done = navtable.done;
+	trap_Mutex_Unlock( navtable.lock );
+
+	if( done )
+	{
+		trap_Thread_Join( navtable.thread );
+		navtable.thread = NULL;
+		trap_Mutex_Destroy( &navtable.lock );
+
+		G_Free( navtable.links );
+		navtable.links = NULL;
+		G_Free( navtable.heap );
+		navtable.heap = NULL;
+
+		AI_NavTable_Save();
+
+		navtable.ready = true;
+		if( developer->integer )
+			G_Printf( "AI: built navigation table for %i nodes\n", navtable.numNodes );
+	}
+
+	return navtable.ready;
+}
+
+//==========================================
+// AI_NavTable_GetPath
+// returns -1 when the query can't be answered from the table
+//==========================================
+int AI_NavTable_GetPath( int origin, int goal, int movetypes, struct astarpath_s *path )
+{
+	int numNodes = navtable.numNodes;
+	int i, cur, count, cost;
+	short int hops[MAX_NODES];
+
+	if( movetypes != navtable.movetypes || !AI_NavTable_Ready() )
+		return -1;
+	if( origin < 0 || origin >= numNodes || goal < 0 || goal >= numNodes || origin == goal )
+		return -1;
+
+	cost = navtable.cost[origin * numNodes + goal];
+	if( cost < 0 )
+		return 0;
+
+	count = 0;
+	cur = origin;
+	while( cur != goal && count < numNodes )
+	{
+		cur = navtable.next[cur * numNodes + goal];
+		hops[count++] = cur;
+	}
+
+	// paths are stored backwards, starting at the goal
+	for( i = 0; i < count; i++ )
+		path->nodes[i] = hops[count - 1 - i];
+
+	path->numNodes = count - 1;
+	path->totalDistance = cost;
+	path->originNode = origin;
+	path->goalNode = goal;
+	return 1;
+}
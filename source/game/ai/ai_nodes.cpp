@@ -93,7 +93,7 @@ static void AI_JumpadGuess_ShowPoint( vec3_t origin, char *modelname )
 	ent->s.modelindex = trap_ModelIndex( modelname );
 	ent->nextThink = level.time + 20000000;
 	ent->think = G_FreeEdict;
-	ent->classname = "checkent";
+	G_SetClassname( ent, "checkent" );
 	ent->r.svflags &= ~SVF_NOCLIENT;
 
 	GClip_LinkEntity( ent );
@@ -1189,6 +1189,9 @@ void AI_InitEntitiesData( void )
 		G_Printf( "       : added jump links:%i.\n", newjumplinks );
 	}
 
+	// the links are final, flush what was invalidated while adding them
+	AStar_RebuildCache();
+
 	G_Printf( "       : AI Navigation Initialized.\n" );
 
 	nav.loaded = true;
@@ -1207,6 +1210,7 @@ void AI_InitNavigationData( bool silent )
 	memset( &nav, 0, sizeof( nav ) );
 	memset( nodes, 0, sizeof( nav_node_t ) * MAX_NODES );
 	memset( pLinks, 0, sizeof( nav_plink_t ) * MAX_NODES );
+	AStar_FreeCache();
 
 	nav.goalEntsFree = nav.goalEnts;
 	nav.goalEntsHeadnode.id = -1;
@@ -2236,7 +2236,7 @@ static asstring_t *objectGameEntity_getTargetname( edict_t *self )
 
 static void objectGameEntity_setTargetname( asstring_t *targetname, edict_t *self )
 {
-	self->targetname = G_RegisterLevelString( targetname->buffer );
+	G_SetTargetname( self, G_RegisterLevelString( targetname->buffer ) );
 }
 
 static asstring_t *objectGameEntity_getTarget( edict_t *self )
@@ -2261,7 +2261,7 @@ static asstring_t *objectGameEntity_getSoundName( edict_t *self )
 
 static void objectGameEntity_setClassname( asstring_t *classname, edict_t *self )
 {
-	self->classname = G_RegisterLevelString( classname->buffer );
+	G_SetClassname( self, G_RegisterLevelString( classname->buffer ) );
 }
 
 static void objectGameEntity_setMap( asstring_t *map, edict_t *self )
@@ -2697,7 +2697,7 @@ static edict_t *asFunc_G_Spawn( asstring_t *classname )
 	ent = G_Spawn();
 
 	if( classname && classname->len ) {
-		ent->classname = G_RegisterLevelString( classname->buffer );
+		G_SetClassname( ent, G_RegisterLevelString( classname->buffer ) );
 	}
 
 	ent->scriptSpawned = true;
@@ -3817,6 +3817,243 @@ static char *G_LoadScriptSection( const char *dir, const char *script, int secti
 	return (char *)data;
 }
 
+/*
+* Script bytecode cache
+*
+* Compiled modules are saved to the cache directory and loaded back on the next
+* map load when the sources and the registered script API haven't changed.
+*/
+#define SCRIPT_BYTECODE_CACHE_VERSION	1
+#define SCRIPT_BYTECODE_EXTENSION		".asb"
+
+typedef struct
+{
+	unsigned int version;
+	unsigned int apiChecksum;
+	unsigned int sourceChecksum;
+	unsigned int dataSize;
+	unsigned int dataChecksum;
+} g_asbytecodeheader_t;
+
+static unsigned int asApiChecksum;
+
+class G_asBytecodeStream : public asIBinaryStream
+{
+public:
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+	size_t position;
+	bool overflow;
+
+	G_asBytecodeStream( uint8_t *buffer = NULL, size_t buffersize = 0 )
+		: data( buffer ), size( buffersize ), capacity( buffersize ), position( 0 ), overflow( false ) {}
+
+	void Read( void *ptr, asUINT length )
+	{
+		// a truncated or corrupted file must not read past the buffer
+		if( overflow || position + length > size ) {
+			memset( ptr, 0, length );
+			overflow = true;
+			return;
+		}
+		memcpy( ptr, data + position, length );
+		position += length;
+	}
+
+	void Write( const void *ptr, asUINT length )
+	{
+		if( size + length > capacity ) {
+			size_t newcapacity = max( capacity * 2, size + length + 0x4000 );
+			uint8_t *newdata = ( uint8_t * )G_Malloc( newcapacity );
+			if( data ) {
+				memcpy( newdata, data, size );
+				G_Free( data );
+			}
+			data = newdata;
+			capacity = newcapacity;
+		}
+		memcpy( data + size, ptr, length );
+		size += length;
+	}
+};
+
+/*
+* G_asChecksum
+*/
+static unsigned int G_asChecksum( unsigned int hash, const void *data, size_t size )
+{
+	const uint8_t *p = ( const uint8_t * )data;
+	size_t i;
+
+	for( i = 0; i < size; i++ )
+		hash = ( hash ^ p[i] ) * 16777619u;
+	return hash;
+}
+
+static unsigned int G_asChecksumString( unsigned int hash, const char *str )
+{
+	return str ? G_asChecksum( hash, str, strlen( str ) + 1 ) : G_asChecksum( hash, "", 1 );
+}
+
+/*
+* G_asApiChecksum
+*
+* Identifies everything the game module registered into the engine, bytecode
+* saved against a different API can't be loaded back.
+*/
+static unsigned int G_asApiChecksum( asIScriptEngine *asEngine )
+{
+	unsigned int hash = 2166136261u;
+	unsigned int i, j, count;
+	int value;
+
+	value = GAME_API_VERSION;
+	hash = G_asChecksum( hash, &value, sizeof( value ) );
+	value = ANGELSCRIPT_VERSION;
+	hash = G_asChecksum( hash, &value, sizeof( value ) );
+	value = sizeof( void * );
+	hash = G_asChecksum( hash, &value, sizeof( value ) );
+
+	count = asEngine->GetEnumCount();
+	for( i = 0; i < count; i++ ) {
+		int typeId;
+		const char *name = asEngine->GetEnumByIndex( i, &typeId );
+
+		hash = G_asChecksumString( hash, name );
+		for( j = 0; j < (unsigned int)asEngine->GetEnumValueCount( typeId ); j++ ) {
+			hash = G_asChecksumString( hash, asEngine->GetEnumValueByIndex( typeId, j, &value ) );
+			hash = G_asChecksum( hash, &value, sizeof( value ) );
+		}
+	}
+
+	count = asEngine->GetObjectTypeCount();
+	for( i = 0; i < count; i++ ) {
+		asIObjectType *type = asEngine->GetObjectTypeByIndex( i );
+
+		hash = G_asChecksumString( hash, type->GetName() );
+		for( j = 0; j < type->GetMethodCount(); j++ )
+			hash = G_asChecksumString( hash, type->GetMethodByIndex( j )->GetDeclaration( true, true ) );
+		for( j = 0; j < type->GetPropertyCount(); j++ )
+			hash = G_asChecksumString( hash, type->GetPropertyDeclaration( j, true ) );
+		value = type->GetBehaviourCount() + type->GetFactoryCount();
+		hash = G_asChecksum( hash, &value, sizeof( value ) );
+	}
+
+	count = asEngine->GetFuncdefCount();
+	for( i = 0; i < count; i++ )
+		hash = G_asChecksumString( hash, asEngine->GetFuncdefByIndex( i )->GetDeclaration( true, true ) );
+
+	count = asEngine->GetGlobalFunctionCount();
+	for( i = 0; i < count; i++ )
+		hash = G_asChecksumString( hash, asEngine->GetGlobalFunctionByIndex( i )->GetDeclaration( true, true ) );
+
+	count = asEngine->GetGlobalPropertyCount();
+	for( i = 0; i < count; i++ ) {
+		const char *name, *nameSpace;
+		int typeId;
+
+		asEngine->GetGlobalPropertyByIndex( i, &name, &nameSpace, &typeId );
+		hash = G_asChecksumString( hash, name );
+		hash = G_asChecksumString( hash, nameSpace );
+		hash = G_asChecksumString( hash, asEngine->GetTypeDeclaration( typeId, true ) );
+	}
+
+	return hash;
+}
+
+/*
+* G_asBytecodeCacheName
+*/
+static void G_asBytecodeCacheName( const char *scriptName, char *filename, size_t size )
+{
+	Q_snprintfz( filename, size, "%s%s", scriptName, SCRIPT_BYTECODE_EXTENSION );
+	Q_strlwr( filename );
+}
+
+/*
+* G_asLoadBytecode
+*/
+static bool G_asLoadBytecode( asIScriptModule *asModule, const char *scriptName, unsigned int sourceChecksum )
+{
+	char filename[MAX_QPATH];
+	g_asbytecodeheader_t header;
+	uint8_t *data;
+	int length, filenum;
+	int error;
+
+	G_asBytecodeCacheName( scriptName, filename, sizeof( filename ) );
+
+	length = trap_FS_FOpenFile( filename, &filenum, FS_READ|FS_CACHE );
+	if( length == -1 )
+		return false;
+
+	if( length < (int)sizeof( header ) ) {
+		trap_FS_FCloseFile( filenum );
+		return false;
+	}
+
+	trap_FS_Read( &header, sizeof( header ), filenum );
+	if( header.version != SCRIPT_BYTECODE_CACHE_VERSION || header.apiChecksum != asApiChecksum
+		|| header.sourceChecksum != sourceChecksum || header.dataSize != length - sizeof( header ) ) {
+		trap_FS_FCloseFile( filenum );
+		return false;
+	}
+
+	data = ( uint8_t * )G_Malloc( header.dataSize );
+	trap_FS_Read( data, header.dataSize, filenum );
+	trap_FS_FCloseFile( filenum );
+
+	if( G_asChecksum( 2166136261u, data, header.dataSize ) != header.dataChecksum ) {
+		G_Free( data );
+		return false;
+	}
+
+	G_asBytecodeStream stream( data, header.dataSize );
+	error = asModule->LoadByteCode( &stream );
+	G_Free( data );
+
+	if( error < 0 || stream.overflow ) {
+		G_Printf( "* Discarding the outdated bytecode cache for '%s'\n", scriptName );
+		return false;
+	}
+
+	return true;
+}
+
+/*
+* G_asSaveBytecode
+*/
+static void G_asSaveBytecode( asIScriptModule *asModule, const char *scriptName, unsigned int sourceChecksum )
+{
+	char filename[MAX_QPATH];
+	g_asbytecodeheader_t header;
+	G_asBytecodeStream stream;
+	int filenum;
+
+	if( asModule->SaveByteCode( &stream ) < 0 || !stream.size ) {
+		if( stream.data )
+			G_Free( stream.data );
+		return;
+	}
+
+	G_asBytecodeCacheName( scriptName, filename, sizeof( filename ) );
+
+	if( trap_FS_FOpenFile( filename, &filenum, FS_WRITE|FS_CACHE ) != -1 ) {
+		header.version = SCRIPT_BYTECODE_CACHE_VERSION;
+		header.apiChecksum = asApiChecksum;
+		header.sourceChecksum = sourceChecksum;
+		header.dataSize = stream.size;
+		header.dataChecksum = G_asChecksum( 2166136261u, stream.data, stream.size );
+
+		trap_FS_Write( &header, sizeof( header ), filenum );
+		trap_FS_Write( stream.data, stream.size, filenum );
+		trap_FS_FCloseFile( filenum );
+	}
+
+	G_Free( stream.data );
+}
+
 /*
 * G_BuildGameScript
 */
@@ -3825,6 +4062,8 @@ static asIScriptModule *G_BuildGameScript( const char *moduleName, const char *d
 	int error;
 	int numSections, sectionNum;
 	char *section;
+	char **sections;
+	unsigned int sourceChecksum;
 	asIScriptModule *asModule;
 	asIScriptEngine *asEngine;
 	
@@ -3852,21 +4091,58 @@ static asIScriptModule *G_BuildGameScript( const char *moduleName, const char *d
 		return NULL;
 	}
 
-	for( sectionNum = 0; ( section = G_LoadScriptSection( dir, script, sectionNum ) ) != NULL; sectionNum++ ) {
-		const char *sectionName = G_ListNameForPosition( script, sectionNum, SECTIONS_SEPARATOR );
-		error = asModule->AddScriptSection( sectionName, section, strlen( section ) );
-
-		G_Free( section );
+	sections = ( char ** )G_Malloc( sizeof( char * ) * numSections );
+	sourceChecksum = G_asChecksumString( 2166136261u, script );
 
-		if( error ) {
-			G_Printf( S_COLOR_RED "* Failed to add the script section %s with error %i\n", sectionName, error );
-			asEngine->DiscardModule( moduleName );
-			return NULL;
-		}
+	for( sectionNum = 0; sectionNum < numSections && ( section = G_LoadScriptSection( dir, script, sectionNum ) ) != NULL; sectionNum++ ) {
+		sections[sectionNum] = section;
+		sourceChecksum = G_asChecksumString( sourceChecksum, section );
 	}
 
 	if( sectionNum != numSections ) {
 		G_Printf( S_COLOR_RED "* Error: couldn't load all script sections.\n" );
+		while( --sectionNum >= 0 )
+			G_Free( sections[sectionNum] );
+		G_Free( sections );
+		asEngine->DiscardModule( moduleName );
+		return NULL;
+	}
+
+	// skip compilation when the bytecode of the same sources was cached
+	if( G_asLoadBytecode( asModule, scriptName, sourceChecksum ) ) {
+		for( sectionNum = 0; sectionNum < numSections; sectionNum++ )
+			G_Free( sections[sectionNum] );
+		G_Free( sections );
+
+		G_Printf( "* Loaded cached bytecode for '%s'\n", scriptName );
+		return asModule;
+	}
+
+	// a failed load may have left the module in any state
+	asModule = asEngine->GetModule( moduleName, asGM_ALWAYS_CREATE );
+	if( asModule == NULL ) {
+		G_Printf( S_COLOR_RED "G_BuildGameScript: GetModule '%s' failed\n", moduleName );
+		for( sectionNum = 0; sectionNum < numSections; sectionNum++ )
+			G_Free( sections[sectionNum] );
+		G_Free( sections );
+		return NULL;
+	}
+
+	error = 0;
+	for( sectionNum = 0; sectionNum < numSections; sectionNum++ ) {
+		const char *sectionName = G_ListNameForPosition( script, sectionNum, SECTIONS_SEPARATOR );
+
+		if( !error ) {
+			error = asModule->AddScriptSection( sectionName, sections[sectionNum], strlen( sections[sectionNum] ) );
+			if( error )
+				G_Printf( S_COLOR_RED "* Failed to add the script section %s with error %i\n", sectionName, error );
+		}
+
+		G_Free( sections[sectionNum] );
+	}
+	G_Free( sections );
+
+	if( error ) {
 		asEngine->DiscardModule( moduleName );
 		return NULL;
 	}
@@ -3878,6 +4154,8 @@ static asIScriptModule *G_BuildGameScript( const char *moduleName, const char *d
 		return NULL;
 	}
 
+	G_asSaveBytecode( asModule, scriptName, sourceChecksum );
+
 	return asModule;
 }
 
@@ -3933,6 +4211,7 @@ static void G_ResetGameModuleScriptData( void )
 {
 	game.asEngine = NULL;
 	game.asGlobalsInitialized = false;
+	asApiChecksum = 0;
 
 	asEntityCallThinkFuncPtr = NULL;
 	asEntityCallTouchFuncPtr = NULL;
@@ -3967,6 +4246,8 @@ static void G_InitializeGameModuleSyntax( asIScriptEngine *asEngine )
 
 	// register global properties
 	G_asRegisterGlobalProperties( asEngine, asGlobProps, "" );
+
+	asApiChecksum = G_asApiChecksum( asEngine );
 }
 
 /*
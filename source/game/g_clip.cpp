@@ -67,61 +67,170 @@ static areagrid_t g_areagrid;
 extern cvar_t *g_antilag;
 extern cvar_t *g_antilag_maxtimedelta;
 
-#define	CFRAME_UPDATE_BACKUP	64  // copies of entity_state_t to keep buffered (1 second of backup at 62 fps).
+#define	CFRAME_UPDATE_BACKUP	64  // collision frames to keep buffered (1 second of backup at 62 fps).
 #define	CFRAME_UPDATE_MASK	( CFRAME_UPDATE_BACKUP-1 )
 
+// collision state of an entity at some point in time
 typedef struct c4clipedict_s
 {
-	entity_state_t s;
-	entity_shared_t	r;
+	edict_t *ent;		// the fields that aren't backed up are taken from the current entity
+	bool inuse;
+	int solid;
+	unsigned int modelindex;
+	vec3_t origin;
+	vec3_t angles;
+	vec3_t mins, maxs;
+	vec3_t absmin, absmax;
 } c4clipedict_t;
 
-//backups of all server frames areas and edicts
-typedef struct c4frame_s
+// backups of the collision state of all edicts, stored as arrays of fields.
+// Every entity keeps a ring of its last CFRAME_UPDATE_BACKUP records, and a new
+// record is only added when its collision state has changed, so the state of an
+// entity at a given frame is its newest record made at or before that frame.
+typedef struct c4history_s
 {
-	c4clipedict_t clipEdicts[MAX_EDICTS];   // fixme: there is a g_maxentities cvar. We have to adjust to it
-	int numedicts;
+	unsigned int timestamps[CFRAME_UPDATE_BACKUP];	// server time of each collision frame
+
+	int head[MAX_EDICTS];							// ring slot of the newest record
+	int numrecords[MAX_EDICTS];
+
+	unsigned int framenum[MAX_EDICTS][CFRAME_UPDATE_BACKUP];	// collision frame the record was made at
+	bool inuse[MAX_EDICTS][CFRAME_UPDATE_BACKUP];
+	uint8_t solid[MAX_EDICTS][CFRAME_UPDATE_BACKUP];
+	unsigned int modelindex[MAX_EDICTS][CFRAME_UPDATE_BACKUP];
+	vec3_t origin[MAX_EDICTS][CFRAME_UPDATE_BACKUP];
+	vec3_t angles[MAX_EDICTS][CFRAME_UPDATE_BACKUP];
+	vec3_t mins[MAX_EDICTS][CFRAME_UPDATE_BACKUP];
+	vec3_t maxs[MAX_EDICTS][CFRAME_UPDATE_BACKUP];
+	vec3_t absmin[MAX_EDICTS][CFRAME_UPDATE_BACKUP];
+	vec3_t absmax[MAX_EDICTS][CFRAME_UPDATE_BACKUP];
+} c4history_t;
+
+static c4history_t sv_collisionhistory;
+static unsigned int sv_collisionFrameNum = 0;
 
-	unsigned int timestamp;
-	unsigned int framenum;
-} c4frame_t;
+/*
+* GClip_EntityIsAntilagged
+* 
+* Only the position of solid entities and client triggers is backed up
+*/
+static inline bool GClip_EntityIsAntilagged( int entNum, const edict_t *ent )
+{
+	if( !ent->r.inuse || ent->r.solid == SOLID_NOT )
+		return false;
+	if( ent->r.solid == SOLID_TRIGGER && !( entNum >= 1 && entNum <= gs.maxclients ) )
+		return false;
+	return true;
+}
 
-c4frame_t sv_collisionframes[CFRAME_UPDATE_BACKUP];
-static unsigned int sv_collisionFrameNum = 0;
+/*
+* GClip_CollisionStateChanged
+*/
+static bool GClip_CollisionStateChanged( const c4history_t *hist, int entNum, const edict_t *ent )
+{
+	int slot = hist->head[entNum];
+
+	if( hist->inuse[entNum][slot] != ent->r.inuse || hist->solid[entNum][slot] != ent->r.solid )
+		return true;
+	if( !GClip_EntityIsAntilagged( entNum, ent ) )
+		return false;
+
+	return hist->modelindex[entNum][slot] != ent->s.modelindex
+		|| !VectorCompare( hist->origin[entNum][slot], ent->s.origin )
+		|| !VectorCompare( hist->angles[entNum][slot], ent->s.angles )
+		|| !VectorCompare( hist->mins[entNum][slot], ent->r.mins )
+		|| !VectorCompare( hist->maxs[entNum][slot], ent->r.maxs )
+		|| !VectorCompare( hist->absmin[entNum][slot], ent->r.absmin )
+		|| !VectorCompare( hist->absmax[entNum][slot], ent->r.absmax );
+}
+
+/*
+* GClip_ClearCollisionFrames
+*/
+static void GClip_ClearCollisionFrames( void )
+{
+	memset( sv_collisionhistory.numrecords, 0, sizeof( sv_collisionhistory.numrecords ) );
+	sv_collisionFrameNum = 0;
+}
 
 void GClip_BackUpCollisionFrame( void )
 {
-	c4frame_t *cframe;
+	c4history_t *hist = &sv_collisionhistory;
 	edict_t	*svedict;
-	int i;
+	unsigned int framenum;
+	int i, slot;
 
 	if( !g_antilag->integer )
 		return;
 
 	// fixme: should check for any validation here?
 
-	cframe = &sv_collisionframes[sv_collisionFrameNum & CFRAME_UPDATE_MASK];
-	cframe->timestamp = game.serverTime;
-	cframe->framenum = sv_collisionFrameNum;
-	sv_collisionFrameNum++;
+	framenum = sv_collisionFrameNum++;
+	hist->timestamps[framenum & CFRAME_UPDATE_MASK] = game.serverTime;
 
-	//memset( cframe->clipEdicts, 0, sizeof(cframe->clipEdicts) );
-
-	//backup edicts
+	//backup edicts whose collision state has changed since their last record
 	for( i = 0; i < game.numentities; i++ )
 	{
 		svedict = &game.edicts[i];
+		if( hist->numrecords[i] && !GClip_CollisionStateChanged( hist, i, svedict ) )
+			continue;
 
-		cframe->clipEdicts[i].r.inuse = svedict->r.inuse;
-		cframe->clipEdicts[i].r.solid = svedict->r.solid;
-		if( !svedict->r.inuse || svedict->r.solid == SOLID_NOT 
-			|| ( svedict->r.solid == SOLID_TRIGGER && !(i >= 1 && i <= gs.maxclients) ) )
+		slot = ( hist->head[i] + 1 ) & CFRAME_UPDATE_MASK;
+		hist->head[i] = slot;
+		if( hist->numrecords[i] < CFRAME_UPDATE_BACKUP )
+			hist->numrecords[i]++;
+
+		hist->framenum[i][slot] = framenum;
+		hist->inuse[i][slot] = svedict->r.inuse;
+		hist->solid[i][slot] = svedict->r.solid;
+		if( !GClip_EntityIsAntilagged( i, svedict ) )
 			continue;
 
-		cframe->clipEdicts[i].r = svedict->r;
-		cframe->clipEdicts[i].s = svedict->s;
+		hist->modelindex[i][slot] = svedict->s.modelindex;
+		VectorCopy( svedict->s.origin, hist->origin[i][slot] );
+		VectorCopy( svedict->s.angles, hist->angles[i][slot] );
+		VectorCopy( svedict->r.mins, hist->mins[i][slot] );
+		VectorCopy( svedict->r.maxs, hist->maxs[i][slot] );
+		VectorCopy( svedict->r.absmin, hist->absmin[i][slot] );
+		VectorCopy( svedict->r.absmax, hist->absmax[i][slot] );
 	}
-	cframe->numedicts = game.numentities;
+}
+
+/*
+* GClip_SetClipEdictFromEntity
+*/
+static void GClip_SetClipEdictFromEntity( c4clipedict_t *clipent, edict_t *ent )
+{
+	clipent->ent = ent;
+	clipent->inuse = ent->r.inuse;
+	clipent->solid = ent->r.solid;
+	clipent->modelindex = ent->s.modelindex;
+	VectorCopy( ent->s.origin, clipent->origin );
+	VectorCopy( ent->s.angles, clipent->angles );
+	VectorCopy( ent->r.mins, clipent->mins );
+	VectorCopy( ent->r.maxs, clipent->maxs );
+	VectorCopy( ent->r.absmin, clipent->absmin );
+	VectorCopy( ent->r.absmax, clipent->absmax );
+}
+
+/*
+* GClip_SetClipEdictFromHistory
+*/
+static void GClip_SetClipEdictFromHistory( c4clipedict_t *clipent, edict_t *ent, int slot )
+{
+	const c4history_t *hist = &sv_collisionhistory;
+	int entNum = ENTNUM( ent );
+
+	clipent->ent = ent;
+	clipent->inuse = hist->inuse[entNum][slot];
+	clipent->solid = hist->solid[entNum][slot];
+	clipent->modelindex = hist->modelindex[entNum][slot];
+	VectorCopy( hist->origin[entNum][slot], clipent->origin );
+	VectorCopy( hist->angles[entNum][slot], clipent->angles );
+	VectorCopy( hist->mins[entNum][slot], clipent->mins );
+	VectorCopy( hist->maxs[entNum][slot], clipent->maxs );
+	VectorCopy( hist->absmin[entNum][slot], clipent->absmin );
+	VectorCopy( hist->absmax[entNum][slot], clipent->absmax );
 }
 
 static c4clipedict_t *GClip_GetClipEdictForDeltaTime( int entNum, int deltaTime )
@@ -130,26 +239,19 @@ static c4clipedict_t *GClip_GetClipEdictForDeltaTime( int entNum, int deltaTime
 	static c4clipedict_t clipEnts[8];
 	static c4clipedict_t *clipent;
 	static c4clipedict_t clipentNewer; // for interpolation
-	c4frame_t *cframe = NULL;
+	const c4history_t *hist = &sv_collisionhistory;
 	unsigned int backTime, cframenum, bf, i;
+	unsigned int frame = 0, newerFrame = 0;
+	int slot = -1, newerSlot = -1, r, k;
 	edict_t	*ent = game.edicts + entNum;
 
 	// pick one of the 8 slots to prevent overwritings
 	clipent = &clipEnts[index];
 	index = ( index + 1 )&7;
 
-	if( !entNum || deltaTime >= 0 || !g_antilag->integer )
+	if( !entNum || deltaTime >= 0 || !g_antilag->integer || !GClip_EntityIsAntilagged( entNum, ent ) )
 	{                                                    // current time entity
-		clipent->r = ent->r;
-		clipent->s = ent->s;
-		return clipent;
-	}
-
-	if( !ent->r.inuse || ent->r.solid == SOLID_NOT 
-		|| ( ent->r.solid == SOLID_TRIGGER && !(entNum >= 1 && entNum <= gs.maxclients) ) )
-	{
-		clipent->r = ent->r;
-		clipent->s = ent->s;
+		GClip_SetClipEdictFromEntity( clipent, ent );
 		return clipent;
 	}
 
@@ -165,80 +267,80 @@ static c4clipedict_t *GClip_GetClipEdictForDeltaTime( int entNum, int deltaTime
 
 	// find the first snap with timestamp < than realtime - backtime
 	cframenum = sv_collisionFrameNum;
-	for( bf = 1; bf < CFRAME_UPDATE_BACKUP && bf < sv_collisionFrameNum; bf++ ) // never overpass limits
+	r = hist->head[entNum];
+	k = 0;
+	for( bf = 1; bf < CFRAME_UPDATE_BACKUP && bf <= cframenum; bf++ ) // never overpass limits
 	{
-		cframe = &sv_collisionframes[( cframenum-bf ) & CFRAME_UPDATE_MASK];
+		unsigned int f = cframenum - bf;
 
-		// if solid has changed, we can't keep moving backwards
-		if( ent->r.solid != cframe->clipEdicts[entNum].r.solid 
-			|| ent->r.inuse != cframe->clipEdicts[entNum].r.inuse )
+		// step back to the newest record made at or before this frame
+		while( k < hist->numrecords[entNum] && hist->framenum[entNum][r] > f )
 		{
-			bf--;
-			if( bf == 0 )
-			{
-				// we can't step back from first
-				cframe = NULL;
-			}
-			else
-			{
-				cframe = &sv_collisionframes[( cframenum-bf ) & CFRAME_UPDATE_MASK];
-			}
-			break;
+			r = ( r - 1 ) & CFRAME_UPDATE_MASK;
+			k++;
 		}
 
-		if( game.serverTime >= cframe->timestamp + backTime )
+		// if solid has changed, we can't keep moving backwards
+		if( k == hist->numrecords[entNum] 
+			|| hist->solid[entNum][r] != ent->r.solid || hist->inuse[entNum][r] != ent->r.inuse )
+			break;
+
+		newerSlot = slot;
+		newerFrame = frame;
+		slot = r;
+		frame = f;
+
+		if( game.serverTime >= hist->timestamps[f & CFRAME_UPDATE_MASK] + backTime )
 			break;
 	}
 
-	if( !cframe )
+	if( slot < 0 )
 	{
 		// current time entity
-		clipent->r = ent->r;
-		clipent->s = ent->s;
+		GClip_SetClipEdictFromEntity( clipent, ent );
 		return clipent;
 	}
 
 	// setup with older for the data that is not interpolated
-	*clipent = cframe->clipEdicts[entNum];
+	GClip_SetClipEdictFromHistory( clipent, ent, slot );
 
 	// if we found an older than desired backtime frame, interpolate to find a more precise position.
-	if( game.serverTime > cframe->timestamp+backTime )
+	if( game.serverTime > hist->timestamps[frame & CFRAME_UPDATE_MASK] + backTime && slot != newerSlot )
 	{
 		float lerpFrac;
+		unsigned int timestamp = hist->timestamps[frame & CFRAME_UPDATE_MASK];
 
-		if( bf == 1 )
+		if( newerSlot < 0 )
 		{
 			// interpolate from 1st backed up to current
-			lerpFrac = (float)( ( game.serverTime - backTime ) - cframe->timestamp ) 
-				/ (float)( game.serverTime - cframe->timestamp );
-			clipentNewer.r = ent->r;
-			clipentNewer.s = ent->s;
+			lerpFrac = (float)( ( game.serverTime - backTime ) - timestamp ) 
+				/ (float)( game.serverTime - timestamp );
+			GClip_SetClipEdictFromEntity( &clipentNewer, ent );
 		}
 		else
 		{
 			// interpolate between 2 backed up
-			c4frame_t *cframeNewer = &sv_collisionframes[( cframenum-( bf-1 ) ) & CFRAME_UPDATE_MASK];
-			lerpFrac = (float)( ( game.serverTime - backTime ) - cframe->timestamp ) 
-				/ (float)( cframeNewer->timestamp - cframe->timestamp );
-			clipentNewer = cframeNewer->clipEdicts[entNum];
+			lerpFrac = (float)( ( game.serverTime - backTime ) - timestamp ) 
+				/ (float)( hist->timestamps[newerFrame & CFRAME_UPDATE_MASK] - timestamp );
+			GClip_SetClipEdictFromHistory( &clipentNewer, ent, newerSlot );
 		}
 
 #if 0
 		G_Printf( "backTime:%i cframeBackTime:%i backFrames:%i lerfrac:%f\n",
-			backTime, game.serverTime - cframe->timestamp, backframes, lerpFrac );
+			backTime, game.serverTime - timestamp, bf, lerpFrac );
 #endif
 
 		// interpolate
-		VectorLerp( clipent->s.origin, lerpFrac, clipentNewer.s.origin, clipent->s.origin );
-		VectorLerp( clipent->r.mins, lerpFrac, clipentNewer.r.mins, clipent->r.mins );
-		VectorLerp( clipent->r.maxs, lerpFrac, clipentNewer.r.maxs, clipent->r.maxs );
+		VectorLerp( clipent->origin, lerpFrac, clipentNewer.origin, clipent->origin );
+		VectorLerp( clipent->mins, lerpFrac, clipentNewer.mins, clipent->mins );
+		VectorLerp( clipent->maxs, lerpFrac, clipentNewer.maxs, clipent->maxs );
 		for( i = 0; i < 3; i++ )
-			clipent->s.angles[i] = LerpAngle( clipent->s.angles[i], clipentNewer.s.angles[i], lerpFrac );
+			clipent->angles[i] = LerpAngle( clipent->angles[i], clipentNewer.angles[i], lerpFrac );
 	}
 
 #if 0
 	G_Printf( "backTime:%i cframeBackTime:%i backFrames:%i\n", backTime,
-		game.serverTime - cframe->timestamp, backframes );
+		game.serverTime - hist->timestamps[frame & CFRAME_UPDATE_MASK], bf );
 #endif
 
 	// back time entity
@@ -427,18 +529,18 @@ static int GClip_EntitiesInBox_AreaGrid( areagrid_t *areagrid, const vec3_t mins
 			}
 			areagrid->entmarknumber[l->entNum] = areagrid->marknumber;
 
-			if( !clipEnt->r.inuse ) {
+			if( !clipEnt->inuse ) {
 				continue; // deactivated
 			}
-			if( areatype == AREA_TRIGGERS && clipEnt->r.solid != SOLID_TRIGGER ) {
+			if( areatype == AREA_TRIGGERS && clipEnt->solid != SOLID_TRIGGER ) {
 				continue;
 			}
 			if( areatype == AREA_SOLID && 
-				( clipEnt->r.solid == SOLID_TRIGGER || clipEnt->r.solid == SOLID_NOT ) ) {
+				( clipEnt->solid == SOLID_TRIGGER || clipEnt->solid == SOLID_NOT ) ) {
 				continue;
 			}
 
-			if( BoundsIntersect( paddedmins, paddedmaxs, clipEnt->r.absmin, clipEnt->r.absmax )) {
+			if( BoundsIntersect( paddedmins, paddedmaxs, clipEnt->absmin, clipEnt->absmax )) {
 				if( numlist < maxcount ) {
 					list[numlist] = l->entNum;
 				}
@@ -464,18 +566,18 @@ static int GClip_EntitiesInBox_AreaGrid( areagrid_t *areagrid, const vec3_t mins
 				}
 				areagrid->entmarknumber[l->entNum] = areagrid->marknumber;
 
-				if( !clipEnt->r.inuse ) {
+				if( !clipEnt->inuse ) {
 					continue; // deactivated
 				}
-				if( areatype == AREA_TRIGGERS && clipEnt->r.solid != SOLID_TRIGGER ) {
+				if( areatype == AREA_TRIGGERS && clipEnt->solid != SOLID_TRIGGER ) {
 					continue;
 				}
 				if( areatype == AREA_SOLID && 
-					( clipEnt->r.solid == SOLID_TRIGGER || clipEnt->r.solid == SOLID_NOT ) ) {
+					( clipEnt->solid == SOLID_TRIGGER || clipEnt->solid == SOLID_NOT ) ) {
 					continue;
 				}
 
-				if( BoundsIntersect( paddedmins, paddedmaxs, clipEnt->r.absmin, clipEnt->r.absmax )) {
+				if( BoundsIntersect( paddedmins, paddedmaxs, clipEnt->absmin, clipEnt->absmax )) {
 					if( numlist < maxcount ) {
 						list[numlist] = l->entNum;
 					}
@@ -489,6 +591,79 @@ static int GClip_EntitiesInBox_AreaGrid( areagrid_t *areagrid, const vec3_t mins
 }
 
 
+//===============================================================================
+//
+//TRACE CACHE
+//
+// Identical traces and point contents queries are often issued many times
+// (physics, bots, ground checks). Only the part of their result that comes
+// from the world is remembered, it can't change until the world is cleared.
+// Entities are always clipped against their current state, which can be
+// changed without relinking them.
+//===============================================================================
+
+static gs_tracecache_t g_tracecache_world;
+
+/*
+* GClip_InvalidateTraceCache
+*/
+void GClip_InvalidateTraceCache( void )
+{
+	GS_TraceCache_Invalidate( &g_tracecache_world );
+}
+
+/*
+* GClip_TraceCacheStats_f
+*/
+void GClip_TraceCacheStats_f( void )
+{
+	const gs_tracecache_t *cache = &g_tracecache_world;
+	unsigned int traces = cache->traceHits + cache->traceMisses;
+	unsigned int contents = cache->contentsHits + cache->contentsMisses;
+
+	G_Printf( "world trace cache: %s, %i entries, %u invalidations\n", 
+		g_tracecache->integer ? "enabled" : "disabled", GS_TRACECACHE_SIZE, cache->invalidations );
+	G_Printf( "  traces: %u hits, %u misses (%.1f%%)\n", cache->traceHits, 
+		cache->traceMisses, traces ? 100.0f * cache->traceHits / traces : 0.0f );
+	G_Printf( "  point contents: %u hits, %u misses (%.1f%%)\n", cache->contentsHits, 
+		cache->contentsMisses, contents ? 100.0f * cache->contentsHits / contents : 0.0f );
+
+	if( trap_Cmd_Argc() > 1 && !Q_stricmp( trap_Cmd_Argv( 1 ), "reset" ) )
+		GS_TraceCache_ResetStats( &g_tracecache_world );
+}
+
+/*
+* GClip_WorldTrace
+*/
+static void GClip_WorldTrace( trace_t *tr, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int contentmask )
+{
+	if( g_tracecache->integer && GS_TraceCache_FindTrace( &g_tracecache_world, tr, start, mins, maxs, end, -1, contentmask ) )
+		return;
+
+	trap_CM_TransformedBoxTrace( tr, start, end, mins, maxs, NULL, contentmask, NULL, NULL );
+
+	if( g_tracecache->integer )
+		GS_TraceCache_StoreTrace( &g_tracecache_world, tr, start, mins, maxs, end, -1, contentmask );
+}
+
+/*
+* GClip_WorldPointContents
+*/
+static int GClip_WorldPointContents( vec3_t p )
+{
+	int contents;
+
+	if( g_tracecache->integer && GS_TraceCache_FindContents( &g_tracecache_world, p, &contents ) )
+		return contents;
+
+	contents = trap_CM_TransformedPointContents( p, NULL, NULL, NULL );
+
+	if( g_tracecache->integer )
+		GS_TraceCache_StoreContents( &g_tracecache_world, p, contents );
+	return contents;
+}
+
+
 /*
 * GClip_ClearWorld
 * called after the world model has been loaded, before linking any entities
@@ -502,6 +677,10 @@ void GClip_ClearWorld( void )
 	trap_CM_InlineModelBounds( world_model, world_mins, world_maxs );
 
 	GClip_Init_AreaGrid( &g_areagrid, world_mins, world_maxs );
+
+	GClip_ClearCollisionFrames();
+
+	GClip_InvalidateTraceCache();
 }
 
 /*
@@ -731,14 +910,15 @@ static int GClip_AreaEdicts( const vec3_t mins, const vec3_t maxs,
 * Returns a collision model that can be used for testing or clipping an
 * object of mins/maxs size.
 */
-static struct cmodel_s *GClip_CollisionModelForEntity( entity_state_t *s, entity_shared_t *r )
+static struct cmodel_s *GClip_CollisionModelForEntity( c4clipedict_t *clipEnt )
 {
 	struct cmodel_s	*model;
+	int type;
 
-	if( ISBRUSHMODEL( s->modelindex ) )
+	if( ISBRUSHMODEL( clipEnt->modelindex ) )
 	{ 
 		// explicit hulls in the BSP model
-		model = trap_CM_InlineModel( s->modelindex );
+		model = trap_CM_InlineModel( clipEnt->modelindex );
 		if( !model )
 			G_Error( "MOVETYPE_PUSH with a non bsp model" );
 
@@ -746,10 +926,11 @@ static struct cmodel_s *GClip_CollisionModelForEntity( entity_state_t *s, entity
 	}
 
 	// create a temp hull from bounding box sizes
-	if( s->type == ET_PLAYER || s->type == ET_CORPSE )
-		return trap_CM_OctagonModelForBBox( r->mins, r->maxs );
+	type = clipEnt->ent->s.type;
+	if( type == ET_PLAYER || type == ET_CORPSE )
+		return trap_CM_OctagonModelForBBox( clipEnt->mins, clipEnt->maxs );
 	else
-		return trap_CM_ModelForBBox( r->mins, r->maxs );
+		return trap_CM_ModelForBBox( clipEnt->mins, clipEnt->maxs );
 }
 
 
@@ -767,7 +948,7 @@ static int GClip_PointContents( vec3_t p, int timeDelta )
 	struct cmodel_s	*cmodel;
 
 	// get base contents from world
-	contents = trap_CM_TransformedPointContents( p, NULL, NULL, NULL );
+	contents = GClip_WorldPointContents( p );
 
 	// or in contents from all the other entities
 	num = GClip_AreaEdicts( p, p, touch, MAX_EDICTS, AREA_SOLID, timeDelta );
@@ -777,9 +958,9 @@ static int GClip_PointContents( vec3_t p, int timeDelta )
 		clipEnt = GClip_GetClipEdictForDeltaTime( touch[i], timeDelta );
 
 		// might intersect, so do an exact clip
-		cmodel = GClip_CollisionModelForEntity( &clipEnt->s, &clipEnt->r );
+		cmodel = GClip_CollisionModelForEntity( clipEnt );
 
-		c2 = trap_CM_TransformedPointContents( p, cmodel, clipEnt->s.origin, clipEnt->s.angles );
+		c2 = trap_CM_TransformedPointContents( p, cmodel, clipEnt->origin, clipEnt->angles );
 		contents |= c2;
 	}
 
@@ -816,6 +997,7 @@ typedef struct
 {
 	int i, num;
 	c4clipedict_t *touch;
+	int touchNum;
 	int touchlist[MAX_EDICTS];
 	trace_t	trace;
 	struct cmodel_s	*cmodel;
@@ -828,40 +1010,41 @@ typedef struct
 	for( i = 0; i < num; i++ )
 	{
 		touch = GClip_GetClipEdictForDeltaTime( touchlist[i], timeDelta );
+		touchNum = touchlist[i];
 		if( clip->passent >= 0 )
 		{
 			// when they are offseted in time, they can be a different pointer but be the same entity
-			if( touch->s.number == clip->passent )
+			if( touchNum == clip->passent )
 				continue;
-			if( touch->r.owner && ( touch->r.owner->s.number == clip->passent ) )
+			if( touch->ent->r.owner && ( touch->ent->r.owner->s.number == clip->passent ) )
 				continue;
 			if( game.edicts[clip->passent].r.owner 
-				&& ( game.edicts[clip->passent].r.owner->s.number == touch->s.number ) )
+				&& ( game.edicts[clip->passent].r.owner->s.number == touchNum ) )
 				continue;
 
 			// wsw : jal : never clipmove against SVF_PROJECTILE entities
-			if( touch->r.svflags & SVF_PROJECTILE )
+			if( touch->ent->r.svflags & SVF_PROJECTILE )
 				continue;
 		}
 
-		if( ( touch->r.svflags & SVF_CORPSE ) && !( clip->contentmask & CONTENTS_CORPSE ) )
+		if( ( touch->ent->r.svflags & SVF_CORPSE ) && !( clip->contentmask & CONTENTS_CORPSE ) )
 			continue;
 
 		// might intersect, so do an exact clip
-		cmodel = GClip_CollisionModelForEntity( &touch->s, &touch->r );
+		cmodel = GClip_CollisionModelForEntity( touch );
 
-		if( ISBRUSHMODEL( touch->s.modelindex ) )
-			angles = touch->s.angles;
+		if( ISBRUSHMODEL( touch->modelindex ) )
+			angles = touch->angles;
 		else
 			angles = vec3_origin; // boxes don't rotate
 
 		trap_CM_TransformedBoxTrace( &trace, clip->start, clip->end,
 			clip->mins, clip->maxs, cmodel, clip->contentmask,
-			touch->s.origin, angles );
+			touch->origin, angles );
 
 		if( trace.allsolid || trace.fraction < clip->trace->fraction )
 		{
-			trace.ent = touch->s.number;
+			trace.ent = touchNum;
 			*( clip->trace ) = trace;
 		}
 		else if( trace.startsolid )
@@ -934,7 +1117,7 @@ static void GClip_Trace( trace_t *tr, vec3_t start, vec3_t mins, vec3_t maxs,
 	else
 	{
 		// clip to world
-		trap_CM_TransformedBoxTrace( tr, start, end, mins, maxs, NULL, contentmask, NULL, NULL );
+		GClip_WorldTrace( tr, start, mins, maxs, end, contentmask );
 		tr->ent = tr->fraction < 1.0 ? world->s.number : -1;
 		if( tr->fraction == 0 )
 			return; // blocked by the world
@@ -1220,12 +1403,15 @@ void G_SplashFrac4D( int entNum, vec3_t hitpoint, float maxradius, vec3_t pushdi
 	c4clipedict_t *clipEnt;
 
 	clipEnt = GClip_GetClipEdictForDeltaTime( entNum, timeDelta );
-	G_SplashFrac( clipEnt->s.origin, clipEnt->r.mins, clipEnt->r.maxs, hitpoint, 
+	G_SplashFrac( clipEnt->origin, clipEnt->mins, clipEnt->maxs, hitpoint, 
 		maxradius, pushdir, kickFrac, dmgFrac );
 }
 
 entity_state_t *G_GetEntityStateForDeltaTime( int entNum, int deltaTime )
 {
+	static int index = 0;
+	static entity_state_t states[8];
+	entity_state_t *state;
 	c4clipedict_t *clipEnt;
 
 	if( entNum == -1 )
@@ -1235,6 +1421,141 @@ entity_state_t *G_GetEntityStateForDeltaTime( int entNum, int deltaTime )
 
 	clipEnt = GClip_GetClipEdictForDeltaTime( entNum, deltaTime );
 
-	return &clipEnt->s;
+	// pick one of the 8 slots to prevent overwritings
+	state = &states[index];
+	index = ( index + 1 )&7;
+
+	*state = clipEnt->ent->s;
+	state->modelindex = clipEnt->modelindex;
+	VectorCopy( clipEnt->origin, state->origin );
+	VectorCopy( clipEnt->angles, state->angles );
+	return state;
+}
+
+// the layout the antilag history had before it was kept per field: full
+// copies of the entity state of every edict in each collision frame.
+// Only kept so that antilagbench can compare the two
+typedef struct
+{
+	entity_state_t s;
+	entity_shared_t r;
+} c4fullclipedict_t;
+
+/*
+* GClip_BackUpFullCollisionFrame
+*/
+static void GClip_BackUpFullCollisionFrame( c4fullclipedict_t *frames, unsigned int framenum )
+{
+	c4fullclipedict_t *clipEdicts = frames + ( framenum & CFRAME_UPDATE_MASK ) * MAX_EDICTS;
+	edict_t *svedict;
+	int i;
+
+	for( i = 0; i < game.numentities; i++ )
+	{
+		svedict = &game.edicts[i];
+
+		clipEdicts[i].r.inuse = svedict->r.inuse;
+		clipEdicts[i].r.solid = svedict->r.solid;
+		if( !GClip_EntityIsAntilagged( i, svedict ) )
+			continue;
+
+		clipEdicts[i].r = svedict->r;
+		clipEdicts[i].s = svedict->s;
+	}
 }
 
+/*
+* GClip_AntilagBenchmark_f
+* 
+* Times the collision frame backup against the old full entity layout and
+* antilagged traces fired from every client against the entities of the
+* current map. Add bots first to test a full server. The real history is
+* saved and restored, so antilag keeps working afterwards.
+*/
+void GClip_AntilagBenchmark_f( void )
+{
+	int i, j, iterations, numclients, numtraces;
+	unsigned int start, fullLayoutTime, backupTime, fullBackupTime, traceTime;
+	unsigned int savedFrameNum;
+	c4history_t *saved;
+	c4fullclipedict_t *fullFrames;
+	vec3_t end;
+	trace_t trace;
+	edict_t *ent;
+
+	if( !g_antilag->integer )
+	{
+		G_Printf( "g_antilag is disabled\n" );
+		return;
+	}
+
+	iterations = trap_Cmd_Argc() > 1 ? atoi( trap_Cmd_Argv( 1 ) ) : 1000;
+	clamp( iterations, 1, 100000 );
+
+	saved = ( c4history_t * )G_Malloc( sizeof( *saved ) );
+	memcpy( saved, &sv_collisionhistory, sizeof( *saved ) );
+	savedFrameNum = sv_collisionFrameNum;
+
+	// the old layout, every antilagged entity copied into every frame
+	fullFrames = ( c4fullclipedict_t * )G_Malloc( sizeof( *fullFrames ) * CFRAME_UPDATE_BACKUP * MAX_EDICTS );
+	start = trap_Milliseconds();
+	for( i = 0; i < iterations; i++ )
+		GClip_BackUpFullCollisionFrame( fullFrames, i );
+	fullLayoutTime = trap_Milliseconds() - start;
+	G_Free( fullFrames );
+
+	// unchanged collision state, the common case for most entities
+	start = trap_Milliseconds();
+	for( i = 0; i < iterations; i++ )
+		GClip_BackUpCollisionFrame();
+	backupTime = trap_Milliseconds() - start;
+
+	// every entity recorded, the worst case
+	start = trap_Milliseconds();
+	for( i = 0; i < iterations; i++ )
+	{
+		memset( sv_collisionhistory.numrecords, 0, sizeof( sv_collisionhistory.numrecords ) );
+		GClip_BackUpCollisionFrame();
+	}
+	fullBackupTime = trap_Milliseconds() - start;
+
+	// put some time between the backed up frames so that traces interpolate
+	GClip_ClearCollisionFrames();
+	for( i = 0; i < CFRAME_UPDATE_BACKUP; i++ )
+	{
+		GClip_BackUpCollisionFrame();
+		sv_collisionhistory.timestamps[i] -= ( CFRAME_UPDATE_BACKUP - i ) * game.snapFrameTime;
+	}
+
+	numtraces = 0;
+	start = trap_Milliseconds();
+	for( i = 0; i < iterations; i++ )
+	{
+		for( j = 0; j < gs.maxclients; j++ )
+		{
+			ent = PLAYERENT( j );
+			if( !ent->r.inuse || !ent->r.client || ent->r.solid == SOLID_NOT )
+				continue;
+
+			VectorSet( end, ent->s.origin[0] + crandom() * 4096, ent->s.origin[1] + crandom() * 4096, 
+				ent->s.origin[2] + crandom() * 1024 );
+			G_Trace4D( &trace, ent->s.origin, NULL, NULL, end, ent, MASK_SHOT, -( 1 + ( i % 200 ) ) );
+			numtraces++;
+		}
+	}
+	traceTime = trap_Milliseconds() - start;
+	numclients = numtraces / iterations;
+
+	// the timestamps were faked, put the real history back
+	memcpy( &sv_collisionhistory, saved, sizeof( *saved ) );
+	sv_collisionFrameNum = savedFrameNum;
+	G_Free( saved );
+
+	G_Printf( "antilag benchmark: %i entities, %i clients, %i iterations\n", game.numentities, numclients, iterations );
+	G_Printf( "  full entity layout: %.3f ms/frame, %.1f MB\n", (float)fullLayoutTime / iterations,
+		sizeof( c4fullclipedict_t ) * CFRAME_UPDATE_BACKUP * MAX_EDICTS / ( 1024.0f * 1024.0f ) );
+	G_Printf( "  per field history: %.3f ms/frame unchanged, %.3f ms/frame all changed, %.1f MB\n",
+		(float)backupTime / iterations, (float)fullBackupTime / iterations, sizeof( c4history_t ) / ( 1024.0f * 1024.0f ) );
+	if( numtraces )
+		G_Printf( "  G_Trace4D: %.3f us/trace\n", (float)traceTime * 1000.0f / numtraces );
+}
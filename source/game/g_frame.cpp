@@ -819,4 +819,5 @@ void G_RunFrame( unsigned int msec, unsigned int serverTime )
 	GClip_BackUpCollisionFrame();
 
 	G_LevelGarbageCollect();
+	G_EdictStats();
 }
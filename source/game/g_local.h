@@ -362,6 +362,7 @@ extern cvar_t *g_deadbody_followkiller;
 extern cvar_t *g_deadbody_autogib_delay;
 extern cvar_t *g_antilag_timenudge;
 extern cvar_t *g_antilag_maxtimedelta;
+extern cvar_t *g_tracecache;
 
 extern cvar_t *g_teams_maxplayers;
 extern cvar_t *g_teams_allow_uneven;
@@ -374,6 +375,7 @@ extern cvar_t *g_instajump;
 extern cvar_t *g_instashield;
 
 extern cvar_t *g_asGC_stats;
+extern cvar_t *g_edicts_stats;
 extern cvar_t *g_asGC_interval;
 
 extern cvar_t *g_skillRating;
@@ -598,6 +600,10 @@ bool Add_Armor( edict_t *ent, edict_t *other, bool pick_it );
 bool KillBox( edict_t *ent );
 float LookAtKillerYAW( edict_t *self, edict_t *inflictor, edict_t *attacker );
 edict_t *G_Find( edict_t *from, size_t fieldofs, const char *match );
+void G_InitEdictNameIndex( void );
+void G_LinkEdictNames( edict_t *ent );
+void G_SetClassname( edict_t *ent, const char *classname );
+void G_SetTargetname( edict_t *ent, const char *targetname );
 edict_t *G_FindBoxInRadius( edict_t *from, edict_t *to, vec3_t org, float rad );
 edict_t *G_PickTarget( const char *targetname );
 void G_UseTargets( edict_t *ent, edict_t *activator );
@@ -606,6 +612,8 @@ void G_InitMover( edict_t *ent );
 void G_DropSpawnpointToFloor( edict_t *ent );
 
 void G_InitEdict( edict_t *e );
+void G_ClearEdictQueues( void );
+void G_EdictStats( void );
 edict_t *G_Spawn( void );
 void G_FreeEdict( edict_t *e );
 
@@ -615,6 +623,7 @@ void *_G_LevelMalloc( size_t size, const char *filename, int fileline );
 void _G_LevelFree( void *data, const char *filename, int fileline );
 char *_G_LevelCopyString( const char *in, const char *filename, int fileline );
 void G_LevelGarbageCollect( void );
+void G_LevelZoneStats_f( void );
 
 void G_StringPoolInit( void );
 const char *_G_RegisterLevelString( const char *string, const char *filename, int fileline );
@@ -755,6 +764,9 @@ void GClip_TouchTriggers( edict_t *ent );
 void G_PMoveTouchTriggers( pmove_t *pm, vec3_t previous_origin );
 entity_state_t *G_GetEntityStateForDeltaTime( int entNum, int deltaTime );
 int GClip_FindRadius( vec3_t org, float rad, int *list, int maxcount );
+void GClip_AntilagBenchmark_f( void );
+void GClip_InvalidateTraceCache( void );
+void GClip_TraceCacheStats_f( void );
 
 //
 // g_combat.c
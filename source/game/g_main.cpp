@@ -74,6 +74,7 @@ cvar_t *g_maxtimeouts;
 cvar_t *g_antilag;
 cvar_t *g_antilag_maxtimedelta;
 cvar_t *g_antilag_timenudge;
+cvar_t *g_tracecache;
 cvar_t *g_autorecord;
 cvar_t *g_autorecord_maxdemos;
 
@@ -105,6 +106,7 @@ cvar_t *g_disable_vote_gametype;
 cvar_t *g_allow_spectator_voting;
 
 cvar_t *g_asGC_stats;
+cvar_t *g_edicts_stats;
 cvar_t *g_asGC_interval;
 
 cvar_t *g_skillRating;
@@ -298,6 +300,7 @@ void G_Init( unsigned int seed, unsigned int framemsec, int protocol, const char
 	g_antilag_maxtimedelta->modified = true;
 	g_antilag_timenudge = trap_Cvar_Get( "g_antilag_timenudge", "0", CVAR_ARCHIVE );
 	g_antilag_timenudge->modified = true;
+	g_tracecache = trap_Cvar_Get( "g_tracecache", "1", CVAR_ARCHIVE );
 
 	g_allow_spectator_voting = trap_Cvar_Get( "g_allow_spectator_voting", "1", CVAR_ARCHIVE );
 
@@ -349,6 +352,7 @@ void G_Init( unsigned int seed, unsigned int framemsec, int protocol, const char
 	g_disable_vote_gametype = trap_Cvar_Get( "g_disable_vote_gametype", "0", CVAR_ARCHIVE );
 
 	g_asGC_stats = trap_Cvar_Get( "g_asGC_stats", "0", CVAR_ARCHIVE );
+	g_edicts_stats = trap_Cvar_Get( "g_edicts_stats", "0", 0 );
 	g_asGC_interval = trap_Cvar_Get( "g_asGC_interval", "10", CVAR_ARCHIVE );
 
 	g_skillRating = trap_Cvar_Get( "sv_skillRating", va("%.0f", MM_RATING_DEFAULT), CVAR_SERVERINFO|CVAR_READONLY );
@@ -368,6 +372,8 @@ void G_Init( unsigned int seed, unsigned int framemsec, int protocol, const char
 	game.quits = NULL;
 
 	game.numentities = gs.maxclients + 1;
+	G_InitEdictNameIndex();
+	G_ClearEdictQueues();
 
 	trap_LocateEntities( game.edicts, sizeof( game.edicts[0] ), game.numentities, game.maxentities );
 
@@ -405,6 +411,8 @@ void G_Shutdown( void )
 
 	BOT_RemoveBot( "all" );
 
+	AI_Shutdown();
+
 	G_RemoveCommands();
 
 	G_FreeCallvotes();
@@ -443,7 +451,7 @@ static edict_t *CreateTargetChangeLevel( const char *map )
 	edict_t *ent;
 
 	ent = G_Spawn();
-	ent->classname = "target_changelevel";
+	G_SetClassname( ent, "target_changelevel" );
 	Q_strncpyz( level.nextmap, map, sizeof( level.nextmap ) );
 	ent->map = level.nextmap;
 	return ent;
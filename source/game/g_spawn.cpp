@@ -494,6 +494,7 @@ static char *ED_ParseEdict( char *data, edict_t *ent )
 
 	if( !init )
 		ent->classname = NULL;
+	G_LinkEdictNames( ent );
 	if( ent->classname && ent->helpmessage )
 		ent->mapmessage_index = G_RegisterHelpMessage( ent->helpmessage );
 
@@ -746,6 +747,7 @@ static void G_FreeEntities( void )
 	}
 	
 	game.numentities = gs.maxclients + 1;
+	G_ClearEdictQueues();
 }
 
 /*
@@ -823,7 +825,7 @@ static void G_SpawnEntities( void )
 				if( G_Gametype_CanSpawnItem( item ) )
 				{
 					// override entity's classname with whatever item specifies
-					ent->classname = item->classname;
+					G_SetClassname( ent, item->classname );
 					PrecacheItem( item );
 					continue;
 				}
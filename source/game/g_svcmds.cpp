@@ -410,6 +410,11 @@ void G_AddServerCommands( void )
 	trap_Cmd_AddCommand( "listraces", G_ListRaces_f );
 
 	trap_Cmd_AddCommand( "listlocations", Cmd_ListLocations_f );
+
+	trap_Cmd_AddCommand( "antilagbench", GClip_AntilagBenchmark_f );
+	trap_Cmd_AddCommand( "tracecachestats", GClip_TraceCacheStats_f );
+
+	trap_Cmd_AddCommand( "levelzonestats", G_LevelZoneStats_f );
 }
 
 /*
@@ -445,4 +450,9 @@ void G_RemoveCommands( void )
 	trap_Cmd_RemoveCommand( "listraces" );
 
 	trap_Cmd_RemoveCommand( "listlocations" );
+
+	trap_Cmd_RemoveCommand( "antilagbench" );
+	trap_Cmd_RemoveCommand( "tracecachestats" );
+
+	trap_Cmd_RemoveCommand( "levelzonestats" );
 }
@@ -162,6 +162,36 @@ static inline void trap_MemFree( void *data, const char *filename, int fileline
 	GAME_IMPORT.Mem_Free( data, filename, fileline );
 }
 
+static inline struct qthread_s *trap_Thread_Create( void *(*routine) (void*), void *param )
+{
+	return GAME_IMPORT.Thread_Create( routine, param );
+}
+
+static inline void trap_Thread_Join( struct qthread_s *thread )
+{
+	GAME_IMPORT.Thread_Join( thread );
+}
+
+static inline struct qmutex_s *trap_Mutex_Create( void )
+{
+	return GAME_IMPORT.Mutex_Create();
+}
+
+static inline void trap_Mutex_Destroy( struct qmutex_s **mutex )
+{
+	GAME_IMPORT.Mutex_Destroy( mutex );
+}
+
+static inline void trap_Mutex_Lock( struct qmutex_s *mutex )
+{
+	GAME_IMPORT.Mutex_Lock( mutex );
+}
+
+static inline void trap_Mutex_Unlock( struct qmutex_s *mutex )
+{
+	GAME_IMPORT.Mutex_Unlock( mutex );
+}
+
 // dynvars
 static inline dynvar_t *trap_Dynvar_Create( const char *name, bool console, dynvar_getter_f getter, dynvar_setter_f setter )
 {
@@ -29,9 +29,10 @@ ZONE MEMORY ALLOCATION
 There is never any space between memblocks, and there will never be two
 contiguous free memblocks.
 
-The rover can be left pointing at a non-empty block.
-
-Ported over from Quake 1 and Quake 3.
+Free blocks are kept in segregated lists indexed by a two-level bitmap, the
+first level splits sizes by powers of two and the second one subdivides each
+range linearly, so that both allocation and freeing run in constant time
+regardless of how fragmented the zone is.
 ==============================================================================
 */
 
@@ -41,11 +42,19 @@ Ported over from Quake 1 and Quake 3.
 #define	ZONEID		0x1d4a11
 #define MINFRAGMENT 64
 
+#define ZONE_ALIGNMENT		8
+#define ZONE_SL_LOG2		4						// 16 lists per power of two
+#define ZONE_SL_COUNT		( 1 << ZONE_SL_LOG2 )
+#define ZONE_FL_SHIFT		( ZONE_SL_LOG2 + 3 )	// below this, lists are ZONE_ALIGNMENT apart
+#define ZONE_SMALL_SIZE		( 1 << ZONE_FL_SHIFT )
+#define ZONE_FL_COUNT		( 31 - ZONE_FL_SHIFT + 1 )
+
 typedef struct memblock_s
 {
 	int		size;           // including the header and possibly tiny fragments
 	int     tag;            // a tag of 0 is a free block
-	struct memblock_s       *next, *prev;
+	struct memblock_s       *prev;				// physically previous block
+	struct memblock_s       *nextfree, *prevfree;	// only valid for free blocks
 	int     id;        		// should be ZONEID
 } memblock_t;
 
@@ -53,34 +62,166 @@ typedef struct
 {
 	int		size;		// total bytes malloced, including header
 	int		count, used;
-	memblock_t	blocklist;		// start / end cap for linked list
-	memblock_t	*rover;
+	memblock_t	*end;		// in use cap after the last block
+	unsigned int flBitmap;
+	unsigned int slBitmap[ZONE_FL_COUNT];
+	memblock_t	*free[ZONE_FL_COUNT][ZONE_SL_COUNT];
 } memzone_t;
 
 static memzone_t *levelzone;
 
+#define G_Z_NextBlock( block ) ( (memblock_t *)( (uint8_t *)( block ) + ( block )->size ) )
+
+/*
+* G_Z_FindFirstSet
+*/
+static inline int G_Z_FindFirstSet( unsigned int mask )
+{
+	static const int debruijn[32] =
+	{
+		0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+		31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+	};
+
+	return debruijn[( ( mask & ( 0u - mask ) ) * 0x077CB531u ) >> 27];
+}
+
+/*
+* G_Z_FindLastSet
+*/
+static inline int G_Z_FindLastSet( unsigned int mask )
+{
+	int bit = 0;
+
+	if( mask & 0xFFFF0000 ) { mask >>= 16; bit += 16; }
+	if( mask & 0xFF00 ) { mask >>= 8; bit += 8; }
+	if( mask & 0xF0 ) { mask >>= 4; bit += 4; }
+	if( mask & 0xC ) { mask >>= 2; bit += 2; }
+	if( mask & 0x2 ) { bit += 1; }
+	return bit;
+}
+
+/*
+* G_Z_MappingInsert
+* Returns the list a free block of the given size belongs to
+*/
+static void G_Z_MappingInsert( int size, int *fl, int *sl )
+{
+	int bit;
+
+	if( size < ZONE_SMALL_SIZE )
+	{
+		*fl = 0;
+		*sl = size / ( ZONE_SMALL_SIZE / ZONE_SL_COUNT );
+		return;
+	}
+
+	bit = G_Z_FindLastSet( size );
+	*fl = bit - ( ZONE_FL_SHIFT - 1 );
+	*sl = ( size >> ( bit - ZONE_SL_LOG2 ) ) ^ ZONE_SL_COUNT;
+}
+
+/*
+* G_Z_InsertFreeBlock
+*/
+static void G_Z_InsertFreeBlock( memzone_t *zone, memblock_t *block )
+{
+	int fl, sl;
+
+	G_Z_MappingInsert( block->size, &fl, &sl );
+
+	block->tag = TAG_FREE;
+	block->prevfree = NULL;
+	block->nextfree = zone->free[fl][sl];
+	if( block->nextfree )
+		block->nextfree->prevfree = block;
+	zone->free[fl][sl] = block;
+
+	zone->flBitmap |= 1u << fl;
+	zone->slBitmap[fl] |= 1u << sl;
+}
+
+/*
+* G_Z_RemoveFreeBlock
+*/
+static void G_Z_RemoveFreeBlock( memzone_t *zone, memblock_t *block )
+{
+	int fl, sl;
+
+	G_Z_MappingInsert( block->size, &fl, &sl );
+
+	if( block->nextfree )
+		block->nextfree->prevfree = block->prevfree;
+	if( block->prevfree )
+		block->prevfree->nextfree = block->nextfree;
+	else
+	{
+		zone->free[fl][sl] = block->nextfree;
+		if( !zone->free[fl][sl] )
+		{
+			zone->slBitmap[fl] &= ~( 1u << sl );
+			if( !zone->slBitmap[fl] )
+				zone->flBitmap &= ~( 1u << fl );
+		}
+	}
+}
+
+/*
+* G_Z_FindFreeBlock
+* Returns a free block of at least the given size
+*/
+static memblock_t *G_Z_FindFreeBlock( memzone_t *zone, int size )
+{
+	int fl, sl;
+	unsigned int slMap, flMap;
+
+	// round up to the next list, so that any block in it is big enough
+	if( size >= ZONE_SMALL_SIZE )
+		size += ( 1 << ( G_Z_FindLastSet( size ) - ZONE_SL_LOG2 ) ) - 1;
+	G_Z_MappingInsert( size, &fl, &sl );
+	if( fl >= ZONE_FL_COUNT )
+		return NULL;
+
+	slMap = sl < ZONE_SL_COUNT ? zone->slBitmap[fl] & ( ~0u << sl ) : 0;
+	if( !slMap )
+	{
+		flMap = fl + 1 < ZONE_FL_COUNT ? zone->flBitmap & ( ~0u << ( fl + 1 ) ) : 0;
+		if( !flMap )
+			return NULL;
+		fl = G_Z_FindFirstSet( flMap );
+		slMap = zone->slBitmap[fl];
+	}
+	sl = G_Z_FindFirstSet( slMap );
+
+	return zone->free[fl][sl];
+}
+
 /*
 * G_Z_ClearZone
 */
 static void G_Z_ClearZone( memzone_t *zone, int size )
 {
 	memblock_t	*block;
+	int blocksize;
 
-	// set the entire zone to one free block
-	zone->blocklist.next = zone->blocklist.prev = block =
-		(memblock_t *)( (uint8_t *)zone + sizeof(memzone_t) );
-	zone->blocklist.tag = 1;	// in use block
-	zone->blocklist.id = 0;
-	zone->blocklist.size = 0;
+	memset( zone, 0, sizeof( memzone_t ) );
 	zone->size = size;
-	zone->rover = block;
-	zone->used = 0;
-	zone->count = 0;
 
-	block->prev = block->next = &zone->blocklist;
-	block->tag = 0;			// free block
+	// the entire zone is one free block, followed by an in use cap
+	block = (memblock_t *)( (uint8_t *)zone + ( ( sizeof( memzone_t ) + ZONE_ALIGNMENT - 1 ) & ~( ZONE_ALIGNMENT - 1 ) ) );
+	blocksize = ( (uint8_t *)zone + size - (uint8_t *)block - sizeof( memblock_t ) ) & ~( ZONE_ALIGNMENT - 1 );
+
+	block->size = blocksize;
+	block->prev = NULL;
 	block->id = ZONEID;
-	block->size = size - sizeof(memzone_t);
+
+	zone->end = G_Z_NextBlock( block );
+	zone->end->size = 0;
+	zone->end->tag = TAG_LEVEL;
+	zone->end->prev = block;
+	zone->end->id = ZONEID;
+
+	G_Z_InsertFreeBlock( zone, block );
 }
 
 /*
@@ -108,30 +249,25 @@ static void G_Z_Free( void *ptr, const char *filename, int fileline )
 	zone->used -= block->size;
 	zone->count--;
 
-	block->tag = 0;		// mark as free
-
 	other = block->prev;
-	if( !other->tag )
+	if( other && !other->tag )
 	{
 		// merge with previous free block
+		G_Z_RemoveFreeBlock( zone, other );
 		other->size += block->size;
-		other->next = block->next;
-		other->next->prev = other;
-		if( block == zone->rover )
-			zone->rover = other;
 		block = other;
 	}
 
-	other = block->next;
+	other = G_Z_NextBlock( block );
 	if( !other->tag )
 	{
 		// merge the next free block onto the end
+		G_Z_RemoveFreeBlock( zone, other );
 		block->size += other->size;
-		block->next = other->next;
-		block->next->prev = block;
-		if( other == zone->rover )
-			zone->rover = block;
 	}
+
+	G_Z_NextBlock( block )->prev = block;
+	G_Z_InsertFreeBlock( zone, block );
 }
 
 /*
@@ -140,33 +276,22 @@ static void G_Z_Free( void *ptr, const char *filename, int fileline )
 static void *G_Z_TagMalloc( int size, int tag, const char *filename, int fileline )
 {
 	int extra;
-	memblock_t *start, *rover, *newb, *base;
+	memblock_t *newb, *base;
 	memzone_t *zone;
 
 	if( !tag )
 		G_Error( "G_Z_TagMalloc: tried to use a 0 tag (file %s at line %i)", filename, fileline );
 
-	//
-	// scan through the block list looking for the first free block
-	// of sufficient size
-	//
 	size += sizeof(memblock_t);	// account for size of block header
 	size += 4;					// space for memory trash tester
-	size = (size + 3) & ~3;		// align to 32-bit boundary
+	size = ( size + ZONE_ALIGNMENT - 1 ) & ~( ZONE_ALIGNMENT - 1 );
 
 	zone = levelzone;
-	base = rover = zone->rover;
-	start = base->prev;
+	base = G_Z_FindFreeBlock( zone, size );
+	if( !base )
+		return NULL;
 
-	do
-	{
-		if( rover == start )	// scaned all the way around the list
-			return NULL;
-		if( rover->tag )
-			base = rover = rover->next;
-		else
-			rover = rover->next;
-	} while( base->tag || base->size < size );
+	G_Z_RemoveFreeBlock( zone, base );
 
 	//
 	// found a block big enough
@@ -175,19 +300,16 @@ static void *G_Z_TagMalloc( int size, int tag, const char *filename, int filelin
 	if( extra > MINFRAGMENT )
 	{
 		// there will be a free fragment after the allocated block
-		newb = (memblock_t *) ((uint8_t *)base + size );
+		base->size = size;
+		newb = G_Z_NextBlock( base );
 		newb->size = extra;
-		newb->tag = 0;			// free block
 		newb->prev = base;
 		newb->id = ZONEID;
-		newb->next = base->next;
-		newb->next->prev = newb;
-		base->next = newb;
-		base->size = size;
+		G_Z_NextBlock( newb )->prev = newb;
+		G_Z_InsertFreeBlock( zone, newb );
 	}
 
 	base->tag = tag;				// no longer a free block
-	zone->rover = base->next;	// next allocation will start looking here
 	zone->used += base->size;
 	zone->count++;
 	base->id = ZONEID;
@@ -213,6 +335,63 @@ static void *G_Z_Malloc( int size, const char *filename, int fileline )
 	return buf;
 }
 
+/*
+* G_Z_Print
+*/
+static void G_Z_Print( memzone_t *zone )
+{
+	int fl, sl;
+	int numFree, freeSize, largestFree;
+	int listCount[ZONE_FL_COUNT];
+	memblock_t *block;
+
+	numFree = freeSize = largestFree = 0;
+	for( fl = 0; fl < ZONE_FL_COUNT; fl++ )
+	{
+		listCount[fl] = 0;
+		for( sl = 0; sl < ZONE_SL_COUNT; sl++ )
+		{
+			for( block = zone->free[fl][sl]; block; block = block->nextfree )
+			{
+				listCount[fl]++;
+				freeSize += block->size;
+				if( block->size > largestFree )
+					largestFree = block->size;
+			}
+		}
+		numFree += listCount[fl];
+	}
+
+	G_Printf( "level zone: %i bytes, %i used in %i blocks, %i free in %i blocks\n",
+		zone->size, zone->used, zone->count, freeSize, numFree );
+	G_Printf( "largest free block: %i bytes, fragmentation: %.1f%%\n",
+		largestFree, freeSize ? 100.0f * ( 1.0f - (float)largestFree / freeSize ) : 0.0f );
+
+	for( fl = 0; fl < ZONE_FL_COUNT; fl++ )
+	{
+		if( !listCount[fl] )
+			continue;
+		if( !fl )
+			G_Printf( "%8i-%-8i: %i free blocks\n", 0, ZONE_SMALL_SIZE - 1, listCount[fl] );
+		else
+			G_Printf( "%8i-%-8i: %i free blocks\n", 1 << ( fl + ZONE_FL_SHIFT - 1 ), ( 1 << ( fl + ZONE_FL_SHIFT ) ) - 1, listCount[fl] );
+	}
+}
+
+/*
+* G_LevelZoneStats_f
+*/
+void G_LevelZoneStats_f( void )
+{
+	if( !levelzone )
+	{
+		G_Printf( "No level zone\n" );
+		return;
+	}
+
+	G_Z_Print( levelzone );
+}
+
 //==============================================================================
 
 /*
@@ -271,7 +450,7 @@ char *_G_LevelCopyString( const char *in, const char *filename, int fileline )
 */
 void G_LevelGarbageCollect( void )
 {
-	//G_Z_Print( levelzone );
+	// freed blocks are coalesced immediately, nothing to do
 }
 
 //==============================================================================
@@ -529,6 +708,208 @@ void G_ProjectSource( vec3_t point, vec3_t distance, vec3_t forward, vec3_t righ
 }
 
 
+//==================================================
+// EDICT NAME INDEX
+//==================================================
+
+/*
+* Entities are linked into hash chains by classname and targetname, so G_Find
+* doesn't have to compare the strings of every edict. The chains live outside
+* of the edicts, because those get memset in a few places, and they are kept
+* sorted by entity number so G_Find still returns the matches in order.
+* Entries are only hints, G_Find always compares the string it finds.
+*/
+
+#define EDICT_NAMEHASH_SIZE	256
+
+typedef struct
+{
+	size_t fieldofs;
+	int hashTable[EDICT_NAMEHASH_SIZE];
+	int bucket[MAX_EDICTS];
+	int prev[MAX_EDICTS];
+	int next[MAX_EDICTS];
+} g_edictnameindex_t;
+
+static g_edictnameindex_t classnameIndex;
+static g_edictnameindex_t targetnameIndex;
+
+/*
+* G_EdictNameHash
+*/
+static int G_EdictNameHash( const char *name )
+{
+	unsigned int hash = 2166136261u;
+
+	for( ; *name; name++ )
+		hash = ( hash ^ (unsigned char)tolower( *name ) ) * 16777619u;
+
+	return (int)( hash & ( EDICT_NAMEHASH_SIZE - 1 ) );
+}
+
+/*
+* G_EdictNameIndex_Init
+*/
+static void G_EdictNameIndex_Init( g_edictnameindex_t *index, size_t fieldofs )
+{
+	int i;
+
+	index->fieldofs = fieldofs;
+	for( i = 0; i < EDICT_NAMEHASH_SIZE; i++ )
+		index->hashTable[i] = -1;
+	for( i = 0; i < MAX_EDICTS; i++ )
+		index->bucket[i] = index->prev[i] = index->next[i] = -1;
+}
+
+/*
+* G_EdictNameIndex_Unlink
+*/
+static void G_EdictNameIndex_Unlink( g_edictnameindex_t *index, int num )
+{
+	if( index->bucket[num] == -1 )
+		return;
+
+	if( index->prev[num] != -1 )
+		index->next[index->prev[num]] = index->next[num];
+	else
+		index->hashTable[index->bucket[num]] = index->next[num];
+	if( index->next[num] != -1 )
+		index->prev[index->next[num]] = index->prev[num];
+
+	index->bucket[num] = index->prev[num] = index->next[num] = -1;
+}
+
+/*
+* G_EdictNameIndex_Link
+* 
+* Re-links the edict under the current value of its field
+*/
+static void G_EdictNameIndex_Link( g_edictnameindex_t *index, edict_t *ent )
+{
+	int num = ENTNUM( ent );
+	int bucket, prev, next;
+	const char *name;
+
+	if( num < 0 || num >= MAX_EDICTS )
+		return;
+
+	G_EdictNameIndex_Unlink( index, num );
+
+	name = *(const char **)( (uint8_t *)ent + index->fieldofs );
+	if( !name )
+		return;
+
+	bucket = G_EdictNameHash( name );
+
+	// keep the chain sorted by entity number
+	prev = -1;
+	next = index->hashTable[bucket];
+	while( next != -1 && next < num )
+	{
+		prev = next;
+		next = index->next[next];
+	}
+
+	index->bucket[num] = bucket;
+	index->prev[num] = prev;
+	index->next[num] = next;
+	if( prev != -1 )
+		index->next[prev] = num;
+	else
+		index->hashTable[bucket] = num;
+	if( next != -1 )
+		index->prev[next] = num;
+}
+
+/*
+* G_EdictNameIndex_Find
+*/
+static edict_t *G_EdictNameIndex_Find( g_edictnameindex_t *index, edict_t *from, const char *match )
+{
+	int bucket = G_EdictNameHash( match );
+	int num, start;
+	edict_t *e;
+	const char *s;
+
+	start = from ? ENTNUM( from ) : -1;
+
+	// continue from the previous match when it's in this chain
+	if( start >= 0 && start < MAX_EDICTS && index->bucket[start] == bucket )
+		num = index->next[start];
+	else
+		num = index->hashTable[bucket];
+
+	for( ; num != -1 && num < game.numentities; num = index->next[num] )
+	{
+		if( num <= start )
+			continue;
+
+		e = &game.edicts[num];
+		if( !e->r.inuse )
+			continue;
+		s = *(const char **)( (uint8_t *)e + index->fieldofs );
+		if( !s )
+			continue;
+		if( !Q_stricmp( s, match ) )
+			return e;
+	}
+
+	return NULL;
+}
+
+/*
+* G_InitEdictNameIndex
+*/
+void G_InitEdictNameIndex( void )
+{
+	G_EdictNameIndex_Init( &classnameIndex, FOFS( classname ) );
+	G_EdictNameIndex_Init( &targetnameIndex, FOFS( targetname ) );
+}
+
+/*
+* G_LinkEdictNames
+* 
+* Must be called after the classname or targetname of an edict are
+* written without going through G_SetClassname or G_SetTargetname
+*/
+void G_LinkEdictNames( edict_t *ent )
+{
+	G_EdictNameIndex_Link( &classnameIndex, ent );
+	G_EdictNameIndex_Link( &targetnameIndex, ent );
+}
+
+/*
+* G_UnlinkEdictNames
+*/
+static void G_UnlinkEdictNames( edict_t *ent )
+{
+	int num = ENTNUM( ent );
+
+	if( num < 0 || num >= MAX_EDICTS )
+		return;
+
+	G_EdictNameIndex_Unlink( &classnameIndex, num );
+	G_EdictNameIndex_Unlink( &targetnameIndex, num );
+}
+
+/*
+* G_SetClassname
+*/
+void G_SetClassname( edict_t *ent, const char *classname )
+{
+	ent->classname = classname;
+	G_EdictNameIndex_Link( &classnameIndex, ent );
+}
+
+/*
+* G_SetTargetname
+*/
+void G_SetTargetname( edict_t *ent, const char *targetname )
+{
+	ent->targetname = targetname;
+	G_EdictNameIndex_Link( &targetnameIndex, ent );
+}
+
 /*
 * G_Find
 * 
@@ -543,6 +924,14 @@ edict_t *G_Find( edict_t *from, size_t fieldofs, const char *match )
 {
 	char *s;
 
+	if( match )
+	{
+		if( fieldofs == FOFS( classname ) )
+			return G_EdictNameIndex_Find( &classnameIndex, from, match );
+		if( fieldofs == FOFS( targetname ) )
+			return G_EdictNameIndex_Find( &targetnameIndex, from, match );
+	}
+
 	if( !from )
 		from = world;
 	else
@@ -638,7 +1027,7 @@ void G_UseTargets( edict_t *ent, edict_t *activator )
 	{
 		// create a temp object to fire at a later time
 		t = G_Spawn();
-		t->classname = "delayed_use";
+		G_SetClassname( t, "delayed_use" );
 		t->nextThink = level.time + 1000 * ent->delay;
 		t->think = Think_Delay;
 		t->activator = activator;
@@ -781,6 +1170,134 @@ char *_G_CopyString( const char *in, const char *filename, int fileline )
 	return out;
 }
 
+//==================================================
+// EDICT FREE QUEUES
+//==================================================
+
+/*
+* Freed edicts are queued instead of being searched for in G_Spawn. Edicts that
+* can be reused right away (events and entities freed during the spawn frame)
+* go into the ready queue, the rest go into the timed queue. Since freetime is
+* taken from game.realtime, the timed queue is ordered by freetime and only its
+* head ever needs to be checked against the reuse delay.
+*/
+
+typedef struct
+{
+	int head, count;
+	int nums[MAX_EDICTS];
+} g_edictqueue_t;
+
+static g_edictqueue_t edictReadyQueue;
+static g_edictqueue_t edictTimedQueue;
+static bool edictQueued[MAX_EDICTS];
+
+static int edictsSpawnedFrame, edictsFreedFrame;
+
+/*
+* G_EdictQueue_Push
+*/
+static void G_EdictQueue_Push( g_edictqueue_t *queue, int num )
+{
+	queue->nums[( queue->head + queue->count ) % MAX_EDICTS] = num;
+	queue->count++;
+}
+
+/*
+* G_EdictQueue_Pop
+*/
+static int G_EdictQueue_Pop( g_edictqueue_t *queue )
+{
+	int num = queue->nums[queue->head];
+
+	queue->head = ( queue->head + 1 ) % MAX_EDICTS;
+	queue->count--;
+	edictQueued[num] = false;
+	return num;
+}
+
+/*
+* G_EdictQueue_Remove
+* 
+* Removes an edict from anywhere in the queue, keeping the order of the others
+*/
+static bool G_EdictQueue_Remove( g_edictqueue_t *queue, int num )
+{
+	int i, j;
+
+	for( i = 0; i < queue->count; i++ )
+	{
+		if( queue->nums[( queue->head + i ) % MAX_EDICTS] != num )
+			continue;
+
+		for( j = i; j > 0; j-- )
+			queue->nums[( queue->head + j ) % MAX_EDICTS] = queue->nums[( queue->head + j - 1 ) % MAX_EDICTS];
+		queue->head = ( queue->head + 1 ) % MAX_EDICTS;
+		queue->count--;
+		edictQueued[num] = false;
+		return true;
+	}
+
+	return false;
+}
+
+/*
+* G_EdictQueue_Peek
+* 
+* Returns the first queued edict that is still free, dropping stale entries
+*/
+static edict_t *G_EdictQueue_Peek( g_edictqueue_t *queue )
+{
+	edict_t *e;
+
+	while( queue->count )
+	{
+		e = &game.edicts[queue->nums[queue->head]];
+		if( !e->r.inuse && ENTNUM( e ) < game.numentities )
+			return e;
+		G_EdictQueue_Pop( queue );
+	}
+
+	return NULL;
+}
+
+/*
+* G_ClearEdictQueues
+* 
+* Must be called whenever game.numentities is reset
+*/
+void G_ClearEdictQueues( void )
+{
+	memset( &edictReadyQueue, 0, sizeof( edictReadyQueue ) );
+	memset( &edictTimedQueue, 0, sizeof( edictTimedQueue ) );
+	memset( edictQueued, 0, sizeof( edictQueued ) );
+}
+
+/*
+* G_EdictStats
+* 
+* Prints the edict allocation counters of the last frame when g_edicts_stats is set
+*/
+void G_EdictStats( void )
+{
+	if( g_edicts_stats->integer && ( edictsSpawnedFrame || edictsFreedFrame ) )
+	{
+		int i, inuse = 0;
+
+		for( i = 0; i < game.numentities; i++ )
+		{
+			if( game.edicts[i].r.inuse )
+				inuse++;
+		}
+
+		G_Printf( "edicts: %i spawned, %i freed, %i in use of %i, %i ready, %i delayed\n",
+			edictsSpawnedFrame, edictsFreedFrame, inuse, game.numentities,
+			edictReadyQueue.count, edictTimedQueue.count );
+	}
+
+	edictsSpawnedFrame = edictsFreedFrame = 0;
+}
+
 /*
 * G_FreeEdict
 * 
@@ -797,6 +1314,8 @@ void G_FreeEdict( edict_t *ed )
 
 	G_asReleaseEntityBehaviors( ed );
 
+	G_UnlinkEdictNames( ed );
+
 	memset( ed, 0, sizeof( *ed ) );
 	ed->r.inuse = false;
 	ed->s.number = ENTNUM( ed );
@@ -805,6 +1324,15 @@ void G_FreeEdict( edict_t *ed )
 
 	if( !evt && ( level.spawnedTimeStamp != game.realtime ) )
 		ed->freetime = game.realtime; // ET_EVENT or ET_SOUND don't need to wait to be reused
+
+	edictsFreedFrame++;
+
+	// clients are never allocated through G_Spawn
+	if( ed->s.number > gs.maxclients && ed->s.number < MAX_EDICTS && !edictQueued[ed->s.number] )
+	{
+		edictQueued[ed->s.number] = true;
+		G_EdictQueue_Push( ed->freetime ? &edictTimedQueue : &edictReadyQueue, ed->s.number );
+	}
 }
 
 /*
@@ -812,8 +1340,17 @@ void G_FreeEdict( edict_t *ed )
 */
 void G_InitEdict( edict_t *e )
 {
+	int num = ENTNUM( e );
+
+	// edicts taken by number instead of G_Spawn, like the body queue, leave the free queues
+	if( num >= 0 && num < MAX_EDICTS && edictQueued[num] )
+	{
+		if( !G_EdictQueue_Remove( &edictReadyQueue, num ) )
+			G_EdictQueue_Remove( &edictTimedQueue, num );
+	}
+
 	e->r.inuse = true;
-	e->classname = NULL;
+	G_SetClassname( e, NULL );
 	e->gravity = 1.0;
 	e->s.number = ENTNUM( e );
 	e->timeDelta = 0;
@@ -853,47 +1390,47 @@ void G_InitEdict( edict_t *e )
 */
 edict_t *G_Spawn( void )
 {
-	int i;
 	edict_t	*e, *freed;
 
 	if( !level.canSpawnEntities )
 		G_Printf( "WARNING: Spawning entity before map entities have been spawned\n" );
 
-	freed = NULL;
-	e = &game.edicts[gs.maxclients+1];
-	for( i = gs.maxclients + 1; i < game.numentities; i++, e++ )
+	e = G_EdictQueue_Peek( &edictReadyQueue );
+	if( e )
+	{
+		G_EdictQueue_Pop( &edictReadyQueue );
+	}
+	else
 	{
-		if( e->r.inuse )
-			continue;
-
 		// the first couple seconds of server time can involve a lot of
 		// freeing and allocating, so relax the replacement policy
-		if( e->freetime < level.spawnedTimeStamp + 2000 || game.realtime > e->freetime + 500 )
+		freed = G_EdictQueue_Peek( &edictTimedQueue );
+		if( freed && ( freed->freetime < level.spawnedTimeStamp + 2000 || game.realtime > freed->freetime + 500 ) )
 		{
-			G_InitEdict( e );
-			return e;
+			G_EdictQueue_Pop( &edictTimedQueue );
+			e = freed;
 		}
+		else if( game.numentities < game.maxentities )
+		{
+			e = &game.edicts[game.numentities];
+			game.numentities++;
 
-		// this is going to be our second chance to spawn an entity in case all free
-		// entities have been freed only recently
-		if( !freed )
-			freed = e;
-	}
-
-	if( i == game.maxentities )
-	{
-		if( freed )
+			trap_LocateEntities( game.edicts, sizeof( game.edicts[0] ), game.numentities, game.maxentities );
+		}
+		else if( freed )
 		{
-			G_InitEdict( freed );
-			return freed;
+			// this is going to be our second chance to spawn an entity in case all free
+			// entities have been freed only recently
+			G_EdictQueue_Pop( &edictTimedQueue );
+			e = freed;
+		}
+		else
+		{
+			G_Error( "G_Spawn: no free edicts" );
 		}
-		G_Error( "G_Spawn: no free edicts" );
 	}
 
-	game.numentities++;
-
-	trap_LocateEntities( game.edicts, sizeof( game.edicts[0] ), game.numentities, game.maxentities );
-
+	edictsSpawnedFrame++;
 	G_InitEdict( e );
 
 	return e;
@@ -122,7 +122,7 @@ void G_InitBodyQueue( void )
 	for( i = 0; i < BODY_QUEUE_SIZE; i++ )
 	{
 		ent = G_Spawn();
-		ent->classname = "bodyque";
+		G_SetClassname( ent, "bodyque" );
 	}
 }
 
@@ -212,7 +212,7 @@ static edict_t *CopyToBodyQue( edict_t *ent, edict_t *attacker, int damage )
 
 	//init body edict
 	G_InitEdict( body );
-	body->classname = "body";
+	G_SetClassname( body, "body" );
 	body->health = ent->health;
 	body->mass = ent->mass;
 	body->r.owner = ent->r.owner;
@@ -570,12 +570,12 @@ void G_ClientRespawn( edict_t *self, bool ghost )
 	if( AI_GetType( self->ai ) == AI_ISBOT )
 	{
 		self->think = NULL;
-		self->classname = "bot";
+		G_SetClassname( self, "bot" );
 	}
 	else if( self->r.svflags & SVF_FAKECLIENT )
-		self->classname = "fakeclient";
+		G_SetClassname( self, "fakeclient" );
 	else
-		self->classname = "player";
+		G_SetClassname( self, "player" );
 
 	VectorCopy( playerbox_stand_mins, self->r.mins );
 	VectorCopy( playerbox_stand_maxs, self->r.maxs );
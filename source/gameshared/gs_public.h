@@ -1176,6 +1176,48 @@ void GS_AddLaserbeamPoint( gs_laserbeamtrail_t *trail, player_state_t *playerSta
 						  unsigned int timeStamp );
 bool G_GetLaserbeamPoint( gs_laserbeamtrail_t *trail, player_state_t *playerState, unsigned int timeStamp, vec3_t out );
 
+//===============================================================
+// gs_tracecache.c - results of identical trace and point contents queries
+
+#define GS_TRACECACHE_SIZE	256		// must be a power of two
+
+typedef struct
+{
+	unsigned int epoch;
+	vec3_t start, end;
+	vec3_t mins, maxs;
+	int passent;
+	int contentmask;
+	trace_t trace;
+} gs_tracecacheentry_t;
+
+typedef struct
+{
+	unsigned int epoch;
+	vec3_t point;
+	int contents;
+} gs_contentscacheentry_t;
+
+typedef struct
+{
+	unsigned int epoch;         // entries from older epochs never match
+	gs_tracecacheentry_t traces[GS_TRACECACHE_SIZE];
+	gs_contentscacheentry_t contents[GS_TRACECACHE_SIZE];
+
+	unsigned int traceHits, traceMisses;
+	unsigned int contentsHits, contentsMisses;
+	unsigned int invalidations;
+} gs_tracecache_t;
+
+void GS_TraceCache_Invalidate( gs_tracecache_t *cache );
+bool GS_TraceCache_FindTrace( gs_tracecache_t *cache, trace_t *tr, const vec3_t start, 
+	const vec3_t mins, const vec3_t maxs, const vec3_t end, int passent, int contentmask );
+void GS_TraceCache_StoreTrace( gs_tracecache_t *cache, const trace_t *tr, const vec3_t start, 
+	const vec3_t mins, const vec3_t maxs, const vec3_t end, int passent, int contentmask );
+bool GS_TraceCache_FindContents( gs_tracecache_t *cache, const vec3_t point, int *contents );
+void GS_TraceCache_StoreContents( gs_tracecache_t *cache, const vec3_t point, int contents );
+void GS_TraceCache_ResetStats( gs_tracecache_t *cache );
+
 //===============================================================
 // gs_weapondefs.c
 
@@ -0,0 +1,183 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "q_arch.h"
+#include "q_math.h"
+#include "q_shared.h"
+#include "q_comref.h"
+#include "q_collision.h"
+#include "gs_public.h"
+
+/*
+* GS_TraceCache_HashVec
+*/
+static inline unsigned int GS_TraceCache_HashVec( unsigned int hash, const vec3_t v )
+{
+	int i;
+	unsigned int bits;
+
+	for( i = 0; i < 3; i++ )
+	{
+		memcpy( &bits, &v[i], sizeof( bits ) );
+		hash = ( hash ^ bits ) * 16777619u;
+	}
+	return hash;
+}
+
+/*
+* GS_TraceCache_TraceSlot
+*/
+static gs_tracecacheentry_t *GS_TraceCache_TraceSlot( gs_tracecache_t *cache, const vec3_t start, 
+	const vec3_t mins, const vec3_t maxs, const vec3_t end, int passent, int contentmask )
+{
+	unsigned int hash = 2166136261u;
+
+	hash = GS_TraceCache_HashVec( hash, start );
+	hash = GS_TraceCache_HashVec( hash, end );
+	hash = GS_TraceCache_HashVec( hash, mins );
+	hash = GS_TraceCache_HashVec( hash, maxs );
+	hash = ( hash ^ (unsigned int)passent ) * 16777619u;
+	hash = ( hash ^ (unsigned int)contentmask ) * 16777619u;
+
+	return &cache->traces[( hash ^ ( hash >> 16 ) ) & ( GS_TRACECACHE_SIZE - 1 )];
+}
+
+/*
+* GS_TraceCache_ContentsSlot
+*/
+static gs_contentscacheentry_t *GS_TraceCache_ContentsSlot( gs_tracecache_t *cache, const vec3_t point )
+{
+	unsigned int hash = GS_TraceCache_HashVec( 2166136261u, point );
+
+	return &cache->contents[( hash ^ ( hash >> 16 ) ) & ( GS_TRACECACHE_SIZE - 1 )];
+}
+
+/*
+* GS_TraceCache_Invalidate
+*/
+void GS_TraceCache_Invalidate( gs_tracecache_t *cache )
+{
+	cache->epoch++;
+	if( cache->epoch <= 1 )
+	{
+		// the entries could alias the new epoch after a wrap
+		memset( cache->traces, 0, sizeof( cache->traces ) );
+		memset( cache->contents, 0, sizeof( cache->contents ) );
+		cache->epoch = 1;
+	}
+	cache->invalidations++;
+}
+
+/*
+* GS_TraceCache_FindTrace
+*/
+bool GS_TraceCache_FindTrace( gs_tracecache_t *cache, trace_t *tr, const vec3_t start, 
+	const vec3_t mins, const vec3_t maxs, const vec3_t end, int passent, int contentmask )
+{
+	const gs_tracecacheentry_t *entry;
+
+	if( !mins )
+		mins = vec3_origin;
+	if( !maxs )
+		maxs = vec3_origin;
+
+	entry = GS_TraceCache_TraceSlot( cache, start, mins, maxs, end, passent, contentmask );
+	if( cache->epoch && entry->epoch == cache->epoch && entry->passent == passent && entry->contentmask == contentmask 
+		&& VectorCompare( entry->start, start ) && VectorCompare( entry->end, end ) 
+		&& VectorCompare( entry->mins, mins ) && VectorCompare( entry->maxs, maxs ) )
+	{
+		cache->traceHits++;
+		*tr = entry->trace;
+		return true;
+	}
+
+	cache->traceMisses++;
+	return false;
+}
+
+/*
+* GS_TraceCache_StoreTrace
+*/
+void GS_TraceCache_StoreTrace( gs_tracecache_t *cache, const trace_t *tr, const vec3_t start, 
+	const vec3_t mins, const vec3_t maxs, const vec3_t end, int passent, int contentmask )
+{
+	gs_tracecacheentry_t *entry;
+
+	if( !mins )
+		mins = vec3_origin;
+	if( !maxs )
+		maxs = vec3_origin;
+	if( !cache->epoch )
+		GS_TraceCache_Invalidate( cache );
+
+	entry = GS_TraceCache_TraceSlot( cache, start, mins, maxs, end, passent, contentmask );
+	entry->epoch = cache->epoch;
+	VectorCopy( start, entry->start );
+	VectorCopy( end, entry->end );
+	VectorCopy( mins, entry->mins );
+	VectorCopy( maxs, entry->maxs );
+	entry->passent = passent;
+	entry->contentmask = contentmask;
+	entry->trace = *tr;
+}
+
+/*
+* GS_TraceCache_FindContents
+*/
+bool GS_TraceCache_FindContents( gs_tracecache_t *cache, const vec3_t point, int *contents )
+{
+	const gs_contentscacheentry_t *entry = GS_TraceCache_ContentsSlot( cache, point );
+
+	if( cache->epoch && entry->epoch == cache->epoch && VectorCompare( entry->point, point ) )
+	{
+		cache->contentsHits++;
+		*contents = entry->contents;
+		return true;
+	}
+
+	cache->contentsMisses++;
+	return false;
+}
+
+/*
+* GS_TraceCache_StoreContents
+*/
+void GS_TraceCache_StoreContents( gs_tracecache_t *cache, const vec3_t point, int contents )
+{
+	gs_contentscacheentry_t *entry;
+
+	if( !cache->epoch )
+		GS_TraceCache_Invalidate( cache );
+
+	entry = GS_TraceCache_ContentsSlot( cache, point );
+	entry->epoch = cache->epoch;
+	VectorCopy( point, entry->point );
+	entry->contents = contents;
+}
+
+/*
+* GS_TraceCache_ResetStats
+*/
+void GS_TraceCache_ResetStats( gs_tracecache_t *cache )
+{
+	cache->traceHits = cache->traceMisses = 0;
+	cache->contentsHits = cache->contentsMisses = 0;
+	cache->invalidations = 0;
+}
@@ -48,6 +48,15 @@ typedef struct
 	int surfFlags;
 } cbrushside_t;
 
+// brush side planes in groups of four, laid out for the SIMD trace kernels
+typedef struct
+{
+	float normal[3][4];
+	float dist[4];
+} cplanes4_t;
+
+#define CM_NumPlanes4( numsides ) ( ( ( numsides ) + 3 ) >> 2 )
+
 typedef struct
 {
 	int contents;
@@ -55,6 +64,7 @@ typedef struct
 
 	int numsides;
 	cbrushside_t *brushsides;
+	cplanes4_t *planes4;        // CM_NumPlanes4( numsides ) groups
 } cbrush_t;
 
 typedef struct
@@ -107,7 +117,7 @@ typedef struct
 
 struct cmodel_state_s
 {
-	int checkcount;
+	volatile int checkcount;    // trace numbers, see CM_BoxTrace
 	int refcount;
 	struct mempool_s *mempool;
 
@@ -175,22 +185,19 @@ struct cmodel_state_s
 
 	// cm_trace.c
 	cplane_t box_planes[6];
+	cplanes4_t box_planes4[CM_NumPlanes4( 6 )];
 	cbrushside_t box_brushsides[6];
 	cbrush_t box_brush[1];
 	cbrush_t *box_markbrushes[1];
 	cmodel_t box_cmodel[1];
 
 	cplane_t oct_planes[10];
+	cplanes4_t oct_planes4[CM_NumPlanes4( 10 )];
 	cbrushside_t oct_brushsides[10];
 	cbrush_t oct_brush[1];
 	cbrush_t *oct_markbrushes[1];
 	cmodel_t oct_cmodel[1];
 
-	int leaf_count, leaf_maxcount;
-	int *leaf_list;
-	float *leaf_mins, *leaf_maxs;
-	int leaf_topnode;
-
 	// optional special handling of line tracing and point contents
 	void ( *CM_TransformedBoxTrace )( struct cmodel_state_s *cms, trace_t *tr, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, struct cmodel_s *cmodel, int brushmask, vec3_t origin, vec3_t angles );
 	int ( *CM_TransformedPointContents )( struct cmodel_state_s *cms, vec3_t p, struct cmodel_s *cmodel, vec3_t origin, vec3_t angles );
@@ -199,6 +206,8 @@ struct cmodel_state_s
 
 //=======================================================================
 
+void	CM_SetBrushPlanes4( cbrush_t *brush );
+
 void	CM_InitBoxHull( cmodel_state_t *cms );
 void	CM_InitOctagonHull( cmodel_state_t *cms );
 
@@ -41,6 +41,7 @@ static int CM_CreateFacetFromPoints( cmodel_state_t *cms, cbrush_t *facet, vec3_
 	// set default values for brush
 	facet->numsides = 0;
 	facet->brushsides = NULL;
+	facet->planes4 = NULL;
 	facet->contents = shaderref->contents;
 
 	// calculate plane for this triangle
@@ -264,8 +265,13 @@ static void CM_CreatePatch( cmodel_state_t *cms, cface_t *patch, cshaderref_t *s
 	if( patch->numfacets )
 	{
 		uint8_t *data;
+		int totalplanes4 = 0;
 
-		data = Mem_Alloc( cms->mempool, patch->numfacets * sizeof( cbrush_t ) + totalsides * ( sizeof( cbrushside_t ) + sizeof( cplane_t ) ) );
+		for( i = 0; i < patch->numfacets; i++ )
+			totalplanes4 += CM_NumPlanes4( facets[i].numsides );
+
+		data = Mem_Alloc( cms->mempool, patch->numfacets * sizeof( cbrush_t ) + totalsides * ( sizeof( cbrushside_t ) + sizeof( cplane_t ) )
+			+ totalplanes4 * sizeof( cplanes4_t ) );
 
 		patch->facets = ( cbrush_t * )data; data += patch->numfacets * sizeof( cbrush_t );
 		memcpy( patch->facets, facets, patch->numfacets * sizeof( cbrush_t ) );
@@ -274,6 +280,7 @@ static void CM_CreatePatch( cmodel_state_t *cms, cface_t *patch, cshaderref_t *s
 			cplane_t *planes;
 			cbrushside_t *s;
 
+			facet->planes4 = ( cplanes4_t * )data; data += CM_NumPlanes4( facet->numsides ) * sizeof( cplanes4_t );
 			facet->brushsides = ( cbrushside_t * )data; data += facet->numsides * sizeof( cbrushside_t );
 			planes = ( cplane_t * )data; data += facet->numsides * sizeof( cplane_t );
 
@@ -286,6 +293,8 @@ static void CM_CreatePatch( cmodel_state_t *cms, cface_t *patch, cshaderref_t *s
 				CategorizePlane( s->plane );
 				s->surfFlags = shaderref->flags;
 			}
+
+			CM_SetBrushPlanes4( facet );
 		}
 
 		patch->contents = shaderref->contents;
@@ -795,6 +804,8 @@ static void CMod_LoadBrushes( cmodel_state_t *cms, lump_t *l )
 	dbrush_t *in;
 	cbrush_t *out;
 	int shaderref;
+	int numplanes4;
+	cplanes4_t *planes4;
 
 	in = ( void * )( cms->cmod_base + l->fileofs );
 	if( l->filelen % sizeof( *in ) )
@@ -806,12 +817,23 @@ static void CMod_LoadBrushes( cmodel_state_t *cms, lump_t *l )
 	out = cms->map_brushes = Mem_Alloc( cms->mempool, count * sizeof( *out ) );
 	cms->numbrushes = count;
 
+	numplanes4 = 0;
 	for( i = 0; i < count; i++, out++, in++ )
 	{
 		shaderref = LittleLong( in->shadernum );
 		out->contents = cms->map_shaderrefs[shaderref].contents;
 		out->numsides = LittleLong( in->numsides );
 		out->brushsides = cms->map_brushsides + LittleLong( in->firstside );
+		numplanes4 += CM_NumPlanes4( out->numsides );
+	}
+
+	// copy the side planes into groups of four for the trace kernels
+	planes4 = Mem_Alloc( cms->mempool, numplanes4 * sizeof( *planes4 ) );
+	for( i = 0, out = cms->map_brushes; i < count; i++, out++ )
+	{
+		out->planes4 = planes4;
+		planes4 += CM_NumPlanes4( out->numsides );
+		CM_SetBrushPlanes4( out );
 	}
 }
 
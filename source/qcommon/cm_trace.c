@@ -20,8 +20,19 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // cmodel_trace.c
 
 #include "qcommon.h"
+#include "sys_threads.h"
 #include "cm_local.h"
 
+#include <float.h>
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#define CM_SIMD_SSE
+#include <xmmintrin.h>
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+#define CM_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
 /*
 * CM_InitBoxHull
 *
@@ -36,6 +47,7 @@ void CM_InitBoxHull( cmodel_state_t *cms )
 
 	cms->box_brush->numsides = 6;
 	cms->box_brush->brushsides = cms->box_brushsides;
+	cms->box_brush->planes4 = cms->box_planes4;
 	cms->box_brush->contents = CONTENTS_BODY;
 
 	cms->box_markbrushes[0] = cms->box_brush;
@@ -70,6 +82,8 @@ void CM_InitBoxHull( cmodel_state_t *cms )
 			p->signbits = 0;
 		}
 	}
+
+	CM_SetBrushPlanes4( cms->box_brush );
 }
 
 /*
@@ -92,6 +106,7 @@ void CM_InitOctagonHull( cmodel_state_t *cms )
 
 	cms->oct_brush->numsides = 10;
 	cms->oct_brush->brushsides = cms->oct_brushsides;
+	cms->oct_brush->planes4 = cms->oct_planes4;
 	cms->oct_brush->contents = CONTENTS_BODY;
 
 	cms->oct_markbrushes[0] = cms->oct_brush;
@@ -142,6 +157,8 @@ void CM_InitOctagonHull( cmodel_state_t *cms )
 		p->type = PLANE_NONAXIAL;
 		p->signbits = SignbitsForPlane( p );
 	}
+
+	CM_SetBrushPlanes4( cms->oct_brush );
 }
 
 /*
@@ -161,6 +178,8 @@ cmodel_t *CM_ModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs )
 	VectorCopy( mins, cms->box_cmodel->mins );
 	VectorCopy( maxs, cms->box_cmodel->maxs );
 
+	CM_SetBrushPlanes4( cms->box_brush );
+
 	return cms->box_cmodel;
 }
 
@@ -224,6 +243,8 @@ cmodel_t *CM_OctagonModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs
 	VectorSet( cms->oct_planes[9].normal, cosa, -sina, 0 );
 	cms->oct_planes[9].dist = d;
 
+	CM_SetBrushPlanes4( cms->oct_brush );
+
 	return cms->oct_cmodel;
 }
 
@@ -253,7 +274,15 @@ int CM_PointLeafnum( cmodel_state_t *cms, const vec3_t p )
 *
 * Fills in a list of all the leafs touched
 */
-static void CM_BoxLeafnums_r( cmodel_state_t *cms, int nodenum )
+typedef struct
+{
+	int count, maxcount;
+	int *list;
+	const float *mins, *maxs;
+	int topnode;
+} cm_boxleafs_t;
+
+static void CM_BoxLeafnums_r( cmodel_state_t *cms, cm_boxleafs_t *bl, int nodenum )
 {
 	int s;
 	cnode_t	*node;
@@ -261,7 +290,7 @@ static void CM_BoxLeafnums_r( cmodel_state_t *cms, int nodenum )
 	while( nodenum >= 0 )
 	{
 		node = &cms->map_nodes[nodenum];
-		s = BOX_ON_PLANE_SIDE( cms->leaf_mins, cms->leaf_maxs, node->plane ) - 1;
+		s = BOX_ON_PLANE_SIDE( bl->mins, bl->maxs, node->plane ) - 1;
 
 		if( s < 2 )
 		{
@@ -270,35 +299,39 @@ static void CM_BoxLeafnums_r( cmodel_state_t *cms, int nodenum )
 		}
 
 		// go down both sides
-		if( cms->leaf_topnode == -1 )
-			cms->leaf_topnode = nodenum;
-		CM_BoxLeafnums_r( cms, node->children[0] );
+		if( bl->topnode == -1 )
+			bl->topnode = nodenum;
+		CM_BoxLeafnums_r( cms, bl, node->children[0] );
 		nodenum = node->children[1];
 	}
 
-	if( cms->leaf_count < cms->leaf_maxcount )
-		cms->leaf_list[cms->leaf_count++] = -1 - nodenum;
+	if( bl->count < bl->maxcount )
+		bl->list[bl->count++] = -1 - nodenum;
 }
 
 /*
 * CM_BoxLeafnums
+*
+* The working state lives on the stack, so this is safe to call from
+* multiple threads sharing the same collision model.
 */
 int CM_BoxLeafnums( cmodel_state_t *cms, vec3_t mins, vec3_t maxs, int *list, int listsize, int *topnode )
 {
-	cms->leaf_list = list;
-	cms->leaf_count = 0;
-	cms->leaf_maxcount = listsize;
-	cms->leaf_mins = mins;
-	cms->leaf_maxs = maxs;
+	cm_boxleafs_t bl;
 
-	cms->leaf_topnode = -1;
+	bl.list = list;
+	bl.count = 0;
+	bl.maxcount = listsize;
+	bl.mins = mins;
+	bl.maxs = maxs;
+	bl.topnode = -1;
 
-	CM_BoxLeafnums_r( cms, 0 );
+	CM_BoxLeafnums_r( cms, &bl, 0 );
 
 	if( topnode )
-		*topnode = cms->leaf_topnode;
+		*topnode = bl.topnode;
 
-	return cms->leaf_count;
+	return bl.count;
 }
 
 /*
@@ -425,7 +458,7 @@ static int CM_PointContents( cmodel_state_t *cms, vec3_t p, cmodel_t *cmodel )
 * CM_TransformedPointContents
 *
 * Handles offseting and rotation of the end points for moving and
-* rotating entities
+* rotating entities, safe to call from multiple threads
 */
 int CM_TransformedPointContents( cmodel_state_t *cms, vec3_t p, cmodel_t *cmodel, vec3_t origin, vec3_t angles )
 {
@@ -488,24 +521,48 @@ BOX TRACING
 #endif
 #define RADIUS_EPSILON		1.0f
 
-static vec3_t trace_start, trace_end;
-static vec3_t trace_mins, trace_maxs;
-static vec3_t trace_startmins, trace_endmins;
-static vec3_t trace_startmaxs, trace_endmaxs;
-static vec3_t trace_absmins, trace_absmaxs;
-static vec3_t trace_extents;
-
-static trace_t	*trace_trace;
+// Working state of a single trace, kept on the caller's stack so that
+// traces can run in parallel on the same collision model
+typedef struct
+{
+	vec3_t start, end;
+	vec3_t mins, maxs;
+	vec3_t startmins, endmins;
+	vec3_t startmaxs, endmaxs;
+	vec3_t absmins, absmaxs;
+	vec3_t extents;
+
+	trace_t *trace;
 #ifdef TRACEVICFIX
-static float trace_realfraction;
+	float realfraction;
 #endif
-static int trace_contents;
-static bool trace_ispoint;      // optimized case
+	int contents;
+	bool ispoint;      // optimized case
+	bool reference;    // use the plane by plane kernels
+	int checkcount;    // unique number of this trace, stamped on tested brushes and patches
+} cmtrace_t;
 
 /*
-* CM_ClipBoxToBrush
+* CM_TraceCheckOnce
+*
+* Returns false if the brush or patch has already been tested by this trace.
+* A concurrent trace may overwrite the stamp, which only costs a redundant test,
+* but never stamps the number of this trace.
+*/
+static inline bool CM_TraceCheckOnce( cmtrace_t *tc, int *checkcount )
+{
+	if( *checkcount == tc->checkcount )
+		return false;
+	*checkcount = tc->checkcount;
+	return true;
+}
+
+/*
+* CM_ClipBoxToBrushReference
+*
+* Plane by plane version of CM_ClipBoxToBrush, kept for tracebench
 */
-static void CM_ClipBoxToBrush( cmodel_state_t *cms, cbrush_t *brush )
+static void CM_ClipBoxToBrushReference( cmodel_state_t *cms, cmtrace_t *tc, cbrush_t *brush )
 {
 	int i;
 	cplane_t *p, *clipplane;
@@ -538,44 +595,44 @@ static void CM_ClipBoxToBrush( cmodel_state_t *cms, cbrush_t *brush )
 		// push the plane out apropriately for mins/maxs
 		if( p->type < 3 )
 		{
-			d1 = trace_startmins[p->type] - p->dist;
-			d2 = trace_endmins[p->type] - p->dist;
+			d1 = tc->startmins[p->type] - p->dist;
+			d2 = tc->endmins[p->type] - p->dist;
 		}
 		else
 		{
 			switch( p->signbits )
 			{
 			case 0:
-				d1 = p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmins[2] - p->dist;
-				d2 = p->normal[0]*trace_endmins[0] + p->normal[1]*trace_endmins[1] + p->normal[2]*trace_endmins[2] - p->dist;
+				d1 = p->normal[0]*tc->startmins[0] + p->normal[1]*tc->startmins[1] + p->normal[2]*tc->startmins[2] - p->dist;
+				d2 = p->normal[0]*tc->endmins[0] + p->normal[1]*tc->endmins[1] + p->normal[2]*tc->endmins[2] - p->dist;
 				break;
 			case 1:
-				d1 = p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmins[2] - p->dist;
-				d2 = p->normal[0]*trace_endmaxs[0] + p->normal[1]*trace_endmins[1] + p->normal[2]*trace_endmins[2] - p->dist;
+				d1 = p->normal[0]*tc->startmaxs[0] + p->normal[1]*tc->startmins[1] + p->normal[2]*tc->startmins[2] - p->dist;
+				d2 = p->normal[0]*tc->endmaxs[0] + p->normal[1]*tc->endmins[1] + p->normal[2]*tc->endmins[2] - p->dist;
 				break;
 			case 2:
-				d1 = p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmins[2] - p->dist;
-				d2 = p->normal[0]*trace_endmins[0] + p->normal[1]*trace_endmaxs[1] + p->normal[2]*trace_endmins[2] - p->dist;
+				d1 = p->normal[0]*tc->startmins[0] + p->normal[1]*tc->startmaxs[1] + p->normal[2]*tc->startmins[2] - p->dist;
+				d2 = p->normal[0]*tc->endmins[0] + p->normal[1]*tc->endmaxs[1] + p->normal[2]*tc->endmins[2] - p->dist;
 				break;
 			case 3:
-				d1 = p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmins[2] - p->dist;
-				d2 = p->normal[0]*trace_endmaxs[0] + p->normal[1]*trace_endmaxs[1] + p->normal[2]*trace_endmins[2] - p->dist;
+				d1 = p->normal[0]*tc->startmaxs[0] + p->normal[1]*tc->startmaxs[1] + p->normal[2]*tc->startmins[2] - p->dist;
+				d2 = p->normal[0]*tc->endmaxs[0] + p->normal[1]*tc->endmaxs[1] + p->normal[2]*tc->endmins[2] - p->dist;
 				break;
 			case 4:
-				d1 = p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmaxs[2] - p->dist;
-				d2 = p->normal[0]*trace_endmins[0] + p->normal[1]*trace_endmins[1] + p->normal[2]*trace_endmaxs[2] - p->dist;
+				d1 = p->normal[0]*tc->startmins[0] + p->normal[1]*tc->startmins[1] + p->normal[2]*tc->startmaxs[2] - p->dist;
+				d2 = p->normal[0]*tc->endmins[0] + p->normal[1]*tc->endmins[1] + p->normal[2]*tc->endmaxs[2] - p->dist;
 				break;
 			case 5:
-				d1 = p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmaxs[2] - p->dist;
-				d2 = p->normal[0]*trace_endmaxs[0] + p->normal[1]*trace_endmins[1] + p->normal[2]*trace_endmaxs[2] - p->dist;
+				d1 = p->normal[0]*tc->startmaxs[0] + p->normal[1]*tc->startmins[1] + p->normal[2]*tc->startmaxs[2] - p->dist;
+				d2 = p->normal[0]*tc->endmaxs[0] + p->normal[1]*tc->endmins[1] + p->normal[2]*tc->endmaxs[2] - p->dist;
 				break;
 			case 6:
-				d1 = p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmaxs[2] - p->dist;
-				d2 = p->normal[0]*trace_endmins[0] + p->normal[1]*trace_endmaxs[1] + p->normal[2]*trace_endmaxs[2] - p->dist;
+				d1 = p->normal[0]*tc->startmins[0] + p->normal[1]*tc->startmaxs[1] + p->normal[2]*tc->startmaxs[2] - p->dist;
+				d2 = p->normal[0]*tc->endmins[0] + p->normal[1]*tc->endmaxs[1] + p->normal[2]*tc->endmaxs[2] - p->dist;
 				break;
 			case 7:
-				d1 = p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmaxs[2] - p->dist;
-				d2 = p->normal[0]*trace_endmaxs[0] + p->normal[1]*trace_endmaxs[1] + p->normal[2]*trace_endmaxs[2] - p->dist;
+				d1 = p->normal[0]*tc->startmaxs[0] + p->normal[1]*tc->startmaxs[1] + p->normal[2]*tc->startmaxs[2] - p->dist;
+				d2 = p->normal[0]*tc->endmaxs[0] + p->normal[1]*tc->endmaxs[1] + p->normal[2]*tc->endmaxs[2] - p->dist;
 				break;
 			default:
 				d1 = d2 = 0; // shut up compiler
@@ -640,51 +697,53 @@ static void CM_ClipBoxToBrush( cmodel_state_t *cms, cbrush_t *brush )
 	if( !startout )
 	{
 		// original point was inside brush
-		trace_trace->startsolid = true;
-		trace_trace->contents = brush->contents;
+		tc->trace->startsolid = true;
+		tc->trace->contents = brush->contents;
 		if( !getout )
 		{
-			trace_trace->allsolid = true;
-			trace_trace->fraction = 0;
+			tc->trace->allsolid = true;
+			tc->trace->fraction = 0;
 		}
 		return;
 	}
 #ifdef TRACEVICFIX
 	if( enterfrac - FRAC_EPSILON <= leavefrac )
 	{
-		if( enterfrac > -1 && enterfrac < trace_realfraction )
+		if( enterfrac > -1 && enterfrac < tc->realfraction )
 		{
 			if( enterfrac < 0 )
 				enterfrac = 0;
-			trace_realfraction = enterfrac;
-			trace_trace->plane = *clipplane;
-			trace_trace->surfFlags = leadside->surfFlags;
-			trace_trace->contents = brush->contents;
-			trace_trace->fraction = ( enterdist - DIST_EPSILON ) / move;
-			if( trace_trace->fraction < 0 )
-				trace_trace->fraction = 0;
+			tc->realfraction = enterfrac;
+			tc->trace->plane = *clipplane;
+			tc->trace->surfFlags = leadside->surfFlags;
+			tc->trace->contents = brush->contents;
+			tc->trace->fraction = ( enterdist - DIST_EPSILON ) / move;
+			if( tc->trace->fraction < 0 )
+				tc->trace->fraction = 0;
 		}
 	}
 #else
 	if( enterfrac - ( 1.0f / 1024.0f ) <= leavefrac )
 	{
-		if( enterfrac > -1 && enterfrac < trace_trace->fraction )
+		if( enterfrac > -1 && enterfrac < tc->trace->fraction )
 		{
 			if( enterfrac < 0 )
 				enterfrac = 0;
-			trace_trace->fraction = enterfrac;
-			trace_trace->plane = *clipplane;
-			trace_trace->surfFlags = leadside->surfFlags;
-			trace_trace->contents = brush->contents;
+			tc->trace->fraction = enterfrac;
+			tc->trace->plane = *clipplane;
+			tc->trace->surfFlags = leadside->surfFlags;
+			tc->trace->contents = brush->contents;
 		}
 	}
 #endif
 }
 
 /*
-* CM_TestBoxInBrush
+* CM_TestBoxInBrushReference
+*
+* Plane by plane version of CM_TestBoxInBrush, kept for tracebench
 */
-static void CM_TestBoxInBrush( cmodel_state_t *cms, cbrush_t *brush )
+static void CM_TestBoxInBrushReference( cmodel_state_t *cms, cmtrace_t *tc, cbrush_t *brush )
 {
 	int i;
 	cplane_t *p;
@@ -702,7 +761,7 @@ static void CM_TestBoxInBrush( cmodel_state_t *cms, cbrush_t *brush )
 		// if completely in front of face, no intersection
 		if( p->type < 3 )
 		{
-			if( trace_startmins[p->type] > p->dist )
+			if( tc->startmins[p->type] > p->dist )
 				return;
 		}
 		else
@@ -710,35 +769,35 @@ static void CM_TestBoxInBrush( cmodel_state_t *cms, cbrush_t *brush )
 			switch( p->signbits )
 			{
 			case 0:
-				if( p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmins[2] > p->dist )
+				if( p->normal[0]*tc->startmins[0] + p->normal[1]*tc->startmins[1] + p->normal[2]*tc->startmins[2] > p->dist )
 					return;
 				break;
 			case 1:
-				if( p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmins[2] > p->dist )
+				if( p->normal[0]*tc->startmaxs[0] + p->normal[1]*tc->startmins[1] + p->normal[2]*tc->startmins[2] > p->dist )
 					return;
 				break;
 			case 2:
-				if( p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmins[2] > p->dist )
+				if( p->normal[0]*tc->startmins[0] + p->normal[1]*tc->startmaxs[1] + p->normal[2]*tc->startmins[2] > p->dist )
 					return;
 				break;
 			case 3:
-				if( p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmins[2] > p->dist )
+				if( p->normal[0]*tc->startmaxs[0] + p->normal[1]*tc->startmaxs[1] + p->normal[2]*tc->startmins[2] > p->dist )
 					return;
 				break;
 			case 4:
-				if( p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmaxs[2] > p->dist )
+				if( p->normal[0]*tc->startmins[0] + p->normal[1]*tc->startmins[1] + p->normal[2]*tc->startmaxs[2] > p->dist )
 					return;
 				break;
 			case 5:
-				if( p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmaxs[2] > p->dist )
+				if( p->normal[0]*tc->startmaxs[0] + p->normal[1]*tc->startmins[1] + p->normal[2]*tc->startmaxs[2] > p->dist )
 					return;
 				break;
 			case 6:
-				if( p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmaxs[2] > p->dist )
+				if( p->normal[0]*tc->startmins[0] + p->normal[1]*tc->startmaxs[1] + p->normal[2]*tc->startmaxs[2] > p->dist )
 					return;
 				break;
 			case 7:
-				if( p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmaxs[2] > p->dist )
+				if( p->normal[0]*tc->startmaxs[0] + p->normal[1]*tc->startmaxs[1] + p->normal[2]*tc->startmaxs[2] > p->dist )
 					return;
 				break;
 			default:
@@ -749,16 +808,331 @@ static void CM_TestBoxInBrush( cmodel_state_t *cms, cbrush_t *brush )
 	}
 
 	// inside this brush
-	trace_trace->startsolid = trace_trace->allsolid = true;
-	trace_trace->fraction = 0;
-	trace_trace->contents = brush->contents;
+	tc->trace->startsolid = tc->trace->allsolid = true;
+	tc->trace->fraction = 0;
+	tc->trace->contents = brush->contents;
+}
+
+/*
+* CM_SetBrushPlanes4
+*
+* Copies the side planes of the brush into its groups of four,
+* the unused slots of the last group never clip anything
+*/
+void CM_SetBrushPlanes4( cbrush_t *brush )
+{
+	int i, j;
+	cplanes4_t *p4;
+	const cplane_t *plane;
+
+	for( i = 0; i < CM_NumPlanes4( brush->numsides ) * 4; i++ )
+	{
+		p4 = &brush->planes4[i >> 2];
+		if( i < brush->numsides )
+		{
+			plane = brush->brushsides[i].plane;
+			for( j = 0; j < 3; j++ )
+				p4->normal[j][i & 3] = plane->normal[j];
+			p4->dist[i & 3] = plane->dist;
+		}
+		else
+		{
+			for( j = 0; j < 3; j++ )
+				p4->normal[j][i & 3] = 0;
+			p4->dist[i & 3] = FLT_MAX;
+		}
+	}
+}
+
+/*
+* The distance from a plane to the corner of a box nearest to it is
+* the sum of min( normal[i] * mins[i], normal[i] * maxs[i] ) minus the
+* plane distance, which picks the same corner as the plane signbits.
+*
+* CM_ClipPlanes4 stores the distances of the start and end boxes for four
+* planes and returns true if the move is completely in front of one of them.
+* CM_TestPlanes4 returns true if the start box is in front of one of them.
+*/
+#if defined( CM_SIMD_SSE )
+
+static inline __m128 CM_PlanesDist4( const cplanes4_t *p, const float *mins, const float *maxs )
+{
+	__m128 n, x, y, z;
+
+	n = _mm_loadu_ps( p->normal[0] );
+	x = _mm_min_ps( _mm_mul_ps( n, _mm_set1_ps( mins[0] ) ), _mm_mul_ps( n, _mm_set1_ps( maxs[0] ) ) );
+	n = _mm_loadu_ps( p->normal[1] );
+	y = _mm_min_ps( _mm_mul_ps( n, _mm_set1_ps( mins[1] ) ), _mm_mul_ps( n, _mm_set1_ps( maxs[1] ) ) );
+	n = _mm_loadu_ps( p->normal[2] );
+	z = _mm_min_ps( _mm_mul_ps( n, _mm_set1_ps( mins[2] ) ), _mm_mul_ps( n, _mm_set1_ps( maxs[2] ) ) );
+
+	return _mm_sub_ps( _mm_add_ps( _mm_add_ps( x, y ), z ), _mm_loadu_ps( p->dist ) );
+}
+
+static inline bool CM_ClipPlanes4( const cplanes4_t *p, const cmtrace_t *tc, float *d1, float *d2 )
+{
+	__m128 v1 = CM_PlanesDist4( p, tc->startmins, tc->startmaxs );
+	__m128 v2 = CM_PlanesDist4( p, tc->endmins, tc->endmaxs );
+
+	_mm_storeu_ps( d1, v1 );
+	_mm_storeu_ps( d2, v2 );
+	return _mm_movemask_ps( _mm_and_ps( _mm_cmpgt_ps( v1, _mm_setzero_ps() ), _mm_cmpge_ps( v2, v1 ) ) ) != 0;
+}
+
+static inline bool CM_TestPlanes4( const cplanes4_t *p, const float *mins, const float *maxs )
+{
+	return _mm_movemask_ps( _mm_cmpgt_ps( CM_PlanesDist4( p, mins, maxs ), _mm_setzero_ps() ) ) != 0;
+}
+
+#elif defined( CM_SIMD_NEON )
+
+static inline float32x4_t CM_PlanesDist4( const cplanes4_t *p, const float *mins, const float *maxs )
+{
+	float32x4_t n, x, y, z;
+
+	n = vld1q_f32( p->normal[0] );
+	x = vminq_f32( vmulq_n_f32( n, mins[0] ), vmulq_n_f32( n, maxs[0] ) );
+	n = vld1q_f32( p->normal[1] );
+	y = vminq_f32( vmulq_n_f32( n, mins[1] ), vmulq_n_f32( n, maxs[1] ) );
+	n = vld1q_f32( p->normal[2] );
+	z = vminq_f32( vmulq_n_f32( n, mins[2] ), vmulq_n_f32( n, maxs[2] ) );
+
+	return vsubq_f32( vaddq_f32( vaddq_f32( x, y ), z ), vld1q_f32( p->dist ) );
+}
+
+static inline bool CM_AnyLane4( uint32x4_t mask )
+{
+	uint32x2_t m = vorr_u32( vget_low_u32( mask ), vget_high_u32( mask ) );
+	return vget_lane_u32( vpmax_u32( m, m ), 0 ) != 0;
+}
+
+static inline bool CM_ClipPlanes4( const cplanes4_t *p, const cmtrace_t *tc, float *d1, float *d2 )
+{
+	float32x4_t v1 = CM_PlanesDist4( p, tc->startmins, tc->startmaxs );
+	float32x4_t v2 = CM_PlanesDist4( p, tc->endmins, tc->endmaxs );
+
+	vst1q_f32( d1, v1 );
+	vst1q_f32( d2, v2 );
+	return CM_AnyLane4( vandq_u32( vcgtq_f32( v1, vdupq_n_f32( 0 ) ), vcgeq_f32( v2, v1 ) ) );
+}
+
+static inline bool CM_TestPlanes4( const cplanes4_t *p, const float *mins, const float *maxs )
+{
+	return CM_AnyLane4( vcgtq_f32( CM_PlanesDist4( p, mins, maxs ), vdupq_n_f32( 0 ) ) );
+}
+
+#else
+
+static inline void CM_PlanesDist4( const cplanes4_t *p, const float *mins, const float *maxs, float *d )
+{
+	int i;
+	float x, y, z;
+
+	for( i = 0; i < 4; i++ )
+	{
+		x = min( p->normal[0][i] * mins[0], p->normal[0][i] * maxs[0] );
+		y = min( p->normal[1][i] * mins[1], p->normal[1][i] * maxs[1] );
+		z = min( p->normal[2][i] * mins[2], p->normal[2][i] * maxs[2] );
+		d[i] = x + y + z - p->dist[i];
+	}
+}
+
+static inline bool CM_ClipPlanes4( const cplanes4_t *p, const cmtrace_t *tc, float *d1, float *d2 )
+{
+	int i;
+
+	CM_PlanesDist4( p, tc->startmins, tc->startmaxs, d1 );
+	CM_PlanesDist4( p, tc->endmins, tc->endmaxs, d2 );
+	for( i = 0; i < 4; i++ )
+	{
+		if( d1[i] > 0 && d2[i] >= d1[i] )
+			return true;
+	}
+	return false;
+}
+
+static inline bool CM_TestPlanes4( const cplanes4_t *p, const float *mins, const float *maxs )
+{
+	int i;
+	float d[4];
+
+	CM_PlanesDist4( p, mins, maxs, d );
+	for( i = 0; i < 4; i++ )
+	{
+		if( d[i] > 0 )
+			return true;
+	}
+	return false;
+}
+
+#endif
+
+/*
+* CM_ClipBoxToBrush
+*/
+static void CM_ClipBoxToBrush( cmodel_state_t *cms, cmtrace_t *tc, cbrush_t *brush )
+{
+	int i, j, numsides;
+	cplane_t *p, *clipplane;
+	float enterfrac, leavefrac;
+#ifdef TRACEVICFIX
+	float enterdist = 0, move = 1;
+#endif
+	float d1[4], d2[4], f;
+	bool getout, startout;
+	cbrushside_t *side, *leadside;
+	const cplanes4_t *planes4;
+
+	if( !brush->numsides )
+		return;
+
+	enterfrac = -1;
+	leavefrac = 1;
+	clipplane = NULL;
+
+	c_brush_traces++;
+
+	getout = false;
+	startout = false;
+	leadside = NULL;
+	side = brush->brushsides;
+	planes4 = brush->planes4;
+
+	for( i = 0; i < brush->numsides; i += 4, planes4++ )
+	{
+		// if completely in front of any face, no intersection
+		if( CM_ClipPlanes4( planes4, tc, d1, d2 ) )
+			return;
+
+		numsides = min( brush->numsides - i, 4 );
+		for( j = 0; j < numsides; j++, side++ )
+		{
+			p = side->plane;
+
+			if( d2[j] > 0 )
+				getout = true; // endpoint is not in solid
+			if( d1[j] > 0 )
+				startout = true;
+
+			if( d1[j] <= 0 && d2[j] <= 0 )
+				continue;
+#ifdef TRACEVICFIX
+			// crosses face
+			f = d1[j] - d2[j];
+			if( f > 0 )
+			{                   // enter
+				f = d1[j] / f;
+				if( f > enterfrac )
+				{
+					enterdist = d1[j];
+					move = d1[j] - d2[j];
+					enterfrac = f;
+					clipplane = p;
+					leadside = side;
+				}
+			}
+			else if( f < 0 )
+			{                   // leave
+				f = d1[j] / f;
+				if( f < leavefrac )
+					leavefrac = f;
+			}
+#else
+			// crosses face
+			f = d1[j] - d2[j];
+			if( f > 0 )
+			{               // enter
+				f = ( d1[j] - DIST_EPSILON ) / f;
+				if( f > enterfrac )
+				{
+					enterfrac = f;
+					clipplane = p;
+					leadside = side;
+				}
+			}
+			else if( f < 0 )
+			{               // leave
+				f = ( d1[j] + DIST_EPSILON ) / f;
+				if( f < leavefrac )
+					leavefrac = f;
+			}
+#endif
+		}
+	}
+
+	if( !startout )
+	{
+		// original point was inside brush
+		tc->trace->startsolid = true;
+		tc->trace->contents = brush->contents;
+		if( !getout )
+		{
+			tc->trace->allsolid = true;
+			tc->trace->fraction = 0;
+		}
+		return;
+	}
+#ifdef TRACEVICFIX
+	if( enterfrac - FRAC_EPSILON <= leavefrac )
+	{
+		if( enterfrac > -1 && enterfrac < tc->realfraction )
+		{
+			if( enterfrac < 0 )
+				enterfrac = 0;
+			tc->realfraction = enterfrac;
+			tc->trace->plane = *clipplane;
+			tc->trace->surfFlags = leadside->surfFlags;
+			tc->trace->contents = brush->contents;
+			tc->trace->fraction = ( enterdist - DIST_EPSILON ) / move;
+			if( tc->trace->fraction < 0 )
+				tc->trace->fraction = 0;
+		}
+	}
+#else
+	if( enterfrac - ( 1.0f / 1024.0f ) <= leavefrac )
+	{
+		if( enterfrac > -1 && enterfrac < tc->trace->fraction )
+		{
+			if( enterfrac < 0 )
+				enterfrac = 0;
+			tc->trace->fraction = enterfrac;
+			tc->trace->plane = *clipplane;
+			tc->trace->surfFlags = leadside->surfFlags;
+			tc->trace->contents = brush->contents;
+		}
+	}
+#endif
+}
+
+/*
+* CM_TestBoxInBrush
+*/
+static void CM_TestBoxInBrush( cmodel_state_t *cms, cmtrace_t *tc, cbrush_t *brush )
+{
+	int i;
+	const cplanes4_t *planes4;
+
+	if( !brush->numsides )
+		return;
+
+	// if completely in front of any face, no intersection
+	for( i = 0, planes4 = brush->planes4; i < brush->numsides; i += 4, planes4++ )
+	{
+		if( CM_TestPlanes4( planes4, tc->startmins, tc->startmaxs ) )
+			return;
+	}
+
+	// inside this brush
+	tc->trace->startsolid = tc->trace->allsolid = true;
+	tc->trace->fraction = 0;
+	tc->trace->contents = brush->contents;
 }
 
 /*
 * CM_CollideBox
 */
-static void CM_CollideBox( cmodel_state_t *cms, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
-						  int nummarkfaces, void ( *func )( cmodel_state_t *cms, cbrush_t *b ) )
+static void CM_CollideBox( cmodel_state_t *cms, cmtrace_t *tc, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
+						  int nummarkfaces, void ( *func )( cmodel_state_t *cms, cmtrace_t *tc, cbrush_t *b ) )
 {
 	int i, j;
 	cbrush_t *b;
@@ -769,13 +1143,12 @@ static void CM_CollideBox( cmodel_state_t *cms, cbrush_t **markbrushes, int numm
 	for( i = 0; i < nummarkbrushes; i++ )
 	{
 		b = markbrushes[i];
-		if( b->checkcount == cms->checkcount )
-			continue; // already checked this brush
-		b->checkcount = cms->checkcount;
-		if( !( b->contents & trace_contents ) )
+		if( !( b->contents & tc->contents ) )
 			continue;
-		func( cms, b );
-		if( !trace_trace->fraction )
+		if( !CM_TraceCheckOnce( tc, &b->checkcount ) )
+			continue; // already checked this brush
+		func( cms, tc, b );
+		if( !tc->trace->fraction )
 			return;
 	}
 
@@ -786,18 +1159,17 @@ static void CM_CollideBox( cmodel_state_t *cms, cbrush_t **markbrushes, int numm
 	for( i = 0; i < nummarkfaces; i++ )
 	{
 		patch = markfaces[i];
-		if( patch->checkcount == cms->checkcount )
-			continue; // already checked this patch
-		patch->checkcount = cms->checkcount;
-		if( !( patch->contents & trace_contents ) )
+		if( !( patch->contents & tc->contents ) )
 			continue;
-		if( !BoundsIntersect( patch->mins, patch->maxs, trace_absmins, trace_absmaxs ) )
+		if( !BoundsIntersect( patch->mins, patch->maxs, tc->absmins, tc->absmaxs ) )
 			continue;
+		if( !CM_TraceCheckOnce( tc, &patch->checkcount ) )
+			continue; // already checked this patch
 		facet = patch->facets;
 		for( j = 0; j < patch->numfacets; j++, facet++ )
 		{
-			func( cms, facet );
-			if( !trace_trace->fraction )
+			func( cms, tc, facet );
+			if( !tc->trace->fraction )
 				return;
 		}
 	}
@@ -806,25 +1178,27 @@ static void CM_CollideBox( cmodel_state_t *cms, cbrush_t **markbrushes, int numm
 /*
 * CM_ClipBox
 */
-static inline void CM_ClipBox( cmodel_state_t *cms, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
+static inline void CM_ClipBox( cmodel_state_t *cms, cmtrace_t *tc, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
 							  int nummarkfaces )
 {
-	CM_CollideBox( cms, markbrushes, nummarkbrushes, markfaces, nummarkfaces, CM_ClipBoxToBrush );
+	CM_CollideBox( cms, tc, markbrushes, nummarkbrushes, markfaces, nummarkfaces,
+		tc->reference ? CM_ClipBoxToBrushReference : CM_ClipBoxToBrush );
 }
 
 /*
 * CM_TestBox
 */
-static inline void CM_TestBox( cmodel_state_t *cms, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
+static inline void CM_TestBox( cmodel_state_t *cms, cmtrace_t *tc, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
 							  int nummarkfaces )
 {
-	CM_CollideBox( cms, markbrushes, nummarkbrushes, markfaces, nummarkfaces, CM_TestBoxInBrush );
+	CM_CollideBox( cms, tc, markbrushes, nummarkbrushes, markfaces, nummarkfaces,
+		tc->reference ? CM_TestBoxInBrushReference : CM_TestBoxInBrush );
 }
 
 /*
 * CM_RecursiveHullCheck
 */
-static void CM_RecursiveHullCheck( cmodel_state_t *cms, int num, float p1f, float p2f, vec3_t p1, vec3_t p2 )
+static void CM_RecursiveHullCheck( cmodel_state_t *cms, cmtrace_t *tc, int num, float p1f, float p2f, vec3_t p1, vec3_t p2 )
 {
 	cnode_t	*node;
 	cplane_t *plane;
@@ -836,10 +1210,10 @@ static void CM_RecursiveHullCheck( cmodel_state_t *cms, int num, float p1f, floa
 
 loc0:
 #ifdef TRACEVICFIX
-	if( trace_realfraction <= p1f )
+	if( tc->realfraction <= p1f )
 		return; // already hit something nearer
 #else
-	if( trace_trace->fraction <= p1f )
+	if( tc->trace->fraction <= p1f )
 		return; // already hit something nearer
 #endif
 	// if < 0, we are in a leaf node
@@ -848,8 +1222,8 @@ loc0:
 		cleaf_t	*leaf;
 
 		leaf = &cms->map_leafs[-1 - num];
-		if( leaf->contents & trace_contents )
-			CM_ClipBox( cms, leaf->markbrushes, leaf->nummarkbrushes, leaf->markfaces, leaf->nummarkfaces );
+		if( leaf->contents & tc->contents )
+			CM_ClipBox( cms, tc, leaf->markbrushes, leaf->nummarkbrushes, leaf->markfaces, leaf->nummarkfaces );
 		return;
 	}
 
@@ -864,18 +1238,18 @@ loc0:
 	{
 		t1 = p1[plane->type] - plane->dist;
 		t2 = p2[plane->type] - plane->dist;
-		offset = trace_extents[plane->type];
+		offset = tc->extents[plane->type];
 	}
 	else
 	{
 		t1 = DotProduct( plane->normal, p1 ) - plane->dist;
 		t2 = DotProduct( plane->normal, p2 ) - plane->dist;
-		if( trace_ispoint )
+		if( tc->ispoint )
 			offset = 0;
 		else
-			offset = fabs( trace_extents[0] * plane->normal[0] ) +
-			fabs( trace_extents[1] * plane->normal[1] ) +
-			fabs( trace_extents[2] * plane->normal[2] );
+			offset = fabs( tc->extents[0] * plane->normal[0] ) +
+			fabs( tc->extents[1] * plane->normal[1] ) +
+			fabs( tc->extents[2] * plane->normal[2] );
 	}
 
 	// see which sides we need to consider
@@ -927,14 +1301,14 @@ loc0:
 	midf = p1f + ( p2f - p1f ) * frac;
 	VectorLerp( p1, frac, p2, mid );
 
-	CM_RecursiveHullCheck( cms, node->children[side], p1f, midf, p1, mid );
+	CM_RecursiveHullCheck( cms, tc, node->children[side], p1f, midf, p1, mid );
 
 	// go past the node
 	clamp( frac2, 0, 1 );
 	midf = p1f + ( p2f - p1f ) * frac2;
 	VectorLerp( p1, frac2, p2, mid );
 
-	CM_RecursiveHullCheck( cms, node->children[side^1], midf, p2f, mid, p2 );
+	CM_RecursiveHullCheck( cms, tc, node->children[side^1], midf, p2f, mid, p2 );
 }
 
 //======================================================================
@@ -942,47 +1316,51 @@ loc0:
 /*
 * CM_BoxTrace
 */
-static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
+static void CM_BoxTrace( cmodel_state_t *cms, cmtrace_t *tc, trace_t *tr, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
 						cmodel_t *cmodel, vec3_t origin, int brushmask )
 {
 	bool notworld;
 
 	notworld = ( cmodel != cms->map_cmodels ? true : false );
 
-	cms->checkcount++;  // for multi-check avoidance
+	// for multi-check avoidance, zero is the stamp of untested brushes
+	do
+	{
+		tc->checkcount = Sys_Atomic_Add( &cms->checkcount, 1, NULL ) + 1;
+	} while( !tc->checkcount );
 	c_traces++;     // for statistics, may be zeroed
 
 	// fill in a default trace
 	memset( tr, 0, sizeof( *tr ) );
 #ifdef TRACEVICFIX
-	tr->fraction = trace_realfraction = 1;
+	tr->fraction = tc->realfraction = 1;
 #else
 	tr->fraction = 1;
 #endif
 	if( !cms->numnodes )  // map not loaded
 		return;
 
-	trace_trace = tr;
-	trace_contents = brushmask;
-	VectorCopy( start, trace_start );
-	VectorCopy( end, trace_end );
-	VectorCopy( mins, trace_mins );
-	VectorCopy( maxs, trace_maxs );
+	tc->trace = tr;
+	tc->contents = brushmask;
+	VectorCopy( start, tc->start );
+	VectorCopy( end, tc->end );
+	VectorCopy( mins, tc->mins );
+	VectorCopy( maxs, tc->maxs );
 
 	// build a bounding box of the entire move
-	ClearBounds( trace_absmins, trace_absmaxs );
+	ClearBounds( tc->absmins, tc->absmaxs );
 
-	VectorAdd( start, trace_mins, trace_startmins );
-	AddPointToBounds( trace_startmins, trace_absmins, trace_absmaxs );
+	VectorAdd( start, tc->mins, tc->startmins );
+	AddPointToBounds( tc->startmins, tc->absmins, tc->absmaxs );
 
-	VectorAdd( start, trace_maxs, trace_startmaxs );
-	AddPointToBounds( trace_startmaxs, trace_absmins, trace_absmaxs );
+	VectorAdd( start, tc->maxs, tc->startmaxs );
+	AddPointToBounds( tc->startmaxs, tc->absmins, tc->absmaxs );
 
-	VectorAdd( end, trace_mins, trace_endmins );
-	AddPointToBounds( trace_endmins, trace_absmins, trace_absmaxs );
+	VectorAdd( end, tc->mins, tc->endmins );
+	AddPointToBounds( tc->endmins, tc->absmins, tc->absmaxs );
 
-	VectorAdd( end, trace_maxs, trace_endmaxs );
-	AddPointToBounds( trace_endmaxs, trace_absmins, trace_absmaxs );
+	VectorAdd( end, tc->maxs, tc->endmaxs );
+	AddPointToBounds( tc->endmaxs, tc->absmins, tc->absmaxs );
 
 	//
 	// check for position test special case
@@ -997,9 +1375,9 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 
 		if( notworld )
 		{
-			if( BoundsIntersect( cmodel->mins, cmodel->maxs, trace_absmins, trace_absmaxs ) )
+			if( BoundsIntersect( cmodel->mins, cmodel->maxs, tc->absmins, tc->absmaxs ) )
 			{
-				CM_TestBox( cms, cmodel->markbrushes, cmodel->nummarkbrushes, cmodel->markfaces, cmodel->nummarkfaces );
+				CM_TestBox( cms, tc, cmodel->markbrushes, cmodel->nummarkbrushes, cmodel->markfaces, cmodel->nummarkfaces );
 			}
 		}
 		else
@@ -1015,9 +1393,9 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 			{
 				leaf = &cms->map_leafs[leafs[i]];
 
-				if( leaf->contents & trace_contents )
+				if( leaf->contents & tc->contents )
 				{
-					CM_TestBox( cms, leaf->markbrushes, leaf->nummarkbrushes, leaf->markfaces, leaf->nummarkfaces );
+					CM_TestBox( cms, tc, leaf->markbrushes, leaf->nummarkbrushes, leaf->markfaces, leaf->nummarkfaces );
 					if( tr->allsolid )
 						break;
 				}
@@ -1033,13 +1411,13 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 	//
 	if( VectorCompare( mins, vec3_origin ) && VectorCompare( maxs, vec3_origin ) )
 	{
-		trace_ispoint = true;
-		VectorClear( trace_extents );
+		tc->ispoint = true;
+		VectorClear( tc->extents );
 	}
 	else
 	{
-		trace_ispoint = false;
-		VectorSet( trace_extents,
+		tc->ispoint = false;
+		VectorSet( tc->extents,
 			-mins[0] > maxs[0] ? -mins[0] : maxs[0],
 			-mins[1] > maxs[1] ? -mins[1] : maxs[1],
 			-mins[2] > maxs[2] ? -mins[2] : maxs[2] );
@@ -1049,9 +1427,9 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 	// general sweeping through world
 	//
 	if( !notworld )
-		CM_RecursiveHullCheck( cms, 0, 0, 1, start, end );
-	else if( BoundsIntersect( cmodel->mins, cmodel->maxs, trace_absmins, trace_absmaxs ) )
-		CM_ClipBox( cms, cmodel->markbrushes, cmodel->nummarkbrushes, cmodel->markfaces, cmodel->nummarkfaces );
+		CM_RecursiveHullCheck( cms, tc, 0, 0, 1, start, end );
+	else if( BoundsIntersect( cmodel->mins, cmodel->maxs, tc->absmins, tc->absmaxs ) )
+		CM_ClipBox( cms, tc, cmodel->markbrushes, cmodel->nummarkbrushes, cmodel->markfaces, cmodel->nummarkfaces );
 
 #ifdef TRACEVICFIX
 	clamp( tr->fraction, 0, 1 );
@@ -1071,18 +1449,16 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 }
 
 /*
-* CM_TransformedBoxTrace
-*
-* Handles offseting and rotation of the end points for moving and
-* rotating entities
+* CM_TransformedBoxTraceExt
 */
-void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
-							cmodel_t *cmodel, int brushmask, vec3_t origin, vec3_t angles )
+static void CM_TransformedBoxTraceExt( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
+							cmodel_t *cmodel, int brushmask, vec3_t origin, vec3_t angles, bool reference )
 {
 	vec3_t start_l, end_l;
 	vec3_t a, temp;
 	mat3_t axis;
 	bool rotated;
+	cmtrace_t tc;
 
 	if( !tr )
 		return;
@@ -1150,7 +1526,8 @@ void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec
 	}
 
 	// sweep the box through the model
-	CM_BoxTrace( cms, tr, start_l, end_l, mins, maxs, cmodel, origin, brushmask );
+	tc.reference = reference;
+	CM_BoxTrace( cms, &tc, tr, start_l, end_l, mins, maxs, cmodel, origin, brushmask );
 
 	if( rotated && tr->fraction != 1.0 )
 	{
@@ -1174,3 +1551,290 @@ void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec
 #endif
 	}
 }
+
+/*
+* CM_TransformedBoxTrace
+*
+* Handles offseting and rotation of the end points for moving and
+* rotating entities
+*
+* The working state of the trace lives on the stack, so this is safe to call
+* from multiple threads sharing the same collision model, as long as the
+* models from CM_ModelForBBox and CM_OctagonModelForBBox aren't shared.
+*/
+void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
+							cmodel_t *cmodel, int brushmask, vec3_t origin, vec3_t angles )
+{
+	CM_TransformedBoxTraceExt( cms, tr, start, end, mins, maxs, cmodel, brushmask, origin, angles, false );
+}
+
+/*
+===============================================================================
+
+TRACE STRESS TEST AND BENCHMARK
+
+===============================================================================
+*/
+
+typedef struct
+{
+	int cmodel;
+	vec3_t start, end;
+	vec3_t mins, maxs;
+	vec3_t origin, angles;
+	int brushmask;
+
+	trace_t trace;              // reference results from a single thread
+	int contents;
+} cm_stresstrace_t;
+
+typedef struct
+{
+	cmodel_state_t *cms;
+	cm_stresstrace_t *traces;
+	int numtraces;
+	int offset;                 // each thread starts at a different trace
+	int mismatches;
+	struct qthread_s *thread;
+} cm_stressjob_t;
+
+/*
+* CM_StressRandom
+*/
+static float CM_StressRandom( unsigned int *seed, float min, float max )
+{
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return min + ( max - min ) * ( ( *seed & 0xffffff ) / (float)0xffffff );
+}
+
+/*
+* CM_StressTrace
+*/
+static void CM_StressTrace( cmodel_state_t *cms, cm_stresstrace_t *st, trace_t *tr, int *contents, bool reference )
+{
+	cmodel_t *cmodel = CM_InlineModel( cms, st->cmodel );
+
+	CM_TransformedBoxTraceExt( cms, tr, st->start, st->end, st->mins, st->maxs, cmodel, st->brushmask, st->origin, st->angles, reference );
+	if( contents )
+		*contents = CM_TransformedPointContents( cms, st->start, cmodel, st->origin, st->angles );
+}
+
+/*
+* CM_StressGenerate
+*
+* Random point, box and position tests, mostly through the world
+* and some against moved and rotated inline models
+*/
+static cm_stresstrace_t *CM_StressGenerate( cmodel_state_t *cms, int numtraces, unsigned int seed )
+{
+	int i, j, numcmodels;
+	cm_stresstrace_t *traces, *st;
+	vec3_t mins, maxs;
+	float size;
+
+	numcmodels = CM_NumInlineModels( cms );
+	traces = Mem_TempMalloc( sizeof( *traces ) * numtraces );
+
+	for( i = 0, st = traces; i < numtraces; i++, st++ )
+	{
+		st->cmodel = 0;
+		if( numcmodels > 1 && CM_StressRandom( &seed, 0, 1 ) < 0.25f )
+			st->cmodel = 1 + (int)CM_StressRandom( &seed, 0, numcmodels - 1.001f );
+
+		CM_InlineModelBounds( cms, CM_InlineModel( cms, st->cmodel ), mins, maxs );
+		for( j = 0; j < 3; j++ )
+		{
+			mins[j] -= 64;
+			maxs[j] += 64;
+			st->start[j] = CM_StressRandom( &seed, mins[j], maxs[j] );
+			st->end[j] = CM_StressRandom( &seed, mins[j], maxs[j] );
+		}
+
+		size = CM_StressRandom( &seed, 0, 1 ) < 0.3f ? 0 : CM_StressRandom( &seed, 1, 32 );
+		VectorSet( st->mins, -size, -size, -size );
+		VectorSet( st->maxs, size, size, size * 2 );
+		if( CM_StressRandom( &seed, 0, 1 ) < 0.1f )
+			VectorCopy( st->start, st->end );
+
+		VectorClear( st->origin );
+		VectorClear( st->angles );
+		if( st->cmodel )
+		{
+			for( j = 0; j < 3; j++ )
+				st->origin[j] = CM_StressRandom( &seed, -16, 16 );
+			if( CM_StressRandom( &seed, 0, 1 ) < 0.5f )
+				st->angles[YAW] = CM_StressRandom( &seed, 0, 360 );
+		}
+
+		st->brushmask = CM_StressRandom( &seed, 0, 1 ) < 0.5f ? MASK_PLAYERSOLID : MASK_SHOT;
+	}
+
+	return traces;
+}
+
+/*
+* CM_StressCompare
+*/
+static bool CM_StressCompare( const cm_stresstrace_t *st, const trace_t *tr, int contents )
+{
+	const trace_t *ref = &st->trace;
+
+	return ref->fraction == tr->fraction && VectorCompare( ref->endpos, tr->endpos )
+		&& VectorCompare( ref->plane.normal, tr->plane.normal ) && ref->plane.dist == tr->plane.dist
+		&& ref->startsolid == tr->startsolid && ref->allsolid == tr->allsolid
+		&& ref->surfFlags == tr->surfFlags && ref->contents == tr->contents
+		&& st->contents == contents;
+}
+
+/*
+* CM_StressThreadProc
+*/
+static void *CM_StressThreadProc( void *param )
+{
+	cm_stressjob_t *job = param;
+	cm_stresstrace_t *st;
+	trace_t tr;
+	int i, contents;
+
+	for( i = 0; i < job->numtraces; i++ )
+	{
+		st = &job->traces[( i + job->offset ) % job->numtraces];
+		CM_StressTrace( job->cms, st, &tr, &contents, false );
+		if( !CM_StressCompare( st, &tr, contents ) )
+			job->mismatches++;
+	}
+
+	return NULL;
+}
+
+/*
+* CM_TraceStressTest
+*
+* Runs randomized traces on a single thread, then again on several threads
+* at once, and reports traces that don't give the same results
+*/
+void CM_TraceStressTest( cmodel_state_t *cms, int numtraces, int numthreads )
+{
+	int i, mismatches;
+	unsigned int seed, time;
+	cm_stresstrace_t *traces, *st;
+	cm_stressjob_t *jobs;
+
+	if( !cms->numnodes )
+	{
+		Com_Printf( "CM_TraceStressTest: no map loaded\n" );
+		return;
+	}
+
+	clamp( numthreads, 1, 64 );
+	if( numtraces < 1 )
+		numtraces = 1;
+
+	seed = Sys_Milliseconds() | 1;
+	Com_Printf( "Tracing %i random moves on %i threads, seed %u\n", numtraces, numthreads, seed );
+
+	traces = CM_StressGenerate( cms, numtraces, seed );
+
+	// reference results
+	time = Sys_Milliseconds();
+	for( i = 0, st = traces; i < numtraces; i++, st++ )
+		CM_StressTrace( cms, st, &st->trace, &st->contents, false );
+	time = Sys_Milliseconds() - time;
+	Com_Printf( "1 thread: %u ms, %.0f traces/s\n", time, numtraces * 1000.0f / max( time, 1 ) );
+
+	// all threads trace the whole set at the same time
+	jobs = Mem_TempMalloc( sizeof( *jobs ) * numthreads );
+
+	time = Sys_Milliseconds();
+	for( i = 0; i < numthreads; i++ )
+	{
+		jobs[i].cms = cms;
+		jobs[i].traces = traces;
+		jobs[i].numtraces = numtraces;
+		jobs[i].offset = (int)( (int64_t)numtraces * i / numthreads );
+		jobs[i].thread = QThread_Create( CM_StressThreadProc, &jobs[i] );
+	}
+
+	mismatches = 0;
+	for( i = 0; i < numthreads; i++ )
+	{
+		if( jobs[i].thread )
+			QThread_Join( jobs[i].thread );
+		else
+			CM_StressThreadProc( &jobs[i] );
+		mismatches += jobs[i].mismatches;
+	}
+	time = Sys_Milliseconds() - time;
+	Com_Printf( "%i threads: %u ms, %.0f traces/s\n", numthreads, time, (float)numtraces * numthreads * 1000.0f / max( time, 1 ) );
+
+	if( mismatches )
+		Com_Printf( S_COLOR_RED "%i traces out of %i differ from the single threaded results\n", mismatches, numtraces * numthreads );
+	else
+		Com_Printf( "All traces match\n" );
+
+	Mem_TempFree( jobs );
+	Mem_TempFree( traces );
+}
+
+/*
+* CM_TraceBenchmark
+*
+* Times random traces with the plane by plane and the grouped brush
+* clipping kernels, and checks that both give the same results
+*/
+void CM_TraceBenchmark( cmodel_state_t *cms, int numtraces )
+{
+	int i, pass, mismatches;
+	uint64_t time[2];
+	cm_stresstrace_t *traces, *st;
+	trace_t tr;
+
+	if( !cms->numnodes )
+	{
+		Com_Printf( "CM_TraceBenchmark: no map loaded\n" );
+		return;
+	}
+
+	if( numtraces < 1 )
+		numtraces = 1;
+
+	traces = CM_StressGenerate( cms, numtraces, 0x9e3779b9 );
+
+	// reference results, which also warm up the caches
+	for( i = 0, st = traces; i < numtraces; i++, st++ )
+	{
+		CM_StressTrace( cms, st, &st->trace, NULL, true );
+		st->contents = 0;
+	}
+
+	mismatches = 0;
+	for( i = 0, st = traces; i < numtraces; i++, st++ )
+	{
+		CM_StressTrace( cms, st, &tr, NULL, false );
+		if( !CM_StressCompare( st, &tr, 0 ) )
+			mismatches++;
+	}
+
+	// alternate between the kernels
+	time[0] = time[1] = 0;
+	for( pass = 0; pass < 4; pass++ )
+	{
+		bool reference = ( pass & 1 ) == 0;
+		uint64_t start = Sys_Microseconds();
+
+		for( i = 0, st = traces; i < numtraces; i++, st++ )
+			CM_StressTrace( cms, st, &tr, NULL, reference );
+
+		time[reference ? 0 : 1] += Sys_Microseconds() - start;
+	}
+
+	Com_Printf( "plane by plane: %.2f ms, %.0f traces/s\n", time[0] / 2000.0, numtraces * 2 * 1000000.0 / max( time[0], 1 ) );
+	Com_Printf( "grouped planes: %.2f ms, %.0f traces/s\n", time[1] / 2000.0, numtraces * 2 * 1000000.0 / max( time[1], 1 ) );
+	Com_Printf( "speedup: %.2fx\n", (double)time[0] / max( time[1], 1 ) );
+	if( mismatches )
+		Com_Printf( S_COLOR_RED "%i traces differ between the kernels\n", mismatches );
+
+	Mem_TempFree( traces );
+}
@@ -52,6 +52,12 @@ void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec
 
 void CM_RoundUpToHullSize( cmodel_state_t *cms, vec3_t mins, vec3_t maxs, struct cmodel_s *cmodel );
 
+// compares randomized traces run on a single thread and on several threads at once
+void CM_TraceStressTest( cmodel_state_t *cms, int numtraces, int numthreads );
+
+// times the brush clipping kernels on random traces
+void CM_TraceBenchmark( cmodel_state_t *cms, int numtraces );
+
 int CM_ClusterRowSize( cmodel_state_t *cms );
 int CM_AreaRowSize( cmodel_state_t *cms );
 int CM_PointLeafnum( cmodel_state_t *cms, const vec3_t p );
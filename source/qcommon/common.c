@@ -75,6 +75,8 @@ unsigned int time_before_game;
 unsigned int time_after_game;
 unsigned int time_before_ref;
 unsigned int time_after_ref;
+uint64_t time_snap_build;
+uint64_t time_snap_send;
 
 /*
 ==============================================================
@@ -833,6 +835,9 @@ void Qcommon_InitCommands( void )
 	Cmd_AddCommand( "irc_connect", Irc_Connect_f );
 	Cmd_AddCommand( "irc_disconnect", Irc_Disconnect_f );
 
+	Cmd_AddCommand( "net_compressbench", Com_CompressionBenchmark_f );
+	Cmd_AddCommand( "net_traindict", Com_TrainCompressionDictionary_f );
+
 	if( dedicated->integer )
 		Cmd_AddCommand( "quit", Com_Quit );
 
@@ -855,6 +860,9 @@ void Qcommon_ShutdownCommands( void )
 	Cmd_RemoveCommand( "irc_connect" );
 	Cmd_RemoveCommand( "irc_disconnect" );
 
+	Cmd_RemoveCommand( "net_compressbench" );
+	Cmd_RemoveCommand( "net_traindict" );
+
 	if( dedicated->integer )
 		Cmd_RemoveCommand( "quit" );
 
@@ -1125,17 +1133,19 @@ void Qcommon_Frame( unsigned int realmsec )
 
 	if( host_speeds->integer )
 	{
-		int all, sv, gm, cl, rf;
+		int all, sv, gm, sn, tx, cl, rf;
 
 		all = time_after - time_before;
 		sv = time_between - time_before;
 		cl = time_after - time_between;
 		gm = time_after_game - time_before_game;
+		sn = (int)( time_snap_build / 1000 );
+		tx = (int)( time_snap_send / 1000 );
 		rf = time_after_ref - time_before_ref;
-		sv -= gm;
+		sv -= gm + sn + tx;
 		cl -= rf;
-		Com_Printf( "all:%3i sv:%3i gm:%3i cl:%3i rf:%3i\n",
-			all, sv, gm, cl, rf );
+		Com_Printf( "all:%3i sv:%3i gm:%3i sn:%3i tx:%3i cl:%3i rf:%3i\n",
+			all, sv, gm, sn, tx, cl, rf );
 	}
 
 	MM_Frame( realmsec );
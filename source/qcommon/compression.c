@@ -21,6 +21,33 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "qcommon.h"
 #include "compression.h"
 
+#define COMPRESSOR_ZSTD_LEVEL		3
+#define COMPRESSOR_DICT_SIZE		( 64 * 1024 )
+#define COMPRESSOR_TRAIN_MAXSIZE	( 16 * 1024 * 1024 )
+
+typedef struct
+{
+	const char *name;
+	bool ( *load )( void );
+	void ( *unload )( void );
+	bool ( *available )( void );
+	bool ( *setDictionary )( const uint8_t *dict, size_t dictSize );
+	int ( *compress )( bool dict, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen );
+	int ( *decompress )( bool dict, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen );
+} compressor_t;
+
+static uint8_t *comp_dict;
+static size_t comp_dictSize;
+static unsigned int comp_dictChecksum;
+
+/*
+=======================================================================
+
+ZLIB
+
+=======================================================================
+*/
+
 static void *zLibrary;
 
 /*
@@ -41,12 +68,462 @@ void ZLib_LoadLibrary( void )
 	zLibrary = (void *)1;
 }
 
+static bool ZLib_Load( void )
+{
+	ZLib_LoadLibrary();
+	return true;
+}
+
+static bool ZLib_Available( void )
+{
+	return zLibrary != NULL;
+}
+
+static bool ZLib_SetDictionary( const uint8_t *dict, size_t dictSize )
+{
+	// the zlib stream format has no use for the shared dictionary
+	return false;
+}
+
+static int ZLib_CompressChunk( bool dict, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen )
+{
+	int result, zlerror;
+	unsigned long zDestLen = destLen;
+
+	zlerror = qzcompress2( dest, &zDestLen, source, sourceLen, Z_BEST_COMPRESSION );
+	switch( zlerror )
+	{
+	case Z_OK:
+		result = zDestLen; // returns the new length into destLen
+		break;
+	case Z_MEM_ERROR:
+		Com_DPrintf( "ZLib data error! Z_MEM_ERROR on compress.\n" );
+		result = -1;
+		break;
+	case Z_BUF_ERROR:
+		Com_DPrintf( "ZLib data error! Z_BUF_ERROR on compress.\n" );
+		result = -1;
+		break;
+	case Z_STREAM_ERROR:
+		Com_DPrintf( "ZLib data error! Z_STREAM_ERROR on compress.\n" );
+		result = -1;
+		break;
+	default:
+		Com_DPrintf( "ZLib data error! Error code %i on compress.\n", zlerror );
+		result = -1;
+		break;
+	}
+
+	return result;
+}
+
+static int ZLib_DecompressChunk( bool dict, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen )
+{
+	int result, zlerror;
+	unsigned long zDestLen = destLen;
+
+	zlerror = qzuncompress( dest, &zDestLen, source, sourceLen );
+	switch( zlerror )
+	{
+	case Z_OK:
+		result = zDestLen; // returns the new length into destLen
+		break;
+	case Z_MEM_ERROR:
+		Com_DPrintf( "ZLib data error! Z_MEM_ERROR on decompress.\n" );
+		result = -1;
+		break;
+	case Z_BUF_ERROR:
+		Com_DPrintf( "ZLib data error! Z_BUF_ERROR on decompress.\n" );
+		result = -1;
+		break;
+	case Z_DATA_ERROR:
+		Com_DPrintf( "ZLib data error! Z_DATA_ERROR on decompress.\n" );
+		result = -1;
+		break;
+	default:
+		Com_DPrintf( "ZLib data error! Error code %i on decompress.\n", zlerror );
+		result = -1;
+		break;
+	}
+
+	return result;
+}
+
+/*
+=======================================================================
+
+LZ4
+
+=======================================================================
+*/
+
+#ifdef _WIN32
+#define LZ4_LIBNAME "lz4.dll|liblz4.dll"
+#elif defined ( __MACOSX__ )
+#define LZ4_LIBNAME "liblz4.1.dylib|liblz4.dylib"
+#else
+#define LZ4_LIBNAME "liblz4.so.1|liblz4.so"
+#endif
+
+static void *lz4Library;
+static void *lz4DictStream, *lz4WorkStream;
+static int lz4StreamSize;
+
+static int ( *qLZ4_compress_default )( const char *src, char *dst, int srcSize, int dstCapacity );
+static int ( *qLZ4_decompress_safe )( const char *src, char *dst, int compressedSize, int dstCapacity );
+static void *( *qLZ4_createStream )( void );
+static int ( *qLZ4_freeStream )( void *stream );
+static int ( *qLZ4_loadDict )( void *stream, const char *dictionary, int dictSize );
+static int ( *qLZ4_compress_fast_continue )( void *stream, const char *src, char *dst, int srcSize, int dstCapacity, int acceleration );
+static int ( *qLZ4_decompress_safe_usingDict )( const char *src, char *dst, int compressedSize, int dstCapacity, const char *dictStart, int dictSize );
+static int ( *qLZ4_sizeofState )( void );
+
+static dllfunc_t lz4funcs[] =
+{
+	{ "LZ4_compress_default", ( void ** )&qLZ4_compress_default },
+	{ "LZ4_decompress_safe", ( void ** )&qLZ4_decompress_safe },
+	{ "LZ4_createStream", ( void ** )&qLZ4_createStream },
+	{ "LZ4_freeStream", ( void ** )&qLZ4_freeStream },
+	{ "LZ4_loadDict", ( void ** )&qLZ4_loadDict },
+	{ "LZ4_compress_fast_continue", ( void ** )&qLZ4_compress_fast_continue },
+	{ "LZ4_decompress_safe_usingDict", ( void ** )&qLZ4_decompress_safe_usingDict },
+	{ "LZ4_sizeofState", ( void ** )&qLZ4_sizeofState },
+	{ NULL, NULL }
+};
+
+static bool LZ4_SetDictionary( const uint8_t *dict, size_t dictSize )
+{
+	if( lz4DictStream )
+	{
+		qLZ4_freeStream( lz4DictStream );
+		lz4DictStream = NULL;
+	}
+
+	if( !lz4Library || !dict )
+		return false;
+
+	// the dictionary is loaded once and the stream state copied for each message
+	lz4DictStream = qLZ4_createStream();
+	if( !lz4DictStream )
+		return false;
+	qLZ4_loadDict( lz4DictStream, ( const char * )dict, dictSize );
+	return true;
+}
+
+static void LZ4_Unload( void )
+{
+	LZ4_SetDictionary( NULL, 0 );
+
+	if( lz4WorkStream )
+	{
+		qLZ4_freeStream( lz4WorkStream );
+		lz4WorkStream = NULL;
+	}
+
+	if( lz4Library )
+		Com_UnloadLibrary( &lz4Library );
+}
+
+static bool LZ4_Load( void )
+{
+	LZ4_Unload();
+
+	lz4Library = Com_LoadSysLibrary( LZ4_LIBNAME, lz4funcs );
+	if( !lz4Library )
+		return false;
+
+	lz4StreamSize = qLZ4_sizeofState();
+	lz4WorkStream = qLZ4_createStream();
+	if( !lz4WorkStream )
+	{
+		LZ4_Unload();
+		return false;
+	}
+
+	return true;
+}
+
+static bool LZ4_Available( void )
+{
+	return lz4Library != NULL;
+}
+
+static int LZ4_CompressChunk( bool dict, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen )
+{
+	int result;
+
+	if( dict )
+	{
+		if( !lz4DictStream )
+			return -1;
+		memcpy( lz4WorkStream, lz4DictStream, lz4StreamSize );
+		result = qLZ4_compress_fast_continue( lz4WorkStream, ( const char * )source, ( char * )dest, sourceLen, destLen, 1 );
+	}
+	else
+	{
+		result = qLZ4_compress_default( ( const char * )source, ( char * )dest, sourceLen, destLen );
+	}
+
+	if( result <= 0 )
+	{
+		Com_DPrintf( "LZ4 data error! Output buffer too small on compress.\n" );
+		return -1;
+	}
+
+	return result;
+}
+
+static int LZ4_DecompressChunk( bool dict, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen )
+{
+	int result;
+
+	if( dict )
+	{
+		if( !comp_dict )
+			return -1;
+		result = qLZ4_decompress_safe_usingDict( ( const char * )source, ( char * )dest, sourceLen, destLen,
+			( const char * )comp_dict, comp_dictSize );
+	}
+	else
+	{
+		result = qLZ4_decompress_safe( ( const char * )source, ( char * )dest, sourceLen, destLen );
+	}
+
+	if( result < 0 )
+	{
+		Com_DPrintf( "LZ4 data error! Error code %i on decompress.\n", result );
+		return -1;
+	}
+
+	return result;
+}
+
+/*
+=======================================================================
+
+ZSTD
+
+=======================================================================
+*/
+
+#ifdef _WIN32
+#define ZSTD_LIBNAME "zstd.dll|libzstd.dll"
+#elif defined ( __MACOSX__ )
+#define ZSTD_LIBNAME "libzstd.1.dylib|libzstd.dylib"
+#else
+#define ZSTD_LIBNAME "libzstd.so.1|libzstd.so"
+#endif
+
+static void *zstdLibrary;
+static void *zstdCCtx, *zstdDCtx;
+static void *zstdCDict, *zstdDDict;
+
+static void *( *qZSTD_createCCtx )( void );
+static size_t ( *qZSTD_freeCCtx )( void *cctx );
+static void *( *qZSTD_createDCtx )( void );
+static size_t ( *qZSTD_freeDCtx )( void *dctx );
+static size_t ( *qZSTD_compressCCtx )( void *cctx, void *dst, size_t dstCapacity, const void *src, size_t srcSize, int level );
+static size_t ( *qZSTD_decompressDCtx )( void *dctx, void *dst, size_t dstCapacity, const void *src, size_t srcSize );
+static unsigned ( *qZSTD_isError )( size_t code );
+static const char *( *qZSTD_getErrorName )( size_t code );
+static void *( *qZSTD_createCDict )( const void *dict, size_t dictSize, int level );
+static size_t ( *qZSTD_freeCDict )( void *cdict );
+static void *( *qZSTD_createDDict )( const void *dict, size_t dictSize );
+static size_t ( *qZSTD_freeDDict )( void *ddict );
+static size_t ( *qZSTD_compress_usingCDict )( void *cctx, void *dst, size_t dstCapacity, const void *src, size_t srcSize, const void *cdict );
+static size_t ( *qZSTD_decompress_usingDDict )( void *dctx, void *dst, size_t dstCapacity, const void *src, size_t srcSize, const void *ddict );
+
+// optional, only needed to train new dictionaries
+static size_t ( *qZDICT_trainFromBuffer )( void *dictBuffer, size_t dictCapacity, const void *samplesBuffer, const size_t *samplesSizes, unsigned nbSamples );
+static unsigned ( *qZDICT_isError )( size_t code );
+
+static dllfunc_t zstdfuncs[] =
+{
+	{ "ZSTD_createCCtx", ( void ** )&qZSTD_createCCtx },
+	{ "ZSTD_freeCCtx", ( void ** )&qZSTD_freeCCtx },
+	{ "ZSTD_createDCtx", ( void ** )&qZSTD_createDCtx },
+	{ "ZSTD_freeDCtx", ( void ** )&qZSTD_freeDCtx },
+	{ "ZSTD_compressCCtx", ( void ** )&qZSTD_compressCCtx },
+	{ "ZSTD_decompressDCtx", ( void ** )&qZSTD_decompressDCtx },
+	{ "ZSTD_isError", ( void ** )&qZSTD_isError },
+	{ "ZSTD_getErrorName", ( void ** )&qZSTD_getErrorName },
+	{ "ZSTD_createCDict", ( void ** )&qZSTD_createCDict },
+	{ "ZSTD_freeCDict", ( void ** )&qZSTD_freeCDict },
+	{ "ZSTD_createDDict", ( void ** )&qZSTD_createDDict },
+	{ "ZSTD_freeDDict", ( void ** )&qZSTD_freeDDict },
+	{ "ZSTD_compress_usingCDict", ( void ** )&qZSTD_compress_usingCDict },
+	{ "ZSTD_decompress_usingDDict", ( void ** )&qZSTD_decompress_usingDDict },
+	{ NULL, NULL }
+};
+
+static bool ZSTD_SetDictionary( const uint8_t *dict, size_t dictSize )
+{
+	if( zstdCDict )
+	{
+		qZSTD_freeCDict( zstdCDict );
+		zstdCDict = NULL;
+	}
+	if( zstdDDict )
+	{
+		qZSTD_freeDDict( zstdDDict );
+		zstdDDict = NULL;
+	}
+
+	if( !zstdLibrary || !dict )
+		return false;
+
+	zstdCDict = qZSTD_createCDict( dict, dictSize, COMPRESSOR_ZSTD_LEVEL );
+	zstdDDict = qZSTD_createDDict( dict, dictSize );
+	if( !zstdCDict || !zstdDDict )
+	{
+		ZSTD_SetDictionary( NULL, 0 );
+		return false;
+	}
+
+	return true;
+}
+
+static void ZSTD_Unload( void )
+{
+	ZSTD_SetDictionary( NULL, 0 );
+
+	if( zstdCCtx )
+	{
+		qZSTD_freeCCtx( zstdCCtx );
+		zstdCCtx = NULL;
+	}
+	if( zstdDCtx )
+	{
+		qZSTD_freeDCtx( zstdDCtx );
+		zstdDCtx = NULL;
+	}
+
+	qZDICT_trainFromBuffer = NULL;
+	qZDICT_isError = NULL;
+
+	if( zstdLibrary )
+		Com_UnloadLibrary( &zstdLibrary );
+}
+
+static bool ZSTD_Load( void )
+{
+	ZSTD_Unload();
+
+	zstdLibrary = Com_LoadSysLibrary( ZSTD_LIBNAME, zstdfuncs );
+	if( !zstdLibrary )
+		return false;
+
+	zstdCCtx = qZSTD_createCCtx();
+	zstdDCtx = qZSTD_createDCtx();
+	if( !zstdCCtx || !zstdDCtx )
+	{
+		ZSTD_Unload();
+		return false;
+	}
+
+	*( void ** )&qZDICT_trainFromBuffer = Com_LibraryProcAddress( zstdLibrary, "ZDICT_trainFromBuffer" );
+	*( void ** )&qZDICT_isError = Com_LibraryProcAddress( zstdLibrary, "ZDICT_isError" );
+	if( !qZDICT_trainFromBuffer || !qZDICT_isError )
+	{
+		qZDICT_trainFromBuffer = NULL;
+		qZDICT_isError = NULL;
+	}
+
+	return true;
+}
+
+static bool ZSTD_Available( void )
+{
+	return zstdLibrary != NULL;
+}
+
+static int ZSTD_CompressChunk( bool dict, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen )
+{
+	size_t result;
+
+	if( dict )
+	{
+		if( !zstdCDict )
+			return -1;
+		result = qZSTD_compress_usingCDict( zstdCCtx, dest, destLen, source, sourceLen, zstdCDict );
+	}
+	else
+	{
+		result = qZSTD_compressCCtx( zstdCCtx, dest, destLen, source, sourceLen, COMPRESSOR_ZSTD_LEVEL );
+	}
+
+	if( qZSTD_isError( result ) )
+	{
+		Com_DPrintf( "Zstd data error! %s on compress.\n", qZSTD_getErrorName( result ) );
+		return -1;
+	}
+
+	return result;
+}
+
+static int ZSTD_DecompressChunk( bool dict, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen )
+{
+	size_t result;
+
+	if( dict )
+	{
+		if( !zstdDDict )
+			return -1;
+		result = qZSTD_decompress_usingDDict( zstdDCtx, dest, destLen, source, sourceLen, zstdDDict );
+	}
+	else
+	{
+		result = qZSTD_decompressDCtx( zstdDCtx, dest, destLen, source, sourceLen );
+	}
+
+	if( qZSTD_isError( result ) )
+	{
+		Com_DPrintf( "Zstd data error! %s on decompress.\n", qZSTD_getErrorName( result ) );
+		return -1;
+	}
+
+	return result;
+}
+
+/*
+=======================================================================
+
+COMPRESSORS
+
+=======================================================================
+*/
+
+static const compressor_t compressors[COMPRESSOR_TOTAL] =
+{
+	{ "zlib", ZLib_Load, ZLib_UnloadLibrary, ZLib_Available, ZLib_SetDictionary, ZLib_CompressChunk, ZLib_DecompressChunk },
+	{ "lz4", LZ4_Load, LZ4_Unload, LZ4_Available, LZ4_SetDictionary, LZ4_CompressChunk, LZ4_DecompressChunk },
+	{ "zstd", ZSTD_Load, ZSTD_Unload, ZSTD_Available, ZSTD_SetDictionary, ZSTD_CompressChunk, ZSTD_DecompressChunk },
+};
+
+static char comp_availableString[MAX_INFO_VALUE];
+
 /*
 * Com_LoadCompressionLibraries
 */
 void Com_LoadCompressionLibraries( void )
 {
-	ZLib_LoadLibrary();
+	int i;
+
+	comp_availableString[0] = '\0';
+
+	for( i = 0; i < COMPRESSOR_TOTAL; i++ )
+	{
+		if( !compressors[i].load() )
+			continue;
+
+		// zlib is implied, the list only advertises the optional ones
+		if( i != COMPRESSOR_ZLIB )
+		{
+			if( comp_availableString[0] )
+				Q_strncatz( comp_availableString, ",", sizeof( comp_availableString ) );
+			Q_strncatz( comp_availableString, compressors[i].name, sizeof( comp_availableString ) );
+		}
+	}
 }
 
 /*
@@ -54,5 +531,425 @@ void Com_LoadCompressionLibraries( void )
 */
 void Com_UnloadCompressionLibraries( void )
 {
-	ZLib_UnloadLibrary();
+	int i;
+
+	Com_UnloadCompressionDictionary();
+
+	for( i = 0; i < COMPRESSOR_TOTAL; i++ )
+		compressors[i].unload();
+
+	comp_availableString[0] = '\0';
+}
+
+/*
+* Com_FindCompressor
+*
+* Returns -1 if the name is unknown
+*/
+int Com_FindCompressor( const char *name )
+{
+	int i;
+
+	for( i = 0; i < COMPRESSOR_TOTAL; i++ )
+	{
+		if( !Q_stricmp( compressors[i].name, name ) )
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+* Com_CompressorName
+*/
+const char *Com_CompressorName( int compressor )
+{
+	if( compressor < 0 || compressor >= COMPRESSOR_TOTAL )
+		return "unknown";
+	return compressors[compressor].name;
+}
+
+/*
+* Com_CompressorAvailable
+*/
+bool Com_CompressorAvailable( int compressor )
+{
+	if( compressor < 0 || compressor >= COMPRESSOR_TOTAL )
+		return false;
+	return compressors[compressor].available();
+}
+
+/*
+* Com_AvailableCompressors
+*
+* Comma separated list of the optional compressors that could be loaded
+*/
+const char *Com_AvailableCompressors( void )
+{
+	return comp_availableString;
+}
+
+/*
+* Com_CompressChunk
+*
+* Returns the compressed length or -1 on error
+*/
+int Com_CompressChunk( int compressor, bool dict, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen )
+{
+	if( !Com_CompressorAvailable( compressor ) )
+		return -1;
+	return compressors[compressor].compress( dict, source, sourceLen, dest, destLen );
+}
+
+/*
+* Com_DecompressChunk
+*
+* Returns the decompressed length or -1 on error
+*/
+int Com_DecompressChunk( int compressor, bool dict, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen )
+{
+	if( !Com_CompressorAvailable( compressor ) )
+		return -1;
+	return compressors[compressor].decompress( dict, source, sourceLen, dest, destLen );
+}
+
+/*
+=======================================================================
+
+SHARED DICTIONARY
+
+=======================================================================
+*/
+
+/*
+* Com_UnloadCompressionDictionary
+*/
+void Com_UnloadCompressionDictionary( void )
+{
+	int i;
+
+	for( i = 0; i < COMPRESSOR_TOTAL; i++ )
+		compressors[i].setDictionary( NULL, 0 );
+
+	if( comp_dict )
+	{
+		Mem_ZoneFree( comp_dict );
+		comp_dict = NULL;
+	}
+	comp_dictSize = 0;
+	comp_dictChecksum = 0;
+}
+
+/*
+* Com_LoadCompressionDictionary
+*
+* Both ends of a connection must have loaded the same dictionary to use it,
+* which is checked by its checksum at connect time
+*/
+bool Com_LoadCompressionDictionary( const char *filename )
+{
+	int i, length;
+	void *buffer;
+	bool loaded;
+
+	Com_UnloadCompressionDictionary();
+
+	if( !filename || !filename[0] )
+		return false;
+
+	length = FS_LoadFile( filename, &buffer, NULL, 0 );
+	if( !buffer )
+	{
+		Com_Printf( "Couldn't load compression dictionary %s\n", filename );
+		return false;
+	}
+	if( length <= 0 )
+	{
+		FS_FreeFile( buffer );
+		return false;
+	}
+
+	comp_dict = Mem_ZoneMalloc( length );
+	memcpy( comp_dict, buffer, length );
+	comp_dictSize = length;
+	FS_FreeFile( buffer );
+
+	loaded = false;
+	for( i = 0; i < COMPRESSOR_TOTAL; i++ )
+	{
+		if( compressors[i].setDictionary( comp_dict, comp_dictSize ) )
+			loaded = true;
+	}
+
+	if( !loaded )
+	{
+		Com_Printf( "No compressor could use the dictionary %s\n", filename );
+		Com_UnloadCompressionDictionary();
+		return false;
+	}
+
+	comp_dictChecksum = qzcrc32( 0L, comp_dict, comp_dictSize );
+	if( !comp_dictChecksum )
+		comp_dictChecksum = 1;
+
+	Com_Printf( "Loaded compression dictionary %s (%i bytes)\n", filename, length );
+	return true;
+}
+
+/*
+* Com_CompressionDictionaryChecksum
+*
+* Returns 0 if no dictionary is loaded
+*/
+unsigned int Com_CompressionDictionaryChecksum( void )
+{
+	return comp_dictChecksum;
+}
+
+/*
+=======================================================================
+
+DEMO SAMPLES
+
+=======================================================================
+*/
+
+/*
+* Com_OpenDemoSamples
+*/
+static int Com_OpenDemoSamples( const char *demoname )
+{
+	char name[MAX_QPATH];
+	int file;
+
+	Q_snprintfz( name, sizeof( name ), "demos/%s", demoname );
+	COM_DefaultExtension( name, APP_DEMO_EXTENSION_STR, sizeof( name ) );
+
+	if( FS_FOpenFile( name, &file, FS_READ|SNAP_DEMO_GZ ) == -1 )
+	{
+		Com_Printf( "Couldn't open %s\n", name );
+		return 0;
+	}
+
+	return file;
+}
+
+/*
+* Com_ReadDemoSample
+*
+* Like SNAP_ReadDemoMessage, without dropping the server on broken demos
+*/
+static int Com_ReadDemoSample( int file, uint8_t *data )
+{
+	int msglen = -1;
+
+	if( FS_Read( &msglen, 4, file ) != 4 )
+		return -1;
+
+	msglen = LittleLong( msglen );
+	if( msglen <= 0 || msglen > MAX_MSGLEN )
+		return -1;
+
+	if( FS_Read( data, msglen, file ) != msglen )
+		return -1;
+
+	return msglen;
+}
+
+/*
+* Com_CompressionBenchmark_f
+*
+* Replays the messages of a demo through every available compressor
+*/
+void Com_CompressionBenchmark_f( void )
+{
+	int i, file, length, numMessages;
+	int pass, numPasses;
+	uint8_t *samples, *source, *packed, *unpacked;
+	int *sizes;
+	size_t totalSize, maxSamples, offset;
+
+	if( Cmd_Argc() != 2 )
+	{
+		Com_Printf( "Usage: %s <demo>\n", Cmd_Argv( 0 ) );
+		return;
+	}
+
+	file = Com_OpenDemoSamples( Cmd_Argv( 1 ) );
+	if( !file )
+		return;
+
+	maxSamples = 1024;
+	samples = Mem_ZoneMalloc( COMPRESSOR_TRAIN_MAXSIZE );
+	sizes = Mem_ZoneMalloc( maxSamples * sizeof( *sizes ) );
+	packed = Mem_ZoneMalloc( MAX_MSGLEN * 2 );
+	unpacked = Mem_ZoneMalloc( MAX_MSGLEN );
+
+	numMessages = 0;
+	totalSize = 0;
+	while( totalSize + MAX_MSGLEN <= COMPRESSOR_TRAIN_MAXSIZE )
+	{
+		length = Com_ReadDemoSample( file, samples + totalSize );
+		if( length < 0 )
+			break;
+
+		if( (size_t)numMessages == maxSamples )
+		{
+			int *newSizes = Mem_ZoneMalloc( maxSamples * 2 * sizeof( *sizes ) );
+			memcpy( newSizes, sizes, maxSamples * sizeof( *sizes ) );
+			Mem_ZoneFree( sizes );
+			sizes = newSizes;
+			maxSamples *= 2;
+		}
+
+		sizes[numMessages++] = length;
+		totalSize += length;
+	}
+
+	FS_FCloseFile( file );
+
+	if( !numMessages )
+	{
+		Com_Printf( "No messages in demo\n" );
+		goto done;
+	}
+
+	Com_Printf( "%i messages, %i bytes\n", numMessages, (int)totalSize );
+
+	numPasses = Com_CompressionDictionaryChecksum() ? 2 : 1;
+	for( i = 0; i < COMPRESSOR_TOTAL; i++ )
+	{
+		if( !Com_CompressorAvailable( i ) )
+			continue;
+
+		for( pass = 0; pass < numPasses; pass++ )
+		{
+			bool dict = pass != 0;
+			size_t packedSize = 0;
+			uint64_t compressTime = 0, decompressTime = 0, start;
+			int j, failed = 0;
+
+			if( dict && i == COMPRESSOR_ZLIB )
+				continue;
+
+			for( j = 0, offset = 0; j < numMessages; offset += sizes[j], j++ )
+			{
+				source = samples + offset;
+
+				start = Sys_Microseconds();
+				length = Com_CompressChunk( i, dict, source, sizes[j], packed, MAX_MSGLEN * 2 );
+				compressTime += Sys_Microseconds() - start;
+				if( length < 0 )
+				{
+					failed++;
+					continue;
+				}
+				packedSize += length;
+
+				start = Sys_Microseconds();
+				length = Com_DecompressChunk( i, dict, packed, length, unpacked, MAX_MSGLEN );
+				decompressTime += Sys_Microseconds() - start;
+				if( length != sizes[j] || memcmp( unpacked, source, length ) )
+					failed++;
+			}
+
+			Com_Printf( "%-5s%s: ratio %.3f, compress %.1f MB/s, decompress %.1f MB/s",
+				compressors[i].name, dict ? "+dict" : "     ",
+				packedSize ? (double)totalSize / packedSize : 0.0,
+				compressTime ? (double)totalSize / compressTime : 0.0,
+				decompressTime ? (double)totalSize / decompressTime : 0.0 );
+			if( failed )
+				Com_Printf( ", %i failed", failed );
+			Com_Printf( "\n" );
+		}
+	}
+
+done:
+	Mem_ZoneFree( samples );
+	Mem_ZoneFree( sizes );
+	Mem_ZoneFree( packed );
+	Mem_ZoneFree( unpacked );
+}
+
+/*
+* Com_TrainCompressionDictionary_f
+*
+* Trains a shared dictionary from the messages of one or more demos
+*/
+void Com_TrainCompressionDictionary_f( void )
+{
+	int i, file, length, filenum;
+	unsigned numSamples, maxSamples;
+	uint8_t *samples, *dict;
+	size_t *sizes, totalSize, dictSize;
+
+	if( Cmd_Argc() < 3 )
+	{
+		Com_Printf( "Usage: %s <output> <demo> [demo...]\n", Cmd_Argv( 0 ) );
+		return;
+	}
+
+	if( !qZDICT_trainFromBuffer )
+	{
+		Com_Printf( "Dictionary training requires the zstd library\n" );
+		return;
+	}
+
+	maxSamples = 1024;
+	samples = Mem_ZoneMalloc( COMPRESSOR_TRAIN_MAXSIZE );
+	sizes = Mem_ZoneMalloc( maxSamples * sizeof( *sizes ) );
+
+	numSamples = 0;
+	totalSize = 0;
+	for( i = 2; i < Cmd_Argc() && totalSize + MAX_MSGLEN <= COMPRESSOR_TRAIN_MAXSIZE; i++ )
+	{
+		file = Com_OpenDemoSamples( Cmd_Argv( i ) );
+		if( !file )
+			continue;
+
+		while( totalSize + MAX_MSGLEN <= COMPRESSOR_TRAIN_MAXSIZE )
+		{
+			length = Com_ReadDemoSample( file, samples + totalSize );
+			if( length < 0 )
+				break;
+
+			if( numSamples == maxSamples )
+			{
+				size_t *newSizes = Mem_ZoneMalloc( maxSamples * 2 * sizeof( *sizes ) );
+				memcpy( newSizes, sizes, maxSamples * sizeof( *sizes ) );
+				Mem_ZoneFree( sizes );
+				sizes = newSizes;
+				maxSamples *= 2;
+			}
+
+			sizes[numSamples++] = length;
+			totalSize += length;
+		}
+
+		FS_FCloseFile( file );
+	}
+
+	dict = Mem_ZoneMalloc( COMPRESSOR_DICT_SIZE );
+	dictSize = 0;
+	if( numSamples )
+		dictSize = qZDICT_trainFromBuffer( dict, COMPRESSOR_DICT_SIZE, samples, sizes, numSamples );
+
+	if( !numSamples || qZDICT_isError( dictSize ) )
+	{
+		Com_Printf( "Couldn't train a dictionary from %u messages\n", numSamples );
+	}
+	else if( FS_FOpenFile( Cmd_Argv( 1 ), &filenum, FS_WRITE ) == -1 )
+	{
+		Com_Printf( "Couldn't write %s\n", Cmd_Argv( 1 ) );
+	}
+	else
+	{
+		FS_Write( dict, dictSize, filenum );
+		FS_FCloseFile( filenum );
+		Com_Printf( "Wrote %s, %i bytes from %u messages\n", Cmd_Argv( 1 ), (int)dictSize, numSamples );
+	}
+
+	Mem_ZoneFree( dict );
+	Mem_ZoneFree( samples );
+	Mem_ZoneFree( sizes );
 }
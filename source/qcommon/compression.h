@@ -37,6 +37,32 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define qgzflush gzflush
 #define qgzsetparams gzsetparams
 #define qgzbuffer gzbuffer
+#define qzcrc32 crc32
+
+// compressors for the network channel, zlib is always available
+// and the only one known to older clients
+enum
+{
+	COMPRESSOR_ZLIB,
+	COMPRESSOR_LZ4,
+	COMPRESSOR_ZSTD,
+
+	COMPRESSOR_TOTAL
+};
 
 void Com_LoadCompressionLibraries( void );
 void Com_UnloadCompressionLibraries( void );
+
+int Com_FindCompressor( const char *name );
+const char *Com_CompressorName( int compressor );
+bool Com_CompressorAvailable( int compressor );
+const char *Com_AvailableCompressors( void );
+int Com_CompressChunk( int compressor, bool dict, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen );
+int Com_DecompressChunk( int compressor, bool dict, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen );
+
+bool Com_LoadCompressionDictionary( const char *filename );
+void Com_UnloadCompressionDictionary( void );
+unsigned int Com_CompressionDictionaryChecksum( void );
+
+void Com_CompressionBenchmark_f( void );
+void Com_TrainCompressionDictionary_f( void );
@@ -196,6 +196,18 @@ static filehandle_t fs_filehandles[FS_MAX_HANDLES];
 static filehandle_t fs_filehandles_headnode, *fs_free_filehandles;
 static qmutex_t *fs_fh_mutex;
 
+// mappings that outlive the file handle they were created from
+typedef struct fs_mapping_s
+{
+	void *data;
+	void *mapping;
+	size_t size;
+	size_t offset;
+	struct fs_mapping_s *next;
+} fs_mapping_t;
+
+static fs_mapping_t *fs_detached_mappings;
+
 static int fs_notifications = 0;
 
 static int FS_AddNotifications( int bitmask );
@@ -1943,6 +1955,72 @@ void FS_UnMMapBaseFile( int file, void *data )
 	fh->mapping = NULL;
 }
 
+/*
+* FS_MMapBaseFileDetached
+*
+* Unlike FS_MMapBaseFile, the file can be closed right away and
+* the mapping is released with FS_UnMMapDetached
+*/
+void *FS_MMapBaseFileDetached( int file, size_t size, size_t offset )
+{
+	void *data;
+	filehandle_t *fh;
+	fs_mapping_t *m;
+
+	if( !size )
+		return NULL;
+
+	fh = FS_FileHandleForNum( file );
+	if( !fh->fstream || fh->vfsHandle )
+		return NULL;
+
+	m = ( fs_mapping_t * )FS_Malloc( sizeof( *m ) );
+	data = Sys_FS_MMapFile( Sys_FS_FileNo( fh->fstream ), size, offset, &m->mapping, &m->offset );
+	if( !data )
+	{
+		FS_Free( m );
+		return NULL;
+	}
+
+	m->data = data;
+	m->size = size;
+
+	QMutex_Lock( fs_fh_mutex );
+	m->next = fs_detached_mappings;
+	fs_detached_mappings = m;
+	QMutex_Unlock( fs_fh_mutex );
+
+	return data;
+}
+
+/*
+* FS_UnMMapDetached
+*/
+void FS_UnMMapDetached( void *data )
+{
+	fs_mapping_t *m, **prev;
+
+	if( !data )
+		return;
+
+	QMutex_Lock( fs_fh_mutex );
+	for( prev = &fs_detached_mappings; *prev; prev = &( *prev )->next )
+	{
+		if( ( *prev )->data == data )
+			break;
+	}
+	m = *prev;
+	if( m )
+		*prev = m->next;
+	QMutex_Unlock( fs_fh_mutex );
+
+	if( !m )
+		return;
+
+	Sys_FS_UnMMapFile( m->mapping, m->data, m->size, m->offset );
+	FS_Free( m );
+}
+
 /*
 * FS_FreeFile
 */
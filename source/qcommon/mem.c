@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // Z_zone.c
 
 #include "qcommon.h"
+#include "sys_threads.h"
 
 //#define MEMTRASH
 
@@ -52,6 +53,9 @@ typedef struct memheader_s
 	const char *filename;
 	int fileline;
 
+	// slab size class the memory came from, or -1 if it was malloc'ed
+	int sizeclass;
+
 	// should always be MEMHEADER_SENTINEL1
 	unsigned int sentinel1;
 	// immediately followed by data, which is followed by a MEMHEADER_SENTINEL2 byte
@@ -91,12 +95,64 @@ struct mempool_s
 
 	int fileline;
 
+	// protects the chain and the sizes
+	qmutex_t *mutex;
+
 	// should always be MEMHEADER_SENTINEL1
 	unsigned int sentinel2;
 };
 
 // ============================================================================
 
+// Small blocks are carved out of large slabs and recycled through per-thread
+// free lists, so that most allocations don't hit the heap or any shared lock.
+// Threads exchange blocks with a global depot in batches. Each cache is set
+// on a thread key when first used, so that its blocks go back to the depot
+// when the thread exits, whoever created it.
+
+#if defined( _MSC_VER )
+#define MEM_THREADLOCAL __declspec( thread )
+#else
+#define MEM_THREADLOCAL __thread
+#endif
+
+#define MEMSLAB_SIZE				0x10000
+#define MEMSLAB_HEADER_SIZE			MEMALIGNMENT_DEFAULT
+#define MEMSLAB_MAX_BLOCK_SIZE		2048
+#define MEMSLAB_NUM_CLASSES			12
+#define MEMSLAB_CACHE_BYTES			0x8000		// per thread and size class
+
+static const size_t memSlabClassSizes[MEMSLAB_NUM_CLASSES] =
+{
+	96, 128, 160, 192, 256, 320, 384, 512, 768, 1024, 1536, MEMSLAB_MAX_BLOCK_SIZE
+};
+
+typedef struct memslabblock_s
+{
+	struct memslabblock_s *next;
+} memslabblock_t;
+
+typedef struct
+{
+	memslabblock_t *free[MEMSLAB_NUM_CLASSES];
+	int numfree[MEMSLAB_NUM_CLASSES];
+	bool keyed;					// set on memSlabCacheKey
+} memslabcache_t;
+
+static MEM_THREADLOCAL memslabcache_t memSlabCache;
+static qthreadkey_t *memSlabCacheKey;
+
+// global depot, protected by memMutex
+static memslabblock_t *memSlabDepot[MEMSLAB_NUM_CLASSES];
+static int memSlabDepotCount[MEMSLAB_NUM_CLASSES];
+static void *memSlabs;
+static int memNumSlabs;
+
+static uint8_t memSlabClassForSize[MEMSLAB_MAX_BLOCK_SIZE / MEMALIGNMENT_DEFAULT + 1];
+static bool memSlabsEnabled = true;
+
+// ============================================================================
+
 //#define SHOW_NONFREED
 
 cvar_t *developerMemory;
@@ -128,10 +184,205 @@ static void _Mem_Error( const char *format, ... )
 	Sys_Error( msg );
 }
 
+/*
+* Mem_SlabCacheLimit
+*/
+static int Mem_SlabCacheLimit( int sizeclass )
+{
+	return max( MEMSLAB_CACHE_BYTES / (int)memSlabClassSizes[sizeclass], 8 );
+}
+
+/*
+* Mem_RefillSlabCache
+*/
+static void Mem_RefillSlabCache( memslabcache_t *cache, int sizeclass )
+{
+	int i, count;
+	size_t blocksize = memSlabClassSizes[sizeclass];
+	memslabblock_t *block;
+
+	count = Mem_SlabCacheLimit( sizeclass ) / 2;
+
+	QMutex_Lock( memMutex );
+
+	if( memSlabDepotCount[sizeclass] < count )
+	{
+		uint8_t *slab, *p;
+
+		slab = ( uint8_t * )malloc( MEMSLAB_SIZE );
+		if( slab == NULL )
+			_Mem_Error( "Mem_Alloc: out of memory" );
+
+		// slabs are chained through their first bytes so they can be released on shutdown
+		*( void ** )slab = memSlabs;
+		memSlabs = slab;
+		memNumSlabs++;
+
+		for( p = slab + MEMSLAB_HEADER_SIZE; p + blocksize <= slab + MEMSLAB_SIZE; p += blocksize )
+		{
+			block = ( memslabblock_t * )p;
+			block->next = memSlabDepot[sizeclass];
+			memSlabDepot[sizeclass] = block;
+			memSlabDepotCount[sizeclass]++;
+		}
+	}
+
+	for( i = 0; i < count && memSlabDepot[sizeclass]; i++ )
+	{
+		block = memSlabDepot[sizeclass];
+		memSlabDepot[sizeclass] = block->next;
+		memSlabDepotCount[sizeclass]--;
+
+		block->next = cache->free[sizeclass];
+		cache->free[sizeclass] = block;
+		cache->numfree[sizeclass]++;
+	}
+
+	QMutex_Unlock( memMutex );
+}
+
+/*
+* Mem_FlushSlabCache
+*/
+static void Mem_FlushSlabCache( memslabcache_t *cache, int sizeclass, int count )
+{
+	memslabblock_t *block;
+
+	QMutex_Lock( memMutex );
+
+	while( count-- > 0 && cache->free[sizeclass] )
+	{
+		block = cache->free[sizeclass];
+		cache->free[sizeclass] = block->next;
+		cache->numfree[sizeclass]--;
+
+		block->next = memSlabDepot[sizeclass];
+		memSlabDepot[sizeclass] = block;
+		memSlabDepotCount[sizeclass]++;
+	}
+
+	QMutex_Unlock( memMutex );
+}
+
+/*
+* Mem_ReleaseSlabCache
+* 
+* Hands the blocks cached by an exiting thread back to the global depot
+*/
+static void Mem_ReleaseSlabCache( void *param )
+{
+	int i;
+	memslabcache_t *cache = ( memslabcache_t * )param;
+
+	if( !memory_initialized )
+		return;
+
+	for( i = 0; i < MEMSLAB_NUM_CLASSES; i++ )
+	{
+		if( cache->numfree[i] )
+			Mem_FlushSlabCache( cache, i, cache->numfree[i] );
+	}
+	cache->keyed = false;
+}
+
+/*
+* Mem_ThreadSlabCache
+*/
+static inline memslabcache_t *Mem_ThreadSlabCache( void )
+{
+	memslabcache_t *cache = &memSlabCache;
+
+	if( !cache->keyed )
+	{
+		Sys_ThreadKey_Set( memSlabCacheKey, cache );
+		cache->keyed = true;
+	}
+	return cache;
+}
+
+/*
+* Mem_SlabAlloc
+*/
+static void *Mem_SlabAlloc( int sizeclass )
+{
+	memslabcache_t *cache = Mem_ThreadSlabCache();
+	memslabblock_t *block;
+
+	if( !cache->free[sizeclass] )
+		Mem_RefillSlabCache( cache, sizeclass );
+
+	block = cache->free[sizeclass];
+	cache->free[sizeclass] = block->next;
+	cache->numfree[sizeclass]--;
+	return block;
+}
+
+/*
+* Mem_SlabFree
+*/
+static void Mem_SlabFree( void *base, int sizeclass )
+{
+	memslabcache_t *cache = Mem_ThreadSlabCache();
+	memslabblock_t *block = ( memslabblock_t * )base;
+	int limit;
+
+	block->next = cache->free[sizeclass];
+	cache->free[sizeclass] = block;
+	cache->numfree[sizeclass]++;
+
+	limit = Mem_SlabCacheLimit( sizeclass );
+	if( cache->numfree[sizeclass] > limit )
+		Mem_FlushSlabCache( cache, sizeclass, limit / 2 );
+}
+
+/*
+* Mem_InitSlabs
+*/
+static void Mem_InitSlabs( void )
+{
+	int i, sizeclass;
+
+	// without a way to release the caches of exiting threads, stick to the heap
+	if( !memSlabCacheKey && Sys_ThreadKey_Create( &memSlabCacheKey, Mem_ReleaseSlabCache ) != 0 )
+	{
+		memSlabCacheKey = NULL;
+		memSlabsEnabled = false;
+		return;
+	}
+
+	for( i = 0, sizeclass = 0; i <= MEMSLAB_MAX_BLOCK_SIZE / MEMALIGNMENT_DEFAULT; i++ )
+	{
+		while( memSlabClassSizes[sizeclass] < (size_t)i * MEMALIGNMENT_DEFAULT )
+			sizeclass++;
+		memSlabClassForSize[i] = sizeclass;
+	}
+}
+
+/*
+* Mem_FreeSlabs
+*/
+static void Mem_FreeSlabs( void )
+{
+	void *slab, *next;
+
+	for( slab = memSlabs; slab; slab = next )
+	{
+		next = *( void ** )slab;
+		free( slab );
+	}
+
+	memSlabs = NULL;
+	memNumSlabs = 0;
+	memset( memSlabDepot, 0, sizeof( memSlabDepot ) );
+	memset( memSlabDepotCount, 0, sizeof( memSlabDepotCount ) );
+	memset( &memSlabCache, 0, sizeof( memSlabCache ) );
+}
+
 void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t alignment, int z, int musthave, int canthave, const char *filename, int fileline )
 {
 	void *base;
 	size_t realsize;
+	int sizeclass;
 	memheader_t *mem;
 
 	if( size <= 0 )
@@ -153,16 +404,21 @@ void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t alignment, int z, int
 	if( developerMemory && developerMemory->integer )
 		Com_DPrintf( "Mem_Alloc: pool %s, file %s:%i, size %i bytes\n", pool->name, filename, fileline, size );
 
-	QMutex_Lock( memMutex );
-
-	pool->totalsize += size;
 	realsize = sizeof( memheader_t ) + size + alignment + sizeof( int );
 
-	pool->realsize += realsize;
-
-	base = malloc( realsize );
-	if( base == NULL )
-		_Mem_Error( "Mem_Alloc: out of memory (alloc at %s:%i)", filename, fileline );
+	if( memSlabsEnabled && alignment <= MEMALIGNMENT_DEFAULT && realsize <= MEMSLAB_MAX_BLOCK_SIZE )
+	{
+		sizeclass = memSlabClassForSize[( realsize + MEMALIGNMENT_DEFAULT - 1 ) / MEMALIGNMENT_DEFAULT];
+		realsize = memSlabClassSizes[sizeclass];
+		base = Mem_SlabAlloc( sizeclass );
+	}
+	else
+	{
+		sizeclass = -1;
+		base = malloc( realsize );
+		if( base == NULL )
+			_Mem_Error( "Mem_Alloc: out of memory (alloc at %s:%i)", filename, fileline );
+	}
 
 	// calculate address that aligns the end of the memheader_t to the specified alignment
 	mem = ( memheader_t * )((((size_t)base + sizeof( memheader_t ) + (alignment-1)) & ~(alignment-1)) - sizeof( memheader_t ));
@@ -171,12 +427,18 @@ void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t alignment, int z, int
 	mem->fileline = fileline;
 	mem->size = size;
 	mem->realsize = realsize;
+	mem->sizeclass = sizeclass;
 	mem->pool = pool;
 	mem->sentinel1 = MEMHEADER_SENTINEL1;
 
 	// we have to use only a single byte for this sentinel, because it may not be aligned, and some platforms can't use unaligned accesses
 	*( (uint8_t *) mem + sizeof( memheader_t ) + mem->size ) = MEMHEADER_SENTINEL2;
 
+	QMutex_Lock( pool->mutex );
+
+	pool->totalsize += size;
+	pool->realsize += realsize;
+
 	// append to head of list
 	mem->next = pool->chain;
 	mem->prev = NULL;
@@ -184,7 +446,7 @@ void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t alignment, int z, int
 	if( mem->next )
 		mem->next->prev = mem;
 
-	QMutex_Unlock( memMutex );
+	QMutex_Unlock( pool->mutex );
 
 	if( z )
 		memset( (void *)( (uint8_t *) mem + sizeof( memheader_t ) ), 0, mem->size );
@@ -238,6 +500,7 @@ char *_Mem_CopyString( mempool_t *pool, const char *in, const char *filename, in
 void _Mem_Free( void *data, int musthave, int canthave, const char *filename, int fileline )
 {
 	void *base;
+	int sizeclass;
 	memheader_t *mem;
 	mempool_t *pool;
 
@@ -264,11 +527,14 @@ void _Mem_Free( void *data, int musthave, int canthave, const char *filename, in
 	if( developerMemory && developerMemory->integer )
 		Com_DPrintf( "Mem_Free: pool %s, alloc %s:%i, free %s:%i, size %i bytes\n", pool->name, mem->filename, mem->fileline, filename, fileline, mem->size );
 
-	QMutex_Lock( memMutex );
+	QMutex_Lock( pool->mutex );
 
 	// unlink memheader from doubly linked list
 	if( ( mem->prev ? mem->prev->next != mem : pool->chain != mem ) || ( mem->next && mem->next->prev != mem ) )
+	{
+		QMutex_Unlock( pool->mutex );
 		_Mem_Error( "Mem_Free: not allocated or double freed (free at %s:%i)", filename, fileline );
+	}
 
 	if( mem->prev )
 		mem->prev->next = mem->next;
@@ -281,15 +547,19 @@ void _Mem_Free( void *data, int musthave, int canthave, const char *filename, in
 	pool->totalsize -= mem->size;
 
 	base = mem->baseaddress;
+	sizeclass = mem->sizeclass;
 	pool->realsize -= mem->realsize;
 
-	QMutex_Unlock( memMutex );
+	QMutex_Unlock( pool->mutex );
 
 #ifdef MEMTRASH
 	memset( mem, 0xBF, sizeof( memheader_t ) + mem->size + sizeof( int ) );
 #endif
 
-	free( base );
+	if( sizeclass >= 0 )
+		Mem_SlabFree( base, sizeclass );
+	else
+		free( base );
 }
 
 mempool_t *_Mem_AllocPool( mempool_t *parent, const char *name, int flags, const char *filename, int fileline )
@@ -316,8 +586,11 @@ mempool_t *_Mem_AllocPool( mempool_t *parent, const char *name, int flags, const
 	pool->child = NULL;
 	pool->totalsize = 0;
 	pool->realsize = sizeof( mempool_t );
+	pool->mutex = QMutex_Create();
 	Q_strncpyz( pool->name, name, sizeof( pool->name ) );
 
+	QMutex_Lock( memMutex );
+
 	if( parent )
 	{
 		pool->next = parent->child;
@@ -329,6 +602,8 @@ mempool_t *_Mem_AllocPool( mempool_t *parent, const char *name, int flags, const
 		poolChain = pool;
 	}
 
+	QMutex_Unlock( memMutex );
+
 	return pool;
 }
 
@@ -382,18 +657,27 @@ void _Mem_FreePool( mempool_t **pool, int musthave, int canthave, const char *fi
 #endif
 
 	// unlink pool from chain
+	QMutex_Lock( memMutex );
+
 	if( ( *pool )->parent )
 		for( chainAddress = &( *pool )->parent->child; *chainAddress && *chainAddress != *pool; chainAddress = &( ( *chainAddress )->next ) ) ;
 	else
 		for( chainAddress = &poolChain; *chainAddress && *chainAddress != *pool; chainAddress = &( ( *chainAddress )->next ) ) ;
 
 	if( *chainAddress != *pool )
+	{
+		QMutex_Unlock( memMutex );
 		_Mem_Error( "Mem_FreePool: pool already free (freepool at %s:%i)", filename, fileline );
+	}
+
+	*chainAddress = ( *pool )->next;
+
+	QMutex_Unlock( memMutex );
 
 	while( ( *pool )->chain )  // free memory owned by the pool
 		Mem_Free( (void *)( (uint8_t *)( *pool )->chain + sizeof( memheader_t ) ) );
 
-	*chainAddress = ( *pool )->next;
+	QMutex_Destroy( &( *pool )->mutex );
 
 	// free the pool itself
 #ifdef MEMTRASH
@@ -541,6 +825,7 @@ static void Mem_PrintStats( void )
 
 	Com_Printf( "%i memory pools, totalling %i bytes (%.3fMB), %i bytes (%.3fMB) actual\n", total, totalsize, totalsize / 1048576.0,
 		realsize, realsize / 1048576.0 );
+	Com_Printf( "%i small block slabs (%.3fMB)\n", memNumSlabs, memNumSlabs * MEMSLAB_SIZE / 1048576.0 );
 
 	// temporary pools are not nested
 	for( pool = poolChain; pool; pool = pool->next )
@@ -654,6 +939,119 @@ static void MemStats_f( void )
 	Mem_PrintStats();
 }
 
+#define MEMBENCH_LIVE_BLOCKS	256
+
+typedef struct
+{
+	mempool_t *pool;
+	int iterations;
+	unsigned int seed;
+} membenchthread_t;
+
+/*
+* Mem_BenchThread
+*/
+static void *Mem_BenchThread( void *param )
+{
+	membenchthread_t *bench = ( membenchthread_t * )param;
+	void *blocks[MEMBENCH_LIVE_BLOCKS];
+	unsigned int seed = bench->seed;
+	int i, j;
+
+	memset( blocks, 0, sizeof( blocks ) );
+
+	for( i = 0; i < bench->iterations; i++ )
+	{
+		seed = seed * 1103515245 + 12345;
+		j = ( seed >> 8 ) % MEMBENCH_LIVE_BLOCKS;
+		if( blocks[j] )
+			Mem_Free( blocks[j] );
+		blocks[j] = Mem_Alloc( bench->pool, 8 + ( ( seed >> 16 ) % 512 ) );
+	}
+
+	for( j = 0; j < MEMBENCH_LIVE_BLOCKS; j++ )
+	{
+		if( blocks[j] )
+			Mem_Free( blocks[j] );
+	}
+
+	return NULL;
+}
+
+/*
+* Mem_RunBench
+*/
+static double Mem_RunBench( int numThreads, int iterations, bool sharedPool )
+{
+	int i;
+	uint64_t start, time;
+	membenchthread_t bench[8];
+	qthread_t *threads[8];
+	mempool_t *pools[8];
+
+	for( i = 0; i < numThreads; i++ )
+	{
+		pools[i] = ( sharedPool && i ) ? pools[0] : Mem_AllocPool( NULL, "Memory Benchmark" );
+		bench[i].pool = pools[i];
+		bench[i].iterations = iterations;
+		bench[i].seed = i + 1;
+	}
+
+	start = Sys_Microseconds();
+	for( i = 0; i < numThreads; i++ )
+		threads[i] = QThread_Create( Mem_BenchThread, &bench[i] );
+	for( i = 0; i < numThreads; i++ )
+		QThread_Join( threads[i] );
+	time = Sys_Microseconds() - start;
+
+	for( i = 0; i < numThreads; i++ )
+	{
+		if( !sharedPool || !i )
+			Mem_FreePool( &pools[i] );
+	}
+
+	// alloc/free pairs per second
+	return (double)numThreads * iterations * 1000000.0 / max( time, 1 );
+}
+
+/*
+* MemBench_f
+*/
+static void MemBench_f( void )
+{
+	static const int numThreads[] = { 1, 4, 8 };
+	int i, iterations;
+	double heap, slabs, heapShared, slabsShared;
+
+	iterations = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 1000000;
+	if( iterations <= 0 )
+	{
+		Com_Printf( "Usage: %s [iterations]\n", Cmd_Argv( 0 ) );
+		return;
+	}
+
+	if( !memSlabCacheKey )
+	{
+		Com_Printf( "Slab caches are not supported on this system\n" );
+		return;
+	}
+
+	Com_Printf( "alloc/free pairs per second, %i per thread:\n", iterations );
+	Com_Printf( "threads       heap      slabs  heap/shared slabs/shared\n" );
+
+	for( i = 0; i < (int)( sizeof( numThreads ) / sizeof( numThreads[0] ) ); i++ )
+	{
+		memSlabsEnabled = false;
+		heap = Mem_RunBench( numThreads[i], iterations, false );
+		heapShared = Mem_RunBench( numThreads[i], iterations, true );
+		memSlabsEnabled = true;
+		slabs = Mem_RunBench( numThreads[i], iterations, false );
+		slabsShared = Mem_RunBench( numThreads[i], iterations, true );
+
+		Com_Printf( "%7i %10.0f %10.0f %12.0f %12.0f\n", numThreads[i], heap, slabs, heapShared, slabsShared );
+	}
+}
+
 
 /*
 * Memory_Init
@@ -664,6 +1062,8 @@ void Memory_Init( void )
 
 	memMutex = QMutex_Create();
 
+	Mem_InitSlabs();
+
 	zoneMemPool = Mem_AllocPool( NULL, "Zone" );
 	tempMemPool = Mem_AllocTempPool( "Temporary Memory" );
 
@@ -681,6 +1081,7 @@ void Memory_InitCommands( void )
 
 	Cmd_AddCommand( "memlist", MemList_f );
 	Cmd_AddCommand( "memstats", MemStats_f );
+	Cmd_AddCommand( "membench", MemBench_f );
 
 	commands_initialized = true;
 }
@@ -716,6 +1117,8 @@ void Memory_Shutdown( void )
 		Mem_FreePool( &pool );
 	}
 
+	Mem_FreeSlabs();
+
 	QMutex_Destroy( &memMutex );
 
 	memory_initialized = false;
@@ -731,4 +1134,5 @@ void Memory_ShutdownCommands( void )
 
 	Cmd_RemoveCommand( "memlist" );
 	Cmd_RemoveCommand( "memstats" );
+	Cmd_RemoveCommand( "membench" );
 }
@@ -43,6 +43,7 @@ void MSG_Clear( msg_t *msg )
 {
 	msg->cursize = 0;
 	msg->compressed = false;
+	msg->bit = 0;
 }
 
 void *MSG_GetSpace( msg_t *msg, size_t length )
@@ -157,6 +158,7 @@ void MSG_WriteString( msg_t *msg, const char *s )
 void MSG_BeginReading( msg_t *msg )
 {
 	msg->readcount = 0;
+	msg->bit = 0;
 }
 
 int MSG_ReadChar( msg_t *msg )
@@ -280,32 +282,116 @@ char *MSG_ReadStringLine( msg_t *msg )
 	return MSG_ReadString2( msg, true );
 }
 
+//==================================================
+// BIT FUNCTIONS
+// Blocks of bits are closed by MSG_FlushBits when
+// writing, and MSG_AlignBits when reading
+//==================================================
+
+void MSG_WriteBits( msg_t *msg, unsigned int value, int numbits )
+{
+	uint8_t *buf;
+	int count;
+
+	assert( numbits > 0 && numbits <= 32 );
+
+	while( numbits > 0 )
+	{
+		if( !msg->bit )
+		{
+			buf = ( uint8_t* )MSG_GetSpace( msg, 1 );
+			buf[0] = 0;
+		}
+
+		count = min( 8 - msg->bit, numbits );
+		msg->data[msg->cursize - 1] |= ( value & ( ( 1u << count ) - 1 ) ) << msg->bit;
+		value >>= count;
+		numbits -= count;
+		msg->bit = ( msg->bit + count ) & 7;
+	}
+}
+
+void MSG_FlushBits( msg_t *msg )
+{
+	msg->bit = 0;
+}
+
+unsigned int MSG_ReadBits( msg_t *msg, int numbits )
+{
+	unsigned int value = 0;
+	int count, shift = 0;
+
+	assert( numbits > 0 && numbits <= 32 );
+
+	while( numbits > 0 )
+	{
+		if( msg->readcount >= msg->cursize )
+		{
+			msg->readcount = msg->cursize + 1;
+			return 0;
+		}
+
+		count = min( 8 - msg->bit, numbits );
+		value |= ( ( msg->data[msg->readcount] >> msg->bit ) & ( ( 1u << count ) - 1 ) ) << shift;
+		shift += count;
+		numbits -= count;
+
+		msg->bit += count;
+		if( msg->bit == 8 )
+		{
+			msg->bit = 0;
+			msg->readcount++;
+		}
+	}
+
+	return value;
+}
+
+int MSG_ReadSignedBits( msg_t *msg, int numbits )
+{
+	unsigned int value = MSG_ReadBits( msg, numbits );
+
+	if( numbits < 32 && ( value & ( 1u << ( numbits - 1 ) ) ) )
+		value |= ~0u << numbits;
+	return (int)value;
+}
+
+void MSG_AlignBits( msg_t *msg )
+{
+	if( msg->bit )
+	{
+		msg->bit = 0;
+		msg->readcount++;
+	}
+}
+
 //==================================================
 // SPECIAL CASES
 //==================================================
 
 /*
-* MSG_WriteDeltaEntity
-* 
-* Writes part of a packetentities message.
-* Can delta from either a baseline or a previous packet_entity
+* MSG_CheckEntityNumber
 */
-void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, msg_t *msg, bool force, bool updateOtherOrigin )
+static void MSG_CheckEntityNumber( const entity_state_t *to )
 {
-	int bits;
-
 	if( !to->number )
 		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Unset entity number" );
 	else if( to->number >= MAX_EDICTS )
 		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Entity number >= MAX_EDICTS" );
 	else if( to->number < 0 )
 		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Invalid Entity number" );
+}
 
-	// send an update
-	bits = 0;
+/*
+* MSG_DeltaEntityBits
+* 
+* Returns the U_* bits of the fields that differ, without the header bits
+*/
+static int MSG_DeltaEntityBits( const entity_state_t *from, const entity_state_t *to, bool updateOtherOrigin )
+{
+	int bits;
 
-	if( to->number & 0xFF00 )
-		bits |= U_NUMBER16; // number8 is implicit otherwise
+	bits = 0;
 
 	if( to->linearMovement )
 	{
@@ -403,6 +489,27 @@ void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, msg_t *msg,
 	if( to->team != from->team )
 		bits |= U_TEAM;
 
+	return bits;
+}
+
+/*
+* MSG_WriteDeltaEntity
+* 
+* Writes part of a packetentities message.
+* Can delta from either a baseline or a previous packet_entity
+*/
+void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, msg_t *msg, bool force, bool updateOtherOrigin )
+{
+	int bits;
+
+	MSG_CheckEntityNumber( to );
+
+	// send an update
+	bits = MSG_DeltaEntityBits( from, to, updateOtherOrigin );
+
+	if( to->number & 0xFF00 )
+		bits |= U_NUMBER16; // number8 is implicit otherwise
+
 	//
 	// write the message
 	//
@@ -761,6 +868,459 @@ void MSG_ReadDeltaEntity( msg_t *msg, entity_state_t *from, entity_state_t *to,
 }
 
 
+//==================================================
+// BIT-PACKED SNAPSHOTS
+//==================================================
+
+#define MSG_ENTNUM_BITS			10		// MAX_EDICTS
+#define MSG_ENTNUM_GAP_BITS		3		// following entity numbers up to 8 apart
+
+#define MSG_COORD_MIN_BITS		12
+#define MSG_COORD_DELTA_BITS	9		// +-16 units
+#define MSG_COORD_DELTA2_BITS	14		// +-512 units
+
+#define MSG_FitsSignedBits( v, numbits ) ( ( v ) >= -( 1 << ( ( numbits ) - 1 ) ) && ( v ) < ( 1 << ( ( numbits ) - 1 ) ) )
+
+/*
+* MSG_CoordBitsForBounds
+* 
+* Returns the size of the coordinates able to address every point of the map
+*/
+int MSG_CoordBitsForBounds( const vec3_t mins, const vec3_t maxs )
+{
+	int i, bits;
+	float extent = 0;
+
+	for( i = 0; i < 3; i++ )
+	{
+		extent = max( extent, fabs( mins[i] ) );
+		extent = max( extent, fabs( maxs[i] ) );
+	}
+
+	// the sign bit and a small margin for the entities leaving the world
+	for( bits = MSG_COORD_MIN_BITS; bits < MSG_COORD_BITS; bits++ )
+	{
+		if( ( extent + 256 ) * PM_VECTOR_SNAP < (float)( 1 << ( bits - 1 ) ) )
+			break;
+	}
+
+	return bits;
+}
+
+/*
+* MSG_WriteDeltaCoordPacked
+* 
+* Writes a coordinate quantized to 1/PM_VECTOR_SNAP units. Small changes are
+* sent as a difference to the previous value, everything else as an absolute
+* value sized to the map bounds, or the full range if it's outside of them.
+*/
+void MSG_WriteDeltaCoordPacked( msg_t *msg, int from, int to, bool delta, int coordBits )
+{
+	int d;
+
+	if( delta )
+	{
+		d = to - from;
+		if( MSG_FitsSignedBits( d, MSG_COORD_DELTA_BITS ) )
+		{
+			MSG_WriteBits( msg, 0, 1 );
+			MSG_WriteBits( msg, (unsigned int)d, MSG_COORD_DELTA_BITS );
+			return;
+		}
+
+		MSG_WriteBits( msg, 1, 1 );
+		if( MSG_FitsSignedBits( d, MSG_COORD_DELTA2_BITS ) )
+		{
+			MSG_WriteBits( msg, 0, 1 );
+			MSG_WriteBits( msg, (unsigned int)d, MSG_COORD_DELTA2_BITS );
+			return;
+		}
+		MSG_WriteBits( msg, 1, 1 );
+	}
+
+	if( MSG_FitsSignedBits( to, coordBits ) )
+	{
+		MSG_WriteBits( msg, 1, 1 );
+		MSG_WriteBits( msg, (unsigned int)to, coordBits );
+	}
+	else
+	{
+		MSG_WriteBits( msg, 0, 1 );
+		MSG_WriteBits( msg, (unsigned int)to, MSG_COORD_BITS );
+	}
+}
+
+/*
+* MSG_ReadDeltaCoordPacked
+*/
+int MSG_ReadDeltaCoordPacked( msg_t *msg, int from, bool delta, int coordBits )
+{
+	if( delta )
+	{
+		if( !MSG_ReadBits( msg, 1 ) )
+			return from + MSG_ReadSignedBits( msg, MSG_COORD_DELTA_BITS );
+		if( !MSG_ReadBits( msg, 1 ) )
+			return from + MSG_ReadSignedBits( msg, MSG_COORD_DELTA2_BITS );
+	}
+
+	if( MSG_ReadBits( msg, 1 ) )
+		return MSG_ReadSignedBits( msg, coordBits );
+	return MSG_ReadSignedBits( msg, MSG_COORD_BITS );
+}
+
+/*
+* MSG_WriteEntityNumberPacked
+*/
+static void MSG_WriteEntityNumberPacked( msg_packing_t *packing, msg_t *msg, int number )
+{
+	int gap = number - packing->lastNumber;
+
+	if( number && gap > 0 && gap <= ( 1 << MSG_ENTNUM_GAP_BITS ) )
+	{
+		MSG_WriteBits( msg, 1, 1 );
+		MSG_WriteBits( msg, gap - 1, MSG_ENTNUM_GAP_BITS );
+	}
+	else
+	{
+		MSG_WriteBits( msg, 0, 1 );
+		MSG_WriteBits( msg, number, MSG_ENTNUM_BITS );
+	}
+
+	packing->lastNumber = number;
+}
+
+/*
+* MSG_WriteSmallPacked
+* 
+* Values that usually fit a byte
+*/
+static void MSG_WriteSmallPacked( msg_t *msg, int value )
+{
+	if( value >= 0 && value < 256 )
+	{
+		MSG_WriteBits( msg, 0, 1 );
+		MSG_WriteBits( msg, value, 8 );
+	}
+	else
+	{
+		MSG_WriteBits( msg, 1, 1 );
+		MSG_WriteBits( msg, value, 16 );
+	}
+}
+
+static int MSG_ReadSmallPacked( msg_t *msg )
+{
+	if( !MSG_ReadBits( msg, 1 ) )
+		return MSG_ReadBits( msg, 8 );
+	return MSG_ReadSignedBits( msg, 16 );
+}
+
+/*
+* MSG_WriteDeltaEntityPacked
+* 
+* Bit-packed version of MSG_WriteDeltaEntity. The fields and the value ranges
+* are the same, coordinates are sent by MSG_WriteDeltaCoordPacked.
+*/
+void MSG_WriteDeltaEntityPacked( msg_packing_t *packing, entity_state_t *from, entity_state_t *to, msg_t *msg, bool force, bool updateOtherOrigin )
+{
+	int i, bits;
+	bool delta;
+
+	MSG_CheckEntityNumber( to );
+
+	bits = MSG_DeltaEntityBits( from, to, updateOtherOrigin );
+	if( !bits && !force )
+		return; // nothing to send!
+
+	MSG_WriteEntityNumberPacked( packing, msg, to->number );
+	MSG_WriteBits( msg, 0, 1 ); // not removed
+
+	// the common bits, U_ORIGIN1 to U_EVENT, then the rest if any
+	MSG_WriteBits( msg, bits & 63, 6 );
+	if( bits >> 9 )
+	{
+		MSG_WriteBits( msg, 1, 1 );
+		MSG_WriteBits( msg, bits >> 9, 22 );
+	}
+	else
+	{
+		MSG_WriteBits( msg, 0, 1 );
+	}
+
+	if( bits & U_TYPE )
+		MSG_WriteBits( msg, ( to->type & ~ET_INVERSE ) | ( to->linearMovement ? ET_INVERSE : 0 ), 8 );
+
+	if( bits & U_SOLID )
+		MSG_WriteBits( msg, to->solid, 16 );
+
+	if( bits & U_MODEL )
+		MSG_WriteSmallPacked( msg, to->modelindex );
+	if( bits & U_MODEL2 )
+		MSG_WriteSmallPacked( msg, to->modelindex2 );
+
+	if( bits & U_FRAME8 )
+		MSG_WriteBits( msg, to->frame, 8 );
+	else if( bits & U_FRAME16 )
+		MSG_WriteBits( msg, to->frame, 16 );
+
+	if( ( bits & U_SKIN8 ) && ( bits & U_SKIN16 ) )
+		MSG_WriteBits( msg, to->skinnum, 32 );
+	else if( bits & U_SKIN8 )
+		MSG_WriteBits( msg, to->skinnum, 8 );
+	else if( bits & U_SKIN16 )
+		MSG_WriteBits( msg, to->skinnum, 16 );
+
+	if( ( bits & ( U_EFFECTS8|U_EFFECTS16 ) ) == ( U_EFFECTS8|U_EFFECTS16 ) )
+		MSG_WriteBits( msg, to->effects, 32 );
+	else if( bits & U_EFFECTS8 )
+		MSG_WriteBits( msg, to->effects, 8 );
+	else if( bits & U_EFFECTS16 )
+		MSG_WriteBits( msg, to->effects, 16 );
+
+	// the client only has the previous value if it was sent as the same quantity
+	delta = ( to->linearMovement == from->linearMovement );
+	for( i = 0; i < 3; i++ )
+	{
+		if( !( bits & ( U_ORIGIN1 << i ) ) )
+			continue;
+
+		if( to->linearMovement )
+			MSG_WriteDeltaCoordPacked( msg, Q_rint( from->linearMovementVelocity[i]*PM_VECTOR_SNAP ), 
+				Q_rint( to->linearMovementVelocity[i]*PM_VECTOR_SNAP ), delta, packing->coordBits );
+		else
+			MSG_WriteDeltaCoordPacked( msg, Q_rint( from->origin[i]*PM_VECTOR_SNAP ), 
+				Q_rint( to->origin[i]*PM_VECTOR_SNAP ), delta, packing->coordBits );
+	}
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( !( bits & ( i == 2 ? U_ANGLE3 : U_ANGLE1 << i ) ) )
+			continue;
+
+		if( to->solid == SOLID_BMODEL )
+			MSG_WriteBits( msg, ANGLE2SHORT( to->angles[i] ), 16 );
+		else
+			MSG_WriteBits( msg, ANGLE2BYTE( to->angles[i] ), 8 );
+	}
+
+	if( bits & U_OTHERORIGIN )
+	{
+		for( i = 0; i < 3; i++ )
+			MSG_WriteDeltaCoordPacked( msg, 0, Q_rint( to->origin2[i]*PM_VECTOR_SNAP ), false, packing->coordBits );
+	}
+
+	if( bits & U_SOUND )
+		MSG_WriteBits( msg, (uint8_t)to->sound, 8 );
+
+	for( i = 0; i < 2; i++ )
+	{
+		if( !( bits & ( i ? U_EVENT2 : U_EVENT ) ) )
+			continue;
+
+		if( !to->eventParms[i] )
+		{
+			MSG_WriteBits( msg, (uint8_t)( to->events[i] & ~EV_INVERSE ), 8 );
+		}
+		else
+		{
+			MSG_WriteBits( msg, (uint8_t)( to->events[i] | EV_INVERSE ), 8 );
+			MSG_WriteBits( msg, (uint8_t)to->eventParms[i], 8 );
+		}
+	}
+
+	if( bits & U_ATTENUATION )
+		MSG_WriteBits( msg, (uint8_t)(to->attenuation * 16), 8 );
+
+	if( bits & U_WEAPON )
+		MSG_WriteBits( msg, ( to->weapon & ~0x80 ) | ( to->teleported ? 0x80 : 0 ), 8 );
+
+	if( bits & U_SVFLAGS )
+		MSG_WriteBits( msg, to->svflags, 16 );
+
+	if( bits & U_LIGHT )
+		MSG_WriteBits( msg, to->light, 32 );
+
+	if( bits & U_TEAM )
+		MSG_WriteBits( msg, to->team, 8 );
+}
+
+/*
+* MSG_WriteEntityRemovePacked
+*/
+void MSG_WriteEntityRemovePacked( msg_packing_t *packing, msg_t *msg, int number )
+{
+	MSG_WriteEntityNumberPacked( packing, msg, number );
+	MSG_WriteBits( msg, 1, 1 );
+}
+
+/*
+* MSG_WriteEntitiesEndPacked
+* 
+* Ends the packet entities with the number 0 and gets back to byte alignment
+*/
+void MSG_WriteEntitiesEndPacked( msg_packing_t *packing, msg_t *msg )
+{
+	MSG_WriteEntityNumberPacked( packing, msg, 0 );
+	MSG_FlushBits( msg );
+}
+
+/*
+* MSG_ReadEntityBitsPacked
+* 
+* Returns the entity number and the U_* bits, 0 at the end of the packet entities
+*/
+int MSG_ReadEntityBitsPacked( msg_packing_t *packing, msg_t *msg, unsigned *bits )
+{
+	int number;
+
+	*bits = 0;
+
+	if( MSG_ReadBits( msg, 1 ) )
+		number = packing->lastNumber + MSG_ReadBits( msg, MSG_ENTNUM_GAP_BITS ) + 1;
+	else
+		number = MSG_ReadBits( msg, MSG_ENTNUM_BITS );
+	packing->lastNumber = number;
+
+	if( !number )
+		return 0;
+
+	if( MSG_ReadBits( msg, 1 ) )
+	{
+		*bits = U_REMOVE;
+		return number;
+	}
+
+	*bits = MSG_ReadBits( msg, 6 );
+	if( MSG_ReadBits( msg, 1 ) )
+		*bits |= MSG_ReadBits( msg, 22 ) << 9;
+
+	return number;
+}
+
+/*
+* MSG_ReadDeltaEntityPacked
+*/
+void MSG_ReadDeltaEntityPacked( msg_packing_t *packing, msg_t *msg, entity_state_t *from, entity_state_t *to, int number, unsigned bits )
+{
+	int i, event;
+	bool delta;
+
+	// set everything to the state we are delta'ing from
+	*to = *from;
+
+	to->number = number;
+
+	if( bits & U_TYPE )
+	{
+		int ttype = MSG_ReadBits( msg, 8 );
+		to->type = ttype & ~ET_INVERSE;
+		to->linearMovement = ( ttype & ET_INVERSE ) ? true : false;
+	}
+
+	if( bits & U_SOLID )
+		to->solid = MSG_ReadSignedBits( msg, 16 );
+
+	if( bits & U_MODEL )
+		to->modelindex = MSG_ReadSmallPacked( msg );
+	if( bits & U_MODEL2 )
+		to->modelindex2 = MSG_ReadSmallPacked( msg );
+
+	if( bits & U_FRAME8 )
+		to->frame = MSG_ReadBits( msg, 8 );
+	if( bits & U_FRAME16 )
+		to->frame = MSG_ReadSignedBits( msg, 16 );
+
+	if( ( bits & U_SKIN8 ) && ( bits & U_SKIN16 ) )
+		to->skinnum = MSG_ReadBits( msg, 32 );
+	else if( bits & U_SKIN8 )
+		to->skinnum = MSG_ReadBits( msg, 8 );
+	else if( bits & U_SKIN16 )
+		to->skinnum = MSG_ReadSignedBits( msg, 16 );
+
+	if( ( bits & ( U_EFFECTS8|U_EFFECTS16 ) ) == ( U_EFFECTS8|U_EFFECTS16 ) )
+		to->effects = MSG_ReadBits( msg, 32 );
+	else if( bits & U_EFFECTS8 )
+		to->effects = MSG_ReadBits( msg, 8 );
+	else if( bits & U_EFFECTS16 )
+		to->effects = MSG_ReadSignedBits( msg, 16 );
+
+	delta = ( to->linearMovement == from->linearMovement );
+	for( i = 0; i < 3; i++ )
+	{
+		if( !( bits & ( U_ORIGIN1 << i ) ) )
+			continue;
+
+		if( to->linearMovement )
+			to->linearMovementVelocity[i] = (float)MSG_ReadDeltaCoordPacked( msg, 
+				Q_rint( from->linearMovementVelocity[i]*PM_VECTOR_SNAP ), delta, packing->coordBits )*( 1.0/PM_VECTOR_SNAP );
+		else
+			to->origin[i] = (float)MSG_ReadDeltaCoordPacked( msg, 
+				Q_rint( from->origin[i]*PM_VECTOR_SNAP ), delta, packing->coordBits )*( 1.0/PM_VECTOR_SNAP );
+	}
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( !( bits & ( i == 2 ? U_ANGLE3 : U_ANGLE1 << i ) ) )
+			continue;
+
+		if( to->solid == SOLID_BMODEL )
+			to->angles[i] = SHORT2ANGLE( MSG_ReadSignedBits( msg, 16 ) );
+		else
+			to->angles[i] = BYTE2ANGLE( MSG_ReadBits( msg, 8 ) );
+	}
+
+	if( bits & U_OTHERORIGIN )
+	{
+		for( i = 0; i < 3; i++ )
+			to->origin2[i] = (float)MSG_ReadDeltaCoordPacked( msg, 0, false, packing->coordBits )*( 1.0/PM_VECTOR_SNAP );
+	}
+
+	if( bits & U_SOUND )
+		to->sound = MSG_ReadBits( msg, 8 );
+
+	for( i = 0; i < 2; i++ )
+	{
+		if( bits & ( i ? U_EVENT2 : U_EVENT ) )
+		{
+			event = MSG_ReadBits( msg, 8 );
+			if( event & EV_INVERSE )
+				to->eventParms[i] = MSG_ReadBits( msg, 8 );
+			else
+				to->eventParms[i] = 0;
+			to->events[i] = ( event & ~EV_INVERSE );
+		}
+		else
+		{
+			to->events[i] = 0;
+			to->eventParms[i] = 0;
+		}
+	}
+
+	if( bits & U_ATTENUATION )
+		to->attenuation = (float)MSG_ReadBits( msg, 8 ) / 16.0;
+
+	if( bits & U_WEAPON )
+	{
+		int tweapon = MSG_ReadBits( msg, 8 );
+		to->weapon = tweapon & ~0x80;
+		to->teleported = ( tweapon & 0x80 ) ? true : false;
+	}
+
+	if( bits & U_SVFLAGS )
+		to->svflags = MSG_ReadSignedBits( msg, 16 );
+
+	if( bits & U_LIGHT )
+	{
+		if( to->linearMovement )
+			to->linearMovementTimeStamp = MSG_ReadBits( msg, 32 );
+		else
+			to->light = MSG_ReadBits( msg, 32 );
+	}
+
+	if( bits & U_TEAM )
+		to->team = MSG_ReadBits( msg, 8 );
+}
+
 void MSG_WriteDeltaUsercmd( msg_t *buf, usercmd_t *from, usercmd_t *cmd )
 {
 	int bits;
@@ -33,6 +33,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#if defined ( __linux__ )
+#include <sys/epoll.h>
+#define USE_EPOLL
+#endif
 #endif
 
 #define	MAX_LOOPBACK	4
@@ -63,6 +67,38 @@ typedef struct
 	int get, send;
 } loopback_t;
 
+/*
+* Batched UDP I/O: datagrams are received several at a time and outgoing ones
+* are queued until the owner flushes the socket, so that a server frame costs
+* a handful of system calls instead of one per client datagram. Sockets fall
+* back to recvfrom/sendto if the system doesn't support this. Since queued
+* datagrams are only sent on flush, a send failure is remembered with the
+* destination address and reported by the next NET_SendPacket call to it.
+*/
+#define NET_UDP_RECV_BATCH		16
+#define NET_UDP_SEND_BATCH		64
+#define NET_UDP_SEND_BUFSIZE	( NET_UDP_SEND_BATCH * MAX_PACKETLEN )
+
+typedef struct net_batch_s
+{
+	bool supported;
+
+	int numRecv, nextRecv;
+	net_datagram_t recv[NET_UDP_RECV_BATCH];
+	struct sockaddr_storage recvAddr[NET_UDP_RECV_BATCH];
+	uint8_t recvData[NET_UDP_RECV_BATCH][MAX_MSGLEN];
+
+	int numSend;
+	size_t sendSize;
+	net_datagram_t send[NET_UDP_SEND_BATCH];
+	struct sockaddr_storage sendAddr[NET_UDP_SEND_BATCH];
+	uint8_t sendData[NET_UDP_SEND_BUFSIZE];
+
+	int numFailed;
+	struct sockaddr_storage failedAddr[NET_UDP_SEND_BATCH];
+	char failedError[MAX_STRING_CHARS];
+} net_batch_t;
+
 static loopback_t loopbacks[2];
 static char errorstring[MAX_PRINTMSG];
 static bool	net_initialized = false;
@@ -337,6 +373,8 @@ static bool NET_SocketMakeNonBlocking( socket_handle_t handle )
 	return true;
 }
 
+static int NET_UDP_GetBatchedPacket( const socket_t *socket, netadr_t *address, msg_t *message );
+
 /*
 * NET_UDP_GetPacket
 */
@@ -352,6 +390,9 @@ static int NET_UDP_GetPacket( const socket_t *socket, netadr_t *address, msg_t *
 	assert( message->data );
 	assert( message->maxsize > 0 );
 
+	if( socket->batch && socket->batch->supported )
+		return NET_UDP_GetBatchedPacket( socket, address, message );
+
 	fromlen = sizeof( from );
 	ret = recvfrom( socket->handle, (char*)message->data, message->maxsize, 0, (struct sockaddr *)&from, &fromlen );
 	if( ret == SOCKET_ERROR )
@@ -382,13 +423,175 @@ static int NET_UDP_GetPacket( const socket_t *socket, netadr_t *address, msg_t *
 	return 1;
 }
 
+/*
+* NET_UDP_GetBatchedPacket
+*/
+static int NET_UDP_GetBatchedPacket( const socket_t *socket, netadr_t *address, msg_t *message )
+{
+	int ret;
+	net_batch_t *batch = socket->batch;
+	net_datagram_t *datagram;
+
+	if( batch->nextRecv >= batch->numRecv )
+	{
+		batch->numRecv = batch->nextRecv = 0;
+
+		ret = Sys_NET_RecvMultiple( socket->handle, batch->recv, NET_UDP_RECV_BATCH );
+		if( ret == SOCKET_ERROR )
+		{
+			net_error_t err;
+
+			NET_SetErrorStringFromLastError( "recvmmsg" );
+
+			err = Sys_NET_GetLastError();
+			if( err == NET_ERR_WOULDBLOCK || err == NET_ERR_CONNRESET )  // would block
+				return 0;
+
+			if( err == NET_ERR_UNSUPPORTED )
+			{
+				batch->supported = false;
+				return NET_UDP_GetPacket( socket, address, message );
+			}
+
+			return -1;
+		}
+
+		if( !ret )
+			return 0;
+		batch->numRecv = ret;
+	}
+
+	datagram = &batch->recv[batch->nextRecv++];
+
+	if( !SockaddressToAddress( (struct sockaddr *)datagram->addr, address ) )
+		return -1;
+
+	if( datagram->truncated || datagram->length >= message->maxsize )
+	{
+		NET_SetErrorString( "Oversized packet" );
+		return -1;
+	}
+
+	memcpy( message->data, datagram->data, datagram->length );
+	message->readcount = 0;
+	message->cursize = datagram->length;
+
+	return 1;
+}
+
+/*
+* NET_UDP_SendTo
+*/
+static bool NET_UDP_SendTo( const socket_t *socket, const void *data, size_t length, const struct sockaddr_storage *addr, socklen_t addrlen )
+{
+	if( sendto( socket->handle, data, length, 0, (const struct sockaddr *)addr, addrlen ) == SOCKET_ERROR )
+	{
+		NET_SetErrorStringFromLastError( "sendto" );
+		return false;
+	}
+
+	return true;
+}
+
+/*
+* NET_UDP_SendFailed
+*
+* Remembers the destination of a queued datagram the system refused
+*/
+static void NET_UDP_SendFailed( net_batch_t *batch, const net_datagram_t *datagram )
+{
+	int i;
+
+	Com_Printf( "NET_SendPacket: Error: %s\n", NET_ErrorString() );
+	Q_strncpyz( batch->failedError, NET_ErrorString(), sizeof( batch->failedError ) );
+
+	for( i = 0; i < batch->numFailed; i++ )
+	{
+		if( !memcmp( &batch->failedAddr[i], datagram->addr, datagram->addrlen ) )
+			return;
+	}
+	if( batch->numFailed < NET_UDP_SEND_BATCH )
+		memcpy( &batch->failedAddr[batch->numFailed++], datagram->addr, datagram->addrlen );
+}
+
+/*
+* NET_UDP_TakeSendFailure
+*
+* Returns true and forgets the failure if a datagram queued for the address was refused
+*/
+static bool NET_UDP_TakeSendFailure( net_batch_t *batch, const struct sockaddr_storage *addr, socklen_t addrlen )
+{
+	int i;
+
+	for( i = 0; i < batch->numFailed; i++ )
+	{
+		if( !memcmp( &batch->failedAddr[i], addr, addrlen ) )
+		{
+			batch->failedAddr[i] = batch->failedAddr[--batch->numFailed];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+* NET_UDP_FlushSocket
+*
+* Sends all queued datagrams, skipping the ones the system refuses
+*/
+static void NET_UDP_FlushSocket( const socket_t *socket )
+{
+	int ret, sent;
+	net_batch_t *batch = socket->batch;
+	net_datagram_t *datagram;
+
+	sent = 0;
+	while( sent < batch->numSend )
+	{
+		if( !batch->supported )
+		{
+			datagram = &batch->send[sent++];
+			if( !NET_UDP_SendTo( socket, datagram->data, datagram->length, datagram->addr, datagram->addrlen ) )
+				NET_UDP_SendFailed( batch, datagram );
+			continue;
+		}
+
+		ret = Sys_NET_SendMultiple( socket->handle, batch->send + sent, batch->numSend - sent );
+		if( ret == SOCKET_ERROR )
+		{
+			if( Sys_NET_GetLastError() == NET_ERR_UNSUPPORTED )
+			{
+				batch->supported = false;
+				continue;
+			}
+
+			// the first datagram is the one refused, skip it
+			NET_SetErrorStringFromLastError( "sendmmsg" );
+			NET_UDP_SendFailed( batch, &batch->send[sent] );
+			ret = 1;
+		}
+
+		sent += ret;
+	}
+
+	batch->numSend = 0;
+	batch->sendSize = 0;
+}
+
 /*
 * NET_UDP_SendPacket
+*
+* On batching sockets the datagram is queued and false is only returned
+* for an earlier datagram to the same address the system refused on flush
 */
 static bool NET_UDP_SendPacket( const socket_t *socket, const void *data, size_t length, const netadr_t *address )
 {
 	struct sockaddr_storage addr;
 	socklen_t addrlen;
+	net_batch_t *batch = socket->batch;
+	net_datagram_t *datagram;
+	bool failed;
 
 	assert( socket && socket->open && socket->type == SOCKET_UDP );
 	assert( data );
@@ -399,9 +602,33 @@ static bool NET_UDP_SendPacket( const socket_t *socket, const void *data, size_t
 		return false;
 
 	addrlen = ( addr.ss_family == AF_INET6 ? sizeof( struct sockaddr_in6 ) : sizeof( struct sockaddr_in ) );
-	if( sendto( socket->handle, data, length, 0, (struct sockaddr *)&addr, addrlen ) == SOCKET_ERROR )
+
+	if( !batch || length > NET_UDP_SEND_BUFSIZE )
 	{
-		NET_SetErrorStringFromLastError( "sendto" );
+		if( batch )
+			NET_UDP_FlushSocket( socket );
+		return NET_UDP_SendTo( socket, data, length, &addr, addrlen );
+	}
+
+	failed = batch->numFailed && NET_UDP_TakeSendFailure( batch, &addr, addrlen );
+
+	// queue it until the socket is flushed
+	if( batch->numSend == NET_UDP_SEND_BATCH || batch->sendSize + length > NET_UDP_SEND_BUFSIZE )
+		NET_UDP_FlushSocket( socket );
+
+	datagram = &batch->send[batch->numSend];
+	datagram->data = batch->sendData + batch->sendSize;
+	datagram->length = length;
+	datagram->addrlen = addrlen;
+	memcpy( datagram->data, data, length );
+	memcpy( datagram->addr, &addr, addrlen );
+
+	batch->numSend++;
+	batch->sendSize += length;
+
+	if( failed )
+	{
+		NET_SetErrorString( "%s", batch->failedError );
 		return false;
 	}
 
@@ -487,6 +714,7 @@ static bool NET_IP_OpenSocket( socket_t *sock, const netadr_t *address, socket_t
 	sock->address = *address;
 	sock->server = server;
 	sock->handle = newsocket;
+	sock->batch = NULL;
 
 	return true;
 }
@@ -501,11 +729,55 @@ static void NET_UDP_CloseSocket( socket_t *socket )
 	if( !socket->open )
 		return;
 
+	if( socket->batch )
+	{
+		NET_UDP_FlushSocket( socket );
+		Mem_ZoneFree( socket->batch );
+		socket->batch = NULL;
+	}
+
 	Sys_NET_SocketClose( socket->handle );
 	socket->handle = 0;
 	socket->open = false;
 }
 
+/*
+* NET_UDP_SetSocketBatching
+*/
+static bool NET_UDP_SetSocketBatching( socket_t *socket, bool enable )
+{
+	int i;
+	net_batch_t *batch;
+
+	if( !enable )
+	{
+		if( socket->batch )
+		{
+			NET_UDP_FlushSocket( socket );
+			Mem_ZoneFree( socket->batch );
+			socket->batch = NULL;
+		}
+		return true;
+	}
+
+	if( socket->batch )
+		return true;
+
+	batch = ( net_batch_t * )Mem_ZoneMalloc( sizeof( *batch ) );
+	batch->supported = true;
+	for( i = 0; i < NET_UDP_RECV_BATCH; i++ )
+	{
+		batch->recv[i].data = batch->recvData[i];
+		batch->recv[i].size = sizeof( batch->recvData[i] );
+		batch->recv[i].addr = &batch->recvAddr[i];
+	}
+	for( i = 0; i < NET_UDP_SEND_BATCH; i++ )
+		batch->send[i].addr = &batch->sendAddr[i];
+
+	socket->batch = batch;
+	return true;
+}
+
 //=============================================================================
 
 #ifdef TCP_SUPPORT
@@ -529,6 +801,13 @@ static int NET_TCP_Get( const socket_t *socket, netadr_t *address, void *data, s
 		return -1;
 	}
 
+	if( !ret )
+	{
+		// orderly shutdown, don't confuse it with no data being available
+		NET_SetErrorString( "Connection closed" );
+		return -1;
+	}
+
 	if( address )
 		*address = socket->remoteAddress;
 
@@ -1014,9 +1293,9 @@ int NET_GetPacket( const socket_t *socket, netadr_t *address, msg_t *message )
 /*
 * NET_Get
 * 
-* 1	ok
+* >0	number of bytes received
 * 0	no data ready
-* -1	error
+* -1	error or connection closed
 */
 int NET_Get( const socket_t *socket, netadr_t *address, void *data, size_t length )
 {
@@ -1769,6 +2048,40 @@ void NET_CloseSocket( socket_t *socket )
 	}
 }
 
+/*
+* NET_SetSocketBatching
+*
+* Lets an UDP socket receive several datagrams per system call and queue the
+* outgoing ones until NET_FlushSocket is called. The owner must flush the
+* socket at least once per frame.
+*/
+bool NET_SetSocketBatching( socket_t *socket, bool enable )
+{
+	if( !socket->open )
+		return false;
+
+	if( socket->type != SOCKET_UDP )
+	{
+		NET_SetErrorString( "Operation not supported by the socket type" );
+		return false;
+	}
+
+	return NET_UDP_SetSocketBatching( socket, enable );
+}
+
+/*
+* NET_FlushSocket
+*
+* Sends the datagrams queued on a batching socket
+*/
+void NET_FlushSocket( const socket_t *socket )
+{
+	if( !socket->open || socket->type != SOCKET_UDP || !socket->batch )
+		return;
+
+	NET_UDP_FlushSocket( socket );
+}
+
 /*
 * NET_SetSocketNoDelay
 */
@@ -1919,6 +2232,262 @@ int NET_Monitor( int msec, socket_t *sockets[], void (*read_cb)(socket_t *, void
 	return ret;
 }
 
+/*
+* Persistent socket monitors, for servers handling large numbers of connections.
+* Sockets are registered once instead of being passed on every call. On Linux
+* this is backed by edge-triggered epoll: read_cb is called when new data (or
+* a hangup) arrives and write_cb when the socket becomes writable again, so
+* the owner must remember the readiness until a read or write would block.
+* Other systems use select(), which reports readiness on every call and
+* limits the number of sockets to FD_SETSIZE.
+*/
+typedef struct
+{
+	socket_t *socket;
+	void *privatep;
+	int next;				// free list
+} net_monitor_entry_t;
+
+typedef struct net_monitor_s
+{
+	int maxsockets;
+	int numsockets;
+	int firstfree;
+	net_monitor_entry_t *entries;
+#ifdef USE_EPOLL
+	int epfd;
+	struct epoll_event *events;
+#endif
+} net_monitor_t;
+
+/*
+* NET_CreateMonitor
+*/
+net_monitor_t *NET_CreateMonitor( int maxsockets )
+{
+	int i;
+	net_monitor_t *monitor;
+
+#ifndef USE_EPOLL
+	clamp_high( maxsockets, FD_SETSIZE );
+#endif
+	if( maxsockets < 1 )
+		return NULL;
+
+	monitor = ( net_monitor_t * )Mem_ZoneMalloc( sizeof( *monitor ) );
+	monitor->maxsockets = maxsockets;
+	monitor->entries = ( net_monitor_entry_t * )Mem_ZoneMalloc( sizeof( *monitor->entries ) * maxsockets );
+	for( i = 0; i < maxsockets; i++ )
+		monitor->entries[i].next = i + 1 < maxsockets ? i + 1 : -1;
+	monitor->firstfree = 0;
+
+#ifdef USE_EPOLL
+	monitor->epfd = epoll_create( maxsockets );
+	if( monitor->epfd < 0 )
+	{
+		NET_SetErrorStringFromLastError( "epoll_create" );
+		Mem_ZoneFree( monitor->entries );
+		Mem_ZoneFree( monitor );
+		return NULL;
+	}
+	monitor->events = ( struct epoll_event * )Mem_ZoneMalloc( sizeof( *monitor->events ) * maxsockets );
+#endif
+
+	return monitor;
+}
+
+/*
+* NET_DestroyMonitor
+*/
+void NET_DestroyMonitor( net_monitor_t **pmonitor )
+{
+	net_monitor_t *monitor;
+
+	assert( pmonitor != NULL );
+	monitor = *pmonitor;
+	if( !monitor )
+		return;
+
+#ifdef USE_EPOLL
+	close( monitor->epfd );
+	Mem_ZoneFree( monitor->events );
+#endif
+	Mem_ZoneFree( monitor->entries );
+	Mem_ZoneFree( monitor );
+	*pmonitor = NULL;
+}
+
+/*
+* NET_MonitorAddSocket
+*
+* Returns the monitor slot for the socket, to be passed to NET_MonitorRemoveSocket,
+* or -1 if the socket couldn't be added. The socket must stay at the same address
+* while it is being monitored.
+*/
+int NET_MonitorAddSocket( net_monitor_t *monitor, socket_t *socket, void *privatep )
+{
+	int id;
+	net_monitor_entry_t *entry;
+
+	if( !socket->open || socket->type == SOCKET_LOOPBACK )
+	{
+		NET_SetErrorString( "Operation not supported by the socket type" );
+		return -1;
+	}
+
+	id = monitor->firstfree;
+	if( id < 0 )
+	{
+		NET_SetErrorString( "Too many monitored sockets" );
+		return -1;
+	}
+
+#ifdef USE_EPOLL
+	{
+		struct epoll_event ev;
+
+		memset( &ev, 0, sizeof( ev ) );
+		ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		ev.data.u32 = (uint32_t)id;
+		if( epoll_ctl( monitor->epfd, EPOLL_CTL_ADD, socket->handle, &ev ) < 0 )
+		{
+			NET_SetErrorStringFromLastError( "epoll_ctl" );
+			return -1;
+		}
+	}
+#elif !defined( _WIN32 )
+	if( socket->handle >= FD_SETSIZE )
+	{
+		NET_SetErrorString( "Too many monitored sockets" );
+		return -1;
+	}
+#endif
+
+	entry = &monitor->entries[id];
+	monitor->firstfree = entry->next;
+	entry->socket = socket;
+	entry->privatep = privatep;
+	entry->next = -1;
+	monitor->numsockets++;
+
+	return id;
+}
+
+/*
+* NET_MonitorRemoveSocket
+*
+* Must be called before the socket is closed
+*/
+void NET_MonitorRemoveSocket( net_monitor_t *monitor, int id )
+{
+	net_monitor_entry_t *entry;
+
+	if( id < 0 || id >= monitor->maxsockets )
+		return;
+
+	entry = &monitor->entries[id];
+	if( !entry->socket )
+		return;
+
+#ifdef USE_EPOLL
+	if( entry->socket->open )
+		epoll_ctl( monitor->epfd, EPOLL_CTL_DEL, entry->socket->handle, NULL );
+#endif
+
+	entry->socket = NULL;
+	entry->privatep = NULL;
+	entry->next = monitor->firstfree;
+	monitor->firstfree = id;
+	monitor->numsockets--;
+}
+
+/*
+* NET_MonitorWait
+*
+* Waits for up to msec milliseconds for events on the monitored sockets
+* and calls the callbacks for them, see NET_Monitor
+*/
+int NET_MonitorWait( net_monitor_t *monitor, int msec, void (*read_cb)(socket_t *, void*), void (*write_cb)(socket_t *, void*), void (*exception_cb)(socket_t *, void*) )
+{
+	int i, ret;
+	net_monitor_entry_t *entry;
+#ifdef USE_EPOLL
+	unsigned int events;
+
+	ret = epoll_wait( monitor->epfd, monitor->events, monitor->maxsockets, msec );
+	if( ret < 0 )
+	{
+		NET_SetErrorStringFromLastError( "epoll_wait" );
+		return ret;
+	}
+
+	for( i = 0; i < ret; i++ )
+	{
+		entry = &monitor->entries[monitor->events[i].data.u32];
+		events = monitor->events[i].events;
+
+		// a callback may remove other sockets from the monitor
+		if( !entry->socket || !entry->socket->open )
+			continue;
+
+		if( ( events & ( EPOLLERR | EPOLLHUP ) ) && exception_cb )
+			exception_cb( entry->socket, entry->privatep );
+		if( ( events & ( EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP ) ) && read_cb && entry->socket && entry->socket->open )
+			read_cb( entry->socket, entry->privatep );
+		if( ( events & EPOLLOUT ) && write_cb && entry->socket && entry->socket->open )
+			write_cb( entry->socket, entry->privatep );
+	}
+
+	return ret;
+#else
+	struct timeval timeout;
+	fd_set fdsetr, fdsetw, fdsete;
+	int fdmax = 0;
+
+	FD_ZERO( &fdsetr );
+	FD_ZERO( &fdsetw );
+	FD_ZERO( &fdsete );
+
+	for( i = 0, entry = monitor->entries; i < monitor->maxsockets; i++, entry++ )
+	{
+		if( !entry->socket || !entry->socket->open )
+			continue;
+
+		fdmax = max( (int)entry->socket->handle, fdmax );
+		FD_SET( entry->socket->handle, &fdsetr );
+		if( write_cb )
+			FD_SET( entry->socket->handle, &fdsetw );
+		if( exception_cb )
+			FD_SET( entry->socket->handle, &fdsete );
+	}
+
+	timeout.tv_sec = msec / 1000;
+	timeout.tv_usec = ( msec % 1000 ) * 1000;
+	ret = select( fdmax+1, &fdsetr, write_cb ? &fdsetw : NULL, exception_cb ? &fdsete : NULL, &timeout );
+	if( ret <= 0 )
+	{
+		if( ret < 0 )
+			NET_SetErrorStringFromLastError( "select" );
+		return ret;
+	}
+
+	for( i = 0, entry = monitor->entries; i < monitor->maxsockets; i++, entry++ )
+	{
+		if( !entry->socket || !entry->socket->open )
+			continue;
+
+		if( exception_cb && FD_ISSET( entry->socket->handle, &fdsete ) )
+			exception_cb( entry->socket, entry->privatep );
+		if( read_cb && entry->socket && entry->socket->open && FD_ISSET( entry->socket->handle, &fdsetr ) )
+			read_cb( entry->socket, entry->privatep );
+		if( write_cb && entry->socket && entry->socket->open && FD_ISSET( entry->socket->handle, &fdsetw ) )
+			write_cb( entry->socket, entry->privatep );
+	}
+
+	return ret;
+#endif
+}
+
 /*
 * NET_SendFile
 */
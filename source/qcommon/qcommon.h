@@ -49,6 +49,8 @@ struct client_s;
 struct cmodel_state_s;
 struct client_entities_s;
 struct fatvis_s;
+struct snap_viscache_s;
+struct snap_enccache_s;
 
 //============================================================================
 
@@ -59,6 +61,7 @@ typedef struct
 	size_t cursize;
 	size_t readcount;
 	bool compressed;
+	int bit;					// position inside the current byte of MSG_WriteBits/MSG_ReadBits
 } msg_t;
 
 // msg.c
@@ -113,6 +116,29 @@ void MSG_ReadDir( msg_t *sb, vec3_t vector );
 void MSG_ReadData( msg_t *sb, void *buffer, size_t length );
 int MSG_SkipData( msg_t *sb, size_t length );
 
+// bit-packed snapshots, see FRAMESNAP_FLAG_BITPACKED
+#define MSG_COORD_BITS		24		// the full range of MSG_WriteCoord
+
+typedef struct
+{
+	int coordBits;				// size of the absolute coordinates, from the map bounds
+	int lastNumber;				// entity numbers are sent as the distance to the previous one
+} msg_packing_t;
+
+void MSG_WriteBits( msg_t *msg, unsigned int value, int numbits );
+void MSG_FlushBits( msg_t *msg );
+unsigned int MSG_ReadBits( msg_t *msg, int numbits );
+int MSG_ReadSignedBits( msg_t *msg, int numbits );
+void MSG_AlignBits( msg_t *msg );
+int MSG_CoordBitsForBounds( const vec3_t mins, const vec3_t maxs );
+void MSG_WriteDeltaCoordPacked( msg_t *msg, int from, int to, bool delta, int coordBits );
+int MSG_ReadDeltaCoordPacked( msg_t *msg, int from, bool delta, int coordBits );
+void MSG_WriteDeltaEntityPacked( msg_packing_t *packing, struct entity_state_s *from, struct entity_state_s *to, msg_t *msg, bool force, bool updateOtherOrigin );
+void MSG_WriteEntityRemovePacked( msg_packing_t *packing, msg_t *msg, int number );
+void MSG_WriteEntitiesEndPacked( msg_packing_t *packing, msg_t *msg );
+int MSG_ReadEntityBitsPacked( msg_packing_t *packing, msg_t *msg, unsigned *bits );
+void MSG_ReadDeltaEntityPacked( msg_packing_t *packing, msg_t *msg, entity_state_t *from, entity_state_t *to, int number, unsigned bits );
+
 //============================================================================
 
 typedef struct purelist_s
@@ -137,21 +163,53 @@ void Com_FreePureList( purelist_t **purelist );
 // define this 0 to disable compression of demo files
 #define SNAP_DEMO_GZ					FS_GZ
 
+#define SNAP_DEMO_KEYFRAME_INTERVAL		10000	// msecs between non-delta frames in demos
+#define SNAP_MAX_DEMO_KEYFRAMES			512
+
+typedef struct
+{
+	unsigned int time;				// msecs since the start of the demo
+	int offset;						// position of the keyframe in the uncompressed demo
+} snap_demokeyframe_t;
+
+// the seek index is stored in the demo meta data under the "keyframes" key
+typedef struct
+{
+	unsigned int interval;
+	unsigned int numKeyframes;
+	snap_demokeyframe_t keyframes[SNAP_MAX_DEMO_KEYFRAMES];
+	uint8_t configstrings[( MAX_CONFIGSTRINGS + 7 ) / 8];	// configstrings ever written by a keyframe
+} snap_demoseekindex_t;
+
 void SNAP_ParseBaseline( msg_t *msg, entity_state_t *baselines );
 void SNAP_SkipFrame( msg_t *msg, struct snapshot_s *header );
 struct snapshot_s *SNAP_ParseFrame( msg_t *msg, struct snapshot_s *lastFrame, int *suppressCount, struct snapshot_s *backup, entity_state_t *baselines, int showNet );
 
 void SNAP_WriteFrameSnapToClient( struct ginfo_s *gi, struct client_s *client, msg_t *msg, unsigned int frameNum, unsigned int gameTime,
-								 entity_state_t *baselines, struct client_entities_s *client_entities,
+								 entity_state_t *baselines, struct client_entities_s *client_entities, struct snap_enccache_s *enccache,
 								 int numcmds, gcommand_t *commands, const char *commandsData );
 
 void SNAP_BuildClientFrameSnap( struct cmodel_state_s *cms, struct ginfo_s *gi, unsigned int frameNum, unsigned int timeStamp,
-							   struct fatvis_s *fatvis, struct client_s *client, 
+							   struct fatvis_s *fatvis, struct snap_viscache_s *viscache, struct client_s *client, 
 							   game_state_t *gameState, struct client_entities_s *client_entities,
 							   bool relay, struct mempool_s *mempool );
 
+struct snap_viscache_s *SNAP_CreateVisCache( struct mempool_s *mempool );
+void SNAP_DestroyVisCache( struct snap_viscache_s **pcache );
+
+struct snap_enccache_s *SNAP_CreateEncodeCache( struct mempool_s *mempool );
+void SNAP_DestroyEncodeCache( struct snap_enccache_s **pcache );
+
 void SNAP_FreeClientFrames( struct client_s *client );
 
+typedef struct
+{
+	size_t pending, maxPending;		// bytes queued but not written yet
+	unsigned int numWrites;
+	unsigned int lastLatency, avgLatency, maxLatency;	// msecs from queueing to written
+	unsigned int maxStall;			// msecs the recording thread waited for buffer space
+} snap_demowriterstats_t;
+
 void SNAP_RecordDemoMessage( int demofile, msg_t *msg, int offset );
 int SNAP_ReadDemoMessage( int demofile, msg_t *msg );
 void SNAP_BeginDemoRecording( int demofile, unsigned int spawncount, unsigned int snapFrameTime, 
@@ -163,6 +221,16 @@ size_t SNAP_ClearDemoMeta( char *meta_data, size_t meta_data_max_size );
 size_t SNAP_SetDemoMetaKeyValue( char *meta_data, size_t meta_data_max_size, size_t meta_data_realsize,
 							  const char *key, const char *value );
 size_t SNAP_ReadDemoMetaData( int demofile, char *meta_data, size_t meta_data_size );
+void SNAP_ClearDemoSeekIndex( snap_demoseekindex_t *index, const char *configstrings );
+bool SNAP_DemoKeyframeDue( const snap_demoseekindex_t *index, unsigned int time );
+void SNAP_RecordDemoKeyframe( int demofile, snap_demoseekindex_t *index, unsigned int time, char *configstrings );
+size_t SNAP_SetDemoMetaSeekIndex( char *meta_data, size_t meta_data_max_size, size_t meta_data_realsize, 
+								 const snap_demoseekindex_t *index );
+void SNAP_ReadDemoMetaSeekIndex( const char *meta_data, size_t meta_data_realsize, snap_demoseekindex_t *index );
+const snap_demokeyframe_t *SNAP_FindDemoKeyframe( const snap_demoseekindex_t *index, unsigned int time );
+void SNAP_StartDemoWriter( int demofile );
+void SNAP_StopDemoWriter( int demofile );
+bool SNAP_GetDemoWriterStats( int demofile, snap_demowriterstats_t *stats );
 
 //============================================================================
 
@@ -280,6 +348,7 @@ enum clc_ops_e
 #define FRAMESNAP_FLAG_DELTA		( 1<<0 )
 #define FRAMESNAP_FLAG_ALLENTITIES	( 1<<1 )
 #define FRAMESNAP_FLAG_MULTIPOV		( 1<<2 )
+#define FRAMESNAP_FLAG_BITPACKED	( 1<<3 )	// entities and player states are bit-packed, the coordinate size ends the header
 
 // plyer_state_t communication
 
@@ -593,6 +662,7 @@ typedef struct
 	netadr_t remoteAddress;
 
 	socket_handle_t handle;
+	struct net_batch_s *batch;		// queued datagrams for batched UDP I/O
 } socket_t;
 
 typedef enum
@@ -639,11 +709,20 @@ int         NET_Monitor( int msec, socket_t *sockets[],
 				void (*read_cb)(socket_t *socket, void*), 
 				void (*write_cb)(socket_t *socket, void*), 
 				void (*exception_cb)(socket_t *socket, void*), void *privatep[] );
+
+struct net_monitor_s *NET_CreateMonitor( int maxsockets );
+void		NET_DestroyMonitor( struct net_monitor_s **pmonitor );
+int			NET_MonitorAddSocket( struct net_monitor_s *monitor, socket_t *socket, void *privatep );
+void		NET_MonitorRemoveSocket( struct net_monitor_s *monitor, int id );
+int			NET_MonitorWait( struct net_monitor_s *monitor, int msec, void (*read_cb)(socket_t *, void*), void (*write_cb)(socket_t *, void*), void (*exception_cb)(socket_t *, void*) );
+
 const char *NET_ErrorString( void );
 void	    NET_SetErrorString( const char *format, ... );
 void		NET_SetErrorStringFromLastError( const char *function );
 void	    NET_ShowIP( void );
 int			NET_SetSocketNoDelay( socket_t *socket, int nodelay );
+bool		NET_SetSocketBatching( socket_t *socket, bool enable );
+void		NET_FlushSocket( const socket_t *socket );
 
 const char *NET_SocketTypeToString( socket_type_t type );
 const char *NET_SocketToString( const socket_t *socket );
@@ -690,6 +769,10 @@ typedef struct
 	uint8_t unsentBuffer[MAX_MSGLEN];
 	bool unsentIsCompressed;
 
+	// negotiated at connect time, zlib without dictionary by default
+	int compressor;
+	bool compressdict;
+
 	bool fatal_error;
 } netchan_t;
 
@@ -703,8 +786,8 @@ bool Netchan_Process( netchan_t *chan, msg_t *msg );
 bool Netchan_Transmit( netchan_t *chan, msg_t *msg );
 bool Netchan_PushAllFragments( netchan_t *chan );
 bool Netchan_TransmitNextFragment( netchan_t *chan );
-int Netchan_CompressMessage( msg_t *msg );
-int Netchan_DecompressMessage( msg_t *msg );
+int Netchan_CompressMessage( netchan_t *chan, msg_t *msg );
+int Netchan_DecompressMessage( netchan_t *chan, msg_t *msg );
 void Netchan_OutOfBand( const socket_t *socket, const netadr_t *address, size_t length, const uint8_t *data );
 void Netchan_OutOfBandPrint( const socket_t *socket, const netadr_t *address, const char *format, ... );
 int Netchan_GamePort( void );
@@ -784,6 +867,8 @@ void	FS_FreeBaseFile( void *buffer );
 */
 void	*FS_MMapBaseFile( int file, size_t size, size_t offset );
 void	FS_UnMMapBaseFile( int file, void *data );
+void	*FS_MMapBaseFileDetached( int file, size_t size, size_t offset );
+void	FS_UnMMapDetached( void *data );
 
 int		FS_GetNotifications( void );
 int		FS_RemoveNotifications( int bitmask );
@@ -870,6 +955,8 @@ extern unsigned int time_before_game;
 extern unsigned int time_after_game;
 extern unsigned int time_before_ref;
 extern unsigned int time_after_ref;
+extern uint64_t time_snap_build;	// usecs spent building and encoding client snapshots
+extern uint64_t time_snap_send;		// usecs spent transmitting client snapshots
 
 /*
 ==============================================================
@@ -32,6 +32,9 @@ typedef struct qthread_s qthread_t;
 struct qcondvar_s;
 typedef struct qcondvar_s qcondvar_t;
 
+struct qthreadkey_s;
+typedef struct qthreadkey_s qthreadkey_t;
+
 struct qbufPipe_s;
 typedef struct qbufPipe_s qbufPipe_t;
 
@@ -29,6 +29,280 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 static char dummy_meta_data[SNAP_MAX_DEMO_META_DATA_SIZE];
 
+//======================================================================
+//
+// ASYNCHRONOUS DEMO WRITER
+//
+// Once a writer is started for a demofile, everything recorded to it is
+// queued to a thread which does the compression and the file I/O, so that
+// slow disks don't stall the recording thread. The queue has a fixed size,
+// the recording thread only waits when it's full.
+//
+//======================================================================
+
+#define SNAP_DEMOWRITER_BUFSIZE		0x100000
+
+#define SNAP_DEMOWRITER_CMDSIZE(len) ( ( sizeof( snapDemoWriterCmd_t ) + (len) + 7 ) & ~7 )
+
+enum
+{
+	SNAP_DEMOWRITER_CMD_WRITE,
+	SNAP_DEMOWRITER_CMD_SHUTDOWN,
+
+	SNAP_DEMOWRITER_NUM_CMDS
+};
+
+typedef struct snap_demowriter_s snap_demowriter_t;
+
+typedef struct
+{
+	int id;
+	int len;
+	unsigned int time;				// when the data was queued
+	snap_demowriter_t *writer;
+} snapDemoWriterCmd_t;				// followed by len bytes of data
+
+typedef unsigned (*snapDemoWriterCmdHandler_t)( const void * );
+
+struct snap_demowriter_s
+{
+	int demofile;
+	qbufPipe_t *pipe;
+	qthread_t *thread;
+	snap_demowriter_t *next;
+
+	// recording thread
+	int queued;
+	size_t maxPending;
+	unsigned int maxStall;
+
+	// writer thread
+	volatile int written;
+	volatile unsigned int numWrites;
+	volatile unsigned int lastLatency, maxLatency;
+	volatile uint64_t totalLatency;
+
+	snapDemoWriterCmd_t *cmd;		// [SNAP_DEMOWRITER_CMDSIZE( MAX_MSGLEN + 4 )]
+};
+
+static snap_demowriter_t *snap_demowriters;
+
+/*
+* SNAP_DemoWriterForFile
+*/
+static snap_demowriter_t *SNAP_DemoWriterForFile( int demofile )
+{
+	snap_demowriter_t *writer;
+
+	for( writer = snap_demowriters; writer; writer = writer->next ) {
+		if( writer->demofile == demofile ) {
+			return writer;
+		}
+	}
+	return NULL;
+}
+
+/*
+* SNAP_HandleDemoWriterWriteCmd
+*/
+static unsigned SNAP_HandleDemoWriterWriteCmd( const snapDemoWriterCmd_t *cmd )
+{
+	snap_demowriter_t *writer = cmd->writer;
+	unsigned int latency;
+
+	FS_Write( cmd + 1, cmd->len, writer->demofile );
+
+	latency = Sys_Milliseconds() - cmd->time;
+	writer->lastLatency = latency;
+	if( latency > writer->maxLatency ) {
+		writer->maxLatency = latency;
+	}
+	writer->totalLatency += latency;
+	writer->numWrites++;
+	writer->written += cmd->len;
+
+	return SNAP_DEMOWRITER_CMDSIZE( cmd->len );
+}
+
+/*
+* SNAP_HandleDemoWriterShutdownCmd
+*/
+static unsigned SNAP_HandleDemoWriterShutdownCmd( const snapDemoWriterCmd_t *cmd )
+{
+	return 0; // terminate
+}
+
+/*
+* SNAP_DemoWriterCmdsWaiter
+*/
+static int SNAP_DemoWriterCmdsWaiter( qbufPipe_t *queue, snapDemoWriterCmdHandler_t *cmdHandlers, bool timeout )
+{
+	return QBufPipe_ReadCmds( queue, cmdHandlers );
+}
+
+/*
+* SNAP_DemoWriterThreadProc
+*/
+static void *SNAP_DemoWriterThreadProc( void *param )
+{
+	qbufPipe_t *cmdQueue = param;
+	snapDemoWriterCmdHandler_t cmdHandlers[SNAP_DEMOWRITER_NUM_CMDS] = 
+	{
+		(snapDemoWriterCmdHandler_t)SNAP_HandleDemoWriterWriteCmd,
+		(snapDemoWriterCmdHandler_t)SNAP_HandleDemoWriterShutdownCmd,
+	};
+
+	QBufPipe_Wait( cmdQueue, SNAP_DemoWriterCmdsWaiter, cmdHandlers, Q_THREADS_WAIT_INFINITE );
+
+	return NULL;
+}
+
+/*
+* SNAP_QueueDemoWrite
+*/
+static void SNAP_QueueDemoWrite( snap_demowriter_t *writer, const void *header, int header_len, const void *data, int len )
+{
+	snapDemoWriterCmd_t *cmd = writer->cmd;
+	size_t pending;
+	unsigned int stall;
+
+	cmd->id = SNAP_DEMOWRITER_CMD_WRITE;
+	cmd->len = header_len + len;
+	cmd->time = Sys_Milliseconds();
+	cmd->writer = writer;
+	memcpy( ( uint8_t * )( cmd + 1 ), header, header_len );
+	if( len > 0 ) {
+		memcpy( ( uint8_t * )( cmd + 1 ) + header_len, data, len );
+	}
+
+	writer->queued += cmd->len;
+	pending = writer->queued - writer->written;
+	if( pending > writer->maxPending ) {
+		writer->maxPending = pending;
+	}
+
+	// blocks when the queue is full
+	QBufPipe_WriteCmd( writer->pipe, cmd, SNAP_DEMOWRITER_CMDSIZE( cmd->len ) );
+
+	stall = Sys_Milliseconds() - cmd->time;
+	if( stall > writer->maxStall ) {
+		writer->maxStall = stall;
+	}
+}
+
+/*
+* SNAP_WriteDemoData
+*/
+static void SNAP_WriteDemoData( int demofile, const void *header, int header_len, const void *data, int len )
+{
+	snap_demowriter_t *writer = SNAP_DemoWriterForFile( demofile );
+
+	if( writer ) {
+		SNAP_QueueDemoWrite( writer, header, header_len, data, len );
+		return;
+	}
+
+	FS_Write( header, header_len, demofile );
+	if( len > 0 ) {
+		FS_Write( data, len, demofile );
+	}
+}
+
+/*
+* SNAP_DemoTell
+*
+* Returns the uncompressed position in the demofile, including queued data
+*/
+static int SNAP_DemoTell( int demofile )
+{
+	snap_demowriter_t *writer = SNAP_DemoWriterForFile( demofile );
+
+	if( writer ) {
+		return writer->queued;
+	}
+	return FS_Tell( demofile );
+}
+
+/*
+* SNAP_StartDemoWriter
+*
+* Moves all further writes to the demofile to a separate thread
+*/
+void SNAP_StartDemoWriter( int demofile )
+{
+	snap_demowriter_t *writer;
+
+	assert( demofile && !SNAP_DemoWriterForFile( demofile ) );
+
+	writer = Mem_ZoneMalloc( sizeof( *writer ) + SNAP_DEMOWRITER_CMDSIZE( MAX_MSGLEN + 4 ) );
+	writer->demofile = demofile;
+	writer->cmd = ( snapDemoWriterCmd_t * )( writer + 1 );
+	writer->queued = writer->written = FS_Tell( demofile );
+	writer->pipe = QBufPipe_Create( SNAP_DEMOWRITER_BUFSIZE, 1 );
+	writer->thread = QThread_Create( SNAP_DemoWriterThreadProc, writer->pipe );
+
+	writer->next = snap_demowriters;
+	snap_demowriters = writer;
+}
+
+/*
+* SNAP_StopDemoWriter
+*
+* Waits until all queued data is written. The demofile must be closed afterwards.
+*/
+void SNAP_StopDemoWriter( int demofile )
+{
+	snap_demowriter_t *writer, **prev;
+	snapDemoWriterCmd_t cmd;
+
+	for( prev = &snap_demowriters; *prev; prev = &( *prev )->next ) {
+		if( ( *prev )->demofile == demofile ) {
+			break;
+		}
+	}
+
+	writer = *prev;
+	if( !writer ) {
+		return;
+	}
+	*prev = writer->next;
+
+	memset( &cmd, 0, sizeof( cmd ) );
+	cmd.id = SNAP_DEMOWRITER_CMD_SHUTDOWN;
+	QBufPipe_WriteCmd( writer->pipe, &cmd, SNAP_DEMOWRITER_CMDSIZE( 0 ) );
+
+	QThread_Join( writer->thread );
+	QBufPipe_Destroy( &writer->pipe );
+
+	Mem_ZoneFree( writer );
+}
+
+/*
+* SNAP_GetDemoWriterStats
+*/
+bool SNAP_GetDemoWriterStats( int demofile, snap_demowriterstats_t *stats )
+{
+	snap_demowriter_t *writer = SNAP_DemoWriterForFile( demofile );
+	unsigned int numWrites;
+
+	if( !writer ) {
+		return false;
+	}
+
+	numWrites = writer->numWrites;
+
+	stats->pending = writer->queued - writer->written;
+	stats->maxPending = writer->maxPending;
+	stats->numWrites = numWrites;
+	stats->lastLatency = writer->lastLatency;
+	stats->avgLatency = numWrites ? (unsigned int)( writer->totalLatency / numWrites ) : 0;
+	stats->maxLatency = writer->maxLatency;
+	stats->maxStall = writer->maxStall;
+	return true;
+}
+
+//======================================================================
+
 /*
 * SNAP_RecordDemoMessage
 *
@@ -42,12 +316,12 @@ void SNAP_RecordDemoMessage( int demofile, msg_t *msg, int offset )
 		return;
 
 	// now write the entire message to the file, prefixed by length
-	len = LittleLong( msg->cursize ) - offset;
+	len = msg->cursize - offset;
 	if( len <= 0 )
 		return;
 
-	FS_Write( &len, 4, demofile );
-	FS_Write( msg->data + offset, len, demofile );
+	len = LittleLong( len );
+	SNAP_WriteDemoData( demofile, &len, 4, msg->data + offset, msg->cursize - offset );
 }
 
 /*
@@ -314,7 +588,7 @@ void SNAP_StopDemoRecording( int demofile )
 
 	// finishup
 	i = LittleLong( -1 );
-	FS_Write( &i, 4, demofile );
+	SNAP_WriteDemoData( demofile, &i, 4, NULL, 0 );
 }
 
 /*
@@ -416,3 +690,201 @@ size_t SNAP_ReadDemoMetaData( int demofile, char *meta_data, size_t meta_data_si
 
 	return meta_data_realsize;
 }
+
+/*
+* SNAP_ClearDemoSeekIndex
+*
+* Configstrings set when the recording starts are remembered, so that
+* keyframes restate them even after they have been cleared
+*/
+void SNAP_ClearDemoSeekIndex( snap_demoseekindex_t *index, const char *configstrings )
+{
+	int i;
+
+	memset( index, 0, sizeof( *index ) );
+	index->interval = SNAP_DEMO_KEYFRAME_INTERVAL;
+
+	if( !configstrings ) {
+		return;
+	}
+
+	for( i = 0; i < MAX_CONFIGSTRINGS; i++ ) {
+		if( configstrings[i * MAX_CONFIGSTRING_CHARS] ) {
+			index->configstrings[i >> 3] |= 1 << ( i & 7 );
+		}
+	}
+}
+
+/*
+* SNAP_DemoKeyframeDue
+*/
+bool SNAP_DemoKeyframeDue( const snap_demoseekindex_t *index, unsigned int time )
+{
+	unsigned int last = 0;
+
+	if( index->numKeyframes ) {
+		last = index->keyframes[index->numKeyframes - 1].time;
+	}
+	return time >= last + index->interval;
+}
+
+/*
+* SNAP_RecordDemoKeyframe
+*
+* Adds the current position of the demofile to the seek index and restates all
+* configstrings. The caller must write a non-delta frame right after it, so that
+* playback can start from here.
+*/
+void SNAP_RecordDemoKeyframe( int demofile, snap_demoseekindex_t *index, unsigned int time, char *configstrings )
+{
+	int i;
+	msg_t msg;
+	uint8_t msg_buffer[MAX_MSGLEN];
+	snap_demokeyframe_t *keyframe;
+
+	if( !demofile ) {
+		return;
+	}
+
+	// keep every other keyframe when the index is full
+	if( index->numKeyframes == SNAP_MAX_DEMO_KEYFRAMES ) {
+		for( i = 0; i < SNAP_MAX_DEMO_KEYFRAMES / 2; i++ ) {
+			index->keyframes[i] = index->keyframes[i * 2 + 1];
+		}
+		index->numKeyframes = SNAP_MAX_DEMO_KEYFRAMES / 2;
+		index->interval *= 2;
+	}
+
+	keyframe = &index->keyframes[index->numKeyframes++];
+	keyframe->time = time;
+	keyframe->offset = SNAP_DemoTell( demofile );
+
+	MSG_Init( &msg, msg_buffer, sizeof( msg_buffer ) );
+
+	for( i = 0; i < MAX_CONFIGSTRINGS; i++ ) {
+		const char *configstring = configstrings + i * MAX_CONFIGSTRING_CHARS;
+
+		if( !configstring[0] && !( index->configstrings[i >> 3] & ( 1 << ( i & 7 ) ) ) ) {
+			continue;
+		}
+		index->configstrings[i >> 3] |= 1 << ( i & 7 );
+
+		MSG_WriteByte( &msg, svc_servercs );
+		MSG_WriteString( &msg, va( "cs %i \"%s\"", i, configstring ) );
+
+		DEMO_SAFEWRITE( demofile, &msg, false );
+	}
+
+	DEMO_SAFEWRITE( demofile, &msg, true );
+}
+
+/*
+* SNAP_SetDemoMetaSeekIndex
+*
+* Stores the seek index as a "keyframes" meta key in the following format:
+* time1:offset1 time2:offset2 ... timeN:offsetN
+*/
+size_t SNAP_SetDemoMetaSeekIndex( char *meta_data, size_t meta_data_max_size, size_t meta_data_realsize, 
+								 const snap_demoseekindex_t *index )
+{
+	unsigned int i;
+	char *value;
+	size_t value_size, len;
+
+	if( !index->numKeyframes ) {
+		return meta_data_realsize;
+	}
+
+	value_size = index->numKeyframes * 24;
+	value = Mem_TempMalloc( value_size );
+
+	len = 0;
+	for( i = 0; i < index->numKeyframes; i++ ) {
+		Q_snprintfz( value + len, value_size - len, "%s%u:%i", i ? " " : "", 
+			index->keyframes[i].time, index->keyframes[i].offset );
+		len += strlen( value + len );
+	}
+
+	meta_data_realsize = SNAP_SetDemoMetaKeyValue( meta_data, meta_data_max_size, meta_data_realsize, "keyframes", value );
+
+	Mem_TempFree( value );
+
+	return meta_data_realsize;
+}
+
+/*
+* SNAP_ReadDemoMetaSeekIndex
+*/
+void SNAP_ReadDemoMetaSeekIndex( const char *meta_data, size_t meta_data_realsize, snap_demoseekindex_t *index )
+{
+	const char *s, *end = meta_data + meta_data_realsize;
+	const char *m_key, *m_val;
+	char *p;
+	unsigned int time;
+	int offset;
+
+	SNAP_ClearDemoSeekIndex( index, NULL );
+
+	for( s = meta_data; s < end && *s; ) {
+		m_key = s;
+		m_val = m_key + strlen( m_key ) + 1;
+		if( m_val >= end ) {
+			break;
+		}
+		s = m_val + strlen( m_val ) + 1;
+
+		if( Q_stricmp( m_key, "keyframes" ) ) {
+			continue;
+		}
+
+		p = ( char * )m_val;
+		while( *p && index->numKeyframes < SNAP_MAX_DEMO_KEYFRAMES ) {
+			time = strtoul( p, &p, 10 );
+			if( *p != ':' ) {
+				break;
+			}
+			offset = strtol( p + 1, &p, 10 );
+
+			// keyframes must be in order
+			if( offset > 0 && ( !index->numKeyframes || 
+				( time > index->keyframes[index->numKeyframes - 1].time && 
+				offset > index->keyframes[index->numKeyframes - 1].offset ) ) ) {
+				index->keyframes[index->numKeyframes].time = time;
+				index->keyframes[index->numKeyframes].offset = offset;
+				index->numKeyframes++;
+			}
+
+			while( *p == ' ' ) {
+				p++;
+			}
+		}
+		break;
+	}
+}
+
+/*
+* SNAP_FindDemoKeyframe
+*
+* Returns the last keyframe at or before the given time
+*/
+const snap_demokeyframe_t *SNAP_FindDemoKeyframe( const snap_demoseekindex_t *index, unsigned int time )
+{
+	int lo, hi, mid;
+
+	if( !index->numKeyframes || index->keyframes[0].time > time ) {
+		return NULL;
+	}
+
+	lo = 0;
+	hi = index->numKeyframes - 1;
+	while( lo < hi ) {
+		mid = ( lo + hi + 1 ) / 2;
+		if( index->keyframes[mid].time <= time ) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+
+	return &index->keyframes[lo];
+}
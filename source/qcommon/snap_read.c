@@ -272,11 +272,156 @@ static void SNAP_ParsePlayerstate( msg_t *msg, player_state_t *oldstate, player_
 	}
 }
 
+/*
+* SNAP_ParsePlayerstatePacked
+*
+* Bit-packed version of SNAP_ParsePlayerstate
+*/
+static void SNAP_ParsePlayerstatePacked( msg_t *msg, player_state_t *oldstate, player_state_t *state, msg_packing_t *packing )
+{
+	int flags;
+	int i, event;
+	int statbits[SNAP_STATS_LONGS];
+	bool delta;
+
+	// clear to old value before delta parsing
+	delta = ( oldstate != NULL );
+	if( oldstate )
+		memcpy( state, oldstate, sizeof( *state ) );
+	else
+		memset( state, 0, sizeof( *state ) );
+
+	flags = MSG_ReadBits( msg, 7 );
+	if( MSG_ReadBits( msg, 1 ) )
+		flags |= MSG_ReadBits( msg, 21 ) << 8;
+
+	//
+	// parse the pmove_state_t
+	//
+	if( flags & PS_M_TYPE )
+		state->pmove.pm_type = MSG_ReadBits( msg, 8 );
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( flags & ( PS_M_ORIGIN0 << i ) )
+			state->pmove.origin[i] = ( (float)MSG_ReadDeltaCoordPacked( msg, (int)( state->pmove.origin[i]*PM_VECTOR_SNAP ), 
+				delta, packing->coordBits )*( 1.0/PM_VECTOR_SNAP ) );
+	}
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( flags & ( PS_M_VELOCITY0 << i ) )
+			state->pmove.velocity[i] = ( (float)MSG_ReadDeltaCoordPacked( msg, (int)( state->pmove.velocity[i]*PM_VECTOR_SNAP ), 
+				delta, packing->coordBits )*( 1.0/PM_VECTOR_SNAP ) );
+	}
+
+	if( flags & PS_M_TIME )
+		state->pmove.pm_time = MSG_ReadBits( msg, 8 );
+
+	if( flags & PS_M_FLAGS )
+		state->pmove.pm_flags = MSG_ReadSignedBits( msg, 16 );
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( flags & ( PS_M_DELTA_ANGLES0 << i ) )
+			state->pmove.delta_angles[i] = MSG_ReadSignedBits( msg, 16 );
+	}
+
+	for( i = 0; i < 2; i++ )
+	{
+		if( flags & ( i ? PS_EVENT2 : PS_EVENT ) )
+		{
+			event = MSG_ReadBits( msg, 8 );
+			if( event & EV_INVERSE )
+				state->eventParm[i] = MSG_ReadBits( msg, 8 );
+			else
+				state->eventParm[i] = 0;
+			state->event[i] = event & ~EV_INVERSE;
+		}
+		else
+		{
+			state->event[i] = state->eventParm[i] = 0;
+		}
+	}
+
+	if( flags & PS_VIEWANGLES )
+	{
+		for( i = 0; i < 3; i++ )
+			state->viewangles[i] = SHORT2ANGLE( MSG_ReadSignedBits( msg, 16 ) );
+	}
+
+	if( flags & PS_M_GRAVITY )
+		state->pmove.gravity = MSG_ReadSignedBits( msg, 16 );
+
+	if( flags & PS_WEAPONSTATE )
+		state->weaponState = MSG_ReadBits( msg, 8 );
+
+	if( flags & PS_FOV )
+		state->fov = MSG_ReadBits( msg, 8 );
+
+	if( flags & PS_POVNUM )
+		state->POVnum = MSG_ReadBits( msg, 8 );
+	if( state->POVnum == 0 )
+		Com_Error( ERR_DROP, "SNAP_ParsePlayerstatePacked: Invalid POVnum %i", state->POVnum );
+
+	if( flags & PS_PLAYERNUM )
+		state->playerNum = MSG_ReadBits( msg, 8 );
+	if( state->playerNum >= MAX_CLIENTS )
+		Com_Error( ERR_DROP, "SNAP_ParsePlayerstatePacked: Invalid playerNum %i", state->playerNum );
+
+	if( flags & PS_VIEWHEIGHT )
+		state->viewheight = MSG_ReadSignedBits( msg, 8 );
+
+	if( flags & PS_PMOVESTATS )
+	{
+		int pmstatbits = MSG_ReadBits( msg, 16 );
+		for( i = 0; i < PM_STAT_SIZE; i++ )
+		{
+			if( pmstatbits & ( 1<<i ) )
+				state->pmove.stats[i] = MSG_ReadSignedBits( msg, 16 );
+		}
+	}
+
+	if( flags & PS_INVENTORY )
+	{
+		int invstatbits[SNAP_INVENTORY_LONGS];
+
+		for( i = 0; i < SNAP_INVENTORY_LONGS; i++ )
+			invstatbits[i] = MSG_ReadBits( msg, 32 );
+
+		for( i = 0; i < MAX_ITEMS; i++ )
+		{
+			if( invstatbits[i>>5] & ( 1<<(i&31) ) )
+				state->inventory[i] = MSG_ReadBits( msg, 8 );
+		}
+	}
+
+	if( flags & PS_PLRKEYS )
+		state->plrkeys = MSG_ReadBits( msg, 8 );
+
+	// parse stats
+	if( MSG_ReadBits( msg, 1 ) )
+	{
+		for( i = 0; i < SNAP_STATS_LONGS; i++ )
+			statbits[i] = MSG_ReadBits( msg, 32 );
+
+		for( i = 0; i < PS_MAX_STATS; i++ )
+		{
+			if( statbits[i>>5] & ( 1<<(i&31) ) )
+				state->stats[i] = MSG_ReadSignedBits( msg, 16 );
+		}
+	}
+
+	MSG_AlignBits( msg );
+}
+
 /*
 * SNAP_ParseEntityBits
 */
-static int SNAP_ParseEntityBits( msg_t *msg, unsigned *bits )
+static int SNAP_ParseEntityBits( msg_t *msg, msg_packing_t *packing, unsigned *bits )
 {
+	if( packing )
+		return MSG_ReadEntityBitsPacked( packing, msg, bits );
 	return MSG_ReadEntityBits( msg, bits );
 }
 
@@ -286,13 +431,16 @@ static int SNAP_ParseEntityBits( msg_t *msg, unsigned *bits )
 * Parses deltas from the given base and adds the resulting entity
 * to the current frame
 */
-static void SNAP_DeltaEntity( msg_t *msg, snapshot_t *frame, int newnum, entity_state_t *old, unsigned bits )
+static void SNAP_DeltaEntity( msg_t *msg, msg_packing_t *packing, snapshot_t *frame, int newnum, entity_state_t *old, unsigned bits )
 {
 	entity_state_t *state;
 
 	state = &frame->parsedEntities[frame->numEntities & ( MAX_PARSE_ENTITIES-1 )];
 	frame->numEntities++;
-	MSG_ReadDeltaEntity( msg, old, state, newnum, bits );
+	if( packing )
+		MSG_ReadDeltaEntityPacked( packing, msg, old, state, newnum, bits );
+	else
+		MSG_ReadDeltaEntity( msg, old, state, newnum, bits );
 }
 
 /*
@@ -318,7 +466,7 @@ void SNAP_ParseBaseline( msg_t *msg, entity_state_t *baselines )
 * An svc_packetentities has just been parsed, deal with the
 * rest of the data stream.
 */
-static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot_t *newframe, entity_state_t *baselines, int shownet )
+static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot_t *newframe, entity_state_t *baselines, msg_packing_t *packing, int shownet )
 {
 	int newnum;
 	unsigned bits;
@@ -326,6 +474,8 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 	int oldindex, oldnum;
 
 	newframe->numEntities = 0;
+	if( packing )
+		packing->lastNumber = 0;
 
 	// delta from the entities present in oldframe
 	oldindex = 0;
@@ -343,14 +493,18 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 
 	while( true )
 	{
-		newnum = SNAP_ParseEntityBits( msg, &bits );
+		newnum = SNAP_ParseEntityBits( msg, packing, &bits );
 		if( newnum >= MAX_EDICTS )
 			Com_Error( ERR_DROP, "CL_ParsePacketEntities: bad number:%i", newnum );
 		if( msg->readcount > msg->cursize )
 			Com_Error( ERR_DROP, "CL_ParsePacketEntities: end of message" );
 
 		if( !newnum )
+		{
+			if( packing )
+				MSG_AlignBits( msg );
 			break;
+		}
 
 		while( oldnum < newnum )
 		{
@@ -358,7 +512,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 			if( shownet == 3 )
 				Com_Printf( "   unchanged: %i\n", oldnum );
 
-			SNAP_DeltaEntity( msg, newframe, oldnum, oldstate, 0 );
+			SNAP_DeltaEntity( msg, packing, newframe, oldnum, oldstate, 0 );
 
 			oldindex++;
 			if( oldindex >= oldframe->numEntities )
@@ -385,7 +539,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 			if( shownet == 3 )
 				Com_Printf( "   baseline: %i\n", newnum );
 
-			SNAP_DeltaEntity( msg, newframe, newnum, &baselines[newnum], bits );
+			SNAP_DeltaEntity( msg, packing, newframe, newnum, &baselines[newnum], bits );
 			continue;
 		}
 
@@ -417,7 +571,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 			if( shownet == 3 )
 				Com_Printf( "   delta: %i\n", newnum );
 
-			SNAP_DeltaEntity( msg, newframe, newnum, oldstate, bits );
+			SNAP_DeltaEntity( msg, packing, newframe, newnum, oldstate, bits );
 
 			oldindex++;
 			if( oldindex >= oldframe->numEntities )
@@ -440,7 +594,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 		if( shownet == 3 )
 			Com_Printf( "   unchanged: %i\n", oldnum );
 
-		SNAP_DeltaEntity( msg, newframe, oldnum, oldstate, 0 );
+		SNAP_DeltaEntity( msg, packing, newframe, oldnum, oldstate, 0 );
 
 		oldindex++;
 		if( oldindex >= oldframe->numEntities )
@@ -458,13 +612,14 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 /*
 * SNAP_ParseFrameHeader
 */
-static snapshot_t *SNAP_ParseFrameHeader( msg_t *msg, snapshot_t *newframe, int *suppressCount, snapshot_t *backup, bool skipBody )
+static snapshot_t *SNAP_ParseFrameHeader( msg_t *msg, snapshot_t *newframe, int *suppressCount, msg_packing_t *packing, 
+	snapshot_t *backup, bool skipBody )
 {
 	int len, pos;
 	int areabytes;
 	uint8_t *areabits;
 	unsigned int serverTime;
-	int flags, snapNum, supCnt;
+	int flags, snapNum, supCnt, coordBits;
 
 	// get total length
 	len = MSG_ReadShort( msg );
@@ -502,6 +657,24 @@ static snapshot_t *SNAP_ParseFrameHeader( msg_t *msg, snapshot_t *newframe, int
 #endif
 	}
 
+	// bit-packed frames are followed by the size of the coordinates
+	if( flags & FRAMESNAP_FLAG_BITPACKED )
+	{
+		coordBits = MSG_ReadByte( msg );
+		if( coordBits < 1 || coordBits > MSG_COORD_BITS )
+			Com_Error( ERR_DROP, "Invalid coordinate size: %i", coordBits );
+	}
+	else
+	{
+		coordBits = 0;
+	}
+
+	if( packing )
+	{
+		memset( packing, 0, sizeof( *packing ) );
+		packing->coordBits = coordBits;
+	}
+
 	// validate the new frame
 	newframe->valid = false;
 
@@ -544,7 +717,8 @@ static snapshot_t *SNAP_ParseFrameHeader( msg_t *msg, snapshot_t *newframe, int
 		}
 	}
 
-	if( skipBody )
+	// bit-packed deltas can't be parsed without the frame they're based on
+	if( skipBody || ( coordBits && !newframe->valid ) )
 		MSG_SkipData( msg, len - (msg->readcount - pos) );
 
 	return newframe;
@@ -556,7 +730,7 @@ static snapshot_t *SNAP_ParseFrameHeader( msg_t *msg, snapshot_t *newframe, int
 void SNAP_SkipFrame( msg_t *msg, snapshot_t *header )
 {
 	static snapshot_t frame;
-	SNAP_ParseFrameHeader( msg, header ? header : &frame, NULL, NULL, true );
+	SNAP_ParseFrameHeader( msg, header ? header : &frame, NULL, NULL, NULL, true );
 }
 
 /*
@@ -572,10 +746,14 @@ snapshot_t *SNAP_ParseFrame( msg_t *msg, snapshot_t *lastFrame, int *suppressCou
 	int framediff, numtargets;
 	gcommand_t *gcmd;
 	snapshot_t	*newframe;
+	msg_packing_t packing, *pack;
 
 	// read header
-	newframe = SNAP_ParseFrameHeader( msg, NULL, suppressCount, backup, false );
+	newframe = SNAP_ParseFrameHeader( msg, NULL, suppressCount, &packing, backup, false );
 	deltaframe = NULL;
+	pack = packing.coordBits ? &packing : NULL;
+	if( pack && !newframe->valid )
+		return newframe; // skipped by SNAP_ParseFrameHeader
 
 	if( showNet == 3 )
 	{
@@ -658,7 +836,12 @@ snapshot_t *SNAP_ParseFrame( msg_t *msg, snapshot_t *lastFrame, int *suppressCou
 		_SHOWNET( msg, svc_strings[cmd], showNet );
 		if( cmd != svc_playerinfo )
 			Com_Error( ERR_DROP, "SNAP_ParseFrame: not playerinfo" );
-		if( deltaframe && deltaframe->numplayers >= numplayers )
+		if( numplayers >= MAX_CLIENTS )
+			Com_Error( ERR_DROP, "SNAP_ParseFrame: too many playerinfos" );
+		if( pack )
+			SNAP_ParsePlayerstatePacked( msg, deltaframe && numplayers < deltaframe->numplayers ? 
+				&deltaframe->playerStates[numplayers] : NULL, &newframe->playerStates[numplayers], pack );
+		else if( deltaframe && numplayers < deltaframe->numplayers )
 			SNAP_ParsePlayerstate( msg, &deltaframe->playerStates[numplayers], &newframe->playerStates[numplayers] );
 		else
 			SNAP_ParsePlayerstate( msg, NULL, &newframe->playerStates[numplayers] );
@@ -672,7 +855,7 @@ snapshot_t *SNAP_ParseFrame( msg_t *msg, snapshot_t *lastFrame, int *suppressCou
 	_SHOWNET( msg, svc_strings[cmd], showNet );
 	if( cmd != svc_packetentities )
 		Com_Error( ERR_DROP, "SNAP_ParseFrame: not packetentities" );
-	SNAP_ParsePacketEntities( msg, deltaframe, newframe, baselines, showNet );
+	SNAP_ParsePacketEntities( msg, deltaframe, newframe, baselines, pack, showNet );
 
 	return newframe;
 }
@@ -19,6 +19,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 
 #include "qcommon.h"
+#include "sys_threads.h"
 
 #include "snap_write.h"
 
@@ -34,17 +35,22 @@ Encode a client frame onto the network channel
 * SNAP_EmitPacketEntities
 *
 * Writes a delta update of an entity_state_t list to the message.
+* Bit-packed if packing is set, byte-aligned otherwise.
 */
-static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, client_snapshot_t *to, msg_t *msg, entity_state_t *baselines, entity_state_t *client_entities, int num_client_entities )
+static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, client_snapshot_t *to, msg_t *msg, entity_state_t *baselines, entity_state_t *client_entities, int num_client_entities, msg_packing_t *packing )
 {
 	entity_state_t *oldent, *newent;
 	int oldindex, newindex;
 	int oldnum, newnum;
 	int from_num_entities;
 	int bits;
+	bool updateOtherOrigin;
 
 	MSG_WriteByte( msg, svc_packetentities );
 
+	if( packing )
+		packing->lastNumber = 0;
+
 	if( !from )
 		from_num_entities = 0;
 	else
@@ -83,7 +89,11 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 			// in any bytes being emited if the entity has not changed at all
 			// note that players are always 'newentities', this updates their oldorigin always
 			// and prevents warping ( wsw : jal : I removed it from the players )
-			MSG_WriteDeltaEntity( oldent, newent, msg, false, ( ( EDICT_NUM( newent->number ) )->r.svflags & SVF_TRANSMITORIGIN2 ) ? true : false );
+			updateOtherOrigin = ( ( EDICT_NUM( newent->number ) )->r.svflags & SVF_TRANSMITORIGIN2 ) ? true : false;
+			if( packing )
+				MSG_WriteDeltaEntityPacked( packing, oldent, newent, msg, false, updateOtherOrigin );
+			else
+				MSG_WriteDeltaEntity( oldent, newent, msg, false, updateOtherOrigin );
 			oldindex++;
 			newindex++;
 			continue;
@@ -92,7 +102,11 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 		if( newnum < oldnum )
 		{
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity( &baselines[newnum], newent, msg, true, ( ( EDICT_NUM( newent->number ) )->r.svflags & SVF_TRANSMITORIGIN2 ) ? true : false );
+			updateOtherOrigin = ( ( EDICT_NUM( newent->number ) )->r.svflags & SVF_TRANSMITORIGIN2 ) ? true : false;
+			if( packing )
+				MSG_WriteDeltaEntityPacked( packing, &baselines[newnum], newent, msg, true, updateOtherOrigin );
+			else
+				MSG_WriteDeltaEntity( &baselines[newnum], newent, msg, true, updateOtherOrigin );
 			newindex++;
 			continue;
 		}
@@ -100,6 +114,13 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 		if( newnum > oldnum )
 		{
 			// the old entity isn't present in the new message
+			if( packing )
+			{
+				MSG_WriteEntityRemovePacked( packing, msg, oldnum );
+				oldindex++;
+				continue;
+			}
+
 			bits = U_REMOVE;
 			if( oldnum >= 256 )
 				bits |= ( U_NUMBER16 | U_MOREBITS1 );
@@ -118,7 +139,11 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 		}
 	}
 
-	MSG_WriteShort( msg, 0 ); // end of packetentities
+	// end of packetentities
+	if( packing )
+		MSG_WriteEntitiesEndPacked( packing, msg );
+	else
+		MSG_WriteShort( msg, 0 );
 }
 
 /*
@@ -184,24 +209,15 @@ static void SNAP_WriteDeltaGameStateToClient( client_snapshot_t *from, client_sn
 }
 
 /*
-* SNAP_WritePlayerstateToClient
+* SNAP_PlayerstateFlags
+*
+* Determines what needs to be sent
 */
-static void SNAP_WritePlayerstateToClient( player_state_t *ops, player_state_t *ps, msg_t *msg )
+static int SNAP_PlayerstateFlags( player_state_t *ops, player_state_t *ps )
 {
 	int i;
 	int pflags;
-	player_state_t dummy;
-	int statbits[SNAP_STATS_LONGS];
-
-	if( !ops )
-	{
-		memset( &dummy, 0, sizeof( dummy ) );
-		ops = &dummy;
-	}
 
-	//
-	// determine what needs to be sent
-	//
 	pflags = 0;
 
 	if( ps->pmove.pm_type != ops->pmove.pm_type )
@@ -284,6 +300,27 @@ static void SNAP_WritePlayerstateToClient( player_state_t *ops, player_state_t *
 	if( ps->plrkeys != ops->plrkeys )
 		pflags |= PS_PLRKEYS;
 
+	return pflags;
+}
+
+/*
+* SNAP_WritePlayerstateToClient
+*/
+static void SNAP_WritePlayerstateToClient( player_state_t *ops, player_state_t *ps, msg_t *msg )
+{
+	int i;
+	int pflags;
+	player_state_t dummy;
+	int statbits[SNAP_STATS_LONGS];
+
+	if( !ops )
+	{
+		memset( &dummy, 0, sizeof( dummy ) );
+		ops = &dummy;
+	}
+
+	pflags = SNAP_PlayerstateFlags( ops, ps );
+
 	//
 	// write it
 	//
@@ -459,6 +496,188 @@ static void SNAP_WritePlayerstateToClient( player_state_t *ops, player_state_t *
 	}
 }
 
+/*
+* SNAP_WritePlayerstatePacked
+*
+* Bit-packed version of SNAP_WritePlayerstateToClient
+*/
+static void SNAP_WritePlayerstatePacked( player_state_t *ops, player_state_t *ps, msg_t *msg, msg_packing_t *packing )
+{
+	int i;
+	int pflags;
+	player_state_t dummy;
+	int statbits[SNAP_STATS_LONGS];
+	bool delta;
+
+	delta = ( ops != NULL );
+	if( !ops )
+	{
+		memset( &dummy, 0, sizeof( dummy ) );
+		ops = &dummy;
+	}
+
+	pflags = SNAP_PlayerstateFlags( ops, ps );
+
+	MSG_WriteByte( msg, svc_playerinfo );
+
+	MSG_WriteBits( msg, pflags & 127, 7 );
+	if( pflags >> 8 )
+	{
+		MSG_WriteBits( msg, 1, 1 );
+		MSG_WriteBits( msg, pflags >> 8, 21 );
+	}
+	else
+	{
+		MSG_WriteBits( msg, 0, 1 );
+	}
+
+	if( pflags & PS_M_TYPE )
+		MSG_WriteBits( msg, ps->pmove.pm_type, 8 );
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( pflags & ( PS_M_ORIGIN0 << i ) )
+			MSG_WriteDeltaCoordPacked( msg, (int)( ops->pmove.origin[i]*PM_VECTOR_SNAP ), 
+				(int)( ps->pmove.origin[i]*PM_VECTOR_SNAP ), delta, packing->coordBits );
+	}
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( pflags & ( PS_M_VELOCITY0 << i ) )
+			MSG_WriteDeltaCoordPacked( msg, (int)( ops->pmove.velocity[i]*PM_VECTOR_SNAP ), 
+				(int)( ps->pmove.velocity[i]*PM_VECTOR_SNAP ), delta, packing->coordBits );
+	}
+
+	if( pflags & PS_M_TIME )
+		MSG_WriteBits( msg, ps->pmove.pm_time, 8 );
+
+	if( pflags & PS_M_FLAGS )
+		MSG_WriteBits( msg, ps->pmove.pm_flags, 16 );
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( pflags & ( PS_M_DELTA_ANGLES0 << i ) )
+			MSG_WriteBits( msg, ps->pmove.delta_angles[i], 16 );
+	}
+
+	for( i = 0; i < 2; i++ )
+	{
+		if( !( pflags & ( i ? PS_EVENT2 : PS_EVENT ) ) )
+			continue;
+
+		if( !ps->eventParm[i] )
+		{
+			MSG_WriteBits( msg, (uint8_t)( ps->event[i] & ~EV_INVERSE ), 8 );
+		}
+		else
+		{
+			MSG_WriteBits( msg, (uint8_t)( ps->event[i] | EV_INVERSE ), 8 );
+			MSG_WriteBits( msg, (uint8_t)ps->eventParm[i], 8 );
+		}
+	}
+
+	if( pflags & PS_VIEWANGLES )
+	{
+		for( i = 0; i < 3; i++ )
+			MSG_WriteBits( msg, ANGLE2SHORT( ps->viewangles[i] ), 16 );
+	}
+
+	if( pflags & PS_M_GRAVITY )
+		MSG_WriteBits( msg, ps->pmove.gravity, 16 );
+
+	if( pflags & PS_WEAPONSTATE )
+		MSG_WriteBits( msg, ps->weaponState, 8 );
+
+	if( pflags & PS_FOV )
+		MSG_WriteBits( msg, (uint8_t)ps->fov, 8 );
+
+	if( pflags & PS_POVNUM )
+		MSG_WriteBits( msg, (uint8_t)ps->POVnum, 8 );
+
+	if( pflags & PS_PLAYERNUM )
+		MSG_WriteBits( msg, (uint8_t)ps->playerNum, 8 );
+
+	if( pflags & PS_VIEWHEIGHT )
+		MSG_WriteBits( msg, (uint8_t)ps->viewheight, 8 );
+
+	if( pflags & PS_PMOVESTATS )
+	{
+		int pmstatbits;
+
+		pmstatbits = 0;
+		for( i = 0; i < PM_STAT_SIZE; i++ )
+		{
+			if( ps->pmove.stats[i] != ops->pmove.stats[i] )
+				pmstatbits |= ( 1<<i );
+		}
+
+		MSG_WriteBits( msg, pmstatbits & 0xFFFF, 16 );
+
+		for( i = 0; i < PM_STAT_SIZE; i++ )
+		{
+			if( pmstatbits & ( 1<<i ) )
+				MSG_WriteBits( msg, ps->pmove.stats[i], 16 );
+		}
+	}
+
+	if( pflags & PS_INVENTORY )
+	{
+		int invstatbits[SNAP_INVENTORY_LONGS];
+
+		memset( invstatbits, 0, sizeof( invstatbits ) );
+		for( i = 0; i < MAX_ITEMS; i++ )
+		{
+			if( ps->inventory[i] != ops->inventory[i] )
+				invstatbits[i>>5] |= ( 1<<(i&31) );
+		}
+
+		for( i = 0; i < SNAP_INVENTORY_LONGS; i++ )
+			MSG_WriteBits( msg, invstatbits[i], 32 );
+
+		for( i = 0; i < MAX_ITEMS; i++ )
+		{
+			if( invstatbits[i>>5] & ( 1<<(i&31) ) )
+				MSG_WriteBits( msg, (uint8_t)ps->inventory[i], 8 );
+		}
+	}
+
+	if( pflags & PS_PLRKEYS )
+		MSG_WriteBits( msg, ps->plrkeys, 8 );
+
+	// send stats, most frames don't change any
+	memset( statbits, 0, sizeof( statbits ) );
+	for( i = 0; i < PS_MAX_STATS; i++ )
+	{
+		if( ps->stats[i] != ops->stats[i] )
+			statbits[i>>5] |= 1<<(i&31);
+	}
+
+	for( i = 0; i < SNAP_STATS_LONGS; i++ )
+	{
+		if( statbits[i] )
+			break;
+	}
+
+	if( i == SNAP_STATS_LONGS )
+	{
+		MSG_WriteBits( msg, 0, 1 );
+	}
+	else
+	{
+		MSG_WriteBits( msg, 1, 1 );
+		for( i = 0; i < SNAP_STATS_LONGS; i++ )
+			MSG_WriteBits( msg, statbits[i], 32 );
+
+		for( i = 0; i < PS_MAX_STATS; i++ )
+		{
+			if( statbits[i>>5] & ( 1<<(i&31) ) )
+				MSG_WriteBits( msg, ps->stats[i], 16 );
+		}
+	}
+
+	MSG_FlushBits( msg );
+}
+
 /*
 * SNAP_WriteMultiPOVCommands
 */
@@ -618,15 +837,333 @@ static void SNAP_RelayMultiPOVCommands( ginfo_t *gi, client_t *client, msg_t *ms
 	}
 }
 
+//=====================================================================
+
+/*
+* Multipov clients (TV relays, multiview spectators, server demos) get the
+* same player states and entity lists, so when they acked the same frame the
+* delta encoded blocks are byte identical. Those blocks are encoded once per
+* frame and copied to everyone else. The key is built from the delta base
+* frame number and the entity numbers or raw player states involved; the
+* entity states themselves don't need to be compared since all frames of the
+* same number were built from the same edicts.
+*
+* Single POV clients never match each other, not even spectators chasing the
+* same player: their entity lists always hold their own edict and are culled
+* against their own team and owner number, and their player state differs in
+* playerNum.
+*/
+#define SNAP_ENCCACHE_ENTRIES	32
+#define SNAP_ENCCACHE_MAXKEYS	3
+
+typedef struct
+{
+	const void *data;
+	size_t size;
+} snap_enckey_t;
+
+typedef struct
+{
+	unsigned int hash;
+	size_t keySize;
+	size_t dataSize;
+	size_t bufSize;
+	uint8_t *buf;						// [keySize + dataSize]
+} snap_encentry_t;
+
+typedef struct snap_enccache_s
+{
+	qmutex_t *mutex;
+	mempool_t *mempool;
+
+	const void *client_entities;
+	const void *baselines;
+	unsigned int frameNum;
+	unsigned int gameTime;
+
+	int numEntries;
+	snap_encentry_t entries[SNAP_ENCCACHE_ENTRIES];
+} snap_enccache_t;
+
+/*
+* SNAP_CreateEncodeCache
+*/
+snap_enccache_t *SNAP_CreateEncodeCache( mempool_t *mempool )
+{
+	snap_enccache_t *cache;
+
+	cache = ( snap_enccache_t * )Mem_Alloc( mempool, sizeof( *cache ) );
+	cache->mempool = mempool;
+	cache->mutex = QMutex_Create();
+	return cache;
+}
+
+/*
+* SNAP_DestroyEncodeCache
+*/
+void SNAP_DestroyEncodeCache( snap_enccache_t **pcache )
+{
+	int i;
+	snap_enccache_t *cache;
+
+	assert( pcache != NULL );
+	cache = *pcache;
+	if( !cache )
+		return;
+
+	for( i = 0; i < SNAP_ENCCACHE_ENTRIES; i++ )
+	{
+		if( cache->entries[i].buf )
+			Mem_Free( cache->entries[i].buf );
+	}
+
+	QMutex_Destroy( &cache->mutex );
+	Mem_Free( cache );
+	*pcache = NULL;
+}
+
+/*
+* SNAP_HashEncodeKey
+*/
+static unsigned int SNAP_HashEncodeKey( const snap_enckey_t *keys, int numKeys, size_t *keySize )
+{
+	int i;
+	size_t j;
+	const uint8_t *p;
+	unsigned int hash = 2166136261u;
+
+	*keySize = 0;
+	for( i = 0; i < numKeys; i++ )
+	{
+		p = ( const uint8_t * )keys[i].data;
+		for( j = 0; j < keys[i].size; j++ )
+			hash = ( hash ^ p[j] ) * 16777619u;
+		*keySize += keys[i].size;
+	}
+	return hash;
+}
+
+/*
+* SNAP_EncodeCacheFind
+*
+* Must be called with the cache mutex held
+*/
+static snap_encentry_t *SNAP_EncodeCacheFind( snap_enccache_t *cache, unsigned int hash, const snap_enckey_t *keys, int numKeys, size_t keySize )
+{
+	int i, k;
+	const uint8_t *p;
+	snap_encentry_t *entry;
+
+	for( i = 0, entry = cache->entries; i < cache->numEntries; i++, entry++ )
+	{
+		if( entry->hash != hash || entry->keySize != keySize )
+			continue;
+
+		p = entry->buf;
+		for( k = 0; k < numKeys; k++ )
+		{
+			if( memcmp( p, keys[k].data, keys[k].size ) )
+				break;
+			p += keys[k].size;
+		}
+		if( k == numKeys )
+			return entry;
+	}
+
+	return NULL;
+}
+
+/*
+* SNAP_EncodeCacheBegin
+*
+* Drops the entries from previous frames. Must be called with the cache mutex held.
+*/
+static void SNAP_EncodeCacheBegin( snap_enccache_t *cache, const void *client_entities, const void *baselines,
+	unsigned int frameNum, unsigned int gameTime )
+{
+	if( cache->client_entities == client_entities && cache->baselines == baselines &&
+		cache->frameNum == frameNum && cache->gameTime == gameTime )
+		return;
+
+	cache->client_entities = client_entities;
+	cache->baselines = baselines;
+	cache->frameNum = frameNum;
+	cache->gameTime = gameTime;
+	cache->numEntries = 0;
+}
+
+/*
+* SNAP_EncodeCacheLookup
+*
+* Copies a previously encoded block matching the key to the message.
+*/
+static bool SNAP_EncodeCacheLookup( snap_enccache_t *cache, const snap_enckey_t *keys, int numKeys, msg_t *msg, unsigned int *hash )
+{
+	size_t keySize;
+	snap_encentry_t *entry;
+
+	*hash = SNAP_HashEncodeKey( keys, numKeys, &keySize );
+
+	QMutex_Lock( cache->mutex );
+	entry = SNAP_EncodeCacheFind( cache, *hash, keys, numKeys, keySize );
+	if( entry )
+		MSG_CopyData( msg, entry->buf + entry->keySize, entry->dataSize );
+	QMutex_Unlock( cache->mutex );
+
+	return entry != NULL;
+}
+
+/*
+* SNAP_EncodeCacheStore
+*
+* Stores the block written to the message since the start offset.
+*/
+static void SNAP_EncodeCacheStore( snap_enccache_t *cache, unsigned int frameNum, unsigned int gameTime,
+	const snap_enckey_t *keys, int numKeys, unsigned int hash, msg_t *msg, size_t start )
+{
+	int k;
+	size_t keySize, dataSize;
+	uint8_t *p;
+	snap_encentry_t *entry;
+
+	keySize = 0;
+	for( k = 0; k < numKeys; k++ )
+		keySize += keys[k].size;
+	dataSize = msg->cursize - start;
+
+	QMutex_Lock( cache->mutex );
+	if( cache->frameNum == frameNum && cache->gameTime == gameTime && cache->numEntries < SNAP_ENCCACHE_ENTRIES &&
+		!SNAP_EncodeCacheFind( cache, hash, keys, numKeys, keySize ) )
+	{
+		entry = &cache->entries[cache->numEntries];
+		if( entry->bufSize < keySize + dataSize )
+		{
+			if( entry->buf )
+				Mem_Free( entry->buf );
+			entry->bufSize = keySize + dataSize;
+			entry->buf = ( uint8_t * )Mem_Alloc( cache->mempool, entry->bufSize );
+		}
+
+		p = entry->buf;
+		for( k = 0; k < numKeys; k++ )
+		{
+			memcpy( p, keys[k].data, keys[k].size );
+			p += keys[k].size;
+		}
+		memcpy( p, msg->data + start, dataSize );
+
+		entry->hash = hash;
+		entry->keySize = keySize;
+		entry->dataSize = dataSize;
+		cache->numEntries++;
+	}
+	QMutex_Unlock( cache->mutex );
+}
+
+/*
+* SNAP_WriteFramePlayerstates
+*/
+static void SNAP_WriteFramePlayerstates( snap_enccache_t *cache, client_snapshot_t *oldframe, client_snapshot_t *frame,
+	msg_t *msg, unsigned int frameNum, unsigned int gameTime, msg_packing_t *packing )
+{
+	int i, numoldplayers;
+	int header[4];
+	unsigned int hash = 0;
+	size_t start;
+	snap_enckey_t keys[SNAP_ENCCACHE_MAXKEYS];
+
+	numoldplayers = oldframe ? min( oldframe->numplayers, frame->numplayers ) : 0;
+
+	if( cache )
+	{
+		header[0] = svc_playerinfo;
+		header[1] = frame->numplayers;
+		header[2] = numoldplayers;
+		header[3] = packing ? packing->coordBits : 0;
+
+		keys[0].data = header; keys[0].size = sizeof( header );
+		keys[1].data = frame->ps; keys[1].size = sizeof( player_state_t ) * frame->numplayers;
+		keys[2].data = oldframe ? oldframe->ps : NULL; keys[2].size = sizeof( player_state_t ) * numoldplayers;
+		if( SNAP_EncodeCacheLookup( cache, keys, 3, msg, &hash ) )
+			return;
+	}
+
+	start = msg->cursize;
+
+	for( i = 0; i < frame->numplayers; i++ )
+	{
+		if( packing )
+			SNAP_WritePlayerstatePacked( i < numoldplayers ? &oldframe->ps[i] : NULL, &frame->ps[i], msg, packing );
+		else if( i < numoldplayers )
+			SNAP_WritePlayerstateToClient( &oldframe->ps[i], &frame->ps[i], msg );
+		else
+			SNAP_WritePlayerstateToClient( NULL, &frame->ps[i], msg );
+	}
+	MSG_WriteByte( msg, 0 );
+
+	if( cache )
+		SNAP_EncodeCacheStore( cache, frameNum, gameTime, keys, 3, hash, msg, start );
+}
+
+/*
+* SNAP_WriteFrameEntities
+*/
+static void SNAP_WriteFrameEntities( ginfo_t *gi, snap_enccache_t *cache, client_snapshot_t *oldframe, client_snapshot_t *frame,
+	int oldFrameNum, msg_t *msg, unsigned int frameNum, unsigned int gameTime,
+	entity_state_t *baselines, client_entities_t *client_entities, msg_packing_t *packing )
+{
+	int i;
+	int header[7];
+	unsigned int hash = 0;
+	size_t start;
+	short oldnums[MAX_EDICTS], newnums[MAX_EDICTS];
+	snap_enckey_t keys[SNAP_ENCCACHE_MAXKEYS];
+
+	if( !client_entities )
+		cache = NULL;
+
+	if( cache )
+	{
+		// frames with the same number and build time hold the same
+		// entity states, so only the entity numbers have to match
+		header[0] = svc_packetentities;
+		header[1] = oldFrameNum;
+		header[2] = oldframe ? (int)oldframe->sentTimeStamp : 0;
+		header[3] = oldframe ? oldframe->num_entities : 0;
+		header[4] = (int)frame->sentTimeStamp;
+		header[5] = frame->num_entities;
+		header[6] = packing ? packing->coordBits : 0;
+
+		for( i = 0; i < header[3]; i++ )
+			oldnums[i] = client_entities->entities[( oldframe->first_entity+i )%client_entities->num_entities].number;
+		for( i = 0; i < header[5]; i++ )
+			newnums[i] = client_entities->entities[( frame->first_entity+i )%client_entities->num_entities].number;
+
+		keys[0].data = header; keys[0].size = sizeof( header );
+		keys[1].data = oldnums; keys[1].size = sizeof( oldnums[0] ) * header[3];
+		keys[2].data = newnums; keys[2].size = sizeof( newnums[0] ) * header[5];
+		if( SNAP_EncodeCacheLookup( cache, keys, 3, msg, &hash ) )
+			return;
+	}
+
+	start = msg->cursize;
+
+	SNAP_EmitPacketEntities( gi, oldframe, frame, msg, baselines, client_entities ? client_entities->entities : NULL, client_entities ? client_entities->num_entities : 0, packing );
+
+	if( cache )
+		SNAP_EncodeCacheStore( cache, frameNum, gameTime, keys, 3, hash, msg, start );
+}
+
 /*
 * SNAP_WriteFrameSnapToClient
 */
 void SNAP_WriteFrameSnapToClient( ginfo_t *gi, client_t *client, msg_t *msg, unsigned int frameNum, unsigned int gameTime,
-								 entity_state_t *baselines, client_entities_t *client_entities,
+								 entity_state_t *baselines, client_entities_t *client_entities, snap_enccache_t *enccache,
 								 int numcmds, gcommand_t *commands, const char *commandsData )
 {
 	client_snapshot_t *frame, *oldframe;
 	int flags, i, index, pos, length, supcnt;
+	msg_packing_t packing, *pack;
 
 	// this is the frame we are creating
 	frame = &client->snapShots[frameNum & UPDATE_MASK];
@@ -679,6 +1216,16 @@ void SNAP_WriteFrameSnapToClient( ginfo_t *gi, client_t *client, msg_t *msg, uns
 		flags |= FRAMESNAP_FLAG_ALLENTITIES;
 	if( frame->multipov )
 		flags |= FRAMESNAP_FLAG_MULTIPOV;
+
+	// older clients get byte-aligned snapshots
+	pack = NULL;
+	if( client->protocol == APP_PROTOCOL_VERSION )
+	{
+		memset( &packing, 0, sizeof( packing ) );
+		packing.coordBits = gi->coord_bits ? gi->coord_bits : MSG_COORD_BITS;
+		pack = &packing;
+		flags |= FRAMESNAP_FLAG_BITPACKED;
+	}
 	MSG_WriteByte( msg, flags );
 
 	supcnt = client->suppressCount;
@@ -688,6 +1235,9 @@ void SNAP_WriteFrameSnapToClient( ginfo_t *gi, client_t *client, msg_t *msg, uns
 	client->suppressCount = 0;
 	MSG_WriteByte( msg, supcnt );	// rate dropped packets
 
+	if( pack )
+		MSG_WriteByte( msg, pack->coordBits );
+
 	// add game comands
 	MSG_WriteByte( msg, svc_gamecommands );
 	if( frame->multipov )
@@ -727,18 +1277,23 @@ void SNAP_WriteFrameSnapToClient( ginfo_t *gi, client_t *client, msg_t *msg, uns
 
 	SNAP_WriteDeltaGameStateToClient( oldframe, frame, msg );
 
-	// delta encode the playerstate
-	for( i = 0; i < frame->numplayers; i++ )
+	// only multipov frames are shared between clients
+	if( !frame->multipov )
+		enccache = NULL;
+
+	if( enccache )
 	{
-		if( oldframe && oldframe->numplayers > i )
-			SNAP_WritePlayerstateToClient( &oldframe->ps[i], &frame->ps[i], msg );
-		else
-			SNAP_WritePlayerstateToClient( NULL, &frame->ps[i], msg );
+		QMutex_Lock( enccache->mutex );
+		SNAP_EncodeCacheBegin( enccache, client_entities, baselines, frameNum, gameTime );
+		QMutex_Unlock( enccache->mutex );
 	}
-	MSG_WriteByte( msg, 0 );
+
+	// delta encode the playerstate
+	SNAP_WriteFramePlayerstates( enccache, oldframe, frame, msg, frameNum, gameTime, pack );
 
 	// delta encode the entities
-	SNAP_EmitPacketEntities( gi, oldframe, frame, msg, baselines, client_entities ? client_entities->entities : NULL, client_entities ? client_entities->num_entities : 0 );
+	SNAP_WriteFrameEntities( gi, enccache, oldframe, frame, oldframe ? client->lastframe : -1, msg, frameNum, gameTime,
+		baselines, client_entities, pack );
 
 	// write length into reserved space
 	length = msg->cursize - pos - 2;
@@ -892,10 +1447,193 @@ static bool SNAP_SnapCullSoundEntity( cmodel_state_t *cms, edict_t *ent, vec3_t
 	return true;
 }
 
+//=====================================================================
+
+/*
+* Clients sharing the same merged PVS and portal area (spectators, chasecams)
+* get identical results from the per-entity area and PVS checks, so these
+* are computed once per frame for every distinct visibility set and shared.
+* Only the client-specific filters and sound culling are evaluated per client.
+*/
+#define SNAP_VISCACHE_ENTRIES	64
+
+typedef struct
+{
+	unsigned int hash;
+	int clientarea;
+	uint8_t *pvs;						// [pvsSize]
+	uint8_t *areabits;					// [areaSize]
+	uint8_t areaculled[MAX_EDICTS/8];
+	uint8_t pvsculled[MAX_EDICTS/8];
+} snap_visentry_t;
+
+typedef struct snap_viscache_s
+{
+	qmutex_t *mutex;
+	mempool_t *mempool;
+
+	const cmodel_state_t *cms;
+	unsigned int frameNum;
+	unsigned int timeStamp;
+
+	int pvsSize, areaSize;
+	int bufSize;
+	int numEntries;
+	snap_visentry_t entries[SNAP_VISCACHE_ENTRIES];
+} snap_viscache_t;
+
+/*
+* SNAP_CreateVisCache
+*/
+snap_viscache_t *SNAP_CreateVisCache( mempool_t *mempool )
+{
+	snap_viscache_t *cache;
+
+	cache = ( snap_viscache_t * )Mem_Alloc( mempool, sizeof( *cache ) );
+	cache->mempool = mempool;
+	cache->mutex = QMutex_Create();
+	return cache;
+}
+
+/*
+* SNAP_DestroyVisCache
+*/
+void SNAP_DestroyVisCache( snap_viscache_t **pcache )
+{
+	int i;
+	snap_viscache_t *cache;
+
+	assert( pcache != NULL );
+	cache = *pcache;
+	if( !cache )
+		return;
+
+	for( i = 0; i < SNAP_VISCACHE_ENTRIES; i++ )
+	{
+		if( cache->entries[i].pvs )
+			Mem_Free( cache->entries[i].pvs );
+	}
+
+	QMutex_Destroy( &cache->mutex );
+	Mem_Free( cache );
+	*pcache = NULL;
+}
+
+/*
+* SNAP_HashVisSet
+*/
+static unsigned int SNAP_HashVisSet( const uint8_t *pvs, int pvsSize, const uint8_t *areabits, int areaSize, int clientarea )
+{
+	int i;
+	unsigned int hash = 2166136261u ^ (unsigned int)clientarea;
+
+	for( i = 0; i < pvsSize; i++ )
+		hash = ( hash ^ pvs[i] ) * 16777619u;
+	for( i = 0; i < areaSize; i++ )
+		hash = ( hash ^ areabits[i] ) * 16777619u;
+	return hash;
+}
+
+/*
+* SNAP_VisCacheFind
+*
+* Must be called with the cache mutex held. Entries are never modified
+* after being added, until the cache is reset for the next frame.
+*/
+static snap_visentry_t *SNAP_VisCacheFind( snap_viscache_t *cache, unsigned int hash, const uint8_t *pvs, const uint8_t *areabits, int clientarea )
+{
+	int i;
+	snap_visentry_t *entry;
+
+	for( i = 0, entry = cache->entries; i < cache->numEntries; i++, entry++ )
+	{
+		if( entry->hash != hash || entry->clientarea != clientarea )
+			continue;
+		if( memcmp( entry->pvs, pvs, cache->pvsSize ) || memcmp( entry->areabits, areabits, cache->areaSize ) )
+			continue;
+		return entry;
+	}
+
+	return NULL;
+}
+
+/*
+* SNAP_VisCacheBegin
+*
+* Drops the entries from previous frames. Must be called with the cache mutex held.
+*/
+static void SNAP_VisCacheBegin( snap_viscache_t *cache, cmodel_state_t *cms, unsigned int frameNum, unsigned int timeStamp )
+{
+	int i, bufSize;
+
+	if( cache->cms == cms && cache->frameNum == frameNum && cache->timeStamp == timeStamp )
+		return;
+
+	cache->cms = cms;
+	cache->frameNum = frameNum;
+	cache->timeStamp = timeStamp;
+	cache->numEntries = 0;
+	cache->pvsSize = CM_ClusterRowSize( cms );
+	cache->areaSize = CM_AreaRowSize( cms );
+
+	bufSize = cache->pvsSize + cache->areaSize;
+	if( bufSize > cache->bufSize )
+	{
+		for( i = 0; i < SNAP_VISCACHE_ENTRIES; i++ )
+		{
+			if( cache->entries[i].pvs )
+				Mem_Free( cache->entries[i].pvs );
+			cache->entries[i].pvs = NULL;
+		}
+		cache->bufSize = bufSize;
+	}
+
+	for( i = 0; i < SNAP_VISCACHE_ENTRIES; i++ )
+	{
+		if( !cache->entries[i].pvs )
+			cache->entries[i].pvs = ( uint8_t * )Mem_Alloc( cache->mempool, cache->bufSize );
+		cache->entries[i].areabits = cache->entries[i].pvs + cache->pvsSize;
+	}
+}
+
+/*
+* SNAP_BuildVisEntry
+*
+* Runs the area and PVS checks for all entities that may need them
+*/
+static void SNAP_BuildVisEntry( cmodel_state_t *cms, ginfo_t *gi, int clientarea, uint8_t *areabits, uint8_t *fatpvs, snap_visentry_t *vis )
+{
+	int entNum;
+	edict_t *ent;
+
+	memset( vis->areaculled, 0, sizeof( vis->areaculled ) );
+	memset( vis->pvsculled, 0, sizeof( vis->pvsculled ) );
+
+	for( entNum = 1; entNum < gi->num_edicts; entNum++ )
+	{
+		ent = EDICT_NUM( entNum );
+		if( ent->r.svflags & ( SVF_NOCLIENT|SVF_BROADCAST ) )
+			continue;
+		if( ent->r.areanum < 0 )
+			continue;
+
+		if( clientarea >= 0 && !( areabits[ent->r.areanum>>3] & ( 1<<( ent->r.areanum&7 ) ) ) )
+		{
+			if( ent->r.areanum2 < 0 || !( areabits[ent->r.areanum2>>3] & ( 1<<( ent->r.areanum2&7 ) ) ) )
+				vis->areaculled[entNum>>3] |= 1<<( entNum&7 );
+		}
+
+		if( SNAP_PVSCullEntity( cms, fatpvs, ent ) )
+			vis->pvsculled[entNum>>3] |= 1<<( entNum&7 );
+	}
+}
+
 /*
 * SNAP_SnapCullEntity
+*
+* If vis is not NULL, the area and PVS checks are looked up from it
 */
-static bool SNAP_SnapCullEntity( cmodel_state_t *cms, edict_t *ent, edict_t *clent, client_snapshot_t *frame, vec3_t vieworg, uint8_t *fatpvs )
+static bool SNAP_SnapCullEntity( cmodel_state_t *cms, edict_t *ent, edict_t *clent, client_snapshot_t *frame, vec3_t vieworg, uint8_t *fatpvs, const snap_visentry_t *vis )
 {
 	uint8_t *areabits;
 	bool snd_cull_only;
@@ -926,7 +1664,12 @@ static bool SNAP_SnapCullEntity( cmodel_state_t *cms, edict_t *ent, edict_t *cle
 
 	if( ent->r.areanum < 0 )
 		return true;
-	if( frame->clientarea >= 0 )
+	if( vis )
+	{
+		if( vis->areaculled[ent->s.number>>3] & ( 1<<( ent->s.number&7 ) ) )
+			return true; // blocked by a door
+	}
+	else if( frame->clientarea >= 0 )
 	{
 		// this is the same as CM_AreasConnected but portal's visibility included
 		areabits = frame->areabits + frame->clientarea * CM_AreaRowSize( cms );
@@ -956,17 +1699,69 @@ static bool SNAP_SnapCullEntity( cmodel_state_t *cms, edict_t *ent, edict_t *cle
 	// pure sound emitters don't use PVS culling at all
 	if( snd_cull_only && snd_culled )
 		return true;
-	return snd_culled && SNAP_PVSCullEntity( cms, fatpvs, ent );	// cull by PVS
+	if( !snd_culled )
+		return false;
+	if( vis )
+		return ( vis->pvsculled[ent->s.number>>3] & ( 1<<( ent->s.number&7 ) ) ) != 0;
+	return SNAP_PVSCullEntity( cms, fatpvs, ent );	// cull by PVS
+}
+
+/*
+* SNAP_GetVisEntry
+*
+* Returns the shared area and PVS culling results for this visibility set,
+* computing them into the provided storage if nobody has done that yet this frame
+*/
+static const snap_visentry_t *SNAP_GetVisEntry( snap_viscache_t *cache, cmodel_state_t *cms, ginfo_t *gi, unsigned int frameNum, unsigned int timeStamp,
+	client_snapshot_t *frame, uint8_t *fatpvs, snap_visentry_t *storage )
+{
+	unsigned int hash;
+	uint8_t *areabits;
+	snap_visentry_t *entry;
+
+	areabits = frame->areabits + frame->clientarea * CM_AreaRowSize( cms );
+
+	QMutex_Lock( cache->mutex );
+	SNAP_VisCacheBegin( cache, cms, frameNum, timeStamp );
+	hash = SNAP_HashVisSet( fatpvs, cache->pvsSize, areabits, cache->areaSize, frame->clientarea );
+	entry = SNAP_VisCacheFind( cache, hash, fatpvs, areabits, frame->clientarea );
+	QMutex_Unlock( cache->mutex );
+
+	if( entry )
+		return entry;
+
+	// build our own copy outside of the lock
+	SNAP_BuildVisEntry( cms, gi, frame->clientarea, areabits, fatpvs, storage );
+
+	QMutex_Lock( cache->mutex );
+	if( cache->frameNum == frameNum && cache->numEntries < SNAP_VISCACHE_ENTRIES &&
+		!SNAP_VisCacheFind( cache, hash, fatpvs, areabits, frame->clientarea ) )
+	{
+		entry = &cache->entries[cache->numEntries];
+		entry->hash = hash;
+		entry->clientarea = frame->clientarea;
+		memcpy( entry->pvs, fatpvs, cache->pvsSize );
+		memcpy( entry->areabits, areabits, cache->areaSize );
+		memcpy( entry->areaculled, storage->areaculled, sizeof( entry->areaculled ) );
+		memcpy( entry->pvsculled, storage->pvsculled, sizeof( entry->pvsculled ) );
+		cache->numEntries++;
+	}
+	QMutex_Unlock( cache->mutex );
+
+	return storage;
 }
 
 /*
 * SNAP_BuildSnapEntitiesList
 */
-static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_t *clent, vec3_t vieworg, vec3_t skyorg, uint8_t *fatpvs, client_snapshot_t *frame, snapshotEntityNumbers_t *entsList )
+static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_t *clent, vec3_t vieworg, vec3_t skyorg, uint8_t *fatpvs, 
+	client_snapshot_t *frame, snapshotEntityNumbers_t *entsList, snap_viscache_t *viscache, unsigned int frameNum, unsigned int timeStamp )
 {
 	int leafnum = -1, clusternum = -1, clientarea = -1;
 	int entNum;
 	edict_t	*ent;
+	const snap_visentry_t *vis = NULL;
+	snap_visentry_t visStorage;
 
 	// find the client's PVS
 	if( frame->allentities )
@@ -1016,7 +1811,7 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_
 			if( ent->r.svflags & SVF_PORTAL )
 			{
 				// merge visibility sets if portal
-				if( SNAP_SnapCullEntity( cms, ent, clent, frame, vieworg, fatpvs ) )
+				if( SNAP_SnapCullEntity( cms, ent, clent, frame, vieworg, fatpvs, NULL ) )
 					continue;
 
 				if( !VectorCompare( ent->s.origin, ent->s.origin2 ) )
@@ -1025,6 +1820,10 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_
 		}
 	}
 
+	// the visibility set is final now, see if another client has already culled against it
+	if( viscache && clent && !frame->allentities && clientarea >= 0 )
+		vis = SNAP_GetVisEntry( viscache, cms, gi, frameNum, timeStamp, frame, fatpvs, &visStorage );
+
 	// add the entities to the list
 	for( entNum = 1; entNum < gi->num_edicts; entNum++ )
 	{
@@ -1038,7 +1837,7 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_
 		}
 
 		// always add the client entity, even if SVF_NOCLIENT
-		if( ( ent != clent ) && SNAP_SnapCullEntity( cms, ent, clent, frame, vieworg, fatpvs ) )
+		if( ( ent != clent ) && SNAP_SnapCullEntity( cms, ent, clent, frame, vieworg, fatpvs, vis ) )
 			continue;
 
 		// add it
@@ -1069,7 +1868,7 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_
 * copies off the playerstat and areabits.
 */
 void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int frameNum, unsigned int timeStamp,
-							   fatvis_t *fatvis, client_t *client,
+							   fatvis_t *fatvis, snap_viscache_t *viscache, client_t *client,
 							   game_state_t *gameState, client_entities_t *client_entities,
 							   bool relay, mempool_t *mempool )
 {
@@ -1182,7 +1981,7 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int f
 	//=============================
 	entsList.numSnapshotEntities = 0;
 	memset( entsList.entityAddedToSnapList, 0, sizeof( entsList.entityAddedToSnapList ) );
-	SNAP_BuildSnapEntitiesList( cms, gi, clent, org, fatvis->skyorg, fatvis->pvs, frame, &entsList );
+	SNAP_BuildSnapEntitiesList( cms, gi, clent, org, fatvis->skyorg, fatvis->pvs, frame, &entsList, viscache, frameNum, timeStamp );
 
 	//Com_Printf( "Snap NumEntities:%i\n", entsList.numSnapshotEntities );
 
@@ -1202,8 +2001,9 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int f
 
 	//=============================
 
-	// dump the entities list
-	ne = client_entities->next_entities;
+	// dump the entities list, reserving the range atomically since
+	// snapshots for different clients may be built in parallel
+	ne = Sys_Atomic_Add( (volatile int *)&client_entities->next_entities, entsList.numSnapshotEntities, NULL );
 	frame->num_entities = 0;
 	frame->first_entity = ne;
 
@@ -1223,8 +2023,6 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int f
 		frame->num_entities++;
 		ne++;
 	}
-
-	client_entities->next_entities = ne;
 }
 
 /*
@@ -23,6 +23,16 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "../qcommon/qcommon.h"
 
+typedef struct
+{
+	void *data;
+	size_t size;		// size of the data buffer
+	size_t length;		// length of the datagram
+	void *addr;			// struct sockaddr_storage
+	int addrlen;
+	bool truncated;		// didn't fit into the buffer
+} net_datagram_t;
+
 void	    Sys_NET_Init( void );
 void	    Sys_NET_Shutdown( void );
 
@@ -33,4 +43,7 @@ int			Sys_NET_SocketIoctl( socket_handle_t handle, long request, ioctl_param_t*
 
 int64_t		Sys_NET_SendFile( socket_handle_t handle, int fileno, size_t offset, size_t count );
 
+int			Sys_NET_RecvMultiple( socket_handle_t handle, net_datagram_t *datagrams, int count );
+int			Sys_NET_SendMultiple( socket_handle_t handle, const net_datagram_t *datagrams, int count );
+
 #endif // __SYS_NET_H
@@ -37,4 +37,9 @@ void Sys_CondVar_Destroy( qcondvar_t *cond );
 bool Sys_CondVar_Wait( qcondvar_t *cond, qmutex_t *mutex, unsigned int timeout_msec );
 void Sys_CondVar_Wake( qcondvar_t *cond );
 
+// a thread key holds a value per thread, the destructor is called with it
+// when a thread that set a non-NULL value exits, keys are never destroyed
+int Sys_ThreadKey_Create( qthreadkey_t **pkey, void ( *destructor )( void * ) );
+void Sys_ThreadKey_Set( qthreadkey_t *key, void *value );
+
 #endif // SYS_THREADS_H
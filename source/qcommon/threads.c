@@ -217,6 +217,16 @@ static void QBufPipe_Wake( qbufPipe_t *pipe )
 	QCondVar_Wake( pipe->nonempty_condvar );
 }
 
+/*
+* QBufPipe_WakeReader
+*/
+static void QBufPipe_WakeReader( qbufPipe_t *pipe )
+{
+	QMutex_Lock( pipe->nonempty_mutex );
+	QBufPipe_Wake( pipe );
+	QMutex_Unlock( pipe->nonempty_mutex );
+}
+
 /*
 * QBufPipe_Finish
 *
@@ -226,9 +236,7 @@ static void QBufPipe_Wake( qbufPipe_t *pipe )
 void QBufPipe_Finish( qbufPipe_t *pipe )
 {
 	while( Sys_Atomic_CAS( &pipe->cmdbuf_len, 0, 0, pipe->cmdbuf_mutex ) == false && !pipe->terminated ) {
-		QMutex_Lock( pipe->nonempty_mutex );
-		QBufPipe_Wake( pipe );
-		QMutex_Unlock( pipe->nonempty_mutex );
+		QBufPipe_WakeReader( pipe );
 		QThread_Yield();
 	}
 }
@@ -245,10 +253,12 @@ static void *QBufPipe_AllocCmd( qbufPipe_t *pipe, unsigned cmd_size )
 
 /*
 * QBufPipe_BufLenAdd
+*
+* Returns the length before the addition
 */
-static void QBufPipe_BufLenAdd( qbufPipe_t *pipe, int val )
+static int QBufPipe_BufLenAdd( qbufPipe_t *pipe, int val )
 {
-	Sys_Atomic_Add( &pipe->cmdbuf_len, val, pipe->cmdbuf_mutex );
+	return Sys_Atomic_Add( &pipe->cmdbuf_len, val, pipe->cmdbuf_mutex );
 }
 
 /*
@@ -264,7 +274,7 @@ void QBufPipe_WriteCmd( qbufPipe_t *pipe, const void *cmd, unsigned cmd_size )
 {
 	void *buf;
 	unsigned write_remains;
-	bool was_empty;
+	bool was_empty = false;
 	
 	if( !pipe ) {
 		return;
@@ -278,7 +288,6 @@ void QBufPipe_WriteCmd( qbufPipe_t *pipe, const void *cmd, unsigned cmd_size )
 		pipe->write_pos = 0;
 	}
 
-	was_empty = Sys_Atomic_CAS( &pipe->cmdbuf_len, 0, 0, pipe->cmdbuf_mutex ) == true;
 	write_remains = pipe->bufSize - pipe->write_pos;
 
 	if( sizeof( int ) > write_remains ) {
@@ -291,7 +300,7 @@ void QBufPipe_WriteCmd( qbufPipe_t *pipe, const void *cmd, unsigned cmd_size )
 		}
 
 		// not enough space to enpipe even the reset cmd, rewind
-		QBufPipe_BufLenAdd( pipe, write_remains ); // atomic
+		was_empty = QBufPipe_BufLenAdd( pipe, write_remains ) == 0; // atomic
 		pipe->write_pos = 0;
 	} else if( cmd_size > write_remains ) {
 		int *cmd;
@@ -308,7 +317,7 @@ void QBufPipe_WriteCmd( qbufPipe_t *pipe, const void *cmd, unsigned cmd_size )
 		cmd = QBufPipe_AllocCmd( pipe, sizeof( int ) );
 		*cmd = -1;
 
-		QBufPipe_BufLenAdd( pipe, sizeof( *cmd ) + write_remains ); // atomic
+		was_empty = QBufPipe_BufLenAdd( pipe, sizeof( *cmd ) + write_remains ) == 0; // atomic
 		pipe->write_pos = 0;
 	}
 	else
@@ -324,13 +333,15 @@ void QBufPipe_WriteCmd( qbufPipe_t *pipe, const void *cmd, unsigned cmd_size )
 
 	buf = QBufPipe_AllocCmd( pipe, cmd_size );
 	memcpy( buf, cmd, cmd_size );
-	QBufPipe_BufLenAdd( pipe, cmd_size ); // atomic
+	if( QBufPipe_BufLenAdd( pipe, cmd_size ) == 0 ) { // atomic
+		was_empty = true;
+	}
 
-	// wake the other thread waiting for signal
+	// wake the other thread waiting for signal. the reader only sleeps after
+	// seeing an empty buffer with the mutex held, so it's enough to wake it
+	// when this write is the one that made the buffer non-empty
 	if( was_empty ) {
-		QMutex_Lock( pipe->nonempty_mutex );
-		QBufPipe_Wake( pipe );
-		QMutex_Unlock( pipe->nonempty_mutex );
+		QBufPipe_WakeReader( pipe );
 	}
 }
 
@@ -405,7 +416,11 @@ void QBufPipe_Wait( qbufPipe_t *pipe, int (*read)( qbufPipe_t *, unsigned( ** )(
 		while( Sys_Atomic_CAS( &pipe->cmdbuf_len, 0, 0, pipe->cmdbuf_mutex ) == true ) {
 			QMutex_Lock( pipe->nonempty_mutex );
 
-			result = QCondVar_Wait( pipe->nonempty_condvar, pipe->nonempty_mutex, timeout_msec );
+			// check again with the mutex held, or the wake up may come
+			// between the check above and the wait
+			if( Sys_Atomic_CAS( &pipe->cmdbuf_len, 0, 0, pipe->cmdbuf_mutex ) == true ) {
+				result = QCondVar_Wait( pipe->nonempty_condvar, pipe->nonempty_mutex, timeout_msec );
+			}
 
 			// don't hold the mutex, changes to cmdbuf_len are atomic anyway
 			QMutex_Unlock( pipe->nonempty_mutex );
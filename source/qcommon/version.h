@@ -75,6 +75,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 #endif
 
+#ifndef APP_LEGACY_PROTOCOL_VERSION
+#define APP_LEGACY_PROTOCOL_VERSION		APP_PROTOCOL_VERSION
+#endif
+
 #ifndef APP_DEMO_PROTOCOL_VERSION
 #ifdef PUBLIC_BUILD
 #define APP_DEMO_PROTOCOL_VERSION		1
@@ -45,9 +45,16 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 
 #ifdef PUBLIC_BUILD
-#define APP_PROTOCOL_VERSION			22
+#define APP_PROTOCOL_VERSION			23
 #else
-#define APP_PROTOCOL_VERSION			2200
+#define APP_PROTOCOL_VERSION			2201
+#endif
+
+// still accepted, snapshots are sent byte-aligned to these clients
+#ifdef PUBLIC_BUILD
+#define APP_LEGACY_PROTOCOL_VERSION		22
+#else
+#define APP_LEGACY_PROTOCOL_VERSION		2200
 #endif
 
 #ifdef PUBLIC_BUILD
@@ -34,6 +34,11 @@ struct qcondvar_s {
 	SDL_cond *c;
 };
 
+struct qthreadkey_s {
+	SDL_TLSID id;
+	void ( *destructor )( void * );
+};
+
 /*
 * Sys_Mutex_Create
 */
@@ -117,7 +122,7 @@ void Sys_Thread_Yield( void )
 */
 int Sys_Atomic_Add( volatile int *value, int add, qmutex_t *mutex )
 {
-	return SDL_AtomicAdd( ( SDL_atomic_t * )value, add ) + add;
+	return SDL_AtomicAdd( ( SDL_atomic_t * )value, add );
 }
 
 /*
@@ -186,3 +191,31 @@ void Sys_CondVar_Wake( qcondvar_t *cond )
 
 	SDL_CondSignal( cond->c );
 }
+
+/*
+* Sys_ThreadKey_Create
+*/
+int Sys_ThreadKey_Create( qthreadkey_t **pkey, void ( *destructor )( void * ) )
+{
+	qthreadkey_t *key;
+	SDL_TLSID id;
+
+	id = SDL_TLSCreate();
+	if( !id ) {
+		return -1;
+	}
+
+	key = ( qthreadkey_t * )Q_malloc( sizeof( *key ) );
+	key->id = id;
+	key->destructor = destructor;
+	*pkey = key;
+	return 0;
+}
+
+/*
+* Sys_ThreadKey_Set
+*/
+void Sys_ThreadKey_Set( qthreadkey_t *key, void *value )
+{
+	SDL_TLSSet( key->id, value, ( void ( SDLCALL * )( void * ) )key->destructor );
+}
@@ -49,6 +49,7 @@ typedef struct ginfo_s
 	int num_edicts;         // current number, <= max_edicts
 	int max_edicts;
 	int max_clients;		// <= sv_maxclients, <= max_edicts
+	int coord_bits;			// size of the bit-packed coordinates, 0 for the full range
 } ginfo_t;
 
 #define MAX_FRAME_SOUNDS 256
@@ -136,6 +137,7 @@ typedef struct client_s
 	bool reliable;                  // no need for acks, connection is reliable
 	bool mv;                        // send multiview data to the client
 	bool individual_socket;         // client has it's own socket that has to be checked separately
+	int protocol;                   // bit-packed snapshots for APP_PROTOCOL_VERSION, see SNAP_WriteFrameSnapToClient
 
 	socket_t socket;
 
@@ -224,6 +226,7 @@ typedef struct
 	client_t client;                // special client for writing the messages
 	char meta_data[SNAP_MAX_DEMO_META_DATA_SIZE];
 	size_t meta_data_realsize;
+	snap_demoseekindex_t seekindex;
 } server_static_demo_t;
 
 typedef server_static_demo_t demorec_t;
@@ -289,6 +292,8 @@ typedef struct
 	cmodel_state_t *cms;                // passed to CM-functions
 
 	fatvis_t fatvis;
+	struct snap_viscache_s *viscache;	// shared culling results for clients with the same PVS
+	struct snap_enccache_s *enccache;	// frame data encoded once for clients receiving the same deltas
 
 	char *motd;
 
@@ -334,6 +339,7 @@ extern cvar_t *sv_http_port;
 extern cvar_t *sv_http_upstream_baseurl;
 extern cvar_t *sv_http_upstream_ip;
 extern cvar_t *sv_http_upstream_realip_header;
+extern cvar_t *sv_http_maxconnections;
 #endif
 
 extern cvar_t *sv_skilllevel;
@@ -344,11 +350,17 @@ extern cvar_t *sv_enforcetime;
 extern cvar_t *sv_showRcon;
 extern cvar_t *sv_showChallenge;
 extern cvar_t *sv_showInfoQueries;
+extern cvar_t *sv_infoQueryRate;         // status queries per second allowed from one address, 0 = no limit
+extern cvar_t *sv_infoQueryBurst;
+extern cvar_t *sv_infoQueryGlobalRate;   // status queries per second answered in total, 0 = no limit
 extern cvar_t *sv_highchars;
 
 //wsw : jal
 extern cvar_t *sv_maxrate;
 extern cvar_t *sv_compresspackets;
+extern cvar_t *sv_compresscodecs;  // preferred netchan compressors, in order
+extern cvar_t *sv_udpbatch;       // receive and send UDP datagrams in batches
+extern cvar_t *sv_snapthreads;    // worker threads building client snapshots, 0 = main thread only
 extern cvar_t *sv_public;         // should heartbeats be sent
 
 // wsw : debug netcode
@@ -411,6 +423,7 @@ void SV_UpdateActivity( void );
 void SV_ConnectionlessPacket( const socket_t *socket, const netadr_t *address, msg_t *msg );
 void SV_InitMaster( void );
 void SV_UpdateMaster( void );
+void SV_InfoQueryStats_f( void );
 
 //
 // sv_init.c
@@ -439,6 +452,7 @@ bool SV_SendClientsFragments( void );
 void SV_InitClientMessage( client_t *client, msg_t *msg, uint8_t *data, size_t size );
 bool SV_SendMessageToClient( client_t *client, msg_t *msg );
 void SV_ResetClientFrameCounters( void );
+void SV_SnapThreads_Shutdown( void );
 
 typedef enum { RD_NONE, RD_PACKET } redirect_t;
 
@@ -471,7 +485,7 @@ void SV_BroadcastCommand( const char *format, ... );
 //
 void SV_ParseClientMessage( client_t *client, msg_t *msg );
 bool SV_ClientConnect( const socket_t *socket, const netadr_t *address, client_t *client, char *userinfo,
-                           int game_port, int challenge, bool fakeClient, bool tvClient,
+                           int game_port, int challenge, int protocol, bool fakeClient, bool tvClient,
                            unsigned int ticket_id, int session_id );
 void SV_DropClient( client_t *drop, int type, const char *format, ... );
 void SV_ExecuteClientThinks( int clientNum );
@@ -518,6 +532,7 @@ void SV_Demo_Start_f( void );
 void SV_Demo_Stop_f( void );
 void SV_Demo_Cancel_f( void );
 void SV_Demo_Purge_f( void );
+void SV_Demo_Stats_f( void );
 
 void SV_DemoList_f( client_t *client );
 void SV_DemoGet_f( client_t *client );
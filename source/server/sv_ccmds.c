@@ -403,6 +403,42 @@ static void SV_CvarCheck_f( void )
 	SV_SendServerCommand( client, "cvarinfo \"%s\"", Cmd_Argv( 2 ) );
 }
 
+/*
+* SV_TraceStress_f
+* Compare single and multi threaded collision traces on the current map
+*/
+static void SV_TraceStress_f( void )
+{
+	if( !svs.cms || sv.state == ss_dead )
+	{
+		Com_Printf( "No map loaded\n" );
+		return;
+	}
+
+	if( Cmd_Argc() < 2 )
+	{
+		Com_Printf( "Usage: tracestress <traces> [threads]\n" );
+		return;
+	}
+
+	CM_TraceStressTest( svs.cms, atoi( Cmd_Argv( 1 ) ), Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 4 );
+}
+
+/*
+* SV_TraceBench_f
+* Time the collision brush clipping kernels on the current map
+*/
+static void SV_TraceBench_f( void )
+{
+	if( !svs.cms || sv.state == ss_dead )
+	{
+		Com_Printf( "No map loaded\n" );
+		return;
+	}
+
+	CM_TraceBenchmark( svs.cms, Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 1000000 );
+}
+
 //===========================================================
 
 /*
@@ -414,6 +450,7 @@ void SV_InitOperatorCommands( void )
 	Cmd_AddCommand( "status", SV_Status_f );
 	Cmd_AddCommand( "serverinfo", SV_Serverinfo_f );
 	Cmd_AddCommand( "dumpuser", SV_DumpUser_f );
+	Cmd_AddCommand( "infoquerystats", SV_InfoQueryStats_f );
 
 	Cmd_AddCommand( "map", SV_Map_f );
 	Cmd_AddCommand( "devmap", SV_Map_f );
@@ -424,6 +461,7 @@ void SV_InitOperatorCommands( void )
 	Cmd_AddCommand( "serverrecordstop", SV_Demo_Stop_f );
 	Cmd_AddCommand( "serverrecordcancel", SV_Demo_Cancel_f );
 	Cmd_AddCommand( "serverrecordpurge", SV_Demo_Purge_f );
+	Cmd_AddCommand( "serverrecordstats", SV_Demo_Stats_f );
 
 	Cmd_AddCommand( "purelist", SV_PureList_f );
 
@@ -434,6 +472,8 @@ void SV_InitOperatorCommands( void )
 	}
 
 	Cmd_AddCommand( "cvarcheck", SV_CvarCheck_f );
+	Cmd_AddCommand( "tracestress", SV_TraceStress_f );
+	Cmd_AddCommand( "tracebench", SV_TraceBench_f );
 
 	Cmd_SetCompletionFunc( "map", SV_MapComplete_f );
 	Cmd_SetCompletionFunc( "devmap", SV_MapComplete_f );
@@ -449,6 +489,7 @@ void SV_ShutdownOperatorCommands( void )
 	Cmd_RemoveCommand( "status" );
 	Cmd_RemoveCommand( "serverinfo" );
 	Cmd_RemoveCommand( "dumpuser" );
+	Cmd_RemoveCommand( "infoquerystats" );
 
 	Cmd_RemoveCommand( "map" );
 	Cmd_RemoveCommand( "devmap" );
@@ -459,6 +500,7 @@ void SV_ShutdownOperatorCommands( void )
 	Cmd_RemoveCommand( "serverrecordstop" );
 	Cmd_RemoveCommand( "serverrecordcancel" );
 	Cmd_RemoveCommand( "serverrecordpurge" );
+	Cmd_RemoveCommand( "serverrecordstats" );
 
 	Cmd_RemoveCommand( "purelist" );
 
@@ -469,4 +511,6 @@ void SV_ShutdownOperatorCommands( void )
 	}
 
 	Cmd_RemoveCommand( "cvarcheck" );
+	Cmd_RemoveCommand( "tracestress" );
+	Cmd_RemoveCommand( "tracebench" );
 }
@@ -63,7 +63,7 @@ void SV_ClientCloseDownload( client_t *client )
 * this is the only place a client_t is ever initialized
 */
 bool SV_ClientConnect( const socket_t *socket, const netadr_t *address, client_t *client, char *userinfo,
-						  int game_port, int challenge, bool fakeClient, bool tvClient,
+						  int game_port, int challenge, int protocol, bool fakeClient, bool tvClient,
 						  unsigned int ticket_id, int session_id )
 {
 	int i;
@@ -93,6 +93,7 @@ bool SV_ClientConnect( const socket_t *socket, const netadr_t *address, client_t
 	memset( client, 0, sizeof( *client ) );
 	client->edict = ent;
 	client->challenge = challenge; // save challenge for checksumming
+	client->protocol = protocol;
 
 	client->tvclient = tvClient;
 
@@ -301,7 +302,7 @@ static void SV_New_f( client_t *client )
 
 	// send the serverdata
 	MSG_WriteByte( &tmpMessage, svc_serverdata );
-	MSG_WriteLong( &tmpMessage, APP_PROTOCOL_VERSION );
+	MSG_WriteLong( &tmpMessage, client->protocol );
 	MSG_WriteLong( &tmpMessage, svs.spawncount );
 	MSG_WriteShort( &tmpMessage, (unsigned short)svc.snapFrameTime );
 	MSG_WriteString( &tmpMessage, FS_BaseGameDirectory() );
@@ -43,6 +43,7 @@ static void SV_Demo_WriteStartMessages( void )
 {
 	// clear demo meta data, we'll write some keys later
 	svs.demo.meta_data_realsize = SNAP_ClearDemoMeta( svs.demo.meta_data, sizeof( svs.demo.meta_data ) );
+	SNAP_ClearDemoSeekIndex( &svs.demo.seekindex, sv.configstrings[0] );
 
 	SNAP_BeginDemoRecording( svs.demo.file, svs.spawncount, svc.snapFrameTime, sv.mapname, SV_BITFLAGS_RELIABLE, 
 		svs.purelist, sv.configstrings[0], sv.baselines );
@@ -54,6 +55,8 @@ static void SV_Demo_WriteStartMessages( void )
 void SV_Demo_WriteSnap( void )
 {
 	int i;
+	unsigned int time;
+	bool keyframe;
 	msg_t msg;
 	uint8_t msg_buffer[MAX_MSGLEN];
 
@@ -73,6 +76,15 @@ void SV_Demo_WriteSnap( void )
 		return;
 	}
 
+	// periodically write a non-delta frame, so that playback can seek to it
+	time = svs.gametime - svs.demo.basetime;
+	keyframe = SNAP_DemoKeyframeDue( &svs.demo.seekindex, time );
+	if( keyframe )
+	{
+		SNAP_RecordDemoKeyframe( svs.demo.file, &svs.demo.seekindex, time, sv.configstrings[0] );
+		svs.demo.client.nodelta = true;
+	}
+
 	MSG_Init( &msg, msg_buffer, sizeof( msg_buffer ) );
 
 	SV_BuildClientFrameSnap( &svs.demo.client );
@@ -85,6 +97,9 @@ void SV_Demo_WriteSnap( void )
 
 	svs.demo.duration = svs.gametime - svs.demo.basetime;
 	svs.demo.client.lastframe = sv.framenum; // FIXME: is this needed?
+
+	if( keyframe )
+		svs.demo.client.nodelta = false;
 }
 
 /*
@@ -97,6 +112,9 @@ static void SV_Demo_InitClient( void )
 	svs.demo.client.mv = true;
 	svs.demo.client.reliable = true;
 
+	// demos stay byte-aligned so older builds can play them back
+	svs.demo.client.protocol = 0;
+
 	svs.demo.client.reliableAcknowledge = 0;
 	svs.demo.client.reliableSequence = 0;
 	svs.demo.client.reliableSent = 0;
@@ -194,6 +212,9 @@ void SV_Demo_Start_f( void )
 	svs.demo.localtime = time( NULL );
 	SV_Demo_WriteStartMessages();
 
+	// compress and write the rest of the demo on a separate thread
+	SNAP_StartDemoWriter( svs.demo.file );
+
 	// write one nodelta frame
 	svs.demo.client.nodelta = true;
 	SV_Demo_WriteSnap();
@@ -224,6 +245,9 @@ static void SV_Demo_Stop( bool cancel, bool silent )
 		Com_Printf( "Stopped server demo recording: %s\n", svs.demo.filename );
 	}
 
+	// wait for the queued data to be written
+	SNAP_StopDemoWriter( svs.demo.file );
+
 	FS_FCloseFile( svs.demo.file );
 	svs.demo.file = 0;
 
@@ -245,6 +269,8 @@ static void SV_Demo_Stop( bool cancel, bool silent )
 		SV_SetDemoMetaKeyValue( "matchname", sv.configstrings[CS_MATCHNAME] );
 		SV_SetDemoMetaKeyValue( "matchscore", sv.configstrings[CS_MATCHSCORE] );
 		SV_SetDemoMetaKeyValue( "matchuuid", sv.configstrings[CS_MATCHUUID] );
+		svs.demo.meta_data_realsize = SNAP_SetDemoMetaSeekIndex( svs.demo.meta_data, sizeof( svs.demo.meta_data ), 
+			svs.demo.meta_data_realsize, &svs.demo.seekindex );
 
 		SNAP_WriteDemoMetaData( svs.demo.tempname, svs.demo.meta_data, svs.demo.meta_data_realsize );
 
@@ -283,6 +309,33 @@ void SV_Demo_Cancel_f( void )
 	SV_Demo_Stop( true, atoi( Cmd_Argv( 1 ) ) != 0 );
 }
 
+/*
+* SV_Demo_Stats_f
+* 
+* Prints the state of the demo writer thread
+*/
+void SV_Demo_Stats_f( void )
+{
+	snap_demowriterstats_t stats;
+
+	if( !svs.demo.file )
+	{
+		Com_Printf( "No server demo recording in progress\n" );
+		return;
+	}
+
+	if( !SNAP_GetDemoWriterStats( svs.demo.file, &stats ) )
+	{
+		Com_Printf( "Server demo is written synchronously\n" );
+		return;
+	}
+
+	Com_Printf( "Queued: %u bytes (max %u)\n", (unsigned int)stats.pending, (unsigned int)stats.maxPending );
+	Com_Printf( "Writes: %u\n", stats.numWrites );
+	Com_Printf( "Write latency: %u ms last, %u ms avg, %u ms max\n", stats.lastLatency, stats.avgLatency, stats.maxLatency );
+	Com_Printf( "Longest wait for queue space: %u ms\n", stats.maxStall );
+}
+
 /*
 * SV_Demo_Purge_f
 * 
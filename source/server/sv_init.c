@@ -242,6 +242,7 @@ static void SV_SpawnServer( const char *server, bool devmap )
 {
 	unsigned checksum;
 	int i;
+	vec3_t mins, maxs;
 
 	if( devmap )
 		Cvar_ForceSet( "sv_cheats", "1" );
@@ -270,6 +271,10 @@ static void SV_SpawnServer( const char *server, bool devmap )
 	Q_snprintfz( sv.configstrings[CS_WORLDMODEL], sizeof( sv.configstrings[CS_WORLDMODEL] ), "maps/%s.bsp", server );
 	CM_LoadMap( svs.cms, sv.configstrings[CS_WORLDMODEL], false, &checksum );
 
+	// size the bit-packed snapshot coordinates to the world bounds
+	CM_InlineModelBounds( svs.cms, CM_InlineModel( svs.cms, 0 ), mins, maxs );
+	sv.gi.coord_bits = MSG_CoordBitsForBounds( mins, maxs );
+
 	Q_snprintfz( sv.configstrings[CS_MAPCHECKSUM], sizeof( sv.configstrings[CS_MAPCHECKSUM] ), "%i", checksum );
 
 	// reserve the first modelIndexes for inline models
@@ -354,6 +359,8 @@ void SV_InitGame( void )
 	svs.clients = Mem_Alloc( sv_mempool, sizeof( client_t )*sv_maxclients->integer );
 	svs.client_entities.num_entities = sv_maxclients->integer * UPDATE_BACKUP * MAX_SNAP_ENTITIES;
 	svs.client_entities.entities = Mem_Alloc( sv_mempool, sizeof( entity_state_t ) * svs.client_entities.num_entities );
+	svs.viscache = SNAP_CreateVisCache( sv_mempool );
+	svs.enccache = SNAP_CreateEncodeCache( sv_mempool );
 
 	// init network stuff
 
@@ -375,7 +382,10 @@ void SV_InitGame( void )
 		if( !NET_OpenSocket( &svs.socket_udp, SOCKET_UDP, &address, true ) )
 			Com_Printf( "Error: Couldn't open UDP socket: %s\n", NET_ErrorString() );
 		else
+		{
+			NET_SetSocketBatching( &svs.socket_udp, sv_udpbatch->integer ? true : false );
 			socket_opened = true;
+		}
 
 		// IPv6
 		NET_StringToAddress( sv_ip6->string, &ipv6_address );
@@ -385,7 +395,10 @@ void SV_InitGame( void )
 			if( !NET_OpenSocket( &svs.socket_udp6, SOCKET_UDP, &ipv6_address, true ) )
 				Com_Printf( "Error: Couldn't open UDP6 socket: %s\n", NET_ErrorString() );
 			else
+			{
+				NET_SetSocketBatching( &svs.socket_udp6, sv_udpbatch->integer ? true : false );
 				socket_opened = true;
+			}
 		}
 		else
 			Com_Printf( "Error: invalid IPv6 address: %s\n", sv_ip6->string );
@@ -549,6 +562,9 @@ void SV_ShutdownGame( const char *finalmsg, bool reconnect )
 		memset( &svs.client_entities, 0, sizeof( svs.client_entities ) );
 	}
 
+	SNAP_DestroyVisCache( &svs.viscache );
+	SNAP_DestroyEncodeCache( &svs.enccache );
+
 	if( svs.cms )
 	{
 		// CM_ReleaseReference will take care of freeing up the memory
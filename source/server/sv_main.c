@@ -62,12 +62,16 @@ cvar_t *sv_http_port;
 cvar_t *sv_http_upstream_baseurl;
 cvar_t *sv_http_upstream_ip;
 cvar_t *sv_http_upstream_realip_header;
+cvar_t *sv_http_maxconnections;
 #endif
 
 cvar_t *sv_showclamp;
 cvar_t *sv_showRcon;
 cvar_t *sv_showChallenge;
 cvar_t *sv_showInfoQueries;
+cvar_t *sv_infoQueryRate;
+cvar_t *sv_infoQueryBurst;
+cvar_t *sv_infoQueryGlobalRate;
 cvar_t *sv_highchars;
 
 cvar_t *sv_hostname;
@@ -82,6 +86,9 @@ cvar_t *sv_reconnectlimit; // minimum seconds between connect messages
 
 cvar_t *sv_maxrate;
 cvar_t *sv_compresspackets;
+cvar_t *sv_compresscodecs;
+cvar_t *sv_snapthreads;
+cvar_t *sv_udpbatch;
 cvar_t *sv_masterservers;
 cvar_t *sv_masterservers_steam;
 cvar_t *sv_skilllevel;
@@ -165,7 +172,7 @@ static bool SV_ProcessPacket( netchan_t *netchan, msg_t *msg )
 	MSG_ReadShort( msg ); // game_port
 	if( msg->compressed )
 	{
-		zerror = Netchan_DecompressMessage( msg );
+		zerror = Netchan_DecompressMessage( netchan, msg );
 		if( zerror < 0 )
 		{
 			// compression error. Drop the packet
@@ -743,6 +750,17 @@ static void SV_CheckMatchUUID( void )
 	SV_MM_GetMatchUUID( &SV_CheckMatchUUID_Callback );
 }
 
+/*
+* SV_FlushPackets
+*
+* Sends the datagrams queued on the batching UDP sockets
+*/
+static void SV_FlushPackets( void )
+{
+	NET_FlushSocket( &svs.socket_udp );
+	NET_FlushSocket( &svs.socket_udp6 );
+}
+
 /*
 * SV_Frame
 */
@@ -751,6 +769,7 @@ void SV_Frame( int realmsec, int gamemsec )
 	const unsigned int wrappingPoint = 0x70000000;
 
 	time_before_game = time_after_game = 0;
+	time_snap_build = time_snap_send = 0;
 
 	// if server is not active, do nothing
 	if( !svs.initialized )
@@ -776,6 +795,9 @@ void SV_Frame( int realmsec, int gamemsec )
 	// get packets from clients
 	SV_ReadPackets();
 
+	// don't hold the replies back if we are going to sleep
+	SV_FlushPackets();
+
 	// apply latched userinfo changes
 	SV_CheckLatchedUserinfoChanges();
 
@@ -806,6 +828,8 @@ void SV_Frame( int realmsec, int gamemsec )
 	SV_CheckAutoUpdate();
 
 	SV_CheckPostUpdateRestart();
+
+	SV_FlushPackets();
 }
 
 //============================================================================
@@ -947,6 +971,7 @@ void SV_Init( void )
 	sv_http_upstream_baseurl =	Cvar_Get( "sv_http_upstream_baseurl", "", CVAR_ARCHIVE | CVAR_LATCH );
 	sv_http_upstream_realip_header = Cvar_Get( "sv_http_upstream_realip_header", "", CVAR_ARCHIVE );
 	sv_http_upstream_ip = Cvar_Get( "sv_http_upstream_ip", "", CVAR_ARCHIVE );
+	sv_http_maxconnections = Cvar_Get( "sv_http_maxconnections", "48", CVAR_ARCHIVE | CVAR_LATCH );
 #endif
 
 	rcon_password =		    Cvar_Get( "rcon_password", "", 0 );
@@ -958,6 +983,9 @@ void SV_Init( void )
 	sv_showRcon =		    Cvar_Get( "sv_showRcon", "1", 0 );
 	sv_showChallenge =	    Cvar_Get( "sv_showChallenge", "0", 0 );
 	sv_showInfoQueries =	Cvar_Get( "sv_showInfoQueries", "0", 0 );
+	sv_infoQueryRate =		Cvar_Get( "sv_infoQueryRate", "4", CVAR_ARCHIVE );
+	sv_infoQueryBurst =		Cvar_Get( "sv_infoQueryBurst", "8", CVAR_ARCHIVE );
+	sv_infoQueryGlobalRate =	Cvar_Get( "sv_infoQueryGlobalRate", "400", CVAR_ARCHIVE );
 	sv_highchars =			Cvar_Get( "sv_highchars", "1", 0 );
 
 	sv_uploads_http	=       Cvar_Get( "sv_uploads_http", "1", CVAR_READONLY );
@@ -1013,6 +1041,9 @@ void SV_Init( void )
 	// wsw : jal : cap client's exceding server rules
 	sv_maxrate =		    Cvar_Get( "sv_maxrate", "0", CVAR_DEVELOPER );
 	sv_compresspackets =	    Cvar_Get( "sv_compresspackets", "1", CVAR_DEVELOPER );
+	sv_compresscodecs =	    Cvar_Get( "sv_compresscodecs", "zstd lz4", CVAR_ARCHIVE );
+	sv_snapthreads =	    Cvar_Get( "sv_snapthreads", "0", CVAR_ARCHIVE );
+	sv_udpbatch =		    Cvar_Get( "sv_udpbatch", "1", CVAR_ARCHIVE|CVAR_LATCH );
 	sv_skilllevel =		    Cvar_Get( "sv_skilllevel", "2", CVAR_SERVERINFO|CVAR_ARCHIVE|CVAR_LATCH );
 
 	if( sv_skilllevel->integer > 2 )
@@ -1089,6 +1120,7 @@ void SV_Shutdown( const char *finalmsg )
 	ML_Shutdown();
 	SV_MM_Shutdown( true );
 	SV_ShutdownGame( finalmsg, false );
+	SV_SnapThreads_Shutdown();
 
 	SV_ShutdownOperatorCommands();
 
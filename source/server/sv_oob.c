@@ -19,6 +19,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 
 #include "server.h"
+#include "../qcommon/compression.h"
 #include "../matchmaker/mm_common.h"
 
 typedef struct sv_master_s
@@ -442,6 +443,215 @@ static char *SV_ShortInfoString( void )
 
 
 
+//==============================================================================
+//
+//INFO QUERY CACHE AND LIMITS
+//
+//==============================================================================
+
+// info strings are built at most once per server frame, no matter how many
+// queries arrive during it
+typedef struct
+{
+	bool valid;
+	int spawncount;
+	unsigned int realtime;
+	char string[MAX_MSGLEN - 16];
+} sv_infocache_t;
+
+enum
+{
+	INFOCACHE_SHORT,
+	INFOCACHE_LONG,
+	INFOCACHE_FULL,
+
+	INFOCACHE_TOTAL
+};
+
+static sv_infocache_t sv_infocache[INFOCACHE_TOTAL];
+
+// per-address token buckets, kept in small sets so that a flood of spoofed
+// addresses evicts idle entries before active ones
+#define INFOQUERY_BUCKET_SETS		256
+#define INFOQUERY_BUCKET_WAYS		4
+
+typedef struct
+{
+	netadr_t address;
+	unsigned int time;
+	float tokens;
+} sv_querybucket_t;
+
+static sv_querybucket_t sv_querybuckets[INFOQUERY_BUCKET_SETS][INFOQUERY_BUCKET_WAYS];
+static sv_querybucket_t sv_queryglobalbucket;
+
+static struct
+{
+	unsigned int queries;
+	unsigned int responses;
+	unsigned int limited;
+	unsigned int limitedGlobal;
+	unsigned int rebuilds;
+} sv_infoquerystats;
+
+/*
+* SV_CachedInfoString
+*/
+static const char *SV_CachedInfoString( int type )
+{
+	sv_infocache_t *cache = &sv_infocache[type];
+	const char *string;
+
+	if( cache->valid && cache->spawncount == svs.spawncount && cache->realtime == svs.realtime )
+		return cache->string;
+
+	if( type == INFOCACHE_SHORT )
+		string = SV_ShortInfoString();
+	else
+		string = SV_LongInfoString( type == INFOCACHE_FULL );
+
+	Q_strncpyz( cache->string, string, sizeof( cache->string ) );
+	cache->spawncount = svs.spawncount;
+	cache->realtime = svs.realtime;
+	cache->valid = true;
+	sv_infoquerystats.rebuilds++;
+
+	return cache->string;
+}
+
+/*
+* SV_TakeQueryToken
+*/
+static bool SV_TakeQueryToken( sv_querybucket_t *bucket, float rate, float burst )
+{
+	if( svs.realtime < bucket->time )
+		bucket->time = svs.realtime; // server restarted
+	bucket->tokens += rate * ( svs.realtime - bucket->time ) * 0.001f;
+	if( bucket->tokens > burst )
+		bucket->tokens = burst;
+	bucket->time = svs.realtime;
+
+	if( bucket->tokens < 1.0f )
+		return false;
+
+	bucket->tokens -= 1.0f;
+	return true;
+}
+
+/*
+* SV_QueryBucketForAddress
+*/
+static sv_querybucket_t *SV_QueryBucketForAddress( const netadr_t *address, float rate, float burst )
+{
+	const uint8_t *ip;
+	size_t i, len;
+	unsigned int hash = 2166136261u;
+	sv_querybucket_t *set, *bucket, *best;
+	float bestTokens;
+
+	if( address->type == NA_IP6 )
+	{
+		ip = address->address.ipv6.ip;
+		len = sizeof( address->address.ipv6.ip );
+	}
+	else
+	{
+		ip = address->address.ipv4.ip;
+		len = sizeof( address->address.ipv4.ip );
+	}
+	for( i = 0; i < len; i++ )
+		hash = ( hash ^ ip[i] ) * 16777619u;
+
+	set = sv_querybuckets[hash & ( INFOQUERY_BUCKET_SETS - 1 )];
+
+	best = NULL;
+	bestTokens = -1;
+	for( i = 0; i < INFOQUERY_BUCKET_WAYS; i++ )
+	{
+		float tokens;
+
+		bucket = &set[i];
+		if( bucket->address.type == NA_NOTRANSMIT )
+		{
+			// unused entry
+			tokens = burst + 1;
+		}
+		else
+		{
+			if( NET_CompareBaseAddress( &bucket->address, address ) )
+				return bucket;
+
+			// otherwise replace the entry which has refilled the most
+			tokens = burst;
+			if( svs.realtime >= bucket->time )
+				tokens = min( bucket->tokens + rate * ( svs.realtime - bucket->time ) * 0.001f, burst );
+		}
+
+		if( tokens > bestTokens )
+		{
+			best = bucket;
+			bestTokens = tokens;
+		}
+	}
+
+	best->address = *address;
+	best->time = svs.realtime;
+	best->tokens = burst;
+	return best;
+}
+
+/*
+* SV_InfoQueryAllowed
+* Token bucket limits on status queries, per address and for the whole server
+*/
+static bool SV_InfoQueryAllowed( const netadr_t *address )
+{
+	float rate, burst;
+
+	sv_infoquerystats.queries++;
+
+	if( address->type != NA_IP && address->type != NA_IP6 )
+		return true;
+
+	rate = sv_infoQueryRate->value;
+	if( rate > 0 )
+	{
+		burst = max( sv_infoQueryBurst->value, 1.0f );
+		if( !SV_TakeQueryToken( SV_QueryBucketForAddress( address, rate, burst ), rate, burst ) )
+		{
+			sv_infoquerystats.limited++;
+			return false;
+		}
+	}
+
+	rate = sv_infoQueryGlobalRate->value;
+	if( rate > 0 )
+	{
+		if( !SV_TakeQueryToken( &sv_queryglobalbucket, rate, rate ) )
+		{
+			sv_infoquerystats.limitedGlobal++;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+* SV_InfoQueryStats_f
+*/
+void SV_InfoQueryStats_f( void )
+{
+	Com_Printf( "Info queries: %u\n", sv_infoquerystats.queries );
+	Com_Printf( "Responses sent: %u\n", sv_infoquerystats.responses );
+	Com_Printf( "Dropped by address limit: %u\n", sv_infoquerystats.limited );
+	Com_Printf( "Dropped by global limit: %u\n", sv_infoquerystats.limitedGlobal );
+	Com_Printf( "Info strings built: %u\n", sv_infoquerystats.rebuilds );
+
+	if( !strcmp( Cmd_Argv( 1 ), "reset" ) )
+		memset( &sv_infoquerystats, 0, sizeof( sv_infoquerystats ) );
+}
+
 //==============================================================================
 //
 //OUT OF BAND COMMANDS
@@ -475,8 +685,8 @@ static void SVC_Ping( const socket_t *socket, const netadr_t *address )
 */
 static void SVC_InfoResponse( const socket_t *socket, const netadr_t *address )
 {
-	int i, count;
-	char *string;
+	int i, count, version;
+	const char *string;
 	bool allow_empty = false, allow_full = false;
 
 	if( sv_showInfoQueries->integer )
@@ -499,7 +709,11 @@ static void SVC_InfoResponse( const socket_t *socket, const netadr_t *address )
 	//	return;
 
 	// different protocol version
-	if( atoi( Cmd_Argv( 1 ) ) != APP_PROTOCOL_VERSION )
+	version = atoi( Cmd_Argv( 1 ) );
+	if( version != APP_PROTOCOL_VERSION && version != APP_LEGACY_PROTOCOL_VERSION )
+		return;
+
+	if( !SV_InfoQueryAllowed( address ) )
 		return;
 
 	// check for full/empty filtered states
@@ -531,9 +745,9 @@ static void SVC_InfoResponse( const socket_t *socket, const netadr_t *address )
 		return;
 	}
 
-	string = SV_ShortInfoString();
-	if( string )
-		Netchan_OutOfBandPrint( socket, address, "info\n%s", string );
+	string = SV_CachedInfoString( INFOCACHE_SHORT );
+	Netchan_OutOfBandPrint( socket, address, "info\n%s", string );
+	sv_infoquerystats.responses++;
 }
 
 /*
@@ -541,7 +755,7 @@ static void SVC_InfoResponse( const socket_t *socket, const netadr_t *address )
 */
 static void SVC_SendInfoString( const socket_t *socket, const netadr_t *address, const char *requestType, const char *responseType, bool fullStatus )
 {
-	char *string;
+	const char *string;
 
 	if( sv_showInfoQueries->integer )
 		Com_Printf( "%s Packet %s\n", requestType, NET_AddressToString( address ) );
@@ -562,10 +776,13 @@ static void SVC_SendInfoString( const socket_t *socket, const netadr_t *address,
 	// if( SV_MM_IsLocked() )
 	//	return;
 
+	if( !SV_InfoQueryAllowed( address ) )
+		return;
+
 	// send the same string that we would give for a status OOB command
-	string = SV_LongInfoString( fullStatus );
-	if( string )
-		Netchan_OutOfBandPrint( socket, address, "%s\n\\challenge\\%s%s", responseType, Cmd_Argv( 1 ), string );
+	string = SV_CachedInfoString( fullStatus ? INFOCACHE_FULL : INFOCACHE_LONG );
+	Netchan_OutOfBandPrint( socket, address, "%s\n\\challenge\\%s%s", responseType, Cmd_Argv( 1 ), string );
+	sv_infoquerystats.responses++;
 }
 
 /*
@@ -631,6 +848,69 @@ static void SVC_GetChallenge( const socket_t *socket, const netadr_t *address )
 }
 
 
+/*
+* SVC_ListHasCompressor
+*/
+static bool SVC_ListHasCompressor( const char *list, const char *name )
+{
+	const char *s = list, *end;
+	size_t len = strlen( name );
+
+	while( *s )
+	{
+		end = strchr( s, ',' );
+		if( !end )
+			end = s + strlen( s );
+		if( (size_t)( end - s ) == len && !Q_strnicmp( s, name, len ) )
+			return true;
+		if( !*end )
+			break;
+		s = end + 1;
+	}
+
+	return false;
+}
+
+/*
+* SVC_NegotiateCompression
+* 
+* Picks the first of sv_compresscodecs the client advertised in its userinfo,
+* and the shared dictionary if both ends have loaded the same one
+*/
+static void SVC_NegotiateCompression( netchan_t *netchan, const char *codecs, const char *dict )
+{
+	const char *s, *token;
+	unsigned int checksum;
+	int compressor;
+
+	netchan->compressor = COMPRESSOR_ZLIB;
+	netchan->compressdict = false;
+
+	if( !codecs[0] )
+		return;
+
+	s = sv_compresscodecs->string;
+	while( s )
+	{
+		token = COM_Parse( &s );
+		if( !token[0] )
+			break;
+
+		compressor = Com_FindCompressor( token );
+		if( compressor <= COMPRESSOR_ZLIB || !Com_CompressorAvailable( compressor ) )
+			continue;
+		if( !SVC_ListHasCompressor( codecs, token ) )
+			continue;
+
+		netchan->compressor = compressor;
+		break;
+	}
+
+	checksum = Com_CompressionDictionaryChecksum();
+	if( netchan->compressor != COMPRESSOR_ZLIB && checksum && dict[0] && strtoul( dict, NULL, 16 ) == checksum )
+		netchan->compressdict = true;
+}
+
 /*
 * SVC_DirectConnect
 * A connection request that did not come from the master
@@ -641,6 +921,7 @@ static void SVC_DirectConnect( const socket_t *socket, const netadr_t *address )
 	int incoming = 0;
 #endif
 	char userinfo[MAX_INFO_STRING];
+	char codecs[MAX_INFO_VALUE], dict[MAX_INFO_VALUE], *value;
 	client_t *cl, *newcl;
 	int i, version, game_port, challenge;
 	int previousclients;
@@ -653,7 +934,7 @@ static void SVC_DirectConnect( const socket_t *socket, const netadr_t *address )
 	Com_DPrintf( "SVC_DirectConnect (%s)\n", Cmd_Args() );
 
 	version = atoi( Cmd_Argv( 1 ) );
-	if( version != APP_PROTOCOL_VERSION )
+	if( version != APP_PROTOCOL_VERSION && version != APP_LEGACY_PROTOCOL_VERSION )
 	{
 		if( version <= 6 )
 		{            // before reject packet was added
@@ -835,8 +1116,14 @@ static void SVC_DirectConnect( const socket_t *socket, const netadr_t *address )
 			SV_DropClient( newcl, DROP_TYPE_GENERAL, "%s", "Need room for a real player" );
 	}
 
+	// the game may modify the userinfo
+	value = Info_ValueForKey( userinfo, "cl_compression" );
+	Q_strncpyz( codecs, value ? value : "", sizeof( codecs ) );
+	value = Info_ValueForKey( userinfo, "cl_compressdict" );
+	Q_strncpyz( dict, value ? value : "", sizeof( dict ) );
+
 	// get the game a chance to reject this connection or modify the userinfo
-	if( !SV_ClientConnect( socket, address, newcl, userinfo, game_port, challenge, false, 
+	if( !SV_ClientConnect( socket, address, newcl, userinfo, game_port, challenge, version, false, 
 		tv_client, ticket_id, session_id ) )
 	{
 		char *rejtype, *rejflag, *rejtypeflag, *rejmsg;
@@ -860,8 +1147,14 @@ static void SVC_DirectConnect( const socket_t *socket, const netadr_t *address )
 		return;
 	}
 
-	// send the connect packet to the client
-	Netchan_OutOfBandPrint( socket, address, "client_connect\n%s", newcl->session );
+	SVC_NegotiateCompression( &newcl->netchan, codecs, dict );
+
+	// send the connect packet to the client, older clients only read the session
+	if( newcl->netchan.compressor != COMPRESSOR_ZLIB )
+		Netchan_OutOfBandPrint( socket, address, "client_connect\n%s\n%s %i", newcl->session,
+			Com_CompressorName( newcl->netchan.compressor ), newcl->netchan.compressdict ? 1 : 0 );
+	else
+		Netchan_OutOfBandPrint( socket, address, "client_connect\n%s", newcl->session );
 
 	// free the incoming entry
 #ifdef TCP_ALLOW_CONNECT
@@ -920,7 +1213,7 @@ int SVC_FakeConnect( char *fakeUserinfo, char *fakeSocketType, const char *fakeI
 
 	NET_InitAddress( &address, NA_NOTRANSMIT );
 	// get the game a chance to reject this connection or modify the userinfo
-	if( !SV_ClientConnect( NULL, &address, newcl, userinfo, -1, -1, true, false, 0, 0 ) )
+	if( !SV_ClientConnect( NULL, &address, newcl, userinfo, -1, -1, APP_PROTOCOL_VERSION, true, false, 0, 0 ) )
 	{
 		Com_DPrintf( "Game rejected a connection.\n" );
 		return -1;
@@ -1040,6 +1333,9 @@ bool SV_SteamServerQuery( const char *s, const socket_t *socket, const netadr_t
 	if( ( !sv_public->integer && !NET_IsLANAddress( address ) ) || ( sv_maxclients->integer == 1 ) )
 		return false;
 
+	if( ( !strcmp( s, "TSource Engine Query" ) || s[0] == 'U' ) && !SV_InfoQueryAllowed( address ) )
+		return true;
+
 	if( !strcmp( s, "i" ) )
 	{
 		// ping
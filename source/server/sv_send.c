@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // sv_main.c -- server main program
 
 #include "server.h"
+#include "../qcommon/sys_threads.h"
 
 // shared message buffer to be used for occasional messages
 msg_t tmpMessage;
@@ -299,7 +300,7 @@ bool SV_Netchan_Transmit( netchan_t *netchan, msg_t *msg )
 
 	if( sv_compresspackets->integer )
 	{
-		zerror = Netchan_CompressMessage( msg );
+		zerror = Netchan_CompressMessage( netchan, msg );
 		if( zerror < 0 )
 		{          // it's compression error, just send uncompressed
 			Com_DPrintf( "SV_Netchan_Transmit (ignoring compression): Compression error %i\n", zerror );
@@ -370,7 +371,45 @@ void SV_ResetClientFrameCounters( void )
 void SV_WriteFrameSnapToClient( client_t *client, msg_t *msg )
 {
 	SNAP_WriteFrameSnapToClient( &sv.gi, client, msg, sv.framenum, svs.gametime, sv.baselines,
-		&svs.client_entities, 0, NULL, NULL );
+		&svs.client_entities, svs.enccache, 0, NULL, NULL );
+}
+
+/*
+* SV_SkyPortalOrigin
+*
+* Returns NULL if the sky portal doesn't want entities to be merged into the PVS
+*/
+static vec_t *SV_SkyPortalOrigin( vec3_t origin )
+{
+	int noents = 0;
+	float f1 = 0, f2 = 0;
+
+	if( sv.configstrings[CS_SKYBOX][0] == '\0' )
+		return NULL;
+
+	if( sscanf( sv.configstrings[CS_SKYBOX], "%f %f %f %f %f %i", &origin[0], &origin[1], &origin[2], &f1, &f2, &noents ) >= 3 )
+	{
+		if( !noents )
+			return origin;
+	}
+
+	return NULL;
+}
+
+/*
+* SV_BuildClientFrameSnapVis
+*
+* May be called from the snapshot worker threads, each of them
+* providing its own fatvis buffer
+*/
+static void SV_BuildClientFrameSnapVis( client_t *client, fatvis_t *fatvis, vec_t *skyorg, game_state_t *gameState )
+{
+	fatvis->skyorg = skyorg;		// HACK HACK HACK
+	SNAP_BuildClientFrameSnap( svs.cms, &sv.gi, sv.framenum, svs.gametime,
+		fatvis, svs.viscache, client, gameState, 
+		&svs.client_entities,
+		false, sv_mempool );
+	fatvis->skyorg = NULL;
 }
 
 /*
@@ -378,33 +417,240 @@ void SV_WriteFrameSnapToClient( client_t *client, msg_t *msg )
 */
 void SV_BuildClientFrameSnap( client_t *client )
 {
-	vec_t *skyorg = NULL, origin[3];
+	vec3_t origin;
+
+	SV_BuildClientFrameSnapVis( client, &svs.fatvis, SV_SkyPortalOrigin( origin ), ge->GetGameState() );
+}
+
+//===============================================================================
+//
+//PARALLEL SNAPSHOTS
+//
+//===============================================================================
+
+#define SV_MAX_SNAP_THREADS	16
+
+typedef struct
+{
+	client_t *client;
+	msg_t msg;
+	uint8_t *msgData;		// [MAX_MSGLEN]
+} sv_snapjob_t;
+
+typedef struct
+{
+	qthread_t *thread;
+	qcondvar_t *wakeCond;
+	unsigned int batch;			// last batch this worker has joined
+	fatvis_t fatvis;
+} sv_snapworker_t;
+
+typedef struct
+{
+	int numWorkers;
+	sv_snapworker_t *workers;
+
+	qmutex_t *mutex;
+	qcondvar_t *doneCond;
+	bool shutdown;
+	bool batchOpen;				// workers may only join while the batch is open
+	unsigned int batch;
+	int numActiveWorkers;
+
+	int numJobs;
+	volatile int nextJob;
+	sv_snapjob_t jobs[MAX_CLIENTS];
 
-	if( sv.configstrings[CS_SKYBOX][0] != '\0' )
+	vec_t *skyorg;
+	vec3_t skyorigin;
+	game_state_t *gameState;
+} sv_snapthreads_t;
+
+static sv_snapthreads_t sv_snap;
+
+/*
+* SV_SnapThreads_RunJobs
+*
+* Builds and delta-encodes snapshots until the job list is exhausted.
+* Everything touched here is either owned by the job's client or
+* is read-only for the duration of the batch.
+*/
+static void SV_SnapThreads_RunJobs( fatvis_t *fatvis )
+{
+	int i;
+	sv_snapjob_t *job;
+
+	while( true )
 	{
-		int noents = 0;
-		float f1 = 0, f2 = 0;
+		i = Sys_Atomic_Add( &sv_snap.nextJob, 1, sv_snap.mutex );
+		if( i >= sv_snap.numJobs )
+			break;
 
-		if( sscanf( sv.configstrings[CS_SKYBOX], "%f %f %f %f %f %i", &origin[0], &origin[1], &origin[2], &f1, &f2, &noents ) >= 3 )
+		job = &sv_snap.jobs[i];
+		SV_BuildClientFrameSnapVis( job->client, fatvis, sv_snap.skyorg, sv_snap.gameState );
+		SV_WriteFrameSnapToClient( job->client, &job->msg );
+	}
+}
+
+/*
+* SV_SnapThreads_Worker
+*/
+static void *SV_SnapThreads_Worker( void *param )
+{
+	sv_snapworker_t *worker = ( sv_snapworker_t * )param;
+
+	while( true )
+	{
+		QMutex_Lock( sv_snap.mutex );
+		while( !sv_snap.shutdown && ( !sv_snap.batchOpen || worker->batch == sv_snap.batch ) )
+			QCondVar_Wait( worker->wakeCond, sv_snap.mutex, Q_THREADS_WAIT_INFINITE );
+
+		if( sv_snap.shutdown )
 		{
-			if( !noents )
-				skyorg = origin;
+			QMutex_Unlock( sv_snap.mutex );
+			break;
 		}
+
+		worker->batch = sv_snap.batch;
+		sv_snap.numActiveWorkers++;
+		QMutex_Unlock( sv_snap.mutex );
+
+		SV_SnapThreads_RunJobs( &worker->fatvis );
+
+		QMutex_Lock( sv_snap.mutex );
+		sv_snap.numActiveWorkers--;
+		QCondVar_Wake( sv_snap.doneCond );
+		QMutex_Unlock( sv_snap.mutex );
 	}
 
-	svs.fatvis.skyorg = skyorg;		// HACK HACK HACK
-	SNAP_BuildClientFrameSnap( svs.cms, &sv.gi, sv.framenum, svs.gametime,
-		&svs.fatvis, client, ge->GetGameState(), 
-		&svs.client_entities,
-		false, sv_mempool );
-	svs.fatvis.skyorg = NULL;
+	return NULL;
+}
+
+/*
+* SV_SnapThreads_Shutdown
+*/
+void SV_SnapThreads_Shutdown( void )
+{
+	int i;
+
+	if( sv_snap.numWorkers )
+	{
+		QMutex_Lock( sv_snap.mutex );
+		sv_snap.shutdown = true;
+		for( i = 0; i < sv_snap.numWorkers; i++ )
+			QCondVar_Wake( sv_snap.workers[i].wakeCond );
+		QMutex_Unlock( sv_snap.mutex );
+
+		for( i = 0; i < sv_snap.numWorkers; i++ )
+		{
+			QThread_Join( sv_snap.workers[i].thread );
+			QCondVar_Destroy( &sv_snap.workers[i].wakeCond );
+		}
+
+		Mem_Free( sv_snap.workers );
+	}
+
+	for( i = 0; i < MAX_CLIENTS; i++ )
+	{
+		if( sv_snap.jobs[i].msgData )
+			Mem_Free( sv_snap.jobs[i].msgData );
+	}
+
+	QMutex_Destroy( &sv_snap.mutex );
+	QCondVar_Destroy( &sv_snap.doneCond );
+
+	memset( &sv_snap, 0, sizeof( sv_snap ) );
 }
 
+/*
+* SV_SnapThreads_Init
+*/
+static void SV_SnapThreads_Init( int numWorkers )
+{
+	int i;
+
+	SV_SnapThreads_Shutdown();
+
+	clamp( numWorkers, 0, SV_MAX_SNAP_THREADS );
+	if( !numWorkers )
+		return;
+
+	sv_snap.mutex = QMutex_Create();
+	sv_snap.doneCond = QCondVar_Create();
+
+	sv_snap.workers = Mem_Alloc( sv_mempool, sizeof( *sv_snap.workers ) * numWorkers );
+	for( i = 0; i < numWorkers; i++ )
+	{
+		sv_snap.workers[i].wakeCond = QCondVar_Create();
+		sv_snap.workers[i].thread = QThread_Create( SV_SnapThreads_Worker, &sv_snap.workers[i] );
+	}
+	sv_snap.numWorkers = numWorkers;
+
+	Com_Printf( "Building client snapshots on %i worker thread%s\n", numWorkers, numWorkers == 1 ? "" : "s" );
+}
+
+/*
+* SV_SnapThreads_AddJob
+*/
+static msg_t *SV_SnapThreads_AddJob( client_t *client )
+{
+	sv_snapjob_t *job;
+
+	assert( sv_snap.numJobs < MAX_CLIENTS );
+
+	job = &sv_snap.jobs[sv_snap.numJobs++];
+	if( !job->msgData )
+		job->msgData = Mem_Alloc( sv_mempool, MAX_MSGLEN );
+
+	job->client = client;
+	SV_InitClientMessage( client, &job->msg, job->msgData, MAX_MSGLEN );
+	return &job->msg;
+}
+
+/*
+* SV_SnapThreads_Run
+*
+* Distributes the queued jobs between the workers and the main thread
+* and returns once all of them have been completed
+*/
+static void SV_SnapThreads_Run( void )
+{
+	int i;
+
+	if( !sv_snap.numJobs )
+		return;
+
+	sv_snap.skyorg = SV_SkyPortalOrigin( sv_snap.skyorigin );
+	sv_snap.gameState = ge->GetGameState();
+	sv_snap.nextJob = 0;
+
+	QMutex_Lock( sv_snap.mutex );
+	sv_snap.batch++;
+	sv_snap.batchOpen = true;
+	for( i = 0; i < sv_snap.numWorkers && i < sv_snap.numJobs - 1; i++ )
+		QCondVar_Wake( sv_snap.workers[i].wakeCond );
+	QMutex_Unlock( sv_snap.mutex );
+
+	// the main thread takes its share of the work too
+	SV_SnapThreads_RunJobs( &svs.fatvis );
+
+	// all the jobs have been picked up by now, wait for the workers to finish theirs
+	QMutex_Lock( sv_snap.mutex );
+	sv_snap.batchOpen = false;
+	while( sv_snap.numActiveWorkers > 0 )
+		QCondVar_Wait( sv_snap.doneCond, sv_snap.mutex, Q_THREADS_WAIT_INFINITE );
+	QMutex_Unlock( sv_snap.mutex );
+}
+
+//===============================================================================
+
 /*
 * SV_SendClientDatagram
 */
 static bool SV_SendClientDatagram( client_t *client )
 {
+	uint64_t time_before = 0, time_after = 0;
+
 	if( client->edict && ( client->edict->r.svflags & SVF_FAKECLIENT ) )
 		return true;
 
@@ -412,13 +658,27 @@ static bool SV_SendClientDatagram( client_t *client )
 
 	SV_AddReliableCommandsToMessage( client, &tmpMessage );
 
+	if( host_speeds->integer )
+		time_before = Sys_Microseconds();
+
 	// send over all the relevant entity_state_t
 	// and the player_state_t
 	SV_BuildClientFrameSnap( client );
 
 	SV_WriteFrameSnapToClient( client, &tmpMessage );
 
-	return SV_SendMessageToClient( client, &tmpMessage );
+	if( host_speeds->integer )
+	{
+		time_after = Sys_Microseconds();
+		time_snap_build += time_after - time_before;
+	}
+
+	if( !SV_SendMessageToClient( client, &tmpMessage ) )
+		return false;
+
+	if( host_speeds->integer )
+		time_snap_send += Sys_Microseconds() - time_after;
+	return true;
 }
 
 /*
@@ -428,6 +688,16 @@ void SV_SendClientMessages( void )
 {
 	int i;
 	client_t *client;
+	msg_t *msg;
+	uint64_t time_before = 0, time_after = 0;
+
+	if( sv_snapthreads->modified )
+	{
+		SV_SnapThreads_Init( sv_snapthreads->integer );
+		sv_snapthreads->modified = false;
+	}
+
+	sv_snap.numJobs = 0;
 
 	// send a message to each connected client
 	for( i = 0, client = svs.clients; i < sv_maxclients->integer; i++, client++ )
@@ -447,6 +717,14 @@ void SV_SendClientMessages( void )
 
 		if( client->state == CS_SPAWNED )
 		{
+			if( sv_snap.numWorkers )
+			{
+				// the snapshot is built later, in parallel with other clients
+				msg = SV_SnapThreads_AddJob( client );
+				SV_AddReliableCommandsToMessage( client, msg );
+				continue;
+			}
+
 			if( !SV_SendClientDatagram( client ) )
 			{
 				Com_Printf( "Error sending message to %s: %s\n", client->name, NET_ErrorString() );
@@ -475,4 +753,35 @@ void SV_SendClientMessages( void )
 			}
 		}
 	}
+
+	if( !sv_snap.numJobs )
+		return;
+
+	if( host_speeds->integer )
+		time_before = Sys_Microseconds();
+
+	SV_SnapThreads_Run();
+
+	if( host_speeds->integer )
+	{
+		time_after = Sys_Microseconds();
+		time_snap_build += time_after - time_before;
+	}
+
+	// transmit the snapshots in client order
+	for( i = 0; i < sv_snap.numJobs; i++ )
+	{
+		client = sv_snap.jobs[i].client;
+		if( !SV_SendMessageToClient( client, &sv_snap.jobs[i].msg ) )
+		{
+			Com_Printf( "Error sending message to %s: %s\n", client->name, NET_ErrorString() );
+			if( client->reliable )
+			{
+				SV_DropClient( client, DROP_TYPE_GENERAL, "Error sending message: %s\n", NET_ErrorString() );
+			}
+		}
+	}
+
+	if( host_speeds->integer )
+		time_snap_send += Sys_Microseconds() - time_after;
 }
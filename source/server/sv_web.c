@@ -24,7 +24,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #ifdef HTTP_SUPPORT
 
-#define MAX_INCOMING_HTTP_CONNECTIONS			48
 #define MAX_INCOMING_HTTP_CONNECTIONS_PER_ADDR	3
 
 #define MAX_INCOMING_CONTENT_LENGTH				0x2800
@@ -33,6 +32,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define INCOMING_HTTP_CONNECTION_SEND_TIMEOUT	15 // seconds
 
 #define HTTP_SERVER_SLEEP_TIME					50 // milliseconds
+#define HTTP_SERVER_TIMEOUT_CHECK_TIME			1000 // milliseconds
+
+#define HTTP_SERVER_MAX_CACHED_FILES			64
+#define HTTP_SERVER_FILE_REVALIDATE_TIME		5000 // milliseconds
 
 typedef enum
 {
@@ -82,7 +85,11 @@ typedef struct {
 	netadr_t realAddr;
 
 	bool partial;
-	sv_http_content_range_t partial_content_range;
+	sv_http_content_range_t partial_content_range;	// begin is -1 for suffix ranges, end is -1 for open ranges
+
+	char *if_none_match;
+	char *if_modified_since;
+	char *if_range;
 
 	bool got_start_line;
 	bool close_after_resp;
@@ -97,13 +104,29 @@ typedef struct {
 	char *content;
 	size_t content_length;
 
-	int file;
-	int fileno;
-	size_t file_data_offset;
+	struct sv_http_file_s *file;
 	size_t file_send_pos;
 	char *filename;
 } sv_http_response_t;
 
+typedef struct sv_http_file_s
+{
+	char *filename;
+	int file;						// kept open for as long as the entry is cached
+	int fileno;						// system file descriptor, shared by all downloads of the file
+	size_t offset;					// offset of the data within fileno, non-zero for files in the VFS
+	size_t length;
+	time_t mtime;
+	char etag[32];
+	char last_modified[32];
+
+	int refcount;
+	bool stale;						// unlinked from the cache, freed when the last download ends
+	unsigned int validated;
+
+	struct sv_http_file_s *next;
+} sv_http_file_t;
+
 typedef struct sv_http_connection_s
 {
 	bool open;
@@ -112,6 +135,12 @@ typedef struct sv_http_connection_s
 
 	socket_t socket;
 	netadr_t address;
+	int monitor_id;
+
+	// edge-triggered readiness, kept until a read or write would block
+	bool readable;
+	bool writable;
+	bool queued;
 
 	unsigned int last_active;
 
@@ -135,14 +164,27 @@ typedef unsigned (*queueCmdHandler_t)( const void * );
 static bool sv_http_initialized = false;
 static volatile bool sv_http_running = false;
 
-static sv_http_connection_t sv_http_connections[MAX_INCOMING_HTTP_CONNECTIONS];
+static int sv_http_max_connections;
+static sv_http_connection_t *sv_http_connections;
 static sv_http_connection_t sv_http_connection_headnode, *sv_free_http_connections;
 
+// connections with pending events or work to be done this frame
+static int sv_http_num_ready_connections;
+static sv_http_connection_t **sv_http_ready_connections;
+
+static struct net_monitor_s *sv_http_monitor;
+static unsigned int sv_http_next_timeout_check;
+
 static socket_t sv_socket_http;
 static socket_t sv_socket_http6;
+static int sv_socket_http_monitor_id = -1;
+static int sv_socket_http6_monitor_id = -1;
 
 static netadr_t sv_web_upstream_addr;
 
+static int sv_http_num_files;
+static sv_http_file_t *sv_http_files;
+
 static uint64_t sv_http_request_autoicr;
 
 static trie_t *sv_http_clients = NULL;
@@ -155,6 +197,177 @@ static qbufPipe_t *sv_http_outgoing_queue;
 static qthread_t *sv_http_thread = NULL;
 static void *SV_Web_ThreadProc( void *param );
 
+// ============================================================================
+// File cache
+// Files served over HTTP are resolved once to a system descriptor and a data
+// offset and kept open, so that concurrent downloads of the same file after
+// a map change share a single descriptor and go straight to sendfile.
+
+/*
+* SV_Web_FormatDate
+*
+* Formats the time as an RFC 1123 date, as used by the Last-Modified header
+*/
+static void SV_Web_FormatDate( time_t t, char *buf, size_t buf_size )
+{
+	static const char *days[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+	static const char *months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", 
+		"Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+	struct tm *tm;
+
+	tm = gmtime( &t );
+	if( !tm ) {
+		buf[0] = '\0';
+		return;
+	}
+
+	Q_snprintfz( buf, buf_size, "%s, %02i %s %04i %02i:%02i:%02i GMT", 
+		days[tm->tm_wday], tm->tm_mday, months[tm->tm_mon], tm->tm_year + 1900, 
+		tm->tm_hour, tm->tm_min, tm->tm_sec );
+}
+
+/*
+* SV_Web_FreeFile
+*/
+static void SV_Web_FreeFile( sv_http_file_t *file )
+{
+	FS_FCloseFile( file->file );
+	Mem_Free( file->filename );
+	Mem_Free( file );
+}
+
+/*
+* SV_Web_UnlinkFile
+*
+* Removes the file from the cache. Files that are still being sent are freed
+* when the last download finishes.
+*/
+static void SV_Web_UnlinkFile( sv_http_file_t *file )
+{
+	sv_http_file_t **prev;
+
+	for( prev = &sv_http_files; *prev; prev = &(*prev)->next ) {
+		if( *prev == file ) {
+			*prev = file->next;
+			sv_http_num_files--;
+			break;
+		}
+	}
+
+	file->next = NULL;
+	file->stale = true;
+	if( !file->refcount ) {
+		SV_Web_FreeFile( file );
+	}
+}
+
+/*
+* SV_Web_ReleaseFile
+*/
+static void SV_Web_ReleaseFile( sv_http_file_t *file )
+{
+	assert( file->refcount > 0 );
+
+	file->refcount--;
+	if( !file->refcount && file->stale ) {
+		SV_Web_FreeFile( file );
+	}
+}
+
+/*
+* SV_Web_OpenFile
+*
+* Returns a referenced cache entry for the base file, opening it if needed.
+* Cached entries are checked against the filesystem every few seconds, so
+* that files replaced on disk are not served with stale metadata.
+*/
+static sv_http_file_t *SV_Web_OpenFile( const char *filename )
+{
+	int fs_file;
+	int fileno;
+	int length;
+	size_t offset;
+	sv_http_file_t *file, **prev, *evict;
+	unsigned int now = Sys_Milliseconds();
+
+	for( prev = &sv_http_files; *prev; prev = &(*prev)->next ) {
+		file = *prev;
+		if( strcmp( file->filename, filename ) ) {
+			continue;
+		}
+
+		if( now - file->validated >= HTTP_SERVER_FILE_REVALIDATE_TIME ) {
+			file->validated = now;
+			if( FS_BaseFileMTime( filename ) != file->mtime || 
+				FS_FOpenBaseFile( filename, NULL, FS_READ ) != (int)file->length ) {
+				SV_Web_UnlinkFile( file );
+				break;
+			}
+		}
+
+		// move to the front of the list
+		*prev = file->next;
+		file->next = sv_http_files;
+		sv_http_files = file;
+
+		file->refcount++;
+		return file;
+	}
+
+	length = FS_FOpenBaseFile( filename, &fs_file, FS_READ );
+	if( !fs_file ) {
+		return NULL;
+	}
+
+	fileno = FS_FileNo( fs_file, &offset );
+	if( fileno < 0 || length < 0 ) {
+		FS_FCloseFile( fs_file );
+		return NULL;
+	}
+
+	// evict the least recently used file that isn't being sent
+	if( sv_http_num_files >= HTTP_SERVER_MAX_CACHED_FILES ) {
+		evict = NULL;
+		for( file = sv_http_files; file; file = file->next ) {
+			if( !file->refcount ) {
+				evict = file;
+			}
+		}
+		if( evict ) {
+			SV_Web_UnlinkFile( evict );
+		}
+	}
+
+	file = Mem_ZoneMalloc( sizeof( *file ) );
+	file->filename = ZoneCopyString( filename );
+	file->file = fs_file;
+	file->fileno = fileno;
+	file->offset = offset;
+	file->length = length;
+	file->mtime = FS_BaseFileMTime( filename );
+	file->validated = now;
+	file->refcount = 1;
+
+	Q_snprintfz( file->etag, sizeof( file->etag ), "\"%x-%x\"", (unsigned)file->mtime, (unsigned)file->length );
+	SV_Web_FormatDate( file->mtime, file->last_modified, sizeof( file->last_modified ) );
+
+	file->next = sv_http_files;
+	sv_http_files = file;
+	sv_http_num_files++;
+
+	return file;
+}
+
+/*
+* SV_Web_FreeFiles
+*/
+static void SV_Web_FreeFiles( void )
+{
+	while( sv_http_files ) {
+		SV_Web_UnlinkFile( sv_http_files );
+	}
+}
+
 // ============================================================================
 
 /*
@@ -201,6 +414,18 @@ static void SV_Web_ResetRequest( sv_http_request_t *request )
 		Mem_Free( request->clientSession );
 		request->clientSession = NULL;
 	}
+	if( request->if_none_match ) {
+		Mem_Free( request->if_none_match );
+		request->if_none_match = NULL;
+	}
+	if( request->if_modified_since ) {
+		Mem_Free( request->if_modified_since );
+		request->if_modified_since = NULL;
+	}
+	if( request->if_range ) {
+		Mem_Free( request->if_range );
+		request->if_range = NULL;
+	}
 
 	request->query_string = "";
 	SV_Web_ResetStream( &request->stream );
@@ -233,11 +458,9 @@ static void SV_Web_ResetResponse( sv_http_response_t *response )
 		response->filename = NULL;
 	}
 	if( response->file ) {
-		FS_FCloseFile( response->file );
-		response->file = 0;
+		SV_Web_ReleaseFile( response->file );
+		response->file = NULL;
 	}
-	response->fileno = -1;
-	response->file_data_offset = 0;
 	response->file_send_pos = 0;
 
 	response->content_state = CONTENT_STATE_DEFAULT;
@@ -278,6 +501,9 @@ static sv_http_connection_t *SV_Web_AllocConnection( void )
 	con->state = HTTP_CONN_STATE_NONE;
 	con->close_after_resp = false;
 	con->is_upstream = false;
+	con->monitor_id = -1;
+	con->readable = con->writable = false;
+	con->queued = false;
 	return con;
 }
 
@@ -300,20 +526,52 @@ static void SV_Web_FreeConnection( sv_http_connection_t *con )
 	sv_free_http_connections = con;
 }
 
+/*
+* SV_Web_CloseConnection
+*/
+static void SV_Web_CloseConnection( sv_http_connection_t *con )
+{
+	if( sv_http_monitor ) {
+		NET_MonitorRemoveSocket( sv_http_monitor, con->monitor_id );
+	}
+	con->monitor_id = -1;
+	con->open = false;
+
+	NET_CloseSocket( &con->socket );
+	SV_Web_FreeConnection( con );
+}
+
+/*
+* SV_Web_QueueConnection
+*
+* Schedules the connection to be serviced at the end of this frame
+*/
+static void SV_Web_QueueConnection( sv_http_connection_t *con )
+{
+	if( con->queued ) {
+		return;
+	}
+	con->queued = true;
+	sv_http_ready_connections[sv_http_num_ready_connections++] = con;
+}
+
 /*
 * SV_Web_InitConnections
 */
-static void SV_Web_InitConnections( void )
+static void SV_Web_InitConnections( int max_connections )
 {
-	unsigned int i;
+	int i;
 
-	memset( sv_http_connections, 0, sizeof( sv_http_connections ) );
+	sv_http_max_connections = max( max_connections, 1 );
+	sv_http_connections = Mem_ZoneMalloc( sizeof( *sv_http_connections ) * sv_http_max_connections );
+	sv_http_ready_connections = Mem_ZoneMalloc( sizeof( *sv_http_ready_connections ) * sv_http_max_connections );
+	sv_http_num_ready_connections = 0;
 
 	// link decals
 	sv_free_http_connections = sv_http_connections;
 	sv_http_connection_headnode.prev = &sv_http_connection_headnode;
 	sv_http_connection_headnode.next = &sv_http_connection_headnode;
-	for( i = 0; i < MAX_INCOMING_HTTP_CONNECTIONS - 2; i++ ) {
+	for( i = 0; i < sv_http_max_connections - 1; i++ ) {
 		sv_http_connections[i].next = &sv_http_connections[i+1];
 	}
 }
@@ -331,10 +589,23 @@ static void SV_Web_ShutdownConnections( void )
 	{
 		next = con->prev;
 		if( con->open ) {
-			NET_CloseSocket( &con->socket );
-			SV_Web_FreeConnection( con );
+			SV_Web_CloseConnection( con );
 		}
 	}
+	sv_http_num_ready_connections = 0;
+}
+
+/*
+* SV_Web_FreeConnections
+*/
+static void SV_Web_FreeConnections( void )
+{
+	Mem_ZoneFree( sv_http_connections );
+	Mem_ZoneFree( sv_http_ready_connections );
+	sv_http_connections = NULL;
+	sv_http_ready_connections = NULL;
+	sv_free_http_connections = NULL;
+	sv_http_max_connections = 0;
 }
 
 /*
@@ -490,6 +761,10 @@ static int SV_Web_Get( sv_http_connection_t *con, void *recvbuf, size_t recvbuf_
 		con->open = false;
 		Com_DPrintf( "HTTP connection recv error from %s\n", NET_AddressToString( &con->address ) );
 	}
+	else if( read == 0 ) {
+		// drained, wait for more data to arrive
+		con->readable = false;
+	}
 	return read;
 }
 
@@ -505,6 +780,10 @@ static int SV_Web_Send( sv_http_connection_t *con, void *sendbuf, size_t sendbuf
 		Com_DPrintf( "HTTP transmission error to %s\n", NET_AddressToString( &con->address ) );
 		con->open = false;
 	}
+	else if( sent == 0 ) {
+		// send buffer is full, wait for it to drain
+		con->writable = false;
+	}
 	return sent;
 }
 
@@ -526,6 +805,9 @@ static int64_t SV_Web_SendFile( sv_http_connection_t *con, int fileno, size_t fi
 		con->open = false;
 	}
 	else {
+		if( sent == 0 ) {
+			con->writable = false;
+		}
 		*pos += sent;
 	}
 	return sent;
@@ -637,6 +919,9 @@ unsigned SV_Web_HandleOutQueryCmd( void *pcmd )
 	response->content = cmd->content;
 	response->content_length = cmd->content_length;
 	response->content_state = CONTENT_STATE_RECEIVED;
+
+	// no socket event is going to wake the connection up
+	SV_Web_QueueConnection( ( sv_http_connection_t * )( ( uint8_t * )response - offsetof( sv_http_connection_t, response ) ) );
 	return sizeof( *cmd );
 }
 
@@ -764,6 +1049,64 @@ static void SV_Web_ParseStartLine( sv_http_request_t *request, char *line )
 	}
 }
 
+/*
+* SV_Web_ParseRangeNumber
+*/
+static const char *SV_Web_ParseRangeNumber( const char *p, long *value )
+{
+	*value = -1;
+	if( *p < '0' || *p > '9' ) {
+		return p;
+	}
+
+	*value = 0;
+	while( *p >= '0' && *p <= '9' ) {
+		if( *value > INT_MAX / 10 ) {
+			// larger than any file we could serve
+			*value = INT_MAX;
+		}
+		else {
+			*value = *value * 10 + *p - '0';
+		}
+		p++;
+	}
+	return p;
+}
+
+/*
+* SV_Web_ParseRange
+*
+* Parses a single byte range: "bytes=first-last", "bytes=first-" or "bytes=-suffix".
+* Unknown units, multiple ranges and malformed values are ignored, in which case
+* the whole resource is served, as allowed by RFC 7233.
+*/
+static void SV_Web_ParseRange( sv_http_request_t *request, const char *value )
+{
+	const char *p;
+	long begin, end;
+
+	if( Q_strnicmp( value, "bytes=", 6 ) || strchr( value, ',' ) ) {
+		return;
+	}
+
+	p = SV_Web_ParseRangeNumber( value + 6, &begin );
+	if( *p != '-' ) {
+		return;
+	}
+	p = SV_Web_ParseRangeNumber( p + 1, &end );
+	while( *p == ' ' || *p == '\t' ) {
+		p++;
+	}
+
+	if( *p || ( begin < 0 && end < 0 ) || ( begin >= 0 && end >= 0 && end < begin ) ) {
+		return;
+	}
+
+	request->partial = true;
+	request->partial_content_range.begin = begin;
+	request->partial_content_range.end = end;
+}
+
 /*
 * SV_Web_AnalyzeHeader
 */
@@ -792,54 +1135,13 @@ static void SV_Web_AnalyzeHeader( sv_http_request_t *request, const char *key, c
 	}
 	else if( !Q_stricmp( key, "Range" ) 
 		&& ( request->method == HTTP_METHOD_GET || request->method == HTTP_METHOD_HEAD ) ) {
-		const char *delim = strchr( value, '-' );
-
-		if( Q_strnicmp( value, "bytes=", 6 ) || !delim ) {
-			request->error = HTTP_RESP_BAD_REQUEST;
-		}
-		else {
-			bool neg_end = false;
-			const char *p = value;
-
-			// first byte pos
-			while( *p && p < delim ) {
-				if( *p >= '0' && *p <= '9' )
-					stream->content_range.begin = stream->content_range.begin*10 + *p - '0';
-				p++;
-			}
-			p++;
-
-			// last byte pos
-			if( *p == '-' ) {
-				if( value != delim ) {
-					request->error = HTTP_RESP_REQUESTED_RANGE_NOT_SATISFIABLE;
-					return;
-				}
-				neg_end = true;
-				p++;
-			}
-			while( *p ) {
-				if( *p >= '0' && *p <= '9' )
-				stream->content_range.end = stream->content_range.end*10 + *p++ - '0';
-			}
-
-			// partial content request
-			if( neg_end && stream->content_range.end ) {
-				// bytes=-100
-				request->partial = true;
-				stream->content_range.end = -stream->content_range.end;
-			} else if( stream->content_range.end >= stream->content_range.begin ) {
-				// bytes=200-300
-				request->partial = true;
-			} else if( stream->content_range.begin >= 0 && *(delim+1) == '\0' ) {
-				// bytes=200-
-				request->partial = true;
-			}
-
-			if( request->partial ) {
-				request->partial_content_range = stream->content_range;
-			}
-		}
+		SV_Web_ParseRange( request, value );
+	} else if( !Q_stricmp( key, "If-None-Match" ) ) {
+		request->if_none_match = ZoneCopyString( value );
+	} else if( !Q_stricmp( key, "If-Modified-Since" ) ) {
+		request->if_modified_since = ZoneCopyString( value );
+	} else if( !Q_stricmp( key, "If-Range" ) ) {
+		request->if_range = ZoneCopyString( value );
 	} else if( !Q_stricmp( key, "X-Client" ) ) {
 		request->clientNum = atoi( value );
 	} else if( !Q_stricmp( key, "X-Session" ) ) {
@@ -941,12 +1243,7 @@ static void SV_Web_ReceiveRequest( socket_t *socket, sv_http_connection_t *con )
 
 		ret = SV_Web_Get( con, recvbuf, recvbuf_size - 1 );
 		if( ret <= 0 ) {
-			if( total_received == 0 ) {
-				// no data on the socket after select() call, 
-				// the connection has probably been closed on the other end
-				con->open = false;
-				return;
-			}
+			// closed on the other end or no more data for now
 			break;
 		}
 
@@ -1057,6 +1354,7 @@ static const char *SV_Web_ResponseCodeMessage( http_response_code_t code )
 	switch( code ) {
 		case HTTP_RESP_OK: return "OK";
 		case HTTP_RESP_PARTIAL_CONTENT: return "Partial Content";
+		case HTTP_RESP_NOT_MODIFIED: return "Not Modified";
 		case HTTP_RESP_BAD_REQUEST: return "Bad Request";
 		case HTTP_RESP_FORBIDDEN: return "Forbidden";
 		case HTTP_RESP_NOT_FOUND: return "Not Found";
@@ -1108,16 +1406,12 @@ static void SV_Web_RouteRequest( const sv_http_request_t *request, sv_http_respo
 				return;
 			}
 
-			*content_length = FS_FOpenBaseFile( filename, &response->file, FS_READ );
-			response->fileno = -1;
-			if( response->file ) {
-				response->fileno = FS_FileNo( response->file, &response->file_data_offset );
-			}
-			if( response->fileno == -1 ) {
+			response->file = SV_Web_OpenFile( filename );
+			if( !response->file ) {
 				response->code = HTTP_RESP_NOT_FOUND;
-				*content_length = 0;
 			}
 			else {
+				*content_length = response->file->length;
 				response->code = HTTP_RESP_OK;
 			}
 		}
@@ -1130,6 +1424,58 @@ static void SV_Web_RouteRequest( const sv_http_request_t *request, sv_http_respo
 	}
 }
 
+/*
+* SV_Web_FileNotModified
+*
+* Checks the conditional request headers against the cached file validators.
+* If-Modified-Since is compared literally, as clients echo back our Last-Modified.
+*/
+static bool SV_Web_FileNotModified( const sv_http_request_t *request, const sv_http_file_t *file )
+{
+	if( request->if_none_match ) {
+		return !strcmp( request->if_none_match, "*" ) || strstr( request->if_none_match, file->etag ) != NULL;
+	}
+	if( request->if_modified_since ) {
+		return !strcmp( request->if_modified_since, file->last_modified );
+	}
+	return false;
+}
+
+/*
+* SV_Web_ResolveRange
+*
+* Clamps the requested byte range to the file length and sets up the partial response
+*/
+static void SV_Web_ResolveRange( const sv_http_request_t *request, sv_http_response_t *response, size_t length )
+{
+	long begin = request->partial_content_range.begin;
+	long end = request->partial_content_range.end;
+
+	if( begin < 0 ) {
+		// bytes=-N, the last N bytes of the file
+		if( !end || !length ) {
+			response->code = HTTP_RESP_REQUESTED_RANGE_NOT_SATISFIABLE;
+			return;
+		}
+		begin = (size_t)end >= length ? 0 : length - end;
+		end = length - 1;
+	}
+	else {
+		if( (size_t)begin >= length ) {
+			response->code = HTTP_RESP_REQUESTED_RANGE_NOT_SATISFIABLE;
+			return;
+		}
+		if( end < 0 || (size_t)end >= length ) {
+			end = length - 1;
+		}
+	}
+
+	response->stream.content_range.begin = begin;
+	response->stream.content_range.end = end;
+	response->file_send_pos = begin;
+	response->code = HTTP_RESP_PARTIAL_CONTENT;
+}
+
 /*
 * SV_Web_RespondToQuery
 */
@@ -1140,9 +1486,11 @@ static void SV_Web_RespondToQuery( sv_http_connection_t *con )
 	char *content = NULL;
 	size_t header_length = 0;
 	size_t content_length = 0;
+	bool file_body;
 	sv_http_request_t *request = &con->request;
 	sv_http_response_t *response = &con->response;
 	sv_http_stream_t *resp_stream = &response->stream;
+	sv_http_file_t *file;
 
 	if( request->error ) {
 		response->code = request->error;
@@ -1163,40 +1511,29 @@ static void SV_Web_RespondToQuery( sv_http_connection_t *con )
 			return;
 		}
 
-		if( response->file ) {
-			Com_Printf( "HTTP serving file '%s' to '%s'\n", response->filename, NET_AddressToString( &con->address ) );
-		}
-
-		// serve range requests
-		if( request->partial && response->file ) {
-			// seek to first byte pos and clamp the last byte pos to content length
-			if( request->partial_content_range.begin > 0 ) { 
-				FS_Seek( response->file, request->partial_content_range.begin, FS_SEEK_SET );
-				// range.end may be set to 0 for 'bytes=100-' style requests
-				response->stream.content_range.end = request->partial_content_range.end 
-					? request->partial_content_range.end : content_length;
-
-			} else if( request->partial_content_range.end < 0 ) {
-				// seek to N last bytes in the file
-				FS_Seek( response->file, request->partial_content_range.end, FS_SEEK_END );
-				response->stream.content_range.end = -request->partial_content_range.end;
+		file = response->file;
+		if( file ) {
+			if( SV_Web_FileNotModified( request, file ) ) {
+				response->code = HTTP_RESP_NOT_MODIFIED;
+				content_length = 0;
 			}
+			else {
+				Com_Printf( "HTTP serving file '%s' to '%s'\n", response->filename, NET_AddressToString( &con->address ) );
 
-			// Content-Range header values
-			response->file_send_pos = FS_Tell( response->file );
-			response->stream.content_range.begin = response->file_send_pos;
-			response->stream.content_range.end = min( (int)content_length, response->stream.content_range.end );
-			response->code = HTTP_RESP_PARTIAL_CONTENT;
-		}
-
-		if( request->method == HTTP_METHOD_HEAD && response->file ) {
-			FS_FCloseFile( response->file );
-			response->file = 0;
+				// serve range requests, unless the file has changed since the client got the first part
+				if( request->partial && ( !request->if_range || !strcmp( request->if_range, file->etag ) 
+					|| !strcmp( request->if_range, file->last_modified ) ) ) {
+					SV_Web_ResolveRange( request, response, file->length );
+				}
+			}
 		}
 	}
 
 	con->state = HTTP_CONN_STATE_SEND;
 
+	file = response->file;
+	file_body = file && ( response->code == HTTP_RESP_OK || response->code == HTTP_RESP_PARTIAL_CONTENT );
+
 	Q_snprintfz( resp_stream->header_buf, sizeof( resp_stream->header_buf ), 
 		"%s %i %s\r\nServer: " APPLICATION " v" APP_VERSION_STR "\r\n", 
 		request->http_ver, response->code, SV_Web_ResponseCodeMessage( response->code ) );
@@ -1205,27 +1542,38 @@ static void SV_Web_RespondToQuery( sv_http_connection_t *con )
 			sizeof( resp_stream->header_buf ) );
 
 	if( response->code == HTTP_RESP_REQUESTED_RANGE_NOT_SATISFIABLE ) {
-		int file_length = FS_FOpenBaseFile( request->resource, NULL, FS_READ );
-
 		// in accordance with RFC 2616, send the Content-Range entity header,
 		// specifying the length of the resource
-		if( file_length < 0 ) {
+		if( !file ) {
 			Q_strncatz( resp_stream->header_buf, "Content-Range: bytes */*\r\n",
 				sizeof( resp_stream->header_buf ) );
 		}
 		else {
-			Q_snprintfz( vastr, sizeof( vastr ), "Content-Range: bytes */%i\r\n", content_length );
+			Q_snprintfz( vastr, sizeof( vastr ), "Content-Range: bytes */%u\r\n", (unsigned)file->length );
 			Q_strncatz( resp_stream->header_buf, vastr, sizeof( resp_stream->header_buf ) );
 		}
 	}
 	else if( response->code == HTTP_RESP_PARTIAL_CONTENT ) {
-		Q_snprintfz( vastr, sizeof( vastr ), "Content-Range: bytes %i-%i/%i\r\n", 
-			response->stream.content_range.begin, response->stream.content_range.end, content_length );
+		Q_snprintfz( vastr, sizeof( vastr ), "Content-Range: bytes %li-%li/%u\r\n", 
+			response->stream.content_range.begin, response->stream.content_range.end, (unsigned)content_length );
 		Q_strncatz( resp_stream->header_buf, vastr, sizeof( resp_stream->header_buf ) );
-		content_length = response->stream.content_range.end - response->stream.content_range.begin;
+		content_length = response->stream.content_range.end - response->stream.content_range.begin + 1;
+	}
+
+	if( file && ( file_body || response->code == HTTP_RESP_NOT_MODIFIED ) ) {
+		Q_snprintfz( vastr, sizeof( vastr ), "ETag: %s\r\n", file->etag );
+		Q_strncatz( resp_stream->header_buf, vastr, sizeof( resp_stream->header_buf ) );
+
+		if( file->last_modified[0] ) {
+			Q_snprintfz( vastr, sizeof( vastr ), "Last-Modified: %s\r\n", file->last_modified );
+			Q_strncatz( resp_stream->header_buf, vastr, sizeof( resp_stream->header_buf ) );
+		}
 	}
 
-	if( response->code >= HTTP_RESP_BAD_REQUEST || !content_length ) {
+	if( response->code == HTTP_RESP_NOT_MODIFIED ) {
+		// no message body
+	}
+	else if( response->code >= HTTP_RESP_BAD_REQUEST || ( !content_length && !file_body ) ) {
 		// error response or empty response: just return response code + description
 		Q_strncatz( resp_stream->header_buf, "Content-Type: text/plain\r\n",
 				sizeof( resp_stream->header_buf ) );
@@ -1237,17 +1585,34 @@ static void SV_Web_RespondToQuery( sv_http_connection_t *con )
 	}
 
 	// resource length
-	Q_strncatz( resp_stream->header_buf, va( "Content-Length: %i\r\n", content_length ),
-			sizeof( resp_stream->header_buf ) );
+	if( response->code != HTTP_RESP_NOT_MODIFIED ) {
+		Q_strncatz( resp_stream->header_buf, va( "Content-Length: %i\r\n", content_length ),
+				sizeof( resp_stream->header_buf ) );
+	}
 
-	if( response->file ) {
+	if( file_body ) {
 		Q_snprintfz( vastr, sizeof( vastr ), "Content-Disposition: attachment; filename=\"%s\"\r\n", 
 			COM_FileBase( response->filename ) );
 		Q_strncatz( resp_stream->header_buf, vastr, sizeof( resp_stream->header_buf ) );
 	}
 
+	if( con->close_after_resp ) {
+		Q_strncatz( resp_stream->header_buf, "Connection: close\r\n", sizeof( resp_stream->header_buf ) );
+	}
+
 	Q_strncatz( resp_stream->header_buf, "\r\n", sizeof( resp_stream->header_buf ) );
 
+	// only keep the file around if its contents are going to be sent
+	if( request->method == HTTP_METHOD_HEAD ) {
+		file_body = false;
+		content = NULL;
+		content_length = 0;
+	}
+	if( file && !file_body ) {
+		SV_Web_ReleaseFile( file );
+		response->file = NULL;
+	}
+
 	header_length = strlen( resp_stream->header_buf );
 	if( content && content_length ) {
 		if( content_length + header_length < sizeof( resp_stream->header_buf ) ) {
@@ -1295,7 +1660,7 @@ static size_t SV_Web_SendResponse( sv_http_connection_t *con )
 		while( stream->content_p < stream->content_length && sv_http_running ) {
 			if( response->file ) {
 				sendbuf_size = stream->content_length - stream->content_p;
-				sent = SV_Web_SendFile( con, response->fileno, response->file_data_offset, &response->file_send_pos, sendbuf_size );
+				sent = SV_Web_SendFile( con, response->file->fileno, response->file->offset, &response->file_send_pos, sendbuf_size );
 			}
 			else {
 				if( !stream->content ) {
@@ -1432,17 +1797,31 @@ static void SV_Web_Listen( socket_t *socket )
 		}
 		
 		if( !block ) {
-			Com_DPrintf( "HTTP connection accepted from %s\n", NET_AddressToString( &newaddress ) );
 			con = SV_Web_AllocConnection();
 			if( !con ) {
+				Com_DPrintf( "HTTP connection refused for %s: too many connections\n", NET_AddressToString( &newaddress ) );
+				NET_CloseSocket( &newsocket );
 				break;
 			}
+
+			Com_DPrintf( "HTTP connection accepted from %s\n", NET_AddressToString( &newaddress ) );
 			con->socket = newsocket;
 			con->address = newaddress;
 			con->last_active = Sys_Milliseconds();
 			con->open = true;
 			con->state = HTTP_CONN_STATE_RECV;
 			con->is_upstream = is_upstream;
+
+			con->monitor_id = NET_MonitorAddSocket( sv_http_monitor, &con->socket, con );
+			if( con->monitor_id < 0 ) {
+				Com_DPrintf( "HTTP connection dropped for %s: %s\n", NET_AddressToString( &newaddress ), NET_ErrorString() );
+				SV_Web_CloseConnection( con );
+				break;
+			}
+
+			// the request may already be there
+			con->readable = con->writable = true;
+			SV_Web_QueueConnection( con );
 			continue;
 		}
 
@@ -1451,6 +1830,133 @@ static void SV_Web_Listen( socket_t *socket )
 	}
 }
 
+/*
+* SV_Web_ReadEvent
+*/
+static void SV_Web_ReadEvent( socket_t *socket, void *privatep )
+{
+	sv_http_connection_t *con = privatep;
+
+	if( !con ) {
+		// listening socket
+		SV_Web_Listen( socket );
+		return;
+	}
+
+	con->readable = true;
+	SV_Web_QueueConnection( con );
+}
+
+/*
+* SV_Web_WriteEvent
+*/
+static void SV_Web_WriteEvent( socket_t *socket, void *privatep )
+{
+	sv_http_connection_t *con = privatep;
+
+	if( !con ) {
+		return;
+	}
+
+	con->writable = true;
+	SV_Web_QueueConnection( con );
+}
+
+/*
+* SV_Web_ExceptionEvent
+*/
+static void SV_Web_ExceptionEvent( socket_t *socket, void *privatep )
+{
+	sv_http_connection_t *con = privatep;
+
+	if( !con ) {
+		return;
+	}
+
+	Com_DPrintf( "HTTP connection error from %s\n", NET_AddressToString( &con->address ) );
+	con->open = false;
+	SV_Web_QueueConnection( con );
+}
+
+/*
+* SV_Web_ServiceConnection
+*
+* Advances the connection state for as long as the socket doesn't block
+*/
+static void SV_Web_ServiceConnection( sv_http_connection_t *con )
+{
+	sv_http_connstate_t state;
+
+	while( con->open && sv_http_running ) {
+		state = con->state;
+
+		if( state == HTTP_CONN_STATE_RECV ) {
+			if( !con->readable ) {
+				break;
+			}
+			SV_Web_ReceiveRequest( &con->socket, con );
+		}
+		else {
+			if( !con->writable ) {
+				break;
+			}
+			SV_Web_WriteResponse( &con->socket, con );
+		}
+
+		if( con->state == state ) {
+			break;
+		}
+	}
+}
+
+/*
+* SV_Web_CheckTimeouts
+*/
+static void SV_Web_CheckTimeouts( void )
+{
+	unsigned int now;
+	sv_http_connection_t *con, *next, *hnode = &sv_http_connection_headnode;
+
+	now = Sys_Milliseconds();
+	if( now < sv_http_next_timeout_check ) {
+		return;
+	}
+	sv_http_next_timeout_check = now + HTTP_SERVER_TIMEOUT_CHECK_TIME;
+
+	for( con = hnode->prev; con != hnode; con = next )
+	{
+		next = con->prev;
+		if( !sv_http_running ) {
+			return;
+		}
+
+		if( con->open ) {
+			unsigned int timeout = 0;
+
+			switch( con->state ) {
+				case HTTP_CONN_STATE_RECV:
+					timeout = INCOMING_HTTP_CONNECTION_RECV_TIMEOUT;
+					break;
+				case HTTP_CONN_STATE_RESP:
+				case HTTP_CONN_STATE_SEND:
+					timeout = INCOMING_HTTP_CONNECTION_SEND_TIMEOUT;
+					break;
+				default:
+					break;
+			}
+
+			if( now > con->last_active + timeout*1000 ) {
+				con->open = false;
+				Com_DPrintf( "HTTP connection timeout from %s\n", NET_AddressToString( &con->address ) );
+			}
+		}
+
+		if( !con->open ) {
+			SV_Web_CloseConnection( con );
+		}
+	}
+}
+
 /*
 * SV_Web_Init
 */
@@ -1460,8 +1966,6 @@ void SV_Web_Init( void )
 	sv_http_running = false;
 	sv_http_request_autoicr = 1;
 
-	SV_Web_InitConnections();
-
 	if( !sv_http->integer ) {
 		return;
 	}
@@ -1475,6 +1979,26 @@ void SV_Web_Init( void )
 		return;
 	}
 
+	SV_Web_InitConnections( sv_http_maxconnections->integer );
+
+	// the listening sockets have a NULL connection
+	sv_http_monitor = NET_CreateMonitor( sv_http_max_connections + 2 );
+	if( !sv_http_monitor ) {
+		Com_Printf( "Error: Couldn't create HTTP socket monitor: %s\n", NET_ErrorString() );
+		NET_CloseSocket( &sv_socket_http );
+		NET_CloseSocket( &sv_socket_http6 );
+		SV_Web_FreeConnections();
+		sv_http_initialized = false;
+		return;
+	}
+	if( sv_socket_http.open ) {
+		sv_socket_http_monitor_id = NET_MonitorAddSocket( sv_http_monitor, &sv_socket_http, NULL );
+	}
+	if( sv_socket_http6.open ) {
+		sv_socket_http6_monitor_id = NET_MonitorAddSocket( sv_http_monitor, &sv_socket_http6, NULL );
+	}
+	sv_http_next_timeout_check = 0;
+
 	sv_http_running = true;
 
 	SV_Web_InitQueues();
@@ -1489,10 +2013,8 @@ void SV_Web_Init( void )
 */
 static void SV_Web_Frame( void )
 {
-	sv_http_connection_t *con, *next, *hnode = &sv_http_connection_headnode;
-	socket_t *sockets[MAX_INCOMING_HTTP_CONNECTIONS+1];
-	void *connections[MAX_INCOMING_HTTP_CONNECTIONS];
-	int num_sockets = 0;
+	int i;
+	sv_http_connection_t *con;
 	bool upstream_is_set;
 
 	if( !sv_http_initialized ) {
@@ -1514,7 +2036,7 @@ static void SV_Web_Frame( void )
 			NET_InitAddress( &sv_web_upstream_addr, NA_NOTRANSMIT );
 	}
 
-	// accept new connections
+	// accept new connections, in case some were left in the backlog
 	if( sv_socket_http.address.type == NA_IP ) {
 		SV_Web_Listen( &sv_socket_http );
 	}
@@ -1522,80 +2044,32 @@ static void SV_Web_Frame( void )
 		SV_Web_Listen( &sv_socket_http6 );
 	}
 
-	// handle incoming data
-	num_sockets = 0;
-	for( con = hnode->prev; con != hnode; con = next )
-	{
-		next = con->prev;
-		switch( con->state ) {
-			case HTTP_CONN_STATE_RECV:
-			case HTTP_CONN_STATE_RESP:
-			case HTTP_CONN_STATE_SEND:
-				sockets[num_sockets] = &con->socket;
-				connections[num_sockets] = con;
-				num_sockets++;
-				break;
-			default:
-				break;
-		}
-	}
-	sockets[num_sockets] = NULL;
-
 	// read query results from the game module
 	SV_Web_ReadOutgoingQueueCmds();
 
-	if( num_sockets != 0 ) {
-		NET_Monitor( HTTP_SERVER_SLEEP_TIME, sockets,
-			(void (*)(socket_t *, void*))SV_Web_ReceiveRequest,
-			(void (*)(socket_t *, void*))SV_Web_WriteResponse,
-			NULL, connections );
-	}
-	else {
-		// sleep on network sockets if got nothing else to do
-		if( sv_socket_http.address.type == NA_IP ) {
-			sockets[num_sockets++] = &sv_socket_http;
-		}
-		if( sv_socket_http6.address.type == NA_IP6 ) {
-			sockets[num_sockets++] = &sv_socket_http6;
-		}
-		sockets[num_sockets] = NULL;
-		NET_Sleep( HTTP_SERVER_SLEEP_TIME, sockets );
-	}
+	// wait for socket events, only touching the connections that have something to do
+	NET_MonitorWait( sv_http_monitor, sv_http_num_ready_connections ? 0 : HTTP_SERVER_SLEEP_TIME,
+		SV_Web_ReadEvent, SV_Web_WriteEvent, SV_Web_ExceptionEvent );
 
-	// close dead connections
-	for( con = hnode->prev; con != hnode; con = next )
+	for( i = 0; i < sv_http_num_ready_connections; i++ )
 	{
-		next = con->prev;
 		if( !sv_http_running ) {
 			return;
 		}
 
-		if( con->open ) {
-			unsigned int timeout = 0;
-
-			switch( con->state ) {
-				case HTTP_CONN_STATE_RECV:
-					timeout = INCOMING_HTTP_CONNECTION_RECV_TIMEOUT;
-					break;
-				case HTTP_CONN_STATE_RESP:
-				case HTTP_CONN_STATE_SEND:
-					timeout = INCOMING_HTTP_CONNECTION_SEND_TIMEOUT;
-					break;
-				default:
-					break;
-			}
+		con = sv_http_ready_connections[i];
+		con->queued = false;
 
-			if( Sys_Milliseconds() > con->last_active + timeout*1000 ) {
-				con->open = false;
-				Com_DPrintf( "HTTP connection timeout from %s\n", NET_AddressToString( &con->address ) );
-			}
-		}
+		SV_Web_ServiceConnection( con );
 
 		if( !con->open ) {
-			NET_CloseSocket( &con->socket );
-			SV_Web_FreeConnection( con );
+			SV_Web_CloseConnection( con );
 		}
 	}
+	sv_http_num_ready_connections = 0;
+
+	// close dead connections
+	SV_Web_CheckTimeouts();
 }
 
 /*
@@ -1624,6 +2098,7 @@ static void *SV_Web_ThreadProc( void *param )
 	}
 
 	SV_Web_ShutdownConnections();
+	SV_Web_FreeFiles();
 	return NULL;
 }
 
@@ -1641,9 +2116,16 @@ void SV_Web_Shutdown( void )
 
 	SV_Web_DestroyQueues();
 
+	NET_MonitorRemoveSocket( sv_http_monitor, sv_socket_http_monitor_id );
+	NET_MonitorRemoveSocket( sv_http_monitor, sv_socket_http6_monitor_id );
+	sv_socket_http_monitor_id = sv_socket_http6_monitor_id = -1;
+	NET_DestroyMonitor( &sv_http_monitor );
+
 	NET_CloseSocket( &sv_socket_http );
 	NET_CloseSocket( &sv_socket_http6 );
 
+	SV_Web_FreeConnections();
+
 	sv_http_initialized = false;
 }
 
@@ -354,6 +354,8 @@ static void S_Update( void )
 	S_UpdateMusic();
 	
 	S_UpdateStreams();
+
+	S_UpdateBuffers();
 	
 	s_volume->modified = false; // Checked by src and stream
 	s_musicvolume->modified = false; // Checked by stream and music
@@ -672,6 +674,9 @@ static unsigned S_HandleStuffCmd( const sndStuffCmd_t *cmd )
 	else if( !Q_stricmp( cmd->text, "devicelist" ) ) {
 		S_ListDevices_f();
 	}
+	else if( !Q_stricmp( cmd->text, "soundinfo" ) ) {
+		S_BufferInfo_f();
+	}
 	return sizeof( *cmd );
 }
 
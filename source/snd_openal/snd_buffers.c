@@ -27,6 +27,62 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 sfx_t knownSfx[MAX_SFX];
 static bool buffers_inited = false;
 
+#define S_BUFFER_PREFIX_MSEC	250		// decoded right away for sounds that are streamed in
+#define MAX_RETIRED_BUFFERS		256
+#define DECODER_PIPE_SIZE		0x10000
+
+static sfx_t buffers_lru;	// sentinel of the least recently used list
+static int buffers_size;	// bytes of decoded audio in memory
+
+static struct
+{
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int evictions;
+	unsigned int streamed;
+} buffers_stats;
+
+static ALuint retired_buffers[MAX_RETIRED_BUFFERS];
+static int num_retired_buffers;
+
+typedef unsigned (*pipeCmdHandler_t)( const void * );
+
+enum
+{
+	BUFFER_CMD_DECODE,
+	BUFFER_CMD_SHUTDOWN,
+
+	BUFFER_CMD_NUM_CMDS
+};
+
+typedef struct sfxdecodejob_s
+{
+	sfx_t *sfx;
+	int loadSequence;
+	snd_stream_t *stream;
+	snd_info_t info;
+	uint8_t *data;				// the prefix, then the whole sound
+	int size;					// bytes in data
+	int prefixSize;
+	struct sfxdecodejob_s *next;
+} sfxdecodejob_t;
+
+typedef struct
+{
+	int id;
+	sfxdecodejob_t *job;
+} bufferDecodeCmd_t;
+
+typedef struct
+{
+	int id;
+} bufferShutdownCmd_t;
+
+static qbufPipe_t *decoder_pipe;
+static struct qthread_s *decoder_thread;
+static struct qmutex_s *decoder_lock;
+static sfxdecodejob_t *decoder_done;	// finished jobs, guarded by decoder_lock
+
 /*
 * Local helper functions
 */
@@ -83,7 +139,8 @@ static sfx_t *buffer_find_free( void )
 
 	for( i = 0; i < MAX_SFX; i++ )
 	{
-		if( knownSfx[i].filename[0] == '\0' )
+		// sounds that couldn't be unloaded keep their slot
+		if( knownSfx[i].filename[0] == '\0' && !knownSfx[i].inMemory )
 			return &knownSfx[i];
 	}
 
@@ -99,6 +156,66 @@ sfx_t *S_GetBufferById( int id )
 	return knownSfx + id;
 }
 
+/*
+* Least recently used list of the sounds in memory, the most recent first
+*/
+
+static void buffer_lru_unlink( sfx_t *sfx )
+{
+	if( !sfx->prev )
+		return;
+
+	sfx->prev->next = sfx->next;
+	sfx->next->prev = sfx->prev;
+	sfx->prev = sfx->next = NULL;
+}
+
+static void buffer_lru_link( sfx_t *sfx )
+{
+	buffer_lru_unlink( sfx );
+
+	sfx->prev = &buffers_lru;
+	sfx->next = buffers_lru.next;
+	sfx->next->prev = sfx;
+	buffers_lru.next = sfx;
+}
+
+/*
+* Buffers that may still be queued on sources, deleted once they're released
+*/
+
+static void buffer_flush_retired( void )
+{
+	int i;
+
+	for( i = 0; i < num_retired_buffers; )
+	{
+		qalGetError();
+		qalDeleteBuffers( 1, &retired_buffers[i] );
+		if( qalGetError() != AL_NO_ERROR )
+		{
+			i++;
+			continue;
+		}
+
+		retired_buffers[i] = retired_buffers[--num_retired_buffers];
+	}
+}
+
+static void buffer_retire( ALuint buffer )
+{
+	if( num_retired_buffers == MAX_RETIRED_BUFFERS )
+		buffer_flush_retired();
+
+	if( num_retired_buffers == MAX_RETIRED_BUFFERS )
+	{
+		Com_Printf( "Too many sound buffers waiting to be released\n" );
+		return;
+	}
+
+	retired_buffers[num_retired_buffers++] = buffer;
+}
+
 bool S_UnloadBuffer( sfx_t *sfx )
 {
 	ALenum error;
@@ -117,113 +234,344 @@ bool S_UnloadBuffer( sfx_t *sfx )
 		return false;
 	}
 
+	// drop the rest of the sound if it's still being decoded
+	sfx->loadSequence++;
+	sfx->isStreaming = false;
+
+	buffer_lru_unlink( sfx );
+	buffers_size -= sfx->size;
+	sfx->size = 0;
+
 	sfx->inMemory = false;
 
 	return true;
 }
 
 // Remove the least recently used sound effect from memory
-static bool buffer_evict()
+static bool buffer_evict( const sfx_t *keep )
 {
-	int i;
-	int candinate = -1;
-	int candinate_value = trap_Milliseconds();
+	sfx_t *sfx;
 
-	for( i = 0; i < MAX_SFX; i++ )
+	for( sfx = buffers_lru.prev; sfx != &buffers_lru; sfx = sfx->prev )
 	{
-		if( knownSfx[i].filename[0] == '\0' || !knownSfx[i].inMemory || knownSfx[i].isLocked )
+		if( sfx == keep || sfx->isLocked || sfx->isStreaming )
+			continue;
+		if( S_IsSfxPlaying( sfx ) )
 			continue;
 
-		if( knownSfx[i].used < candinate_value )
-		{
-			candinate = i;
-			candinate_value = knownSfx[i].used;
-		}
-	}
+		if( !S_UnloadBuffer( sfx ) )
+			return false;
 
-	if( candinate != -1 )
-	{
-		return S_UnloadBuffer( &knownSfx[candinate] );
+		buffers_stats.evictions++;
+		return true;
 	}
 
 	return false;
 }
 
-bool S_LoadBuffer( sfx_t *sfx )
+// Keep the decoded sounds within the s_buffercache budget
+static void buffer_enforce_budget( const sfx_t *keep )
 {
-	ALenum error;
-	void *data;
-	snd_info_t info;
-	ALuint format;
+	int budget;
 
-	if( !sfx ) {
-		return false;
-	}
-	if( sfx->filename[0] == '\0' || sfx->inMemory )
-		return false;
-	if( trap_FS_IsUrl( sfx->filename ) )
-		return false;
+	if( s_buffercache->value <= 0 )
+		return;
 
-	data = S_LoadSound( sfx->filename, &info );
-	if( !data )
+	budget = s_buffercache->value * 1024 * 1024;
+	while( buffers_size > budget )
 	{
-		//Com_DPrintf( "Couldn't load %s\n", sfx->filename );
-		return false;
+		if( !buffer_evict( keep ) )
+			break;
 	}
+}
 
-	if( info.channels > 1 )
+// Create an OpenAL buffer for the samples, downmixing them if needed
+static bool buffer_upload( const sfx_t *sfx, ALuint *buffer, void *data, snd_info_t *info )
+{
+	ALenum error;
+	ALuint format;
+	void *mono = NULL;
+
+	if( info->channels > 1 )
 	{
-		void *temp = stereo_mono( data, &info );
-		if( temp )
-		{
-			S_Free( data );
-			data = temp;
-		}
+		mono = stereo_mono( data, info );
+		if( mono )
+			data = mono;
 	}
 
-	format = S_SoundFormat( info.width, info.channels );
+	format = S_SoundFormat( info->width, info->channels );
 
-	qalGenBuffers( 1, &sfx->buffer );
+	qalGenBuffers( 1, buffer );
 	if( ( error = qalGetError() ) != AL_NO_ERROR )
 	{
-		S_Free( data );
+		if( mono )
+			S_Free( mono );
 		Com_Printf( "Couldn't create a sound buffer for %s (%s)\n", sfx->filename, S_ErrorMessage( error ) );
 		return false;
 	}
 
-	qalBufferData( sfx->buffer, format, data, info.size, info.rate );
+	qalBufferData( *buffer, format, data, info->size, info->rate );
 	error = qalGetError();
 
 	// If we ran out of memory, start evicting the least recently used sounds
 	while( error == AL_OUT_OF_MEMORY )
 	{
-		if( !buffer_evict() )
+		if( !buffer_evict( sfx ) )
 		{
-			S_Free( data );
+			qalDeleteBuffers( 1, buffer );
+			if( mono )
+				S_Free( mono );
 			Com_Printf( "Out of memory loading %s\n", sfx->filename );
 			return false;
 		}
 
 		// Try load it again
 		qalGetError();
-		qalBufferData( sfx->buffer, format, data, info.size, info.rate );
+		qalBufferData( *buffer, format, data, info->size, info->rate );
 		error = qalGetError();
 	}
 
+	if( mono )
+		S_Free( mono );
+
 	// Some other error condition
 	if( error != AL_NO_ERROR )
 	{
-		S_Free( data );
+		qalDeleteBuffers( 1, buffer );
 		Com_Printf( "Couldn't fill sound buffer for %s (%s)", sfx->filename, S_ErrorMessage( error ) );
 		return false;
 	}
 
-	S_Free( data );
+	return true;
+}
+
+bool S_LoadBuffer( sfx_t *sfx )
+{
+	snd_stream_t *stream;
+	snd_info_t info, chunk;
+	sfxdecodejob_t *job;
+	bufferDecodeCmd_t cmd;
+	uint8_t *data;
+	int frameSize, size, read;
+	bool streaming;
+
+	if( !sfx ) {
+		return false;
+	}
+	if( sfx->filename[0] == '\0' || sfx->inMemory )
+		return false;
+	if( trap_FS_IsUrl( sfx->filename ) )
+		return false;
+
+	stream = S_OpenStream( sfx->filename, NULL );
+	if( !stream )
+	{
+		//Com_DPrintf( "Couldn't load %s\n", sfx->filename );
+		return false;
+	}
+
+	info = stream->info;
+	frameSize = info.channels * info.width;
+	if( info.size <= 0 || frameSize <= 0 )
+	{
+		S_CloseStream( stream );
+		return false;
+	}
+
+	// long sounds start playing from a prefix while the rest is decoded in the background
+	size = ( info.rate * S_BUFFER_PREFIX_MSEC / 1000 ) * frameSize;
+	streaming = decoder_thread && size > 0 && info.size > size * 2;
+	if( !streaming )
+		size = info.size;
+
+	data = S_Malloc( size );
+	read = S_ReadStream( stream, size, data );
+	read -= read % frameSize;
+	if( read <= 0 )
+	{
+		S_Free( data );
+		S_CloseStream( stream );
+		return false;
+	}
+	if( read < size )
+		streaming = false;
+
+	chunk = info;
+	chunk.size = read;
+	chunk.samples = read / frameSize;
+	if( !buffer_upload( sfx, &sfx->buffer, data, &chunk ) )
+	{
+		S_Free( data );
+		S_CloseStream( stream );
+		return false;
+	}
+
 	sfx->inMemory = true;
+	sfx->size = chunk.size;
+	buffers_size += chunk.size;
+	buffer_lru_link( sfx );
+
+	if( streaming )
+	{
+		job = S_Malloc( sizeof( *job ) );
+		job->sfx = sfx;
+		job->loadSequence = sfx->loadSequence;
+		job->stream = stream;
+		job->info = info;
+		job->data = data;
+		job->size = read;
+		job->prefixSize = read;
+		job->next = NULL;
+
+		sfx->isStreaming = true;
+
+		cmd.id = BUFFER_CMD_DECODE;
+		cmd.job = job;
+		trap_BufPipe_WriteCmd( decoder_pipe, &cmd, sizeof( cmd ) );
+	}
+	else
+	{
+		S_Free( data );
+		S_CloseStream( stream );
+	}
+
+	buffer_enforce_budget( sfx );
 
 	return true;
 }
 
+/*
+* Background decoding
+*/
+
+static unsigned buffer_handle_decode_cmd( const bufferDecodeCmd_t *cmd )
+{
+	sfxdecodejob_t *job = cmd->job;
+	int frameSize = job->info.channels * job->info.width;
+	uint8_t *data;
+	int read;
+
+	data = S_Malloc( job->info.size );
+	memcpy( data, job->data, job->prefixSize );
+	S_Free( job->data );
+
+	while( job->size < job->info.size )
+	{
+		read = S_ReadStream( job->stream, job->info.size - job->size, data + job->size );
+		if( read <= 0 )
+			break;
+		job->size += read;
+	}
+	job->size -= job->size % frameSize;
+
+	S_CloseStream( job->stream );
+	job->stream = NULL;
+	job->data = data;
+
+	trap_Mutex_Lock( decoder_lock );
+	job->next = decoder_done;
+	decoder_done = job;
+	trap_Mutex_Unlock( decoder_lock );
+
+	return sizeof( *cmd );
+}
+
+static unsigned buffer_handle_shutdown_cmd( const bufferShutdownCmd_t *cmd )
+{
+	return 0; // terminate
+}
+
+static pipeCmdHandler_t decoderCmdHandlers[BUFFER_CMD_NUM_CMDS] =
+{
+	/* BUFFER_CMD_DECODE */
+	(pipeCmdHandler_t)buffer_handle_decode_cmd,
+	/* BUFFER_CMD_SHUTDOWN */
+	(pipeCmdHandler_t)buffer_handle_shutdown_cmd,
+};
+
+static int buffer_decoder_waiter( qbufPipe_t *queue, pipeCmdHandler_t *cmdHandlers, bool timeout )
+{
+	return trap_BufPipe_ReadCmds( queue, cmdHandlers );
+}
+
+static void *buffer_decoder_proc( void *param )
+{
+	trap_BufPipe_Wait( decoder_pipe, buffer_decoder_waiter, decoderCmdHandlers, Q_THREADS_WAIT_INFINITE );
+	return NULL;
+}
+
+// Replace the prefix of a sound with the whole decoded sound
+static void buffer_finish_stream( sfx_t *sfx, sfxdecodejob_t *job )
+{
+	snd_info_t chunk;
+	int frameSize = job->info.channels * job->info.width;
+	ALuint buffer;
+
+	sfx->isStreaming = false;
+	buffers_stats.streamed++;
+
+	// sources that are still playing the prefix continue with the rest
+	if( job->size > job->prefixSize && S_IsSfxPlaying( sfx ) )
+	{
+		chunk = job->info;
+		chunk.size = job->size - job->prefixSize;
+		chunk.samples = chunk.size / frameSize;
+		if( buffer_upload( sfx, &buffer, job->data + job->prefixSize, &chunk ) )
+		{
+			if( S_QueueSfxTail( sfx, buffer ) )
+				buffer_retire( buffer );
+			else
+				qalDeleteBuffers( 1, &buffer );
+		}
+	}
+
+	chunk = job->info;
+	chunk.size = job->size;
+	chunk.samples = job->size / frameSize;
+	if( !buffer_upload( sfx, &buffer, job->data, &chunk ) )
+		return;
+
+	buffer_retire( sfx->buffer );
+	sfx->buffer = buffer;
+
+	buffers_size += chunk.size - sfx->size;
+	sfx->size = chunk.size;
+
+	buffer_enforce_budget( sfx );
+}
+
+/*
+* S_UpdateBuffers
+*
+* Picks up the sounds decoded in the background
+*/
+void S_UpdateBuffers( void )
+{
+	sfxdecodejob_t *job, *next;
+
+	if( !buffers_inited )
+		return;
+
+	trap_Mutex_Lock( decoder_lock );
+	job = decoder_done;
+	decoder_done = NULL;
+	trap_Mutex_Unlock( decoder_lock );
+
+	for( ; job; job = next )
+	{
+		next = job->next;
+
+		// the sound may have been unloaded in the meantime
+		if( job->sfx->isStreaming && job->sfx->loadSequence == job->loadSequence )
+			buffer_finish_stream( job->sfx, job );
+
+		S_Free( job->data );
+		S_Free( job );
+	}
+
+	buffer_flush_retired();
+}
+
 /*
 * Sound system wide functions (snd_al_local.h)
 */
@@ -233,6 +581,7 @@ sfx_t *S_FindBuffer( const char *filename )
 {
 	sfx_t *sfx;
 	int i;
+	int loadSequence;
 
 	for( i = 0; i < MAX_SFX; i++ )
 	{
@@ -242,7 +591,10 @@ sfx_t *S_FindBuffer( const char *filename )
 
 	sfx = buffer_find_free();
 
+	// jobs of the previous sound in this slot must not match the new one
+	loadSequence = sfx->loadSequence;
 	memset( sfx, 0, sizeof( *sfx ) );
+	sfx->loadSequence = loadSequence + 1;
 	sfx->id = sfx - knownSfx;
 	Q_strncpyz( sfx->filename, filename, sizeof( sfx->filename ) );
 
@@ -275,21 +627,58 @@ void S_InitBuffers( void )
 
 	memset( knownSfx, 0, sizeof( knownSfx ) );
 
+	buffers_lru.prev = buffers_lru.next = &buffers_lru;
+	buffers_size = 0;
+	num_retired_buffers = 0;
+	memset( &buffers_stats, 0, sizeof( buffers_stats ) );
+
+	decoder_done = NULL;
+	decoder_lock = trap_Mutex_Create();
+	decoder_pipe = trap_BufPipe_Create( DECODER_PIPE_SIZE, 1 );
+	if( decoder_pipe )
+		decoder_thread = trap_Thread_Create( buffer_decoder_proc, NULL );
+
 	buffers_inited = true;
 }
 
 void S_ShutdownBuffers( void )
 {
 	int i;
+	bufferShutdownCmd_t cmd;
+	sfxdecodejob_t *job, *next;
 
 	if( !buffers_inited )
 		return;
 
+	// keep the sound thread away from the jobs
+	buffers_inited = false;
+
+	// let the decoder finish its jobs
+	if( decoder_thread )
+	{
+		cmd.id = BUFFER_CMD_SHUTDOWN;
+		trap_BufPipe_WriteCmd( decoder_pipe, &cmd, sizeof( cmd ) );
+		trap_Thread_Join( decoder_thread );
+		decoder_thread = NULL;
+	}
+	if( decoder_pipe )
+		trap_BufPipe_Destroy( &decoder_pipe );
+
 	for( i = 0; i < MAX_SFX; i++ )
 		S_UnloadBuffer( &knownSfx[i] );
 
+	for( job = decoder_done; job; job = next )
+	{
+		next = job->next;
+		S_Free( job->data );
+		S_Free( job );
+	}
+	decoder_done = NULL;
+	trap_Mutex_Destroy( &decoder_lock );
+
+	buffer_flush_retired();
+
 	memset( knownSfx, 0, sizeof( knownSfx ) );
-	buffers_inited = false;
 }
 
 void S_SoundList_f( void )
@@ -310,18 +699,51 @@ void S_SoundList_f( void )
 			else
 				Com_Printf( " " );
 
+			if( knownSfx[i].isStreaming )
+				Com_Printf( "S" );
+			else
+				Com_Printf( " " );
+
 			Com_Printf( " : %s\n", knownSfx[i].filename );
 		}
 	}
 }
 
+void S_BufferInfo_f( void )
+{
+	int count = 0, streaming = 0;
+	const sfx_t *sfx;
+
+	for( sfx = buffers_lru.next; sfx && sfx != &buffers_lru; sfx = sfx->next )
+	{
+		count++;
+		if( sfx->isStreaming )
+			streaming++;
+	}
+
+	Com_Printf( "%5i sounds in memory, %i streaming\n", count, streaming );
+	Com_Printf( "%5.1f MB used of %.1f MB\n", buffers_size / ( 1024.0 * 1024.0 ), s_buffercache->value );
+	Com_Printf( "%5u hits\n", buffers_stats.hits );
+	Com_Printf( "%5u misses\n", buffers_stats.misses );
+	Com_Printf( "%5u evictions\n", buffers_stats.evictions );
+	Com_Printf( "%5u streamed\n", buffers_stats.streamed );
+}
+
 void S_UseBuffer( sfx_t *sfx )
 {
 	if( sfx->filename[0] == '\0' )
 		return;
 
-	if( !sfx->inMemory )
+	if( sfx->inMemory )
+	{
+		buffers_stats.hits++;
+		buffer_lru_link( sfx );
+	}
+	else
+	{
+		buffers_stats.misses++;
 		S_LoadBuffer( sfx );
+	}
 
 	sfx->used = trap_Milliseconds();
 }
@@ -64,12 +64,17 @@ typedef struct sfx_s
 	bool inMemory;
 	bool isLocked;
 	int used;           // Time last used
+	int size;           // bytes of decoded audio in the buffer
+	bool isStreaming;   // the buffer only holds a prefix, the rest is being decoded
+	int loadSequence;   // bumped on unload, to recognize outdated decoding jobs
+	struct sfx_s *prev, *next; // least recently used list of sounds in memory
 } sfx_t;
 
 extern cvar_t *s_volume;
 extern cvar_t *s_musicvolume;
 extern cvar_t *s_sources;
 extern cvar_t *s_stereo2mono;
+extern cvar_t *s_buffercache;
 
 extern cvar_t *s_doppler;
 extern cvar_t *s_sound_velocity;
@@ -156,6 +161,8 @@ void S_ForEachBuffer( void (*callback)(sfx_t *sfx) );
 sfx_t *S_GetBufferById( int id );
 bool S_LoadBuffer( sfx_t *sfx );
 bool S_UnloadBuffer( sfx_t *sfx );
+void S_UpdateBuffers( void );
+void S_BufferInfo_f( void );
 
 /*
 * Source management
@@ -180,6 +187,7 @@ typedef struct src_s
 	bool isLooping;
 	bool isTracking;
 	bool keepAlive;
+	bool isPrefixed;	// playing the prefix of a sound that is still being decoded, kept until the rest is queued
 
 	vec3_t origin, velocity; // for local culling
 } src_t;
@@ -195,6 +203,8 @@ void S_StopAllSources( void );
 ALuint S_GetALSource( const src_t *src );
 src_t *S_AllocRawSource( int entNum, float fvol, float attenuation, cvar_t *volumeVar );
 void S_SetEntitySpatialization( int entnum, const vec3_t origin, const vec3_t velocity );
+bool S_IsSfxPlaying( const sfx_t *sfx );
+int S_QueueSfxTail( const sfx_t *sfx, ALuint buffer );
 
 /*
 * Music
@@ -34,6 +34,7 @@ cvar_t *s_openAL_device;
 cvar_t *s_doppler;
 cvar_t *s_sound_velocity;
 cvar_t *s_stereo2mono;
+cvar_t *s_buffercache;
 cvar_t *s_globalfocus;
 
 static int s_registration_sequence = 1;
@@ -104,6 +105,14 @@ static void SF_ListDevices_f( void )
 	S_IssueStuffCmd( s_cmdPipe, "devicelist" );
 }
 
+/*
+* SF_SoundInfo_f
+*/
+static void SF_SoundInfo_f( void )
+{
+	S_IssueStuffCmd( s_cmdPipe, "soundinfo" );
+}
+
 /*
 * SF_Init
 */
@@ -118,6 +127,7 @@ bool SF_Init( void *hwnd, int maxEntities, bool verbose )
 	s_doppler = trap_Cvar_Get( "s_doppler", "1.0", CVAR_ARCHIVE );
 	s_sound_velocity = trap_Cvar_Get( "s_sound_velocity", "10976", CVAR_DEVELOPER );
 	s_stereo2mono = trap_Cvar_Get ( "s_stereo2mono", "0", CVAR_ARCHIVE );
+	s_buffercache = trap_Cvar_Get( "s_buffercache", "64", CVAR_ARCHIVE );
 	s_globalfocus = trap_Cvar_Get( "s_globalfocus", "0", CVAR_ARCHIVE );
 
 #ifdef ENABLE_PLAY
@@ -130,6 +140,7 @@ bool SF_Init( void *hwnd, int maxEntities, bool verbose )
 	trap_Cmd_AddCommand( "pausemusic", SF_PauseBackgroundTrack );
 	trap_Cmd_AddCommand( "soundlist", SF_SoundList_f );
 	trap_Cmd_AddCommand( "s_devices", SF_ListDevices_f );
+	trap_Cmd_AddCommand( "s_soundinfo", SF_SoundInfo_f );
 
 	s_cmdPipe = S_CreateSoundCmdPipe();
 	if( !s_cmdPipe ) {
@@ -192,6 +203,7 @@ void SF_Shutdown( bool verbose )
 	trap_Cmd_RemoveCommand( "pausemusic" );
 	trap_Cmd_RemoveCommand( "soundlist" );
 	trap_Cmd_RemoveCommand( "s_devices" );
+	trap_Cmd_RemoveCommand( "s_soundinfo" );
 
 	QAL_Shutdown();
 
@@ -79,7 +79,14 @@ static void source_setup( src_t *src, sfx_t *sfx, int priority, int entNum,
 	qalSourcef( src->source, AL_GAIN, fvol * s_volume->value );
 	qalSourcei( src->source, AL_SOURCE_RELATIVE, AL_FALSE );
 	qalSourcei( src->source, AL_LOOPING, AL_FALSE );
-	qalSourcei( src->source, AL_BUFFER, buffer );
+	qalSourcei( src->source, AL_BUFFER, AL_NONE );
+
+	// the rest of a sound that is still being decoded gets queued after its prefix
+	src->isPrefixed = sfx && sfx->isStreaming && buffer;
+	if( src->isPrefixed )
+		qalSourceQueueBuffers( src->source, 1, &buffer );
+	else
+		qalSourcei( src->source, AL_BUFFER, buffer );
 
 	qalSourcef( src->source, AL_REFERENCE_DISTANCE, s_attenuation_refdistance );
 	qalSourcef( src->source, AL_MAX_DISTANCE, s_attenuation_maxdistance );
@@ -129,6 +136,7 @@ static void source_kill( src_t *src )
 	src->isLocked = false;
 	src->isLooping = false;
 	src->isTracking = false;
+	src->isPrefixed = false;
 }
 
 /*
@@ -169,6 +177,16 @@ static void source_loop( int priority, sfx_t *sfx, int entNum, float fvol, float
 	if( entNum < 0 || entNum >= max_ents )
 		return;
 
+	// the prefix of a sound that is still being decoded would loop on its own,
+	// so only start once the whole sound is in the buffer
+	if( !entlist[entNum].src || entlist[entNum].src->sfx != sfx )
+	{
+		if( !sfx->inMemory )
+			S_UseBuffer( sfx );
+		if( sfx->isStreaming )
+			return;
+	}
+
 	// Do we need to start a new sound playing?
 	if( !entlist[entNum].src )
 	{
@@ -315,6 +333,10 @@ void S_UpdateSources( void )
 		qalGetSourcei( srclist[i].source, AL_SOURCE_STATE, &state );
 		if( state == AL_STOPPED )
 		{
+			// ran out of the prefix before the rest was decoded, S_QueueSfxTail restarts it
+			if( srclist[i].isPrefixed && srclist[i].sfx->isStreaming )
+				continue;
+
 			source_kill( &srclist[i] );
 			if( entNum >= 0 && entNum < max_ents ) {
 				entlist[entNum].src = NULL;
@@ -340,6 +362,61 @@ void S_UpdateSources( void )
 	}
 }
 
+/*
+* S_IsSfxPlaying
+*/
+bool S_IsSfxPlaying( const sfx_t *sfx )
+{
+	int i;
+
+	for( i = 0; i < src_count; i++ )
+	{
+		if( srclist[i].isActive && srclist[i].sfx == sfx )
+			return true;
+	}
+
+	return false;
+}
+
+/*
+* S_QueueSfxTail
+*
+* Queues the rest of a sound after the prefix on every source still playing it,
+* returns the number of sources the buffer has been queued on. Sources that have
+* already played the whole prefix resume at its end.
+*/
+int S_QueueSfxTail( const sfx_t *sfx, ALuint buffer )
+{
+	int i, count, numbufs;
+	ALint state;
+	ALuint prefix;
+
+	count = 0;
+	for( i = 0; i < src_count; i++ )
+	{
+		if( !srclist[i].isActive || !srclist[i].isPrefixed || srclist[i].sfx != sfx )
+			continue;
+
+		qalGetSourcei( srclist[i].source, AL_SOURCE_STATE, &state );
+		if( state == AL_STOPPED )
+		{
+			// playing a stopped source rewinds its queue, so drop the prefix first
+			qalGetSourcei( srclist[i].source, AL_BUFFERS_PROCESSED, &numbufs );
+			while( numbufs-- > 0 )
+				qalSourceUnqueueBuffers( srclist[i].source, 1, &prefix );
+		}
+
+		qalSourceQueueBuffers( srclist[i].source, 1, &buffer );
+		srclist[i].isPrefixed = false;
+		count++;
+
+		if( state == AL_STOPPED )
+			qalSourcePlay( srclist[i].source );
+	}
+
+	return count;
+}
+
 /*
 * S_AllocSource
 */
@@ -435,8 +512,6 @@ void S_StartLocalSound( sfx_t *sfx )
 	if( !src )
 		return;
 
-	S_UseBuffer( sfx );
-
 	source_setup( src, sfx, SRCPRI_LOCAL, -1, S_CHANNEL_AUTO, 1.0, ATTN_NONE );
 	qalSourcei( src->source, AL_SOURCE_RELATIVE, AL_TRUE );
 
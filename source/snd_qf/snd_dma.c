@@ -146,8 +146,6 @@ static bool S_Init( void *hwnd, int maxEntities, bool verbose )
 
 	memset( raw_sounds, 0, sizeof( raw_sounds ) );
 
-	S_InitScaletable();
-
 	// highfrequency attenuation filter
 	s_lpf_cw = S_LowpassCW( HQ_HF_FREQUENCY, dma.speed );
 
@@ -1259,10 +1257,6 @@ static void S_Update( void )
 	int total;
 	channel_t *ch;
 
-	// rebuild scale tables if volume is modified
-	if( s_volume->modified )
-		S_InitScaletable();
-
 	//
 	// debugging output
 	//
@@ -1436,10 +1430,7 @@ static unsigned S_HandleFreeSfxCmd( const sndCmdFreeSfx_t *cmd )
 	sfx_t *sfx;
 	//Com_Printf("S_HandleFreeSfxCmd\n");
 	sfx = known_sfx + cmd->sfx;
-	if( sfx->cache ) {
-		S_Free( sfx->cache );
-		sfx->cache = NULL;
-	}
+	S_FreeSound( sfx );
 	return sizeof( *cmd );
 }
 
@@ -1658,6 +1649,11 @@ static unsigned S_HandleStuffCmd( const sndStuffCmd_t *cmd )
 	if( !Q_stricmp( cmd->text, "soundlist" ) ) {
 		S_SoundList_f();
 	}
+	else if( !Q_strnicmp( cmd->text, "mixbench ", 9 ) ) {
+		int seconds = 0, hq = 0;
+		sscanf( cmd->text + 9, "%i %i", &seconds, &hq );
+		S_MixBenchmark( seconds, hq != 0 );
+	}
 	return sizeof( *cmd );
 }
 
@@ -30,7 +30,6 @@ typedef struct { char *name; void **funcPointer; } dllfunc_t;
 #include "../client/snd_public.h"
 #include "snd_syscalls.h"
 
-// !!! if this is changed, the asm code must change !!!
 typedef struct
 {
 	int left;
@@ -52,7 +51,9 @@ typedef struct sfx_s
 	char name[MAX_QPATH];
 	int registration_sequence;
 	bool isUrl;
+	volatile bool isLoading;	// queued for the registration thread
 	sfxcache_t *cache;
+	bool cachemapped;			// the cache is mapped from disk
 } sfx_t;
 
 typedef struct
@@ -121,6 +122,7 @@ typedef struct
 	unsigned int ldelay;	// invidual ear delay offset for both channels
 	unsigned int rdelay;
 	rawsound_t *rawsamples;	// got no static sfx, read samples directly
+	float paintvol[2];		// volumes the channel was last painted with, ramped towards leftvol and rightvol
 } channel_t;
 
 typedef struct
@@ -246,6 +248,7 @@ extern cvar_t *s_swapstereo;
 extern cvar_t *s_pseudoAcoustics;
 extern cvar_t *s_separationDelay;
 extern cvar_t *s_globalfocus;
+extern cvar_t *s_soundcache;
 
 extern struct mempool_s *soundpool;
 
@@ -261,13 +264,14 @@ extern struct mempool_s *soundpool;
 wavinfo_t GetWavinfo( const char *name, uint8_t *wav, int wavlength );
 unsigned int ResampleSfx( unsigned int numsamples, unsigned int speed, unsigned short channels, unsigned short width, const uint8_t *data, uint8_t *outdata, char *name );
 
-void S_InitScaletable( void );
-
 sfxcache_t *S_LoadSound( sfx_t *s );
+sfxcache_t *S_LoadSoundData( sfx_t *s );
+void S_FreeSound( sfx_t *s );
 
 void S_IssuePlaysound( playsound_t *ps );
 
 int S_PaintChannels( unsigned int endtime, int dumpfile, float gain );
+void S_MixBenchmark( int seconds, bool hq );
 
 //====================================================================
 
@@ -25,6 +25,32 @@ static sndCmdPipe_t *s_cmdPipe;
 
 static struct qthread_s *s_backThread;
 
+// sounds registered during map loading are decoded by a separate thread,
+// so that the registration doesn't have to wait for them
+enum
+{
+	SND_LOADER_CMD_LOAD,
+	SND_LOADER_CMD_SHUTDOWN,
+
+	SND_LOADER_CMD_NUM_CMDS
+};
+
+typedef struct
+{
+	int id;
+	int sfx;
+} sndLoaderCmdLoad_t;
+
+typedef struct
+{
+	int id;
+} sndLoaderCmdShutdown_t;
+
+#define SND_LOADER_PIPE_SIZE	0x4000
+
+static qbufPipe_t *s_loaderPipe;
+static struct qthread_s *s_loaderThread;
+
 static int s_registration_sequence;
 static bool	s_registering;
 
@@ -47,6 +73,7 @@ cvar_t *s_swapstereo;
 cvar_t *s_pseudoAcoustics;
 cvar_t *s_separationDelay;
 cvar_t *s_globalfocus;
+cvar_t *s_soundcache;
 
 sfx_t known_sfx[MAX_SFX];
 int num_sfx;
@@ -86,6 +113,21 @@ static void SF_SoundList_f( void )
 	S_IssueStuffCmd( s_cmdPipe, "soundlist" );
 }
 
+/*
+* SF_MixBenchmark_f
+*/
+static void SF_MixBenchmark_f( void )
+{
+	if( trap_Cmd_Argc() < 2 )
+	{
+		Com_Printf( "s_mixbench: <seconds> [pseudoacoustics]\n" );
+		return;
+	}
+
+	// the mixer belongs to the background thread
+	S_IssueStuffCmd( s_cmdPipe, va( "mixbench %i %i", atoi( trap_Cmd_Argv( 1 ) ), atoi( trap_Cmd_Argv( 2 ) ) ) );
+}
+
 /*
 * S_Music
 */
@@ -126,6 +168,91 @@ static void SF_StopAllSounds_f( void )
 // Load a sound
 // =======================================================================
 
+/*
+* SF_HandleLoaderLoadCmd
+*/
+static unsigned SF_HandleLoaderLoadCmd( const sndLoaderCmdLoad_t *cmd )
+{
+	sfx_t *sfx = known_sfx + cmd->sfx;
+
+	S_LoadSoundData( sfx );
+	sfx->isLoading = false;
+	return sizeof( *cmd );
+}
+
+/*
+* SF_HandleLoaderShutdownCmd
+*/
+static unsigned SF_HandleLoaderShutdownCmd( const sndLoaderCmdShutdown_t *cmd )
+{
+	return 0; // terminate
+}
+
+static pipeCmdHandler_t sndLoaderCmdHandlers[SND_LOADER_CMD_NUM_CMDS] =
+{
+	/* SND_LOADER_CMD_LOAD */
+	(pipeCmdHandler_t)SF_HandleLoaderLoadCmd,
+	/* SND_LOADER_CMD_SHUTDOWN */
+	(pipeCmdHandler_t)SF_HandleLoaderShutdownCmd,
+};
+
+/*
+* SF_LoaderWaiter
+*/
+static int SF_LoaderWaiter( qbufPipe_t *queue, pipeCmdHandler_t *cmdHandlers, bool timeout )
+{
+	return trap_BufPipe_ReadCmds( queue, cmdHandlers );
+}
+
+/*
+* SF_LoaderProc
+*/
+static void *SF_LoaderProc( void *param )
+{
+	trap_BufPipe_Wait( s_loaderPipe, SF_LoaderWaiter, sndLoaderCmdHandlers, Q_THREADS_WAIT_INFINITE );
+	return NULL;
+}
+
+/*
+* SF_InitLoader
+*/
+static void SF_InitLoader( void )
+{
+	s_loaderPipe = trap_BufPipe_Create( SND_LOADER_PIPE_SIZE, 1 );
+	if( s_loaderPipe )
+		s_loaderThread = trap_Thread_Create( SF_LoaderProc, NULL );
+}
+
+/*
+* SF_FinishLoader
+*
+* Blocks until all queued sounds are loaded.
+*/
+static void SF_FinishLoader( void )
+{
+	if( s_loaderThread )
+		trap_BufPipe_Finish( s_loaderPipe );
+}
+
+/*
+* SF_ShutdownLoader
+*/
+static void SF_ShutdownLoader( void )
+{
+	sndLoaderCmdShutdown_t cmd;
+
+	if( s_loaderThread )
+	{
+		cmd.id = SND_LOADER_CMD_SHUTDOWN;
+		trap_BufPipe_WriteCmd( s_loaderPipe, &cmd, sizeof( cmd ) );
+		trap_Thread_Join( s_loaderThread );
+		s_loaderThread = NULL;
+	}
+
+	if( s_loaderPipe )
+		trap_BufPipe_Destroy( &s_loaderPipe );
+}
+
 /*
 * SF_FindName
 */
@@ -187,6 +314,9 @@ void SF_BeginRegistration( void )
 
 	// wait for the queue to be processed
 	S_FinishSoundCmdPipe( s_cmdPipe );
+
+	// and for the sounds of the previous registration
+	SF_FinishLoader();
 }
 
 /*
@@ -195,7 +325,7 @@ void SF_BeginRegistration( void )
 sfx_t *SF_RegisterSound( const char *name )
 {
 	sfx_t *sfx;
-	int sfxnum;
+	sndLoaderCmdLoad_t cmd;
 
 	assert( name );
 
@@ -203,13 +333,19 @@ sfx_t *SF_RegisterSound( const char *name )
 	if( sfx->registration_sequence != s_registration_sequence ) {
 		sfx->registration_sequence = s_registration_sequence;
 
-		// evenly balance the load between two threads during registration
-		sfxnum = sfx - known_sfx;
-		if( !s_registering || sfxnum & 1 ) {
-			S_IssueLoadSfxCmd( s_cmdPipe, sfxnum );
+		// leave the sounds to the loader thread during registration,
+		// the mixer skips them until they're ready
+		if( s_registering && s_loaderThread ) {
+			if( !sfx->cache && !sfx->isUrl && !sfx->isLoading ) {
+				sfx->isLoading = true;
+
+				cmd.id = SND_LOADER_CMD_LOAD;
+				cmd.sfx = sfx - known_sfx;
+				trap_BufPipe_WriteCmd( s_loaderPipe, &cmd, sizeof( cmd ) );
+			}
 		}
 		else {
-			S_LoadSound( sfx );
+			S_IssueLoadSfxCmd( s_cmdPipe, sfx - known_sfx );
 		}
 	}
 	return sfx;
@@ -223,8 +359,9 @@ void SF_FreeSounds( void )
 	int i;
 	sfx_t *sfx;
 
-	// wait for the queue to be processed
+	// wait for the queues to be processed
 	S_FinishSoundCmdPipe( s_cmdPipe );
+	SF_FinishLoader();
 
 	// free all sounds
 	for( i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++ )
@@ -232,7 +369,7 @@ void SF_FreeSounds( void )
 		if( !sfx->name[0] ) {
 			continue;
 		}
-		S_Free( sfx->cache );
+		S_FreeSound( sfx );
 		memset( sfx, 0, sizeof( *sfx ) );
 	}
 }
@@ -245,7 +382,8 @@ void SF_EndRegistration( void )
 	int i;
 	sfx_t *sfx;
 
-	// wait for the queue to be processed
+	// wait for the queue to be processed, the sounds of this
+	// registration are still being loaded by the loader thread
 	S_FinishSoundCmdPipe( s_cmdPipe );
 
 	s_registering = false;
@@ -257,7 +395,7 @@ void SF_EndRegistration( void )
 		}
 		if( sfx->registration_sequence != s_registration_sequence ) {
 			// we don't need this sound
-			S_Free( sfx->cache );
+			S_FreeSound( sfx );
 			memset( sfx, 0, sizeof( *sfx ) );
 		}
 	}
@@ -282,6 +420,7 @@ bool SF_Init( void *hwnd, int maxEntities, bool verbose )
 	s_pseudoAcoustics = trap_Cvar_Get( "s_pseudoAcoustics", "0", CVAR_ARCHIVE );
 	s_separationDelay = trap_Cvar_Get( "s_separationDelay", "1.0", CVAR_ARCHIVE );
 	s_globalfocus = trap_Cvar_Get( "s_globalfocus", "0", CVAR_ARCHIVE );
+	s_soundcache = trap_Cvar_Get( "s_soundcache", "1", CVAR_ARCHIVE );
 
 #ifdef ENABLE_PLAY
 	trap_Cmd_AddCommand( "play", SF_Play_f );
@@ -294,6 +433,7 @@ bool SF_Init( void *hwnd, int maxEntities, bool verbose )
 	trap_Cmd_AddCommand( "pausemusic", SF_PauseBackgroundTrack );
 	trap_Cmd_AddCommand( "soundlist", SF_SoundList_f );
 	trap_Cmd_AddCommand( "soundinfo", SF_SoundInfo_f );
+	trap_Cmd_AddCommand( "s_mixbench", SF_MixBenchmark_f );
 
 	num_sfx = 0;
 	
@@ -309,6 +449,8 @@ bool SF_Init( void *hwnd, int maxEntities, bool verbose )
 
 	s_backThread = trap_Thread_Create( S_BackgroundUpdateProc, s_cmdPipe );
 
+	SF_InitLoader();
+
 	S_IssueInitCmd( s_cmdPipe, hwnd, maxEntities, verbose );
 
 	S_FinishSoundCmdPipe( s_cmdPipe );
@@ -336,6 +478,8 @@ void SF_Shutdown( bool verbose )
 
 	// free all sounds
 	SF_FreeSounds();
+
+	SF_ShutdownLoader();
 	
 	// wake up the mixer
 	SF_Activate( true );
@@ -363,6 +507,7 @@ void SF_Shutdown( bool verbose )
 	trap_Cmd_RemoveCommand( "pausemusic" );
 	trap_Cmd_RemoveCommand( "soundlist" );
 	trap_Cmd_RemoveCommand( "soundinfo" );
+	trap_Cmd_RemoveCommand( "s_mixbench" );
 
 	S_MemFreePool( &soundpool );
 
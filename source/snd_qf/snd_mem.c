@@ -265,35 +265,230 @@ sfxcache_t *S_LoadSound_Wav( sfx_t *s )
 }
 
 /*
-* S_LoadSound
+===============================================================================
+
+Persistent sound cache
+
+Resampled sounds are stored in the cache directory, keyed by the size and
+modification time of the source file and the output rate, and mapped back
+into memory when the same sound is loaded again.
+
+===============================================================================
 */
-sfxcache_t *S_LoadSound( sfx_t *s )
+
+#define SOUND_CACHE_DIRECTORY	"soundcache"
+#define SOUND_CACHE_EXTENSION	".sfxcache"
+#define SOUND_CACHE_MAGIC		( ( 'C' << 24 ) + ( 'X' << 16 ) + ( 'F' << 8 ) + 'S' )
+#define SOUND_CACHE_VERSION		2
+
+typedef struct
+{
+	int magic;
+	int version;
+	unsigned int checksum;      // of the source file size and mtime
+	unsigned int speed;         // output rate the sound was resampled to
+	unsigned int size;          // of the sfxcache_t that follows
+} sndcacheheader_t;
+
+/*
+* S_SoundCachePath
+*/
+static void S_SoundCachePath( const char *name, char *path, size_t size )
+{
+	Q_snprintfz( path, size, "%s/%s%s", SOUND_CACHE_DIRECTORY, name, SOUND_CACHE_EXTENSION );
+}
+
+/*
+* S_ChecksumSoundFile
+*
+* Identifies the source file by its size and modification time,
+* so that a cache hit doesn't need to read it
+*/
+static bool S_ChecksumSoundFile( const char *name, unsigned int *checksum )
+{
+	unsigned int hash = 2166136261u;
+	int filenum, length;
+	uint64_t mtime;
+
+	length = trap_FS_FOpenFile( name, &filenum, FS_READ );
+	if( !filenum )
+		return false;
+	trap_FS_FCloseFile( filenum );
+	if( length <= 0 )
+		return false;
+
+	mtime = (uint64_t)trap_FS_FileMTime( name );
+	if( !mtime || mtime == (uint64_t)-1 )
+		return false;
+
+	hash = ( hash ^ (unsigned int)length ) * 16777619u;
+	hash = ( hash ^ (unsigned int)mtime ) * 16777619u;
+	hash = ( hash ^ (unsigned int)( mtime >> 32 ) ) * 16777619u;
+
+	*checksum = hash;
+	return true;
+}
+
+/*
+* S_ValidCachedSound
+*/
+static bool S_ValidCachedSound( const sfxcache_t *sc, size_t size )
+{
+	if( sc->channels < 1 || sc->channels > 2 || sc->width < 1 || sc->width > 2 )
+		return false;
+	if( sc->speed != dma.speed || sc->loopstart > sc->length )
+		return false;
+	return sizeof( sfxcache_t ) + (size_t)sc->length * sc->channels * sc->width <= size;
+}
+
+/*
+* S_ReadCachedSound
+*/
+static bool S_ReadCachedSound( sfx_t *s, unsigned int checksum )
+{
+	char path[MAX_QPATH * 2];
+	sndcacheheader_t header;
+	sfxcache_t *sc;
+	int filenum, length;
+
+	S_SoundCachePath( s->name, path, sizeof( path ) );
+	length = trap_FS_FOpenFile( path, &filenum, FS_READ|FS_CACHE );
+	if( !filenum )
+		return false;
+
+	if( length < (int)( sizeof( header ) + sizeof( sfxcache_t ) )
+		|| trap_FS_Read( &header, sizeof( header ), filenum ) != sizeof( header )
+		|| header.magic != SOUND_CACHE_MAGIC || header.version != SOUND_CACHE_VERSION
+		|| header.checksum != checksum || header.speed != dma.speed
+		|| header.size != length - sizeof( header ) )
+	{
+		trap_FS_FCloseFile( filenum );
+		return false;
+	}
+
+	// the mapping stays valid once the file is closed
+	sc = trap_FS_MMapBaseFileDetached( filenum, header.size, sizeof( header ) );
+	if( sc )
+	{
+		trap_FS_FCloseFile( filenum );
+
+		if( !S_ValidCachedSound( sc, header.size ) )
+		{
+			trap_FS_UnMMapDetached( sc );
+			return false;
+		}
+
+		s->cachemapped = true;
+		s->cache = sc;
+		return true;
+	}
+
+	// the file can't be mapped, read it instead
+	sc = S_Malloc( header.size );
+	if( trap_FS_Read( sc, header.size, filenum ) != (int)header.size || !S_ValidCachedSound( sc, header.size ) )
+	{
+		S_Free( sc );
+		trap_FS_FCloseFile( filenum );
+		return false;
+	}
+
+	trap_FS_FCloseFile( filenum );
+
+	s->cache = sc;
+	return true;
+}
+
+/*
+* S_WriteCachedSound
+*/
+static void S_WriteCachedSound( const sfx_t *s, unsigned int checksum )
+{
+	char path[MAX_QPATH * 2];
+	sndcacheheader_t header;
+	const sfxcache_t *sc = s->cache;
+	int filenum;
+
+	header.magic = SOUND_CACHE_MAGIC;
+	header.version = SOUND_CACHE_VERSION;
+	header.checksum = checksum;
+	header.speed = dma.speed;
+	header.size = sizeof( sfxcache_t ) + sc->length * sc->channels * sc->width;
+
+	S_SoundCachePath( s->name, path, sizeof( path ) );
+	if( trap_FS_FOpenFile( path, &filenum, FS_WRITE|FS_CACHE ) == -1 )
+		return;
+
+	trap_FS_Write( &header, sizeof( header ), filenum );
+	trap_FS_Write( sc, header.size, filenum );
+	trap_FS_FCloseFile( filenum );
+}
+
+/*
+* S_FreeSound
+*/
+void S_FreeSound( sfx_t *s )
+{
+	if( s->cachemapped )
+	{
+		trap_FS_UnMMapDetached( s->cache );
+		s->cachemapped = false;
+	}
+	else if( s->cache )
+	{
+		S_Free( s->cache );
+	}
+	s->cache = NULL;
+}
+
+/*
+* S_LoadSoundData
+*
+* Loads the sound from the disk cache or decodes it, even if it's
+* flagged as being loaded by the registration thread.
+*/
+sfxcache_t *S_LoadSoundData( sfx_t *s )
 {
 	const char *extension;
+	unsigned int checksum = 0;
+	bool cached;
+	sfxcache_t *sc = NULL;
 
 	if( !s->name[0] )
 		return NULL;
 	if( s->isUrl )
 		return NULL;
-
-	// see if still in memory
 	if( s->cache )
 		return s->cache;
 
+	cached = s_soundcache->integer && S_ChecksumSoundFile( s->name, &checksum );
+	if( cached && S_ReadCachedSound( s, checksum ) )
+		return s->cache;
+
 	extension = COM_FileExtension( s->name );
 	if( extension )
 	{
 		if( !Q_stricmp( extension, ".wav" ) )
-		{
-			return S_LoadSound_Wav( s );
-		}
-		if( !Q_stricmp( extension, ".ogg" ) )
-		{
-			return SNDOGG_Load( s );
-		}
+			sc = S_LoadSound_Wav( s );
+		else if( !Q_stricmp( extension, ".ogg" ) )
+			sc = SNDOGG_Load( s );
 	}
 
-	return NULL;
+	if( sc && cached )
+		S_WriteCachedSound( s, checksum );
+
+	return sc;
+}
+
+/*
+* S_LoadSound
+*/
+sfxcache_t *S_LoadSound( sfx_t *s )
+{
+	// the registration thread publishes the cache before clearing the flag
+	if( s->isLoading )
+		return NULL;
+
+	return S_LoadSoundData( s );
 }
 
 
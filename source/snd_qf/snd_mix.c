@@ -21,307 +21,452 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "snd_local.h"
 
+#if defined ( __SSE2__ ) || defined ( _M_X64 ) || ( defined ( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define S_MIX_SSE2
+#include <emmintrin.h>
+#elif defined ( __ARM_NEON ) || defined ( __ARM_NEON__ )
+#define S_MIX_NEON
+#include <arm_neon.h>
+#endif
+
 #define	PAINTBUFFER_SIZE    2048
-static portable_samplepair_t paintbuffer[PAINTBUFFER_SIZE];
-static int snd_scaletable[32][256];
-static int *snd_p, snd_linear_count, snd_vol, music_vol;
-static short *snd_out;
+#define	S_VOLUME_RAMP_SAMPLES	64	// volume changes are spread over this many samples
+
+// interleaved left and right samples, in the range of 16-bit output
+static float paintbuffer[PAINTBUFFER_SIZE*2];
+static float snd_vol;
+
+/*
+===============================================================================
 
-#if defined ( __arm__ ) && defined ( __GNUC__ )
-// 40-50% faster than the C version.
-// Uses signed saturation instruction (available since ARMv6 or Thumb2) instead of comparisons,
-// with the right shift being a part of the saturation instruction.
+SIMD KERNELS
 
-static void S_WriteLinearBlastStereo16( void )
+Every kernel adds count samples of a sound to the paint buffer, starting with
+the given volumes and adding the steps to them after each sample.
+
+===============================================================================
+*/
+
+#if defined ( S_MIX_SSE2 )
+
+static void S_PaintStereo16( float *out, const short *in, unsigned int count, float lvol, float rvol, float lstep, float rstep )
 {
-	int i;
-	int val;
+	unsigned int i;
+	__m128 vol0, vol1, inc;
+	__m128i s;
+
+	vol0 = _mm_setr_ps( lvol, rvol, lvol + lstep, rvol + rstep );
+	vol1 = _mm_add_ps( vol0, _mm_setr_ps( lstep * 2, rstep * 2, lstep * 2, rstep * 2 ) );
+	inc = _mm_setr_ps( lstep * 4, rstep * 4, lstep * 4, rstep * 4 );
 
-	for( i = 0; i < snd_linear_count; i += 2 )
+	for( i = 0; i + 4 <= count; i += 4, in += 8, out += 8 )
 	{
-		val = snd_p[i];
-		__asm__( "ssat %0, #16, %0, asr #8\n" : "+r"( val ) );
-		snd_out[i] = val;
+		s = _mm_loadu_si128( ( const __m128i * )in );
+		_mm_storeu_ps( out, _mm_add_ps( _mm_loadu_ps( out ),
+			_mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( s, s ), 16 ) ), vol0 ) ) );
+		_mm_storeu_ps( out + 4, _mm_add_ps( _mm_loadu_ps( out + 4 ),
+			_mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( s, s ), 16 ) ), vol1 ) ) );
+		vol0 = _mm_add_ps( vol0, inc );
+		vol1 = _mm_add_ps( vol1, inc );
+	}
 
-		val = snd_p[i+1];
-		__asm__( "ssat %0, #16, %0, asr #8\n" : "+r"( val ) );
-		snd_out[i+1] = val;
+	lvol += lstep * i;
+	rvol += rstep * i;
+	for( ; i < count; i++, in += 2, out += 2 )
+	{
+		out[0] += in[0] * lvol;
+		out[1] += in[1] * rvol;
+		lvol += lstep;
+		rvol += rstep;
 	}
 }
 
-static void S_WriteSwappedLinearBlastStereo16( void )
+static void S_PaintMono16( float *out, const short *in, unsigned int count, float lvol, float rvol, float lstep, float rstep )
 {
-	int i;
-	int val;
+	unsigned int i;
+	__m128 vol0, vol1, inc, f;
+	__m128i s;
+
+	vol0 = _mm_setr_ps( lvol, rvol, lvol + lstep, rvol + rstep );
+	vol1 = _mm_add_ps( vol0, _mm_setr_ps( lstep * 2, rstep * 2, lstep * 2, rstep * 2 ) );
+	inc = _mm_setr_ps( lstep * 4, rstep * 4, lstep * 4, rstep * 4 );
 
-	for( i = 0; i < snd_linear_count; i += 2 )
+	for( i = 0; i + 4 <= count; i += 4, in += 4, out += 8 )
 	{
-		val = snd_p[i+1];
-		__asm__( "ssat %0, #16, %0, asr #8\n" : "+r"( val ) );
-		snd_out[i] = val;
+		s = _mm_loadl_epi64( ( const __m128i * )in );
+		f = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( s, s ), 16 ) );
+		_mm_storeu_ps( out, _mm_add_ps( _mm_loadu_ps( out ), _mm_mul_ps( _mm_unpacklo_ps( f, f ), vol0 ) ) );
+		_mm_storeu_ps( out + 4, _mm_add_ps( _mm_loadu_ps( out + 4 ), _mm_mul_ps( _mm_unpackhi_ps( f, f ), vol1 ) ) );
+		vol0 = _mm_add_ps( vol0, inc );
+		vol1 = _mm_add_ps( vol1, inc );
+	}
 
-		val = snd_p[i];
-		__asm__( "ssat %0, #16, %0, asr #8\n" : "+r"( val ) );
-		snd_out[i+1] = val;
+	lvol += lstep * i;
+	rvol += rstep * i;
+	for( ; i < count; i++, in++, out += 2 )
+	{
+		out[0] += in[0] * lvol;
+		out[1] += in[0] * rvol;
+		lvol += lstep;
+		rvol += rstep;
 	}
 }
 
-#elif !defined ( id386 ) || defined ( __MACOSX__ )
-#ifdef _WIN32
-#pragma warning( push )
-#pragma warning( disable : 4310 )       // cast truncates constant value
-#endif
-static void S_WriteLinearBlastStereo16( void )
+static void S_PaintStereo8( float *out, const signed char *in, unsigned int count, float lvol, float rvol, float lstep, float rstep )
+{
+	unsigned int i;
+	__m128 vol0, vol1, inc;
+	__m128i s;
+
+	vol0 = _mm_setr_ps( lvol, rvol, lvol + lstep, rvol + rstep );
+	vol1 = _mm_add_ps( vol0, _mm_setr_ps( lstep * 2, rstep * 2, lstep * 2, rstep * 2 ) );
+	inc = _mm_setr_ps( lstep * 4, rstep * 4, lstep * 4, rstep * 4 );
+
+	for( i = 0; i + 4 <= count; i += 4, in += 8, out += 8 )
+	{
+		s = _mm_loadl_epi64( ( const __m128i * )in );
+		s = _mm_unpacklo_epi8( s, s );
+		_mm_storeu_ps( out, _mm_add_ps( _mm_loadu_ps( out ),
+			_mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( s, s ), 24 ) ), vol0 ) ) );
+		_mm_storeu_ps( out + 4, _mm_add_ps( _mm_loadu_ps( out + 4 ),
+			_mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( s, s ), 24 ) ), vol1 ) ) );
+		vol0 = _mm_add_ps( vol0, inc );
+		vol1 = _mm_add_ps( vol1, inc );
+	}
+
+	lvol += lstep * i;
+	rvol += rstep * i;
+	for( ; i < count; i++, in += 2, out += 2 )
+	{
+		out[0] += in[0] * lvol;
+		out[1] += in[1] * rvol;
+		lvol += lstep;
+		rvol += rstep;
+	}
+}
+
+static void S_PaintMono8( float *out, const signed char *in, unsigned int count, float lvol, float rvol, float lstep, float rstep )
+{
+	unsigned int i;
+	int packed;
+	__m128 vol0, vol1, inc, f;
+	__m128i s;
+
+	vol0 = _mm_setr_ps( lvol, rvol, lvol + lstep, rvol + rstep );
+	vol1 = _mm_add_ps( vol0, _mm_setr_ps( lstep * 2, rstep * 2, lstep * 2, rstep * 2 ) );
+	inc = _mm_setr_ps( lstep * 4, rstep * 4, lstep * 4, rstep * 4 );
+
+	for( i = 0; i + 4 <= count; i += 4, in += 4, out += 8 )
+	{
+		memcpy( &packed, in, sizeof( packed ) );
+		s = _mm_cvtsi32_si128( packed );
+		s = _mm_unpacklo_epi8( s, s );
+		f = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( s, s ), 24 ) );
+		_mm_storeu_ps( out, _mm_add_ps( _mm_loadu_ps( out ), _mm_mul_ps( _mm_unpacklo_ps( f, f ), vol0 ) ) );
+		_mm_storeu_ps( out + 4, _mm_add_ps( _mm_loadu_ps( out + 4 ), _mm_mul_ps( _mm_unpackhi_ps( f, f ), vol1 ) ) );
+		vol0 = _mm_add_ps( vol0, inc );
+		vol1 = _mm_add_ps( vol1, inc );
+	}
+
+	lvol += lstep * i;
+	rvol += rstep * i;
+	for( ; i < count; i++, in++, out += 2 )
+	{
+		out[0] += in[0] * lvol;
+		out[1] += in[0] * rvol;
+		lvol += lstep;
+		rvol += rstep;
+	}
+}
+
+static void S_WriteLinearBlastStereo16( const float *in, short *out, int count, bool swap )
 {
 	int i;
-	int val;
+	__m128 a, b;
+	const __m128 lo = _mm_set1_ps( -32768.0f ), hi = _mm_set1_ps( 32767.0f );
+
+	for( i = 0; i + 8 <= count; i += 8 )
+	{
+		a = _mm_min_ps( _mm_max_ps( _mm_loadu_ps( in + i ), lo ), hi );
+		b = _mm_min_ps( _mm_max_ps( _mm_loadu_ps( in + i + 4 ), lo ), hi );
+		if( swap )
+		{
+			a = _mm_shuffle_ps( a, a, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+			b = _mm_shuffle_ps( b, b, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+		}
+		_mm_storeu_si128( ( __m128i * )( out + i ), _mm_packs_epi32( _mm_cvttps_epi32( a ), _mm_cvttps_epi32( b ) ) );
+	}
+
+	for( ; i < count; i += 2 )
+	{
+		out[i] = (short)bound( -32768.0f, in[i + swap], 32767.0f );
+		out[i+1] = (short)bound( -32768.0f, in[i + !swap], 32767.0f );
+	}
+}
+
+#elif defined ( S_MIX_NEON )
+
+static void S_PaintStereo16( float *out, const short *in, unsigned int count, float lvol, float rvol, float lstep, float rstep )
+{
+	unsigned int i;
+	float32x4_t vol0, vol1, inc;
+	int16x8_t s;
+	const float v[4] = { lvol, rvol, lvol + lstep, rvol + rstep };
+	const float d[4] = { lstep * 2, rstep * 2, lstep * 2, rstep * 2 };
+
+	vol0 = vld1q_f32( v );
+	vol1 = vaddq_f32( vol0, vld1q_f32( d ) );
+	inc = vaddq_f32( vld1q_f32( d ), vld1q_f32( d ) );
+
+	for( i = 0; i + 4 <= count; i += 4, in += 8, out += 8 )
+	{
+		s = vld1q_s16( in );
+		vst1q_f32( out, vmlaq_f32( vld1q_f32( out ), vcvtq_f32_s32( vmovl_s16( vget_low_s16( s ) ) ), vol0 ) );
+		vst1q_f32( out + 4, vmlaq_f32( vld1q_f32( out + 4 ), vcvtq_f32_s32( vmovl_s16( vget_high_s16( s ) ) ), vol1 ) );
+		vol0 = vaddq_f32( vol0, inc );
+		vol1 = vaddq_f32( vol1, inc );
+	}
+
+	lvol += lstep * i;
+	rvol += rstep * i;
+	for( ; i < count; i++, in += 2, out += 2 )
+	{
+		out[0] += in[0] * lvol;
+		out[1] += in[1] * rvol;
+		lvol += lstep;
+		rvol += rstep;
+	}
+}
+
+static void S_PaintMono16( float *out, const short *in, unsigned int count, float lvol, float rvol, float lstep, float rstep )
+{
+	unsigned int i;
+	float32x4_t vol0, vol1, inc;
+	float32x4x2_t f;
+	const float v[4] = { lvol, rvol, lvol + lstep, rvol + rstep };
+	const float d[4] = { lstep * 2, rstep * 2, lstep * 2, rstep * 2 };
+
+	vol0 = vld1q_f32( v );
+	vol1 = vaddq_f32( vol0, vld1q_f32( d ) );
+	inc = vaddq_f32( vld1q_f32( d ), vld1q_f32( d ) );
+
+	for( i = 0; i + 4 <= count; i += 4, in += 4, out += 8 )
+	{
+		f.val[0] = vcvtq_f32_s32( vmovl_s16( vld1_s16( in ) ) );
+		f = vzipq_f32( f.val[0], f.val[0] );
+		vst1q_f32( out, vmlaq_f32( vld1q_f32( out ), f.val[0], vol0 ) );
+		vst1q_f32( out + 4, vmlaq_f32( vld1q_f32( out + 4 ), f.val[1], vol1 ) );
+		vol0 = vaddq_f32( vol0, inc );
+		vol1 = vaddq_f32( vol1, inc );
+	}
+
+	lvol += lstep * i;
+	rvol += rstep * i;
+	for( ; i < count; i++, in++, out += 2 )
+	{
+		out[0] += in[0] * lvol;
+		out[1] += in[0] * rvol;
+		lvol += lstep;
+		rvol += rstep;
+	}
+}
+
+static void S_PaintStereo8( float *out, const signed char *in, unsigned int count, float lvol, float rvol, float lstep, float rstep )
+{
+	unsigned int i;
+	float32x4_t vol0, vol1, inc;
+	int16x8_t s;
+	const float v[4] = { lvol, rvol, lvol + lstep, rvol + rstep };
+	const float d[4] = { lstep * 2, rstep * 2, lstep * 2, rstep * 2 };
+
+	vol0 = vld1q_f32( v );
+	vol1 = vaddq_f32( vol0, vld1q_f32( d ) );
+	inc = vaddq_f32( vld1q_f32( d ), vld1q_f32( d ) );
+
+	for( i = 0; i + 4 <= count; i += 4, in += 8, out += 8 )
+	{
+		s = vmovl_s8( vld1_s8( in ) );
+		vst1q_f32( out, vmlaq_f32( vld1q_f32( out ), vcvtq_f32_s32( vmovl_s16( vget_low_s16( s ) ) ), vol0 ) );
+		vst1q_f32( out + 4, vmlaq_f32( vld1q_f32( out + 4 ), vcvtq_f32_s32( vmovl_s16( vget_high_s16( s ) ) ), vol1 ) );
+		vol0 = vaddq_f32( vol0, inc );
+		vol1 = vaddq_f32( vol1, inc );
+	}
+
+	lvol += lstep * i;
+	rvol += rstep * i;
+	for( ; i < count; i++, in += 2, out += 2 )
+	{
+		out[0] += in[0] * lvol;
+		out[1] += in[1] * rvol;
+		lvol += lstep;
+		rvol += rstep;
+	}
+}
 
-	for( i = 0; i < snd_linear_count; i += 2 )
+static void S_PaintMono8( float *out, const signed char *in, unsigned int count, float lvol, float rvol, float lstep, float rstep )
+{
+	unsigned int i;
+	float32x4_t vol0, vol1, vol2, vol3, inc;
+	float32x4x2_t f, g;
+	int16x8_t s;
+	const float v[4] = { lvol, rvol, lvol + lstep, rvol + rstep };
+	const float d[4] = { lstep * 2, rstep * 2, lstep * 2, rstep * 2 };
+
+	vol0 = vld1q_f32( v );
+	vol1 = vaddq_f32( vol0, vld1q_f32( d ) );
+	inc = vaddq_f32( vld1q_f32( d ), vld1q_f32( d ) );
+	vol2 = vaddq_f32( vol0, inc );
+	vol3 = vaddq_f32( vol1, inc );
+	inc = vaddq_f32( inc, inc );
+
+	for( i = 0; i + 8 <= count; i += 8, in += 8, out += 16 )
 	{
-		val = snd_p[i]>>8;
-		snd_out[i] = bound( (short)0x8000, val, 0x7fff );
+		s = vmovl_s8( vld1_s8( in ) );
+		f.val[0] = vcvtq_f32_s32( vmovl_s16( vget_low_s16( s ) ) );
+		g.val[0] = vcvtq_f32_s32( vmovl_s16( vget_high_s16( s ) ) );
+		f = vzipq_f32( f.val[0], f.val[0] );
+		g = vzipq_f32( g.val[0], g.val[0] );
+		vst1q_f32( out, vmlaq_f32( vld1q_f32( out ), f.val[0], vol0 ) );
+		vst1q_f32( out + 4, vmlaq_f32( vld1q_f32( out + 4 ), f.val[1], vol1 ) );
+		vst1q_f32( out + 8, vmlaq_f32( vld1q_f32( out + 8 ), g.val[0], vol2 ) );
+		vst1q_f32( out + 12, vmlaq_f32( vld1q_f32( out + 12 ), g.val[1], vol3 ) );
+		vol0 = vaddq_f32( vol0, inc );
+		vol1 = vaddq_f32( vol1, inc );
+		vol2 = vaddq_f32( vol2, inc );
+		vol3 = vaddq_f32( vol3, inc );
+	}
 
-		val = snd_p[i+1]>>8;
-		snd_out[i+1] = bound( (short)0x8000, val, 0x7fff );
+	lvol += lstep * i;
+	rvol += rstep * i;
+	for( ; i < count; i++, in++, out += 2 )
+	{
+		out[0] += in[0] * lvol;
+		out[1] += in[0] * rvol;
+		lvol += lstep;
+		rvol += rstep;
 	}
 }
 
-static void S_WriteSwappedLinearBlastStereo16( void )
+static void S_WriteLinearBlastStereo16( const float *in, short *out, int count, bool swap )
 {
 	int i;
-	int val;
+	float32x4_t a, b;
 
-	for( i = 0; i < snd_linear_count; i += 2 )
+	// the conversion and the narrowing both saturate
+	for( i = 0; i + 8 <= count; i += 8 )
 	{
-		val = snd_p[i+1]>>8;
-		snd_out[i] = bound( (short)0x8000, val, 0x7fff );
+		a = vld1q_f32( in + i );
+		b = vld1q_f32( in + i + 4 );
+		if( swap )
+		{
+			a = vrev64q_f32( a );
+			b = vrev64q_f32( b );
+		}
+		vst1q_s16( out + i, vcombine_s16( vqmovn_s32( vcvtq_s32_f32( a ) ), vqmovn_s32( vcvtq_s32_f32( b ) ) ) );
+	}
 
-		val = snd_p[i]>>8;
-		snd_out[i+1] = bound( (short)0x8000, val, 0x7fff );
+	for( ; i < count; i += 2 )
+	{
+		out[i] = (short)bound( -32768.0f, in[i + swap], 32767.0f );
+		out[i+1] = (short)bound( -32768.0f, in[i + !swap], 32767.0f );
 	}
-#ifdef _WIN32
-#pragma warning( pop )
-#endif
 }
-#elif defined ( __GNUC__ )
 
-ATTRIBUTE_NOINLINE void S_WriteSwappedLinearBlastStereo16( void );
-ATTRIBUTE_NOINLINE void S_WriteLinearBlastStereo16( void );
+#else
 
-void S_WriteLinearBlastStereo16( void )
+static void S_PaintStereo16( float *out, const short *in, unsigned int count, float lvol, float rvol, float lstep, float rstep )
 {
-	__asm__ __volatile__(
-	        "		# preserve register variables\n"
-	        "		pushl	%edi\n"
-	        "		pushl	%ebx\n"
-	        "		movl	"VAR(snd_linear_count)",%ecx\n"
-	        "		movl	"VAR(snd_p)",%ebx\n"
-	        "		movl	"VAR(snd_out)",%edi\n"
-	        "	LWLBLoopTop:\n"
-	        "		movl	-8(%ebx,%ecx,4),%eax\n"
-	        "		sarl	$8,%eax\n"
-	        "		cmpl	$0x7FFF,%eax\n"
-	        "		jg	LClampHigh\n"
-	        "		cmpl	$0xFFFF8000,%eax\n"
-	        "		jnl	LClampDone\n"
-	        "		movl	$0xFFFF8000,%eax\n"
-	        "		jmp	LClampDone\n"
-	        "	LClampHigh:\n"
-	        "		movl	$0x7FFF,%eax\n"
-	        "	LClampDone:\n"
-	        "		movl	-4(%ebx,%ecx,4),%edx\n"
-	        "		sarl	$8,%edx\n"
-	        "		cmpl	$0x7FFF,%edx\n"
-	        "		jg	LClampHigh2\n"
-	        "		cmpl	$0xFFFF8000,%edx\n"
-	        "		jnl	LClampDone2\n"
-	        "		movl	$0xFFFF8000,%edx\n"
-	        "		jmp	LClampDone2\n"
-	        "	LClampHigh2:\n"
-	        "		movl	$0x7FFF,%edx\n"
-	        "	LClampDone2:\n"
-	        "		shll	$16,%edx\n"
-	        "		andl	$0xFFFF,%eax\n"
-	        "		orl		%eax,%edx\n"
-	        "		movl	%edx,-4(%edi,%ecx,2)\n"
-	        "		subl	$2,%ecx\n"
-	        "		jnz	LWLBLoopTop\n"
-	        "		popl	%ebx\n"
-	        "		popl	%edi\n"
-	        "#		ret\n"
-	);
+	unsigned int i;
+
+	for( i = 0; i < count; i++, in += 2, out += 2 )
+	{
+		out[0] += in[0] * lvol;
+		out[1] += in[1] * rvol;
+		lvol += lstep;
+		rvol += rstep;
+	}
 }
 
-void S_WriteSwappedLinearBlastStereo16( void )
+static void S_PaintMono16( float *out, const short *in, unsigned int count, float lvol, float rvol, float lstep, float rstep )
 {
-	__asm__ __volatile__(
-	        "		# preserve register variables\n"
-	        "		pushl	%edi\n"
-	        "		pushl	%ebx\n"
-	        "		movl	"VAR(snd_linear_count)",%ecx\n"
-	        "		movl	"VAR(snd_p)",%ebx\n"
-	        "		movl	"VAR(snd_out)",%edi\n"
-	        "	LWLBLoopTopS:\n"
-	        "		movl	-4(%ebx,%ecx,4),%eax\n"
-	        "		sarl	$8,%eax\n"
-	        "		cmpl	$0x7FFF,%eax\n"
-	        "		jg	LClampHighS\n"
-	        "		cmpl	$0xFFFF8000,%eax\n"
-	        "		jnl	LClampDoneS\n"
-	        "		movl	$0xFFFF8000,%eax\n"
-	        "		jmp	LClampDoneS\n"
-	        "	LClampHighS:\n"
-	        "		movl	$0x7FFF,%eax\n"
-	        "	LClampDoneS:\n"
-	        "		movl	-8(%ebx,%ecx,4),%edx\n"
-	        "		sarl	$8,%edx\n"
-	        "		cmpl	$0x7FFF,%edx\n"
-	        "		jg	LClampHigh2S\n"
-	        "		cmpl	$0xFFFF8000,%edx\n"
-	        "		jnl	LClampDone2S\n"
-	        "		movl	$0xFFFF8000,%edx\n"
-	        "		jmp	LClampDone2S\n"
-	        "	LClampHigh2S:\n"
-	        "		movl	$0x7FFF,%edx\n"
-	        "	LClampDone2S:\n"
-	        "		shll	$16,%edx\n"
-	        "		andl	$0xFFFF,%eax\n"
-	        "		orl	%eax,%edx\n"
-	        "		movl	%edx,-4(%edi,%ecx,2)\n"
-	        "		subl	$2,%ecx\n"
-	        "		jnz	LWLBLoopTopS\n"
-	        "		popl	%ebx\n"
-	        "		popl	%edi\n"
-	        "#		ret\n"
-	);
+	unsigned int i;
+
+	for( i = 0; i < count; i++, in++, out += 2 )
+	{
+		out[0] += in[0] * lvol;
+		out[1] += in[0] * rvol;
+		lvol += lstep;
+		rvol += rstep;
+	}
 }
-#elif defined (_WIN32)
-static ATTRIBUTE_NAKED void S_WriteLinearBlastStereo16( void )
+
+static void S_PaintStereo8( float *out, const signed char *in, unsigned int count, float lvol, float rvol, float lstep, float rstep )
 {
-	__asm {
-		push edi
-			push ebx
-			mov ecx, ds : dword ptr[snd_linear_count]
-		mov ebx, ds : dword ptr[snd_p]
-		mov edi, ds : dword ptr[snd_out]
-
-LWLBLoopTop:
-		mov eax, ds : dword ptr[-8+ebx+ecx*4]
-		sar eax, 8
-			cmp eax, 07FFFh
-			jg LClampHigh
-			cmp eax, 0FFFF8000h
-			jnl LClampDone
-			mov eax, 0FFFF8000h
-			jmp LClampDone
-
-LClampHigh:
-		mov eax, 07FFFh
-
-LClampDone:
-		mov edx, ds : dword ptr[-4+ebx+ecx*4]
-		sar edx, 8
-			cmp edx, 07FFFh
-			jg LClampHigh2
-			cmp edx, 0FFFF8000h
-			jnl LClampDone2
-			mov edx, 0FFFF8000h
-			jmp LClampDone2
-
-LClampHigh2:
-		mov edx, 07FFFh
-
-LClampDone2:
-		shl edx, 16
-			and eax, 0FFFFh
-			or edx, eax
-			mov ds : dword ptr[-4+edi+ecx*2], edx
-			sub ecx, 2
-			jnz LWLBLoopTop
-			pop ebx
-			pop edi
-			ret
+	unsigned int i;
+
+	for( i = 0; i < count; i++, in += 2, out += 2 )
+	{
+		out[0] += in[0] * lvol;
+		out[1] += in[1] * rvol;
+		lvol += lstep;
+		rvol += rstep;
 	}
 }
 
-static ATTRIBUTE_NAKED void S_WriteSwappedLinearBlastStereo16( void )
+static void S_PaintMono8( float *out, const signed char *in, unsigned int count, float lvol, float rvol, float lstep, float rstep )
 {
-	__asm {
-		push edi
-			push ebx
-			mov ecx, ds : dword ptr[snd_linear_count]
-		mov ebx, ds : dword ptr[snd_p]
-		mov edi, ds : dword ptr[snd_out]
-
-LWLBLoopTop:
-		mov eax, ds : dword ptr[-4+ebx+ecx*4]
-		sar eax, 8
-			cmp eax, 07FFFh
-			jg LClampHigh
-			cmp eax, 0FFFF8000h
-			jnl LClampDone
-			mov eax, 0FFFF8000h
-			jmp LClampDone
-
-LClampHigh:
-		mov eax, 07FFFh
-
-LClampDone:
-		mov edx, ds : dword ptr[-8+ebx+ecx*4]
-		sar edx, 8
-			cmp edx, 07FFFh
-			jg LClampHigh2
-			cmp edx, 0FFFF8000h
-			jnl LClampDone2
-			mov edx, 0FFFF8000h
-			jmp LClampDone2
-
-LClampHigh2:
-		mov edx, 07FFFh
-
-LClampDone2:
-		shl edx, 16
-			and eax, 0FFFFh
-			or edx, eax
-			mov ds : dword ptr[-4+edi+ecx*2], edx
-			sub ecx, 2
-			jnz LWLBLoopTop
-			pop ebx
-			pop edi
-			ret
+	unsigned int i;
+
+	for( i = 0; i < count; i++, in++, out += 2 )
+	{
+		out[0] += in[0] * lvol;
+		out[1] += in[0] * rvol;
+		lvol += lstep;
+		rvol += rstep;
 	}
 }
+
+static void S_WriteLinearBlastStereo16( const float *in, short *out, int count, bool swap )
+{
+	int i;
+
+	for( i = 0; i < count; i += 2 )
+	{
+		out[i] = (short)bound( -32768.0f, in[i + swap], 32767.0f );
+		out[i+1] = (short)bound( -32768.0f, in[i + !swap], 32767.0f );
+	}
+}
+
 #endif
 
 static void S_TransferStereo16( unsigned int *pbuf, int endtime )
 {
 	int lpos;
 	int lpaintedtime;
+	int linear_count;
+	const float *p;
+	bool swap;
 
-	snd_p = (int *) paintbuffer;
+	p = paintbuffer;
 	lpaintedtime = paintedtime;
+	swap = s_swapstereo->integer != 0;
 
 	while( lpaintedtime < endtime )
 	{
 		// handle recirculating buffer issues
 		lpos = lpaintedtime & ( ( dma.samples>>1 )-1 );
 
-		snd_out = (short *) pbuf + ( lpos<<1 );
-
-		snd_linear_count = ( dma.samples>>1 ) - lpos;
-		if( lpaintedtime + snd_linear_count > endtime )
-			snd_linear_count = endtime - lpaintedtime;
+		linear_count = ( dma.samples>>1 ) - lpos;
+		if( lpaintedtime + linear_count > endtime )
+			linear_count = endtime - lpaintedtime;
 
-		snd_linear_count <<= 1;
+		linear_count <<= 1;
 
 		// write a linear blast of samples
-		if( s_swapstereo->integer )
-			S_WriteSwappedLinearBlastStereo16();
-		else
-			S_WriteLinearBlastStereo16();
+		S_WriteLinearBlastStereo16( p, (short *) pbuf + ( lpos<<1 ), linear_count, swap );
 
-		snd_p += snd_linear_count;
-		lpaintedtime += ( snd_linear_count>>1 );
+		p += linear_count;
+		lpaintedtime += ( linear_count>>1 );
 	}
 }
 
@@ -341,31 +486,20 @@ static void S_TransferPaintBuffer( int endtime )
 	int out_idx;
 	int count;
 	int out_mask;
-	int *p;
+	const float *p;
 	int step;
 	int val;
 	unsigned int *pbuf;
 
 	pbuf = (unsigned int *)dma.buffer;
-/*
-	if( s_testsound->integer )
-	{
-		int i;
-		int count;
 
-		// write a fixed sine wave
-		count = endtime - paintedtime;
-		for( i = 0; i < count; i++ )
-			paintbuffer[i].left = paintbuffer[i].right = sin( ( paintedtime+i )*0.1 )*20000*256;
-	}
-*/
 	if( dma.samplebits == 16 && dma.channels == 2 )
 	{ // optimized case
 		S_TransferStereo16( pbuf, endtime );
 	}
 	else
 	{ // general case
-		p = (int *)paintbuffer;
+		p = paintbuffer;
 		count = ( endtime - paintedtime ) * dma.channels;
 		out_mask = dma.samples - 1;
 		out_idx = paintedtime * dma.channels & out_mask;
@@ -376,12 +510,8 @@ static void S_TransferPaintBuffer( int endtime )
 			short *out = (short *)pbuf;
 			while( count-- )
 			{
-				val = *p >> 8;
+				val = (int)bound( -32768.0f, *p, 32767.0f );
 				p += step;
-				if( val > 0x7fff )
-					val = 0x7fff;
-				else if( val < -32768 )
-					val = -32768;
 				out[out_idx] = val;
 				out_idx = ( out_idx + 1 ) & out_mask;
 			}
@@ -391,12 +521,8 @@ static void S_TransferPaintBuffer( int endtime )
 			unsigned char *out = (unsigned char *)pbuf;
 			while( count-- )
 			{
-				val = *p >> 8;
+				val = (int)bound( -32768.0f, *p, 32767.0f );
 				p += step;
-				if( val > 0x7fff )
-					val = 0x7fff;
-				else if( val < -32768 )
-					val = -32768;
 				out[out_idx] = ( val>>8 ) + 128;
 				out_idx = ( out_idx + 1 ) & out_mask;
 			}
@@ -457,10 +583,227 @@ CHANNEL MIXING
 ===============================================================================
 */
 
-static void S_PaintChannelFrom8( channel_t *ch, sfxcache_t *sc, unsigned int endtime, int offset );
-static void S_PaintChannelFrom16( channel_t *ch, sfxcache_t *sc, unsigned int endtime, int offset );
-static void S_PaintChannelFrom8HQ( channel_t *ch, sfxcache_t *sc, unsigned int endtime, int offset );
-static void S_PaintChannelFrom16HQ( channel_t *ch, sfxcache_t *sc, unsigned int endtime, int offset );
+/*
+* S_SetupVolumeRamp
+*
+* Returns the number of samples over which the channel is faded from the volumes
+* it was last painted with to its current ones, leaving the volumes for the
+* samples after the ramp in ch->paintvol.
+*/
+static unsigned int S_SetupVolumeRamp( channel_t *ch, unsigned int count, float *vol, float *step )
+{
+	unsigned int ramp;
+	float target[2];
+
+	target[0] = ch->leftvol * snd_vol;
+	target[1] = ch->rightvol * snd_vol;
+
+	vol[0] = ch->paintvol[0];
+	vol[1] = ch->paintvol[1];
+	step[0] = step[1] = 0;
+
+	// don't fade in channels that haven't been painted yet
+	if( ( !vol[0] && !vol[1] ) || ( vol[0] == target[0] && vol[1] == target[1] ) )
+	{
+		ch->paintvol[0] = target[0];
+		ch->paintvol[1] = target[1];
+		return 0;
+	}
+
+	step[0] = ( target[0] - vol[0] ) / S_VOLUME_RAMP_SAMPLES;
+	step[1] = ( target[1] - vol[1] ) / S_VOLUME_RAMP_SAMPLES;
+
+	ramp = min( count, S_VOLUME_RAMP_SAMPLES );
+	if( ramp == S_VOLUME_RAMP_SAMPLES )
+	{
+		ch->paintvol[0] = target[0];
+		ch->paintvol[1] = target[1];
+	}
+	else
+	{
+		ch->paintvol[0] = vol[0] + step[0] * ramp;
+		ch->paintvol[1] = vol[1] + step[1] * ramp;
+	}
+
+	return ramp;
+}
+
+static void S_PaintChannelFrom8( channel_t *ch, sfxcache_t *sc, unsigned int count, int offset )
+{
+	unsigned int ramp;
+	float vol[2], step[2];
+	const signed char *sfx;
+	float *samp;
+
+	if( !snd_vol )
+	{
+		ch->pos += count;
+		return;
+	}
+
+	// 8-bit samples are scaled up to the 16-bit range
+	ramp = S_SetupVolumeRamp( ch, count, vol, step );
+
+	samp = &paintbuffer[offset * 2];
+	sfx = (const signed char *)sc->data + ch->pos * sc->channels;
+
+	if( sc->channels == 2 )
+	{
+		S_PaintStereo8( samp, sfx, ramp, vol[0] * 256, vol[1] * 256, step[0] * 256, step[1] * 256 );
+		S_PaintStereo8( samp + ramp * 2, sfx + ramp * 2, count - ramp, ch->paintvol[0] * 256, ch->paintvol[1] * 256, 0, 0 );
+	}
+	else
+	{
+		S_PaintMono8( samp, sfx, ramp, vol[0] * 256, vol[1] * 256, step[0] * 256, step[1] * 256 );
+		S_PaintMono8( samp + ramp * 2, sfx + ramp, count - ramp, ch->paintvol[0] * 256, ch->paintvol[1] * 256, 0, 0 );
+	}
+
+	ch->pos += count;
+}
+
+static void S_PaintChannelFrom16( channel_t *ch, sfxcache_t *sc, unsigned int count, int offset )
+{
+	unsigned int ramp;
+	float vol[2], step[2];
+	const short *sfx;
+	float *samp;
+
+	if( !snd_vol )
+	{
+		ch->pos += count;
+		return;
+	}
+
+	ramp = S_SetupVolumeRamp( ch, count, vol, step );
+
+	samp = &paintbuffer[offset * 2];
+	sfx = (const short *)sc->data + ch->pos * sc->channels;
+
+	if( sc->channels == 2 )
+	{
+		S_PaintStereo16( samp, sfx, ramp, vol[0], vol[1], step[0], step[1] );
+		S_PaintStereo16( samp + ramp * 2, sfx + ramp * 2, count - ramp, ch->paintvol[0], ch->paintvol[1], 0, 0 );
+	}
+	else
+	{
+		S_PaintMono16( samp, sfx, ramp, vol[0], vol[1], step[0], step[1] );
+		S_PaintMono16( samp + ramp * 2, sfx + ramp, count - ramp, ch->paintvol[0], ch->paintvol[1], 0, 0 );
+	}
+
+	ch->pos += count;
+}
+
+/*
+* S_PaintChannelFromHQ
+*
+* The lowpass filters are recursive, so mono sounds are filtered and delayed
+* one sample at a time. Stereo sounds aren't spatialized and take the plain path.
+*/
+static void S_PaintChannelFromHQ( channel_t *ch, sfxcache_t *sc, unsigned int count, int offset )
+{
+	unsigned int i, ramp;
+	int j, k;
+	int shift;
+	float vol[2], step[2];
+	float *samp;
+
+	if( sc->channels == 2 )
+	{
+		if( sc->width == 1 )
+			S_PaintChannelFrom8( ch, sc, count, offset );
+		else
+			S_PaintChannelFrom16( ch, sc, count, offset );
+		return;
+	}
+
+	if( !snd_vol )
+	{
+		ch->pos += count;
+		return;
+	}
+
+	ramp = S_SetupVolumeRamp( ch, count, vol, step );
+
+	samp = &paintbuffer[offset * 2];
+
+	// 8-bit samples are filtered in the 16-bit range
+	shift = sc->width == 1 ? 8 : 0;
+
+#define S_HQ_SAMPLE( pos ) ( sc->width == 1 ? ( (const signed char *)sc->data )[pos] : ( (const short *)sc->data )[pos] )
+#define S_HQ_STEP_RAMP() \
+	if( ramp ) \
+	{ \
+		vol[0] += step[0]; \
+		vol[1] += step[1]; \
+		if( !--ramp ) \
+		{ \
+			vol[0] = ch->paintvol[0]; \
+			vol[1] = ch->paintvol[1]; \
+		} \
+	}
+
+	if( !ramp )
+	{
+		vol[0] = ch->paintvol[0];
+		vol[1] = ch->paintvol[1];
+	}
+
+	// initialize our counter here
+	i = 0;
+	if( ch->pos < ch->ldelay )
+	{
+		// left channel delayed, write first right channels
+		unsigned int rights = min( count, ch->ldelay - ch->pos );
+		for( ; i < rights; i++, samp += 2 )
+		{
+			k = S_HQ_SAMPLE( ch->pos + i ) << shift;
+			samp[1] += S_Lowpass2pole( k, &ch->lpf_history[2], ch->lpf_rcoeff ) * vol[1];
+			S_HQ_STEP_RAMP();
+		}
+	}
+	else if( ch->pos < ch->rdelay )
+	{
+		// right channel delayed, write first left channels
+		unsigned int lefts = min( count, ch->rdelay - ch->pos );
+		for( ; i < lefts; i++, samp += 2 )
+		{
+			j = S_HQ_SAMPLE( ch->pos + i ) << shift;
+			samp[0] += S_Lowpass2pole( j, &ch->lpf_history[0], ch->lpf_lcoeff ) * vol[0];
+			S_HQ_STEP_RAMP();
+		}
+	}
+
+	// write the common samples for both channels
+	for( ; i < count; i++, samp += 2 )
+	{
+		j = S_HQ_SAMPLE( ch->pos + i - ch->ldelay ) << shift;
+		k = S_HQ_SAMPLE( ch->pos + i - ch->rdelay ) << shift;
+
+		samp[0] += S_Lowpass2pole( j, &ch->lpf_history[0], ch->lpf_lcoeff ) * vol[0];
+		samp[1] += S_Lowpass2pole( k, &ch->lpf_history[2], ch->lpf_rcoeff ) * vol[1];
+		S_HQ_STEP_RAMP();
+	}
+
+	// TODO: write the rest of the delayed channel
+
+#undef S_HQ_STEP_RAMP
+#undef S_HQ_SAMPLE
+
+	ch->pos += count;
+}
+
+/*
+* S_PaintChannel
+*/
+static void S_PaintChannel( channel_t *ch, sfxcache_t *sc, unsigned int count, int offset, bool hq )
+{
+	if( hq )
+		S_PaintChannelFromHQ( ch, sc, count, offset );
+	else if( sc->width == 1 )
+		S_PaintChannelFrom8( ch, sc, count, offset );
+	else
+		S_PaintChannelFrom16( ch, sc, count, offset );
+}
 
 int S_PaintChannels( unsigned int endtime, int dumpfile, float gain )
 {
@@ -473,8 +816,7 @@ int S_PaintChannels( unsigned int endtime, int dumpfile, float gain )
 	playsound_t *ps;
 
 	total = 0;
-	snd_vol = s_volume->value*gain*256;
-	music_vol = s_musicvolume->value*gain*256;
+	snd_vol = s_volume->value*gain / 256.0f;
 
 	while( paintedtime < endtime )
 	{
@@ -502,13 +844,15 @@ int S_PaintChannels( unsigned int endtime, int dumpfile, float gain )
 		}
 
 		// clear the paint buffer
-		memset( paintbuffer, 0, ( end - paintedtime ) * sizeof( portable_samplepair_t ) );
+		memset( paintbuffer, 0, ( end - paintedtime ) * 2 * sizeof( *paintbuffer ) );
 
 		// paint in the raw samples
 		for( i = 0; i < MAX_RAW_SOUNDS; i++ ) {
 			// copy from the streaming sound source
 			int s;
 			unsigned j, stop;
+			float left_volume, right_volume;
+			float *samp;
 			rawsound_t *rawsound = raw_sounds[i];
 
 			if( !rawsound ) {
@@ -519,12 +863,16 @@ int S_PaintChannels( unsigned int endtime, int dumpfile, float gain )
 				continue;
 			}
 
+			left_volume = rawsound->left_volume / 256.0f;
+			right_volume = rawsound->right_volume / 256.0f;
+
 			stop = ( end < rawsound->rawend ) ? end : rawsound->rawend;
-			for( j = paintedtime; j < stop; j++ )
+			samp = paintbuffer;
+			for( j = paintedtime; j < stop; j++, samp += 2 )
 			{
 				s = j&( MAX_RAW_SAMPLES-1 );
-				paintbuffer[j-paintedtime].left += rawsound->rawsamples[s].left * rawsound->left_volume;
-				paintbuffer[j-paintedtime].right += rawsound->rawsamples[s].right * rawsound->right_volume;
+				samp[0] += rawsound->rawsamples[s].left * left_volume;
+				samp[1] += rawsound->rawsamples[s].right * right_volume;
 			}
 		}
 
@@ -538,7 +886,7 @@ int S_PaintChannels( unsigned int endtime, int dumpfile, float gain )
 			{
 				if( !ch->sfx || ( !ch->leftvol && !ch->rightvol ) )
 					break;
-				
+
 				count = 0;
 
 				// max painting is to the end of the buffer
@@ -555,20 +903,7 @@ int S_PaintChannels( unsigned int endtime, int dumpfile, float gain )
 
 				if( count > 0 && ch->sfx )
 				{
-					if( s_pseudoAcoustics->value )
-					{
-						if( sc->width == 1 )
-							S_PaintChannelFrom8HQ( ch, sc, count, ltime - paintedtime );
-						else
-							S_PaintChannelFrom16HQ( ch, sc, count, ltime - paintedtime );
-					}
-					else
-					{
-						if( sc->width == 1 )
-							S_PaintChannelFrom8( ch, sc, count, ltime - paintedtime );
-						else
-							S_PaintChannelFrom16( ch, sc, count, ltime - paintedtime );
-					}
+					S_PaintChannel( ch, sc, count, ltime - paintedtime, s_pseudoAcoustics->value != 0 );
 					ltime += count;
 				}
 
@@ -606,262 +941,104 @@ int S_PaintChannels( unsigned int endtime, int dumpfile, float gain )
 	return total;
 }
 
-void S_InitScaletable( void )
-{
-	int i, j;
-	int scale;
-
-	s_volume->modified = false;
-	for( i = 0; i < 32; i++ )
-	{
-		scale = i * 8 * 256 * s_volume->value;
-		for( j = 0; j < 256; j++ )
-			snd_scaletable[i][j] = ( (signed char)j ) * scale;
-	}
-}
-
-static void S_PaintChannelFrom8( channel_t *ch, sfxcache_t *sc, unsigned int count, int offset )
-{
-	unsigned int i;
-	int j;
-	int *lscale, *rscale;
-	unsigned char *sfx;
-	portable_samplepair_t *samp;
-
-	if( ch->leftvol > 255 )
-		ch->leftvol = 255;
-	if( ch->rightvol > 255 )
-		ch->rightvol = 255;
-
-	if( !s_volume->value )
-	{
-		ch->pos += count;
-		return;
-	}
-
-	lscale = snd_scaletable[ch->leftvol >> 3];
-	rscale = snd_scaletable[ch->rightvol >> 3];
-
-	samp = &paintbuffer[offset];
-
-	if( sc->channels == 2 )
-	{
-		sfx = (unsigned char *)sc->data + ch->pos * 2;
-
-		for( i = 0; i < count; i++, samp++ )
-		{
-			samp->left += lscale[*sfx++];
-			samp->right += rscale[*sfx++];
-		}
-	}
-	else
-	{
-		sfx = (unsigned char *)sc->data + ch->pos;
-
-		for( i = 0; i < count; i++, samp++ )
-		{
-			j = *sfx++;
-			samp->left += lscale[j];
-			samp->right += rscale[j];
-		}
-	}
-
-	ch->pos += count;
-}
-
-static void S_PaintChannelFrom16( channel_t *ch, sfxcache_t *sc, unsigned int count, int offset )
+/*
+* S_MixBenchmark
+*
+* Mixes a fixed set of synthetic channels for the given number of seconds
+* without touching the DMA buffer and reports the mixing throughput.
+*/
+void S_MixBenchmark( int seconds, bool hq )
 {
-	unsigned int i;
-	int j;
-	int leftvol, rightvol;
-	signed short *sfx;
-	portable_samplepair_t *samp;
-
-	if( !snd_vol )
+	int i, c;
+	int speed;
+	unsigned int start, elapsed, pos;
+	unsigned int painted;
+	uint64_t mixed;
+	short *out;
+	sfxcache_t *sc[4];
+	channel_t *bench;
+	const unsigned int numChannels = 64;
+	const unsigned int delay = 16;
+
+	if( seconds < 1 )
+		seconds = 1;
+	speed = dma.speed ? dma.speed : 44100;
+
+	// one second of every sound format, mono and stereo, 8 and 16-bit
+	for( i = 0; i < 4; i++ )
 	{
-		ch->pos += count;
-		return;
-	}
-
-	leftvol = ch->leftvol*snd_vol;
-	rightvol = ch->rightvol*snd_vol;
+		int width = ( i & 1 ) + 1;
+		int channels = ( i >> 1 ) + 1;
 
-	samp = &paintbuffer[offset];
+		sc[i] = S_Malloc( sizeof( sfxcache_t ) + speed * width * channels );
+		sc[i]->length = speed;
+		sc[i]->loopstart = 0;
+		sc[i]->speed = speed;
+		sc[i]->width = width;
+		sc[i]->channels = channels;
 
-	if( sc->channels == 2 )
-	{
-		sfx = (signed short *)sc->data + ch->pos * 2;
-
-		for( i = 0; i < count; i++, samp++ )
+		for( c = 0; c < speed * channels; c++ )
 		{
-			samp->left += ( *sfx++ * leftvol ) >> 8;
-			samp->right += ( *sfx++ * rightvol ) >> 8;
-		}
-	}
-	else
-	{
-		sfx = (signed short *)sc->data + ch->pos;
+			float v = sin( c * ( 0.01 + 0.005 * i ) );
 
-		for( i = 0; i < count; i++, samp++ )
-		{
-			j = *sfx++;
-			samp->left += ( j * leftvol ) >> 8;
-			samp->right += ( j * rightvol ) >> 8;
+			if( width == 1 )
+				( (signed char *)sc[i]->data )[c] = (signed char)( v * 127 );
+			else
+				( (short *)sc[i]->data )[c] = (short)( v * 32767 );
 		}
 	}
 
-	ch->pos += count;
-}
-
-static void S_PaintChannelFrom8HQ( channel_t *ch, sfxcache_t *sc, unsigned int count, int offset )
-{
-	unsigned int i;
-	int j, k;
-	int *lscale, *rscale;
-	unsigned char *sfx;
-	portable_samplepair_t *samp;
-
-	if( ch->leftvol > 255 )
-		ch->leftvol = 255;
-	if( ch->rightvol > 255 )
-		ch->rightvol = 255;
-
-	if( !s_volume->value )
+	bench = S_Malloc( sizeof( channel_t ) * numChannels );
+	memset( bench, 0, sizeof( channel_t ) * numChannels );
+	for( c = 0; c < (int)numChannels; c++ )
 	{
-		ch->pos += count;
-		return;
+		bench[c].pos = delay + ( c * 997 ) % ( speed - PAINTBUFFER_SIZE - delay );
+		bench[c].lpf_lcoeff = bench[c].lpf_rcoeff = 0x4000;
+		bench[c].ldelay = ( c & 1 ) ? delay : 0;
+		bench[c].rdelay = ( c & 1 ) ? 0 : delay;
 	}
 
-	lscale = snd_scaletable[ch->leftvol >> 3];
-	rscale = snd_scaletable[ch->rightvol >> 3];
-
-	samp = &paintbuffer[offset];
+	out = S_Malloc( sizeof( short ) * PAINTBUFFER_SIZE * 2 );
+	snd_vol = 1.0f / 256.0f;
+	mixed = 0;
+	painted = 0;
 
-	if( sc->channels == 2 )
+	start = trap_Milliseconds();
+	do
 	{
-		sfx = (unsigned char *)sc->data + ch->pos * 2;
-
-		for( i = 0; i < count; i++, samp++ )
-		{
-			samp->left += lscale[*sfx++];
-			samp->right += rscale[*sfx++];
-		}
-	}
-	else
-	{
-		sfx = (unsigned char *)sc->data + ch->pos;
-
-		// initialize our counter here
-		i = 0;
-		if( ch->pos < ch->ldelay )
-		{
-			// left channel delayed, write first right channels
-			unsigned int rights = min( count, ch->ldelay - ch->pos );
-			for( ; i < rights; i++, samp++ )
-			{
-				j = *sfx++;
-				j = S_Lowpass2pole( j << 8, &ch->lpf_history[2], ch->lpf_rcoeff ) >> 8;
-				samp->right += rscale[j&255];
-			}
-		}
-		else if( ch->pos < ch->rdelay )
-		{
-			// right channel delayed, write first left channels
-			unsigned int lefts = min( count, ch->rdelay - ch->pos );
-			for( ; i < lefts; i++, samp++ )
-			{
-				j = *sfx++;
-				j = S_Lowpass2pole( j << 8, &ch->lpf_history[0], ch->lpf_lcoeff )>> 8;
-				samp->left += lscale[j&255];
-			}
-		}
+		memset( paintbuffer, 0, sizeof( paintbuffer ) );
 
-		// write the common samples for both channels
-		for( ; i < count; i++, samp++, sfx++ )
+		for( c = 0; c < (int)numChannels; c++ )
 		{
-			j = *(sfx - ch->ldelay) << 8;
-			k = *(sfx - ch->rdelay) << 8;
-
-			j = S_Lowpass2pole( j, &ch->lpf_history[0], ch->lpf_lcoeff ) >> 8;
-			k = S_Lowpass2pole( k, &ch->lpf_history[2], ch->lpf_rcoeff ) >> 8;
-			samp->left += lscale[j&255];
-			samp->right += rscale[k&255];
-		}
+			channel_t *ch = &bench[c];
+			sfxcache_t *s = sc[c & 3];
 
-		// TODO: write the rest of the delayed channel
-	}
+			// keep the volumes moving so that the ramps are exercised as well
+			pos = painted + c * 31;
+			ch->leftvol = 64 + ( pos * 7 ) % 192;
+			ch->rightvol = 64 + ( pos * 13 ) % 192;
 
-	ch->pos += count;
-}
-
-static void S_PaintChannelFrom16HQ( channel_t *ch, sfxcache_t *sc, unsigned int count, int offset )
-{
-	unsigned int i;
-	int j, k;
-	int leftvol, rightvol;
-	signed short *sfx;
-	portable_samplepair_t *samp;
-
-	if( !snd_vol )
-	{
-		ch->pos += count;
-		return;
-	}
-
-	leftvol = ch->leftvol*snd_vol;
-	rightvol = ch->rightvol*snd_vol;
-
-	samp = &paintbuffer[offset];
-
-	if( sc->channels == 2 )
-	{
-		sfx = (signed short *)sc->data + ch->pos * 2;
-
-		for( i = 0; i < count; i++, samp++ )
-		{
-			samp->left += ( *sfx++ * leftvol ) >> 8;
-			samp->right += ( *sfx++ * rightvol ) >> 8;
+			if( ch->pos + PAINTBUFFER_SIZE > s->length )
+				ch->pos = delay;
+			S_PaintChannel( ch, s, PAINTBUFFER_SIZE, 0, hq );
 		}
-	}
-	else
-	{
-		sfx = (signed short *)sc->data + ch->pos;
 
-		// initialize our counter here
-		i = 0;
-		if( ch->pos < ch->ldelay )
-		{
-			// left channel delayed, write first right channels
-			unsigned int rights = min( count, ch->ldelay - ch->pos );
-			for( ; i < rights; i++, samp++ )
-			{
-				j = *sfx++;
-				samp->right += ( S_Lowpass2pole( j, &ch->lpf_history[2], ch->lpf_rcoeff ) * rightvol ) >> 8;
-			}
-		}
-		else if( ch->pos < ch->rdelay )
-		{
-			// right channel delayed, write first left channels
-			unsigned int lefts = min( count, ch->rdelay - ch->pos );
-			for( ; i < lefts; i++, samp++ )
-			{
-				j = *sfx++;
-				samp->left += ( S_Lowpass2pole( j, &ch->lpf_history[0], ch->lpf_lcoeff ) * leftvol ) >> 8;
-			}
-		}
+		S_WriteLinearBlastStereo16( paintbuffer, out, PAINTBUFFER_SIZE * 2, false );
 
-		// write the common samples for both chann[1]els
-		for( ; i < count; i++, samp++, sfx++ )
-		{
-			j = *(sfx - ch->ldelay);
-			k = *(sfx - ch->rdelay);
+		mixed += PAINTBUFFER_SIZE * numChannels;
+		painted++;
+		elapsed = trap_Milliseconds() - start;
+	} while( elapsed < (unsigned int)seconds * 1000 );
 
-			samp->left += ( S_Lowpass2pole( j, &ch->lpf_history[0], ch->lpf_lcoeff ) * leftvol ) >> 8;
-			samp->right += ( S_Lowpass2pole( k, &ch->lpf_history[2], ch->lpf_rcoeff ) * rightvol ) >> 8;
-		}
+	if( !elapsed )
+		elapsed = 1;
 
-		// TODO: write the rest of the delayed channel
-	}
+	Com_Printf( "mixed %u channels%s for %.1f seconds: %.0f samples/sec, %.1fx realtime at %i Hz\n",
+		numChannels, hq ? " (pseudo acoustics)" : "", elapsed / 1000.0,
+		mixed * 1000.0 / elapsed, ( (double)painted * PAINTBUFFER_SIZE * 1000.0 / elapsed ) / speed, speed );
 
-	ch->pos += count;
+	S_Free( out );
+	S_Free( bench );
+	for( i = 0; i < 4; i++ )
+		S_Free( sc[i] );
 }
@@ -158,7 +158,7 @@ sfxcache_t *SNDOGG_Load( sfx_t *s )
 	len = (int) ( (double) samples * (double) dma.speed / (double) vi->rate );
 	len = len * 2 * vi->channels;
 
-	sc = s->cache = S_Malloc( len + sizeof( sfxcache_t ) );
+	sc = S_Malloc( len + sizeof( sfxcache_t ) );
 	sc->length = samples;
 	sc->loopstart = sc->length;
 	sc->speed = vi->rate;
@@ -197,7 +197,6 @@ sfxcache_t *SNDOGG_Load( sfx_t *s )
 		if( (void *)buffer != sc->data )
 			S_Free( buffer );
 		S_Free( sc );
-		s->cache = NULL;
 		return NULL;
 	}
 
@@ -211,6 +210,7 @@ sfxcache_t *SNDOGG_Load( sfx_t *s )
 		S_Free( buffer );
 	}
 
+	s->cache = sc;
 	return sc;
 }
 
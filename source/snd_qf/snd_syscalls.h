@@ -160,6 +160,21 @@ static inline bool trap_FS_IsUrl( const char *url )
 	return SOUND_IMPORT.FS_IsUrl( url );
 }
 
+static inline time_t trap_FS_FileMTime( const char *filename )
+{
+	return SOUND_IMPORT.FS_FileMTime( filename );
+}
+
+static inline void *trap_FS_MMapBaseFileDetached( int file, size_t size, size_t offset )
+{
+	return SOUND_IMPORT.FS_MMapBaseFileDetached( file, size, offset );
+}
+
+static inline void trap_FS_UnMMapDetached( void *data )
+{
+	SOUND_IMPORT.FS_UnMMapDetached( data );
+}
+
 // misc
 static inline unsigned int trap_Milliseconds( void )
 {
@@ -308,7 +308,7 @@ static bool TV_Downstream_Netchan_Transmit( netchan_t *netchan, msg_t *msg )
 
 	if( tv_compresspackets->integer )
 	{
-		zerror = Netchan_CompressMessage( msg );
+		zerror = Netchan_CompressMessage( netchan, msg );
 		if( zerror < 0 )
 		{
 			// it's compression error, just send uncompressed
@@ -607,7 +607,7 @@ static bool TV_Downstream_ProcessPacket( netchan_t *netchan, msg_t *msg )
 	/*game_port = */MSG_ReadShort( msg );
 	if( msg->compressed )
 	{
-		zerror = Netchan_DecompressMessage( msg );
+		zerror = Netchan_DecompressMessage( netchan, msg );
 		if( zerror < 0 )
 		{          // compression error. Drop the packet
 			Com_DPrintf( "TV_Downstream_ProcessPacket: Compression error %i. Dropping packet\n", zerror );
@@ -96,7 +96,7 @@ void TV_Downstream_New_f( client_t *client )
 
 	// send the serverdata
 	MSG_WriteByte( &message, svc_serverdata );
-	MSG_WriteLong( &message, APP_PROTOCOL_VERSION );
+	MSG_WriteLong( &message, client->protocol );
 	if( !client->relay )
 	{
 		MSG_WriteLong( &message, tvs.lobby.spawncount );
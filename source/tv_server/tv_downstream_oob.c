@@ -197,7 +197,7 @@ static char *TV_Downstream_ShortInfoString( void )
 */
 static void TV_Downstream_InfoResponse( const socket_t *socket, const netadr_t *address )
 {
-	int i, count;
+	int i, count, version;
 	char *string;
 	bool allow_empty = false, allow_full = false;
 
@@ -208,7 +208,8 @@ static void TV_Downstream_InfoResponse( const socket_t *socket, const netadr_t *
 		return;
 
 	// different protocol version
-	if( atoi( Cmd_Argv( 1 ) ) != APP_PROTOCOL_VERSION )
+	version = atoi( Cmd_Argv( 1 ) );
+	if( version != APP_PROTOCOL_VERSION && version != APP_LEGACY_PROTOCOL_VERSION )
 		return;
 
 	// check for full/empty filtered states
@@ -274,7 +275,7 @@ static void TV_Downstream_GetStatusResponse( const socket_t *socket, const netad
 * TV_Downstream_ClientConnect
 */
 static bool TV_Downstream_ClientConnect( const socket_t *socket, const netadr_t *address, client_t *client,
-											char *userinfo, int game_port, int challenge, bool tv_client )
+											char *userinfo, int game_port, int challenge, int protocol, bool tv_client )
 {
 	assert( socket );
 	assert( address );
@@ -295,6 +296,7 @@ static bool TV_Downstream_ClientConnect( const socket_t *socket, const netadr_t
 
 	// the upstream is accepted, set up the client slot
 	client->challenge = challenge; // save challenge for checksumming
+	client->protocol = protocol;
 	client->tv = (tv_client ? true : false);
 
 	switch( socket->type )
@@ -356,7 +358,7 @@ static void TV_Downstream_DirectConnect( const socket_t *socket, const netadr_t
 	bool tv_client;
 
 	version = atoi( Cmd_Argv( 1 ) );
-	if( version != APP_PROTOCOL_VERSION )
+	if( version != APP_PROTOCOL_VERSION && version != APP_LEGACY_PROTOCOL_VERSION )
 	{
 		if( version <= 6 )
 		{            // before reject packet was added
@@ -496,7 +498,7 @@ static void TV_Downstream_DirectConnect( const socket_t *socket, const netadr_t
 	}
 
 	// get the game a chance to reject this upstream or modify the userinfo
-	if( !TV_Downstream_ClientConnect( socket, address, newcl, userinfo, game_port, challenge, tv_client ) )
+	if( !TV_Downstream_ClientConnect( socket, address, newcl, userinfo, game_port, challenge, version, tv_client ) )
 	{
 		char *rejtypeflag, *rejmsg;
 
@@ -35,6 +35,7 @@ typedef struct ginfo_s
 	int num_edicts;         // current number, <= max_edicts
 	int max_edicts;
 	int max_clients;		// <= sv_maxclients, <= max_edicts
+	int coord_bits;			// size of the bit-packed coordinates, 0 for the full range
 
 	struct edict_s *local_edicts;
 	int local_edict_size;
@@ -144,6 +145,7 @@ typedef struct client_s
 	bool reliable;                  // no need for acks, upstream is reliable
 	bool mv;                        // send multiview data to the client
 	bool individual_socket;         // client has it's own socket that has to be checked separately
+	int protocol;                   // bit-packed snapshots for APP_PROTOCOL_VERSION, see SNAP_WriteFrameSnapToClient
 
 	socket_t socket;
 
@@ -53,6 +53,7 @@ cvar_t *tv_zombietime;
 cvar_t *tv_maxclients;
 cvar_t *tv_maxmvclients;
 cvar_t *tv_compresspackets;
+cvar_t *tv_udpbatch;
 cvar_t *tv_name;
 cvar_t *tv_reconnectlimit; // minimum seconds between connect messages
 
@@ -101,6 +102,7 @@ void TV_Init( void )
 	tv_zombietime = Cvar_Get( "tv_zombietime", "2", 0 );
 	tv_name = Cvar_Get( "tv_name", APPLICATION "[TV]", CVAR_SERVERINFO | CVAR_ARCHIVE );
 	tv_compresspackets = Cvar_Get( "tv_compresspackets", "1", 0 );
+	tv_udpbatch = Cvar_Get( "tv_udpbatch", "1", CVAR_ARCHIVE | CVAR_NOSET );
 	tv_maxclients = Cvar_Get( "tv_maxclients", "64", CVAR_ARCHIVE | CVAR_SERVERINFO | CVAR_NOSET );
 	tv_maxmvclients = Cvar_Get( "tv_maxmvclients", "4", CVAR_ARCHIVE | CVAR_SERVERINFO | CVAR_NOSET );
 	tv_public = Cvar_Get( "tv_public", "1", CVAR_ARCHIVE | CVAR_SERVERINFO );
@@ -145,6 +147,10 @@ void TV_Init( void )
 			Com_Printf( "Error: Couldn't open UDP socket: %s\n", NET_ErrorString() );
 			Cvar_ForceSet( tv_udp->name, "0" );
 		}
+		else
+		{
+			NET_SetSocketBatching( &tvs.socket_udp, tv_udpbatch->integer ? true : false );
+		}
 	}
 
 	// IPv6
@@ -158,6 +164,10 @@ void TV_Init( void )
 		{
 			Com_Printf( "Error: Couldn't open UDP6 socket: %s\n", NET_ErrorString() );
 		}
+		else
+		{
+			NET_SetSocketBatching( &tvs.socket_udp6, tv_udpbatch->integer ? true : false );
+		}
 	}
 
 #ifdef TCP_ALLOW_TVCONNECT
@@ -211,6 +221,17 @@ void TV_Init( void )
 	TV_Downstream_InitMaster();
 }
 
+/*
+* TV_FlushPackets
+*
+* Sends the datagrams queued on the batching UDP sockets
+*/
+static void TV_FlushPackets( void )
+{
+	NET_FlushSocket( &tvs.socket_udp );
+	NET_FlushSocket( &tvs.socket_udp6 );
+}
+
 /*
 * TV_Frame
 */
@@ -243,6 +264,8 @@ void TV_Frame( int realmsec, int gamemsec )
 
 	TV_Downstream_MasterHeartbeat();
 
+	TV_FlushPackets();
+
 	Sys_Sleep( 5 );
 }
 
@@ -266,6 +289,8 @@ void TV_Shutdown( const char *finalmsg )
 	tvs.upstreams = NULL;
 	tvs.numupstreams = 0;
 
+	TV_FlushPackets();
+
 	TV_RemoveCommands();
 }
 
@@ -85,6 +85,8 @@ struct relay_s
 
 	cmodel_state_t *cms;
 	fatvis_t fatvis;
+	struct snap_viscache_s *viscache;	// shared culling results for spectators with the same PVS
+	struct snap_enccache_s *enccache;	// frame data encoded once for clients receiving the same deltas
 
 	ginfo_t gi;
 	int num_active_specs;
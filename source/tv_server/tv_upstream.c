@@ -165,7 +165,7 @@ static void TV_Upstream_Netchan_Transmit( upstream_t *upstream, msg_t *msg )
 
 	// do not enable client compression until I fix the compression+fragmentation rare case bug
 	/*if( cl_compresspackets->integer ) {
-	zerror = Netchan_CompressMessage( msg );
+	zerror = Netchan_CompressMessage( &upstream->netchan, msg );
 	if( zerror < 0 ) {  // it's compression error, just send uncompressed
 	Com_DPrintf( "TV_Upstream_Netchan_Transmit (ignoring compression): Compression error %i\n", zerror );
 	}
@@ -192,7 +192,7 @@ static bool TV_Upstream_ProcessPacket( netchan_t *netchan, msg_t *msg )
 	/*sequence_ack = */MSG_ReadLong( msg );
 	if( msg->compressed )
 	{
-		zerror = Netchan_DecompressMessage( msg );
+		zerror = Netchan_DecompressMessage( netchan, msg );
 		if( zerror < 0 )
 		{          // compression error. Drop the packet
 			Com_Printf( "Compression error %i. Dropping packet\n", zerror );
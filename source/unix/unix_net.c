@@ -18,6 +18,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 */
 
+#if defined ( __linux__ ) && !defined ( _GNU_SOURCE )
+#define _GNU_SOURCE		// recvmmsg, sendmmsg
+#endif
+
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -53,6 +57,7 @@ net_error_t Sys_NET_GetLastError( void )
 	case ECONNREFUSED:	return NET_ERR_CONNRESET;
 	case EWOULDBLOCK:	return NET_ERR_WOULDBLOCK;
 	case EINPROGRESS:	return NET_ERR_INPROGRESS;
+	case ENOSYS:		return NET_ERR_UNSUPPORTED;
 	default:			return NET_ERR_UNKNOWN;
 	}
 }
@@ -108,6 +113,87 @@ int64_t Sys_NET_SendFile( socket_handle_t handle, int fileno, size_t offset, siz
 	return len;
 }
 
+#if defined ( __linux__ ) && defined ( MSG_WAITFORONE )
+#define SYS_NET_MAX_MMSG	64
+#endif
+
+/*
+* Sys_NET_RecvMultiple
+*
+* Returns the number of datagrams received or SOCKET_ERROR
+*/
+int Sys_NET_RecvMultiple( socket_handle_t handle, net_datagram_t *datagrams, int count )
+{
+#ifdef SYS_NET_MAX_MMSG
+	int i, ret;
+	struct mmsghdr msgs[SYS_NET_MAX_MMSG];
+	struct iovec iovecs[SYS_NET_MAX_MMSG];
+
+	if( count > SYS_NET_MAX_MMSG )
+		count = SYS_NET_MAX_MMSG;
+
+	memset( msgs, 0, sizeof( msgs[0] ) * count );
+	for( i = 0; i < count; i++ )
+	{
+		iovecs[i].iov_base = datagrams[i].data;
+		iovecs[i].iov_len = datagrams[i].size;
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = datagrams[i].addr;
+		msgs[i].msg_hdr.msg_namelen = sizeof( struct sockaddr_storage );
+	}
+
+	ret = recvmmsg( handle, msgs, count, MSG_DONTWAIT, NULL );
+	if( ret < 0 )
+		return SOCKET_ERROR;
+
+	for( i = 0; i < ret; i++ )
+	{
+		datagrams[i].length = msgs[i].msg_len;
+		datagrams[i].addrlen = msgs[i].msg_hdr.msg_namelen;
+		datagrams[i].truncated = ( msgs[i].msg_hdr.msg_flags & MSG_TRUNC ) ? true : false;
+	}
+
+	return ret;
+#else
+	errno = ENOSYS;
+	return SOCKET_ERROR;
+#endif
+}
+
+/*
+* Sys_NET_SendMultiple
+*
+* Returns the number of datagrams sent or SOCKET_ERROR if the first one failed
+*/
+int Sys_NET_SendMultiple( socket_handle_t handle, const net_datagram_t *datagrams, int count )
+{
+#ifdef SYS_NET_MAX_MMSG
+	int i;
+	struct mmsghdr msgs[SYS_NET_MAX_MMSG];
+	struct iovec iovecs[SYS_NET_MAX_MMSG];
+
+	if( count > SYS_NET_MAX_MMSG )
+		count = SYS_NET_MAX_MMSG;
+
+	memset( msgs, 0, sizeof( msgs[0] ) * count );
+	for( i = 0; i < count; i++ )
+	{
+		iovecs[i].iov_base = datagrams[i].data;
+		iovecs[i].iov_len = datagrams[i].length;
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = datagrams[i].addr;
+		msgs[i].msg_hdr.msg_namelen = datagrams[i].addrlen;
+	}
+
+	return sendmmsg( handle, msgs, count, MSG_NOSIGNAL );
+#else
+	errno = ENOSYS;
+	return SOCKET_ERROR;
+#endif
+}
+
 //===================================================================
 
 /*
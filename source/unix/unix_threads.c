@@ -36,6 +36,10 @@ struct qcondvar_s {
 	pthread_cond_t c;
 };
 
+struct qthreadkey_s {
+	pthread_key_t k;
+};
+
 /*
 * Sys_Mutex_Create
 */
@@ -210,3 +214,31 @@ void Sys_CondVar_Wake( qcondvar_t *cond )
 	}
 	pthread_cond_signal( &cond->c );
 }
+
+/*
+* Sys_ThreadKey_Create
+*/
+int Sys_ThreadKey_Create( qthreadkey_t **pkey, void ( *destructor )( void * ) )
+{
+	qthreadkey_t *key;
+	pthread_key_t k;
+	int res;
+
+	res = pthread_key_create( &k, destructor );
+	if( res != 0 ) {
+		return res;
+	}
+
+	key = ( qthreadkey_t * )Q_malloc( sizeof( *key ) );
+	key->k = k;
+	*pkey = key;
+	return 0;
+}
+
+/*
+* Sys_ThreadKey_Set
+*/
+void Sys_ThreadKey_Set( qthreadkey_t *key, void *value )
+{
+	pthread_setspecific( key->k, value );
+}
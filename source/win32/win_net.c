@@ -47,6 +47,7 @@ net_error_t Sys_NET_GetLastError( void )
 	case WSAECONNRESET:		return NET_ERR_CONNRESET;
 	case WSAEWOULDBLOCK:	return NET_ERR_WOULDBLOCK;
 	case WSAEAFNOSUPPORT:	return NET_ERR_UNSUPPORTED;
+	case WSAEOPNOTSUPP:		return NET_ERR_UNSUPPORTED;
 	case ERROR_IO_PENDING:	return NET_ERR_WOULDBLOCK;
 	default:				return NET_ERR_UNKNOWN;
 	}
@@ -97,6 +98,24 @@ int64_t Sys_NET_SendFile( socket_handle_t handle, int fileno, size_t offset, siz
 	return sent;
 }
 
+/*
+* Sys_NET_RecvMultiple
+*/
+int Sys_NET_RecvMultiple( socket_handle_t handle, net_datagram_t *datagrams, int count )
+{
+	WSASetLastError( WSAEOPNOTSUPP );
+	return SOCKET_ERROR;
+}
+
+/*
+* Sys_NET_SendMultiple
+*/
+int Sys_NET_SendMultiple( socket_handle_t handle, const net_datagram_t *datagrams, int count )
+{
+	WSASetLastError( WSAEOPNOTSUPP );
+	return SOCKET_ERROR;
+}
+
 //===================================================================
 
 /*
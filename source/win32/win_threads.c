@@ -34,6 +34,21 @@ struct qcondvar_s {
 	HANDLE e;
 };
 
+// fiber local storage is used for thread keys since it calls back on thread exit
+struct qthreadkey_s {
+	DWORD index;
+	void ( *destructor )( void * );
+};
+
+typedef struct {
+	qthreadkey_t *key;
+	void *value;
+} qthreadkeyvalue_t;
+
+static DWORD ( WINAPI *pFlsAlloc )( PFLS_CALLBACK_FUNCTION lpCallback );
+static BOOL ( WINAPI *pFlsSetValue )( DWORD dwFlsIndex, PVOID lpFlsData );
+static PVOID ( WINAPI *pFlsGetValue )( DWORD dwFlsIndex );
+
 static void ( WINAPI *pInitializeConditionVariable )( PCONDITION_VARIABLE ConditionVariable );
 static void ( WINAPI *pWakeConditionVariable )( PCONDITION_VARIABLE ConditionVariable );
 static BOOL ( WINAPI *pSleepConditionVariableCS )( PCONDITION_VARIABLE ConditionVariable,
@@ -290,6 +305,75 @@ void Sys_CondVar_Wake( qcondvar_t *cond )
 	}
 }
 
+/*
+* Sys_ThreadKey_Callback
+*/
+static VOID WINAPI Sys_ThreadKey_Callback( PVOID data )
+{
+	qthreadkeyvalue_t *kv = ( qthreadkeyvalue_t * )data;
+
+	if( kv ) {
+		kv->key->destructor( kv->value );
+		Q_free( kv );
+	}
+}
+
+/*
+* Sys_ThreadKey_Create
+*
+* Called before Sys_InitThreads by the memory system, so it looks up the FLS functions itself
+*/
+int Sys_ThreadKey_Create( qthreadkey_t **pkey, void ( *destructor )( void * ) )
+{
+	qthreadkey_t *key;
+	DWORD index;
+
+	if( !pFlsAlloc ) {
+		HMODULE kernel32Dll = GetModuleHandle( "kernel32.dll" );
+		if( kernel32Dll ) {
+			pFlsGetValue = ( void * )GetProcAddress( kernel32Dll, "FlsGetValue" );
+			pFlsSetValue = ( void * )GetProcAddress( kernel32Dll, "FlsSetValue" );
+			pFlsAlloc = ( void * )GetProcAddress( kernel32Dll, "FlsAlloc" );
+		}
+		if( !pFlsAlloc || !pFlsSetValue || !pFlsGetValue ) {
+			pFlsAlloc = NULL;
+			return ERROR_CALL_NOT_IMPLEMENTED;
+		}
+	}
+
+	index = pFlsAlloc( Sys_ThreadKey_Callback );
+	if( index == FLS_OUT_OF_INDEXES ) {
+		return GetLastError();
+	}
+
+	key = ( qthreadkey_t * )Q_malloc( sizeof( *key ) );
+	key->index = index;
+	key->destructor = destructor;
+	*pkey = key;
+	return 0;
+}
+
+/*
+* Sys_ThreadKey_Set
+*/
+void Sys_ThreadKey_Set( qthreadkey_t *key, void *value )
+{
+	qthreadkeyvalue_t *kv = ( qthreadkeyvalue_t * )pFlsGetValue( key->index );
+
+	if( !value ) {
+		Q_free( kv );
+		pFlsSetValue( key->index, NULL );
+		return;
+	}
+
+	if( !kv ) {
+		kv = ( qthreadkeyvalue_t * )Q_malloc( sizeof( *kv ) );
+		kv->key = key;
+		pFlsSetValue( key->index, kv );
+	}
+	kv->value = value;
+}
+
 /*
 * Sys_InitThreads
 */